@@ -0,0 +1,109 @@
+#define _GNU_SOURCE
+
+#include "job_stats.h"
+
+#include "monitoring.h"
+#include "collectors.h"
+#include "adaptive_rate.h"
+
+
+Adaptive_Rate * init_adaptive_rate(long full_period_ns, long base_period_ns, double threshold_pct, int n_fields, unsigned short * field_ids){
+
+	if ((full_period_ns <= 0) || (base_period_ns < full_period_ns) || ((base_period_ns % full_period_ns) != 0)){
+		fprintf(stderr, "Adaptive base period (%ld ms) has to be a multiple of the sample period (%ld ms)\n", base_period_ns / 1000000, full_period_ns / 1000000);
+		return NULL;
+	}
+
+	Adaptive_Rate * adaptive_rate = (Adaptive_Rate *) calloc(1, sizeof(Adaptive_Rate));
+	if (adaptive_rate == NULL){
+		fprintf(stderr, "Could not allocate memory for adaptive rate\n");
+		return NULL;
+	}
+
+	adaptive_rate -> full_period_ns = full_period_ns;
+	adaptive_rate -> base_period_ns = base_period_ns;
+	adaptive_rate -> threshold_pct = threshold_pct;
+	adaptive_rate -> idle_hold_ticks = (int) ((ADAPTIVE_IDLE_HOLD_MILLIS * 1000000L) / full_period_ns);
+	if (adaptive_rate -> idle_hold_ticks < 1){
+		adaptive_rate -> idle_hold_ticks = 1;
+	}
+
+	unsigned short gpu_fields[N_ADAPTIVE_GPU_FIELDS] = ADAPTIVE_GPU_FIELDS;
+	adaptive_rate -> gpu_field_num = -1;
+	for (int k = 0; (k < N_ADAPTIVE_GPU_FIELDS) && (adaptive_rate -> gpu_field_num == -1); k++){
+		for (int i = 0; i < n_fields; i++){
+			if (field_ids[i] == gpu_fields[k]){
+				adaptive_rate -> gpu_field_num = i;
+				break;
+			}
+		}
+	}
+	if (adaptive_rate -> gpu_field_num == -1){
+		fprintf(stderr, "No GPU activity field is watched, the adaptive rate only follows cpu and jobs\n");
+	}
+
+	return adaptive_rate;
+}
+
+bool is_sample_active(Adaptive_Rate * adaptive_rate, Samples_Buffer * samples_buffer, int sample, int n_job_events){
+
+	if (n_job_events > 0){
+		return true;
+	}
+
+	// sources that didn't run this tick hold 0, only the ones that did can show activity
+	unsigned int skipped = samples_buffer -> skipped_collectors[sample];
+
+	// slots are filled from the front, one job is enough
+	if ((samples_buffer -> max_jobs > 0) && !(skipped & COLLECTOR_BIT(COLLECTOR_JOBS)) && (samples_buffer -> job_samples[sample * samples_buffer -> max_jobs].job_id != 0)){
+		return true;
+	}
+
+	if (!(skipped & COLLECTOR_BIT(COLLECTOR_PROC)) && (samples_buffer -> cpu_util[sample].util_pct >= adaptive_rate -> threshold_pct)){
+		return true;
+	}
+
+	int field_num = adaptive_rate -> gpu_field_num;
+	if ((field_num == -1) || (skipped & COLLECTOR_BIT(COLLECTOR_GPU))){
+		return false;
+	}
+	// fractions (0-1) for doubles, percent for GPU_UTIL
+	bool is_fraction = (samples_buffer -> field_types[field_num] == GPU_FT_DOUBLE);
+	void * field_column;
+	double busy_pct;
+	for (int gpuId = 0; gpuId < samples_buffer -> n_devices; gpuId++){
+		field_column = FIELD_COLUMN(samples_buffer, gpuId * samples_buffer -> n_fields + field_num);
+		// no value (e.g. SM_ACTIVE without profiling support) isn't activity
+		if (IS_GPU_VALUE_BLANK(field_column, sample, samples_buffer -> field_types[field_num])){
+			continue;
+		}
+		if (is_fraction){
+			busy_pct = ((double *) field_column)[sample] * 100;
+		}
+		else {
+			busy_pct = (double) ((long *) field_column)[sample];
+		}
+		if (busy_pct >= adaptive_rate -> threshold_pct){
+			return true;
+		}
+	}
+	return false;
+}
+
+void update_adaptive_rate(Adaptive_Rate * adaptive_rate, Tick_Scheduler * scheduler, bool active){
+
+	if (active){
+		adaptive_rate -> n_idle_ticks = 0;
+		if (scheduler -> period_ns != adaptive_rate -> full_period_ns){
+			set_tick_period(scheduler, adaptive_rate -> full_period_ns);
+			adaptive_rate -> n_speedups++;
+		}
+		return;
+	}
+
+	adaptive_rate -> n_idle_ticks++;
+	if ((adaptive_rate -> n_idle_ticks >= adaptive_rate -> idle_hold_ticks) && (scheduler -> period_ns != adaptive_rate -> base_period_ns)){
+		set_tick_period(scheduler, adaptive_rate -> base_period_ns);
+		adaptive_rate -> n_slowdowns++;
+	}
+}
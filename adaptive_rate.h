@@ -0,0 +1,52 @@
+#ifndef ADAPTIVE_RATE_H
+#define ADAPTIVE_RATE_H
+
+#include "scheduler.h"
+
+// ADAPTIVE SAMPLING RATE (-a, --adaptive_base_millis=<int>)
+//	- a node is idle when every GPU and the CPU are below the threshold, no job has a cgroup
+//	  (with -j) and no job event arrived (with -e), anything else is activity
+//	- after ADAPTIVE_IDLE_HOLD_MILLIS of idle samples the sampler drops to the base period, the
+//	  first sample that sees activity puts it back on the full period for the very next tick
+//	- the base period is a multiple of the full one, so every tick stays on the full-rate grid
+//	- every sample records the period it covers (Samples_Buffer -> periods_ms, stored as the
+//	  period_ms host metric), so rates are value / period_ms and integrals value * period_ms
+//	- GPU activity is the first of ADAPTIVE_GPU_FIELDS that is watched (none: CPU and jobs only)
+//	- only sources that ran for the sample count (see collectors.h), a sample where none of them
+//	  ran counts as idle
+
+// idle time at the full rate before dropping to the base period
+#define ADAPTIVE_IDLE_HOLD_MILLIS 5000
+
+// default for -A, --adaptive_threshold_pct
+#define ADAPTIVE_DEFAULT_THRESHOLD_PCT 5.0
+
+// GPU_UTIL, SM_ACTIVE, GR_ENGINE_ACTIVE (in order of preference)
+#define N_ADAPTIVE_GPU_FIELDS 3
+#define ADAPTIVE_GPU_FIELDS {203, 1002, 1001}
+
+typedef struct adaptive_rate {
+	long full_period_ns;
+	long base_period_ns;
+	double threshold_pct;
+	// consecutive idle samples before dropping to the base period
+	int idle_hold_ticks;
+	int n_idle_ticks;
+	// index into the field list of the GPU activity field, -1 if none is watched
+	int gpu_field_num;
+	// number of switches to the base period and back to the full one
+	long n_slowdowns;
+	long n_speedups;
+} Adaptive_Rate;
+
+
+// NULL if base_period_ns isn't a multiple of full_period_ns (or on allocation failure)
+Adaptive_Rate * init_adaptive_rate(long full_period_ns, long base_period_ns, double threshold_pct, int n_fields, unsigned short * field_ids);
+
+// activity in sample of samples_buffer (CPU util, GPU field, job slots), n_job_events from process_job_events
+bool is_sample_active(Adaptive_Rate * adaptive_rate, Samples_Buffer * samples_buffer, int sample, int n_job_events);
+
+// sets the period of the next tick on scheduler, call before end_tick
+void update_adaptive_rate(Adaptive_Rate * adaptive_rate, Tick_Scheduler * scheduler, bool active);
+
+#endif
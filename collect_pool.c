@@ -0,0 +1,155 @@
+#define _GNU_SOURCE
+
+#include "job_stats.h"
+
+#include "collect_pool.h"
+
+
+static long now_ns(){
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+// takes tasks until none are left, called by every thread of the tick
+static void run_pending_tasks(Collect_Pool * collect_pool){
+
+	int task_id;
+	long start_ns;
+	Collect_Task * task;
+	while ((task_id = __atomic_fetch_add(&(collect_pool -> next_task), 1, __ATOMIC_RELAXED)) < N_COLLECT_TASKS){
+		task = &(collect_pool -> tasks[task_id]);
+		if ((!task -> due) || (task -> function == NULL)){
+			continue;
+		}
+		start_ns = now_ns();
+		task -> ret = (task -> function)(task -> ctx);
+		task -> duration_ns = now_ns() - start_ns;
+	}
+}
+
+static void * collect_worker_main(void * arg){
+
+	Collect_Pool * collect_pool = (Collect_Pool *) arg;
+
+	// stop is set here if another worker could not be started
+	pthread_mutex_lock(&(collect_pool -> start_lock));
+	bool stop = collect_pool -> stop;
+	pthread_mutex_unlock(&(collect_pool -> start_lock));
+	if (stop){
+		return NULL;
+	}
+
+	// the barriers order everything the tasks write before the sampling thread reads it
+	while (true){
+		pthread_barrier_wait(&(collect_pool -> start_barrier));
+		if (collect_pool -> stop){
+			break;
+		}
+		run_pending_tasks(collect_pool);
+		pthread_barrier_wait(&(collect_pool -> end_barrier));
+	}
+
+	return NULL;
+}
+
+Collect_Pool * init_collect_pool(int n_workers){
+
+	if (n_workers < 0){
+		fprintf(stderr, "Collection threads can't be negative\n");
+		return NULL;
+	}
+
+	Collect_Pool * collect_pool = (Collect_Pool *) calloc(1, sizeof(Collect_Pool));
+	if (collect_pool == NULL){
+		fprintf(stderr, "Could not allocate memory for collection pool\n");
+		return NULL;
+	}
+	collect_pool -> n_workers = n_workers;
+	if (n_workers == 0){
+		return collect_pool;
+	}
+
+	collect_pool -> workers = (pthread_t *) malloc(n_workers * sizeof(pthread_t));
+	if (collect_pool -> workers == NULL){
+		fprintf(stderr, "Could not allocate memory for collection pool\n");
+		free(collect_pool);
+		return NULL;
+	}
+
+	pthread_barrier_init(&(collect_pool -> start_barrier), NULL, n_workers + 1);
+	pthread_barrier_init(&(collect_pool -> end_barrier), NULL, n_workers + 1);
+	pthread_mutex_init(&(collect_pool -> start_lock), NULL);
+
+	int ret = 0;
+	int n_started;
+	pthread_mutex_lock(&(collect_pool -> start_lock));
+	for (n_started = 0; n_started < n_workers; n_started++){
+		ret = pthread_create(&(collect_pool -> workers[n_started]), NULL, collect_worker_main, (void *) collect_pool);
+		if (ret != 0){
+			fprintf(stderr, "Could not start collection thread: %s\n", strerror(ret));
+			// the ones already started exit before the barriers
+			collect_pool -> stop = true;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&(collect_pool -> start_lock));
+
+	if (ret != 0){
+		for (int i = 0; i < n_started; i++){
+			pthread_join(collect_pool -> workers[i], NULL);
+		}
+		pthread_barrier_destroy(&(collect_pool -> start_barrier));
+		pthread_barrier_destroy(&(collect_pool -> end_barrier));
+		pthread_mutex_destroy(&(collect_pool -> start_lock));
+		free(collect_pool -> workers);
+		free(collect_pool);
+		return NULL;
+	}
+
+	return collect_pool;
+}
+
+void destroy_collect_pool(Collect_Pool * collect_pool){
+
+	if (collect_pool -> n_workers > 0){
+		collect_pool -> stop = true;
+		pthread_barrier_wait(&(collect_pool -> start_barrier));
+		for (int i = 0; i < collect_pool -> n_workers; i++){
+			pthread_join(collect_pool -> workers[i], NULL);
+		}
+		pthread_barrier_destroy(&(collect_pool -> start_barrier));
+		pthread_barrier_destroy(&(collect_pool -> end_barrier));
+		pthread_mutex_destroy(&(collect_pool -> start_lock));
+	}
+
+	free(collect_pool -> workers);
+	free(collect_pool);
+}
+
+void set_collect_task(Collect_Pool * collect_pool, Collect_Task_Id task_id, Collect_Task_Function function, void * ctx){
+	collect_pool -> tasks[task_id].function = function;
+	collect_pool -> tasks[task_id].ctx = ctx;
+}
+
+long run_collect_tasks(Collect_Pool * collect_pool){
+
+	long start_ns = now_ns();
+
+	for (int i = 0; i < N_COLLECT_TASKS; i++){
+		collect_pool -> tasks[i].ret = 0;
+		collect_pool -> tasks[i].duration_ns = 0;
+	}
+	collect_pool -> next_task = 0;
+
+	if (collect_pool -> n_workers == 0){
+		run_pending_tasks(collect_pool);
+		return now_ns() - start_ns;
+	}
+
+	pthread_barrier_wait(&(collect_pool -> start_barrier));
+	run_pending_tasks(collect_pool);
+	pthread_barrier_wait(&(collect_pool -> end_barrier));
+
+	return now_ns() - start_ns;
+}
@@ -0,0 +1,71 @@
+#ifndef COLLECT_POOL_H
+#define COLLECT_POOL_H
+
+#include <pthread.h>
+
+// CONCURRENT COLLECTION WITHIN A TICK (-T, --collect_threads=<int>)
+//	- the collection of a tick is split into independent tasks that write disjoint columns of
+//	  the sample: the GPU update (dcgmUpdateAllFields blocks), /proc/stat + memory, the network
+//	  counters and the job cgroups
+//	- n_workers threads plus the sampling thread pull the tick's due tasks off a shared index,
+//	  the sample is complete once everyone is through one barrier, so the collection takes as
+//	  long as the slowest task instead of the sum
+//	- n_workers = 0 runs the tasks one after the other on the sampling thread (no threads)
+//	- every task is timed, the scheduler keeps the per-stage and whole-collection latencies (see Tick_Stats)
+
+// in order of how long they usually block, so the slow ones start first
+typedef enum collect_task_id {
+	COLLECT_TASK_GPU,
+	COLLECT_TASK_PROC,
+	COLLECT_TASK_NET,
+	COLLECT_TASK_JOBS,
+	N_COLLECT_TASKS
+} Collect_Task_Id;
+
+// stage names stored with the tick stats (Tick_Stages), same order as Collect_Task_Id
+#define COLLECT_TASK_NAMES {"gpu", "proc", "net", "jobs"}
+
+// default for -T: one worker per task besides the one the sampling thread runs
+#define DEFAULT_COLLECT_WORKERS (N_COLLECT_TASKS - 1)
+
+// returns -1 on a fatal error
+typedef int (*Collect_Task_Function)(void * ctx);
+
+typedef struct collect_task {
+	Collect_Task_Function function;
+	void * ctx;
+	// set by the caller every tick
+	bool due;
+	// RESULT OF THE LAST RUN
+	int ret;
+	long duration_ns;
+} Collect_Task;
+
+typedef struct collect_pool {
+	int n_workers;
+	pthread_t * workers;
+	// workers + sampling thread, start releases the workers, end is the merge
+	pthread_barrier_t start_barrier;
+	pthread_barrier_t end_barrier;
+	// held while the workers are created, they reach the barriers only once all of them exist
+	pthread_mutex_t start_lock;
+	bool stop;
+	// next task to take (atomic)
+	int next_task;
+	Collect_Task tasks[N_COLLECT_TASKS];
+} Collect_Pool;
+
+
+// starts n_workers threads, NULL on failure
+Collect_Pool * init_collect_pool(int n_workers);
+
+// stops and joins the workers
+void destroy_collect_pool(Collect_Pool * collect_pool);
+
+void set_collect_task(Collect_Pool * collect_pool, Collect_Task_Id task_id, Collect_Task_Function function, void * ctx);
+
+// runs every task with due set (the calling thread takes part) and returns once all are done
+// with the wall time of the whole collection in ns, each task's ret / duration_ns are updated
+long run_collect_tasks(Collect_Pool * collect_pool);
+
+#endif
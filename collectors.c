@@ -0,0 +1,157 @@
+#define _GNU_SOURCE
+
+#include "job_stats.h"
+
+#include "monitoring.h"
+#include "collectors.h"
+
+
+// same order as Collector_Id
+static const char * collector_names[N_COLLECTORS] = {"proc", "meminfo", "net", "gpu", "jobs"};
+
+static void insert_collector(Collector_Wheel * collector_wheel, Collector * collector){
+
+	Collector ** slot = &(collector_wheel -> slots[collector -> due_tick & (TIMER_WHEEL_SLOTS - 1)]);
+	collector -> next = *slot;
+	*slot = collector;
+}
+
+// "<name>=<millis>[+<phase_millis>]" into the collector, -1 on a bad entry
+static int parse_collector_period(Collector_Wheel * collector_wheel, char * entry){
+
+	char * value = strchr(entry, '=');
+	if (value == NULL){
+		fprintf(stderr, "Collector period \"%s\" is not <name>=<millis>\n", entry);
+		return -1;
+	}
+	*value = '\0';
+	value++;
+
+	Collector * collector = NULL;
+	for (int i = 0; i < N_COLLECTORS; i++){
+		if (strcmp(entry, collector_names[i]) == 0){
+			collector = &(collector_wheel -> collectors[i]);
+			break;
+		}
+	}
+	if (collector == NULL){
+		fprintf(stderr, "Unknown collector: %s (proc, meminfo, net, gpu or jobs)\n", entry);
+		return -1;
+	}
+
+	char * end;
+	long tick_ms = collector_wheel -> tick_ns / 1000000;
+	long period_ms = strtol(value, &end, 10);
+	long phase_ms = 0;
+	if (*end == '+'){
+		phase_ms = strtol(end + 1, &end, 10);
+	}
+	if ((*end != '\0') || (period_ms <= 0) || ((period_ms % tick_ms) != 0) || (phase_ms < 0) || ((phase_ms % tick_ms) != 0) || (phase_ms >= period_ms)){
+		fprintf(stderr, "Collector %s: period has to be a multiple of the sample period (%ld ms), phase a multiple smaller than the period\n", collector -> name, tick_ms);
+		return -1;
+	}
+
+	collector -> period = period_ms / tick_ms;
+	collector -> phase = phase_ms / tick_ms;
+	return 0;
+}
+
+Collector_Wheel * init_collector_wheel(long tick_ns, char * periods_str){
+
+	if ((tick_ns <= 0) || ((tick_ns % 1000000) != 0)){
+		fprintf(stderr, "Invalid collector tick: %ld ns\n", tick_ns);
+		return NULL;
+	}
+
+	Collector_Wheel * collector_wheel = (Collector_Wheel *) calloc(1, sizeof(Collector_Wheel));
+	if (collector_wheel == NULL){
+		fprintf(stderr, "Could not allocate memory for collector wheel\n");
+		return NULL;
+	}
+	collector_wheel -> tick_ns = tick_ns;
+	collector_wheel -> cur_tick = -1;
+
+	Collector * collector;
+	for (int i = 0; i < N_COLLECTORS; i++){
+		collector = &(collector_wheel -> collectors[i]);
+		collector -> id = (Collector_Id) i;
+		collector -> name = collector_names[i];
+		collector -> period = 1;
+		collector -> phase = 0;
+	}
+
+	if (periods_str != NULL){
+		char * periods_copy = strdup(periods_str);
+		char * cur = periods_copy;
+		char * entry;
+		int err = 0;
+		while ((err == 0) && ((entry = strsep(&cur, ",")) != NULL)){
+			if (*entry != '\0'){
+				err = parse_collector_period(collector_wheel, entry);
+			}
+		}
+		free(periods_copy);
+		if (err == -1){
+			free(collector_wheel);
+			return NULL;
+		}
+	}
+
+	// everything phase 0 runs on the first tick
+	for (int i = 0; i < N_COLLECTORS; i++){
+		collector = &(collector_wheel -> collectors[i]);
+		collector -> due_tick = collector -> phase;
+		insert_collector(collector_wheel, collector);
+	}
+
+	return collector_wheel;
+}
+
+unsigned int advance_collector_wheel(Collector_Wheel * collector_wheel, long elapsed_ns){
+
+	long n_advance = elapsed_ns / collector_wheel -> tick_ns;
+	if (n_advance < 1){
+		n_advance = 1;
+	}
+	long first_tick = collector_wheel -> cur_tick + 1;
+	long tick = collector_wheel -> cur_tick + n_advance;
+	collector_wheel -> cur_tick = tick;
+
+	// a jump of more than a lap looks at every slot once
+	long n_slots = (n_advance < TIMER_WHEEL_SLOTS) ? n_advance : TIMER_WHEEL_SLOTS;
+
+	unsigned int due_mask = 0;
+	Collector * due_list = NULL;
+	Collector ** link;
+	Collector * collector;
+	for (long t = first_tick; t < first_tick + n_slots; t++){
+		link = &(collector_wheel -> slots[t & (TIMER_WHEEL_SLOTS - 1)]);
+		while (*link != NULL){
+			collector = *link;
+			// later lap
+			if (collector -> due_tick > tick){
+				link = &(collector -> next);
+				continue;
+			}
+			*link = collector -> next;
+			collector -> next = due_list;
+			due_list = collector;
+		}
+	}
+
+	// run once (coalesced) and move to the first due tick after this one
+	while (due_list != NULL){
+		collector = due_list;
+		due_list = collector -> next;
+		due_mask |= COLLECTOR_BIT(collector -> id);
+		collector -> n_runs++;
+		collector -> due_tick += ((tick - collector -> due_tick) / collector -> period + 1) * collector -> period;
+		insert_collector(collector_wheel, collector);
+	}
+
+	return due_mask;
+}
+
+long get_collector_period_millis(Collector_Wheel * collector_wheel, Collector_Id id){
+	return collector_wheel -> collectors[id].period * (collector_wheel -> tick_ns / 1000000);
+}
@@ -0,0 +1,65 @@
+#ifndef COLLECTORS_H
+#define COLLECTORS_H
+
+// COLLECTORS (-R, --collector_periods=<name>=<millis>[+<phase_millis>],...)
+//	- every source of the sampling loop has its own period and phase offset, a multiple of the
+//	  tick (-s, --sample_freq_millis, so the tick is the fastest any source can run)
+//	- proc: /proc/stat util (+ per-core and --cpu_time), meminfo: free / used memory,
+//	  net: interface totals and per-port series, gpu: every watched field, jobs: job cgroups
+//	- sources not given keep the tick, a source runs on the ticks where
+//	  (tick - phase) % period == 0 (ticks count on the full-rate grid, so they keep their
+//	  wall-clock period under --adaptive_base_millis, due sources are coalesced into the next tick)
+//	- a sample records the sources that didn't run (Samples_Buffer -> skipped_collectors),
+//	  storage writes no rows (eav, Gpu_Samples, Cpu_Core_Samples, Job_Samples, Port_Samples)
+//	  or NULL columns (Host_Samples) for them, values that are deltas cover the time since the
+//	  source's previous run
+//
+// Scheduling is a hashed timer wheel: a source sits in slot due_tick % TIMER_WHEEL_SLOTS and only
+// the slots the tick moved over are looked at, however many sources are registered.
+
+typedef enum collector_id {
+	COLLECTOR_PROC,
+	COLLECTOR_MEMINFO,
+	COLLECTOR_NET,
+	COLLECTOR_GPU,
+	COLLECTOR_JOBS,
+	N_COLLECTORS
+} Collector_Id;
+
+#define COLLECTOR_BIT(id) (1U << (id))
+#define ALL_COLLECTORS ((1U << N_COLLECTORS) - 1)
+
+// power of 2
+#define TIMER_WHEEL_SLOTS 64
+
+typedef struct collector {
+	Collector_Id id;
+	const char * name;
+	// in ticks
+	long period;
+	long phase;
+	long due_tick;
+	long n_runs;
+	// next collector in the same wheel slot
+	struct collector * next;
+} Collector;
+
+typedef struct collector_wheel {
+	long tick_ns;
+	// tick of the last advance on the full-rate grid, -1 before the first one
+	long cur_tick;
+	Collector collectors[N_COLLECTORS];
+	Collector * slots[TIMER_WHEEL_SLOTS];
+} Collector_Wheel;
+
+
+// periods_str as above (NULL: every source on every tick), NULL if a period isn't a multiple of tick_ns or a name is unknown
+Collector_Wheel * init_collector_wheel(long tick_ns, char * periods_str);
+
+// moves the wheel by elapsed_ns (Tick_Scheduler -> sample_period_ns) and returns the COLLECTOR_BITs due on this tick
+unsigned int advance_collector_wheel(Collector_Wheel * collector_wheel, long elapsed_ns);
+
+// period of a source in ms
+long get_collector_period_millis(Collector_Wheel * collector_wheel, Collector_Id id);
+
+#endif
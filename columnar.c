@@ -0,0 +1,770 @@
+#define _GNU_SOURCE
+
+#include "job_stats.h"
+
+#include "monitoring.h"
+#include "columnar.h"
+
+
+// HOST COLUMN ORDER (same as the host metrics in storage.c)
+//	- 0 = mem_used_pct, 1 = free_mem, 2 = util_pct, 3..8 = net deltas, 9 = period_ms, 10 = skipped_collectors
+static const unsigned short host_column_types[N_COLUMNAR_HOST_COLUMNS] = {
+	GPU_FT_DOUBLE, GPU_FT_INT64, GPU_FT_DOUBLE,
+	GPU_FT_INT64, GPU_FT_INT64, GPU_FT_INT64, GPU_FT_INT64, GPU_FT_INT64, GPU_FT_INT64,
+	GPU_FT_INT64, GPU_FT_INT64
+};
+
+// host columns written by each version, the ones a version doesn't have are the last ones
+static int get_n_host_columns(int version){
+	if (version < 3){
+		return N_COLUMNAR_HOST_COLUMNS - (3 - version);
+	}
+	return N_COLUMNAR_HOST_COLUMNS;
+}
+
+
+/* BIT LEVEL BUFFERS */
+
+typedef struct bit_buffer {
+	unsigned char * data;
+	size_t len;
+	size_t cap;
+	// bits used in the last byte, 0 means the next bit starts a new byte
+	int n_bits;
+} Bit_Buffer;
+
+typedef struct bit_reader {
+	const unsigned char * data;
+	size_t len;
+	size_t bit_pos;
+	bool overrun;
+} Bit_Reader;
+
+static int ensure_capacity(Bit_Buffer * buf, size_t extra){
+
+	if (buf -> len + extra <= buf -> cap){
+		return 0;
+	}
+
+	size_t new_cap = (buf -> cap == 0) ? 4096 : buf -> cap;
+	while (new_cap < buf -> len + extra){
+		new_cap *= 2;
+	}
+
+	unsigned char * new_data = (unsigned char *) realloc(buf -> data, new_cap);
+	if (new_data == NULL){
+		return -1;
+	}
+	buf -> data = new_data;
+	buf -> cap = new_cap;
+	return 0;
+}
+
+// MSB first
+static int put_bits(Bit_Buffer * buf, uint64_t value, int n){
+
+	int free_bits, take;
+	unsigned char chunk;
+
+	while (n > 0){
+		if (buf -> n_bits == 0){
+			if (ensure_capacity(buf, 1) == -1){
+				return -1;
+			}
+			buf -> data[buf -> len] = 0;
+			buf -> len++;
+		}
+		free_bits = 8 - buf -> n_bits;
+		take = (n < free_bits) ? n : free_bits;
+		chunk = (value >> (n - take)) & ((1u << take) - 1);
+		buf -> data[buf -> len - 1] |= chunk << (free_bits - take);
+		buf -> n_bits = (buf -> n_bits + take) % 8;
+		n -= take;
+	}
+	return 0;
+}
+
+static void align_bits(Bit_Buffer * buf){
+	buf -> n_bits = 0;
+}
+
+static int put_varint(Bit_Buffer * buf, uint64_t value){
+
+	align_bits(buf);
+	if (ensure_capacity(buf, 10) == -1){
+		return -1;
+	}
+	while (value >= 0x80){
+		buf -> data[buf -> len] = (value & 0x7f) | 0x80;
+		buf -> len++;
+		value >>= 7;
+	}
+	buf -> data[buf -> len] = value;
+	buf -> len++;
+	return 0;
+}
+
+static uint64_t get_bits(Bit_Reader * reader, int n){
+
+	uint64_t value = 0;
+	size_t byte;
+	int bit_in_byte, avail, take;
+
+	while (n > 0){
+		byte = reader -> bit_pos / 8;
+		if (byte >= reader -> len){
+			reader -> overrun = true;
+			return 0;
+		}
+		bit_in_byte = reader -> bit_pos % 8;
+		avail = 8 - bit_in_byte;
+		take = (n < avail) ? n : avail;
+		value = (value << take) | ((reader -> data[byte] >> (avail - take)) & ((1u << take) - 1));
+		reader -> bit_pos += take;
+		n -= take;
+	}
+	return value;
+}
+
+static uint64_t get_varint(Bit_Reader * reader){
+
+	// varints always start on a byte
+	reader -> bit_pos = ((reader -> bit_pos + 7) / 8) * 8;
+
+	uint64_t value = 0;
+	int shift = 0;
+	size_t byte;
+	while (shift < 64){
+		byte = reader -> bit_pos / 8;
+		if (byte >= reader -> len){
+			reader -> overrun = true;
+			return 0;
+		}
+		reader -> bit_pos += 8;
+		value |= ((uint64_t) (reader -> data[byte] & 0x7f)) << shift;
+		if ((reader -> data[byte] & 0x80) == 0){
+			break;
+		}
+		shift += 7;
+	}
+	return value;
+}
+
+static uint64_t zigzag_encode(int64_t value){
+	return ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+}
+
+static int64_t zigzag_decode(uint64_t value){
+	return (int64_t) (value >> 1) ^ -((int64_t) (value & 1));
+}
+
+
+/* COLUMN ENCODINGS */
+
+// Gorilla XOR:
+//	- first value raw
+//	- '0' if equal to previous
+//	- '10' + meaningful bits if they fit in the previous leading/trailing window
+//	- '11' + 5 bits leading zeros + 6 bits meaningful length (0 means 64) + meaningful bits
+static int encode_doubles(Bit_Buffer * buf, uint64_t * vals, int n){
+
+	if (n == 0){
+		return 0;
+	}
+
+	int err = put_bits(buf, vals[0], 64);
+
+	uint64_t prev = vals[0];
+	uint64_t xor;
+	int prev_leading = -1;
+	int prev_trailing = 0;
+	int leading, trailing, meaningful;
+
+	for (int i = 1; i < n; i++){
+		xor = vals[i] ^ prev;
+		prev = vals[i];
+
+		if (xor == 0){
+			err |= put_bits(buf, 0, 1);
+			continue;
+		}
+
+		leading = __builtin_clzll(xor);
+		trailing = __builtin_ctzll(xor);
+		if (leading > 31){
+			leading = 31;
+		}
+
+		if ((prev_leading != -1) && (leading >= prev_leading) && (trailing >= prev_trailing)){
+			meaningful = 64 - prev_leading - prev_trailing;
+			err |= put_bits(buf, 2, 2);
+			err |= put_bits(buf, xor >> prev_trailing, meaningful);
+			continue;
+		}
+
+		meaningful = 64 - leading - trailing;
+		err |= put_bits(buf, 3, 2);
+		err |= put_bits(buf, leading, 5);
+		err |= put_bits(buf, meaningful & 63, 6);
+		err |= put_bits(buf, xor >> trailing, meaningful);
+		prev_leading = leading;
+		prev_trailing = trailing;
+	}
+	return err;
+}
+
+static void decode_doubles(Bit_Reader * reader, uint64_t * vals, int n){
+
+	if (n == 0){
+		return;
+	}
+
+	vals[0] = get_bits(reader, 64);
+
+	uint64_t prev = vals[0];
+	int leading = 0;
+	int trailing = 0;
+	int meaningful;
+
+	for (int i = 1; i < n; i++){
+		if (get_bits(reader, 1) == 0){
+			vals[i] = prev;
+			continue;
+		}
+		if (get_bits(reader, 1) == 1){
+			leading = get_bits(reader, 5);
+			meaningful = get_bits(reader, 6);
+			if (meaningful == 0){
+				meaningful = 64;
+			}
+			trailing = 64 - leading - meaningful;
+		}
+		meaningful = 64 - leading - trailing;
+		prev ^= get_bits(reader, meaningful) << trailing;
+		vals[i] = prev;
+	}
+}
+
+// first value, then deltas, as zigzag varints
+static int encode_longs(Bit_Buffer * buf, int64_t * vals, int n){
+
+	int err = 0;
+	int64_t prev = 0;
+	for (int i = 0; i < n; i++){
+		err |= put_varint(buf, zigzag_encode(vals[i] - prev));
+		prev = vals[i];
+	}
+	return err;
+}
+
+static void decode_longs(Bit_Reader * reader, int64_t * vals, int n){
+
+	int64_t prev = 0;
+	for (int i = 0; i < n; i++){
+		prev += zigzag_decode(get_varint(reader));
+		vals[i] = prev;
+	}
+}
+
+// first value, first delta, then delta-of-deltas (0 for a perfectly regular period)
+static int encode_timestamps(Bit_Buffer * buf, int64_t * vals, int n){
+
+	int err = 0;
+	int64_t prev_delta = 0;
+	int64_t delta;
+	for (int i = 0; i < n; i++){
+		if (i == 0){
+			err |= put_varint(buf, zigzag_encode(vals[0]));
+			continue;
+		}
+		delta = vals[i] - vals[i - 1];
+		err |= put_varint(buf, zigzag_encode(delta - prev_delta));
+		prev_delta = delta;
+	}
+	return err;
+}
+
+static void decode_timestamps(Bit_Reader * reader, int64_t * vals, int n){
+
+	int64_t delta = 0;
+	for (int i = 0; i < n; i++){
+		if (i == 0){
+			vals[0] = zigzag_decode(get_varint(reader));
+			continue;
+		}
+		delta += zigzag_decode(get_varint(reader));
+		vals[i] = vals[i - 1] + delta;
+	}
+}
+
+
+/* WRITING */
+
+Columnar_Writer * open_columnar_writer(char * path){
+
+	Columnar_Writer * columnar_writer = (Columnar_Writer *) malloc(sizeof(Columnar_Writer));
+	if (columnar_writer == NULL){
+		fprintf(stderr, "Could not allocate memory for columnar writer\n");
+		return NULL;
+	}
+
+	columnar_writer -> data_file = fopen(path, "ab");
+	if (columnar_writer -> data_file == NULL){
+		fprintf(stderr, "Could not open columnar file at: %s\n", path);
+		free(columnar_writer);
+		return NULL;
+	}
+
+	char * index_path;
+	asprintf(&index_path, "%s.idx", path);
+	columnar_writer -> index_file = fopen(index_path, "ab");
+	if (columnar_writer -> index_file == NULL){
+		fprintf(stderr, "Could not open columnar index at: %s\n", index_path);
+		fclose(columnar_writer -> data_file);
+		free(index_path);
+		free(columnar_writer);
+		return NULL;
+	}
+	free(index_path);
+
+	columnar_writer -> scratch_cap = 0;
+	columnar_writer -> scratch = NULL;
+	columnar_writer -> n_chunks = 0;
+	columnar_writer -> n_bytes_written = 0;
+	columnar_writer -> n_samples_written = 0;
+
+	return columnar_writer;
+}
+
+void close_columnar_writer(Columnar_Writer * columnar_writer){
+	fclose(columnar_writer -> data_file);
+	fclose(columnar_writer -> index_file);
+	free(columnar_writer -> scratch);
+	free(columnar_writer);
+}
+
+// copies column values for every sample into the 8-byte slots of vals
+static void gather_host_column(Samples_Buffer * samples_buffer, int n_samples, int column, void * vals){
+
+	double * dbl_vals = (double *) vals;
+	int64_t * int_vals = (int64_t *) vals;
+
+	for (int i = 0; i < n_samples; i++){
+		Proc_Data * cpu_data = &(samples_buffer -> cpu_util[i]);
+		Net_Data * net_data = &(samples_buffer -> net_util[i]);
+		switch (column){
+			case 0: dbl_vals[i] = cpu_data -> mem_used_pct; break;
+			case 1: int_vals[i] = cpu_data -> free_mem; break;
+			case 2: dbl_vals[i] = cpu_data -> util_pct; break;
+			case 3: int_vals[i] = net_data -> ib_rx_bytes; break;
+			case 4: int_vals[i] = net_data -> ib_tx_bytes; break;
+			case 5: int_vals[i] = net_data -> ib_sys_rx_bytes; break;
+			case 6: int_vals[i] = net_data -> ib_sys_tx_bytes; break;
+			case 7: int_vals[i] = net_data -> eth_rx_bytes; break;
+			case 8: int_vals[i] = net_data -> eth_tx_bytes; break;
+			case 9: int_vals[i] = samples_buffer -> periods_ms[i]; break;
+			case 10: int_vals[i] = samples_buffer -> skipped_collectors[i]; break;
+		}
+	}
+}
+
+// DECIMAL DOUBLES
+// Most DCGM doubles (and mem/cpu pct) carry a few decimal digits, which XOR encodes poorly
+// (0.37 and 0.38 share almost no mantissa bits). If every value in the column is exactly
+// round(v * 10^scale) / 10^scale the column is stored as those integers instead (lossless).
+#define MAX_DECIMAL_SCALE 4
+
+static const double decimal_scales[MAX_DECIMAL_SCALE + 1] = {1, 10, 100, 1000, 10000};
+
+// smallest scale that reproduces every value bit for bit, -1 if none
+static int find_decimal_scale(double * vals, int n){
+
+	double scaled;
+	int i;
+	for (int scale = 0; scale <= MAX_DECIMAL_SCALE; scale++){
+		for (i = 0; i < n; i++){
+			scaled = round(vals[i] * decimal_scales[scale]);
+			if ((fabs(scaled) > 9007199254740992.0) || (scaled / decimal_scales[scale] != vals[i]) || (signbit(vals[i]) && (vals[i] == 0))){
+				break;
+			}
+		}
+		if (i == n){
+			return scale;
+		}
+	}
+	return -1;
+}
+
+// column starts with one byte: 0 = XOR, else decimal scale + 1
+// (both are tried when the decimal form is exact, constant columns are smaller as XOR)
+static int encode_double_column(Bit_Buffer * buf, void * vals, int n){
+
+	int scale = find_decimal_scale((double *) vals, n);
+
+	size_t start = buf -> len;
+	int err = put_bits(buf, 0, 8);
+	err |= encode_doubles(buf, (uint64_t *) vals, n);
+
+	if ((scale == -1) || (err != 0)){
+		return err;
+	}
+
+	size_t xor_len = buf -> len;
+	buf -> len = start;
+	align_bits(buf);
+
+	// scaled in place (vals is the writer's gather scratch), exact so it can be undone
+	for (int i = 0; i < n; i++){
+		((int64_t *) vals)[i] = (int64_t) round(((double *) vals)[i] * decimal_scales[scale]);
+	}
+	err = put_bits(buf, scale + 1, 8);
+	err |= encode_longs(buf, (int64_t *) vals, n);
+
+	if (buf -> len <= xor_len){
+		return err;
+	}
+
+	for (int i = 0; i < n; i++){
+		((double *) vals)[i] = ((int64_t *) vals)[i] / decimal_scales[scale];
+	}
+	buf -> len = start;
+	align_bits(buf);
+	err = put_bits(buf, 0, 8);
+	return err | encode_doubles(buf, (uint64_t *) vals, n);
+}
+
+static void decode_double_column(Bit_Reader * reader, void * vals, int n){
+
+	int scale = (int) get_bits(reader, 8) - 1;
+
+	if (scale == -1){
+		decode_doubles(reader, (uint64_t *) vals, n);
+		return;
+	}
+	if (scale > MAX_DECIMAL_SCALE){
+		reader -> overrun = true;
+		return;
+	}
+
+	decode_longs(reader, (int64_t *) vals, n);
+	for (int i = 0; i < n; i++){
+		((double *) vals)[i] = ((int64_t *) vals)[i] / decimal_scales[scale];
+	}
+}
+
+static int encode_column(Bit_Buffer * buf, void * vals, int n, unsigned short column_type){
+
+	// 4 byte length placeholder, patched once the column is encoded
+	align_bits(buf);
+	if (ensure_capacity(buf, 4) == -1){
+		return -1;
+	}
+	size_t length_pos = buf -> len;
+	buf -> len += 4;
+
+	int err;
+	if (column_type == GPU_FT_DOUBLE){
+		err = encode_double_column(buf, vals, n);
+	}
+	else {
+		err = encode_longs(buf, (int64_t *) vals, n);
+	}
+	align_bits(buf);
+
+	uint32_t column_bytes = buf -> len - length_pos - 4;
+	memcpy(buf -> data + length_pos, &column_bytes, 4);
+	return err;
+}
+
+int write_columnar_chunk(Columnar_Writer * columnar_writer, Samples_Buffer * samples_buffer){
+
+	int n_samples = samples_buffer -> n_samples;
+	int n_devices = samples_buffer -> n_devices;
+	int n_fields = samples_buffer -> n_fields;
+
+	if (n_samples == 0){
+		return 0;
+	}
+
+	Bit_Buffer buf;
+	buf.data = columnar_writer -> scratch;
+	buf.cap = columnar_writer -> scratch_cap;
+	buf.len = 0;
+	buf.n_bits = 0;
+
+	int err = 0;
+
+	// one column of 8 byte slots at a time
+	int64_t * column_vals = (int64_t *) malloc(n_samples * sizeof(int64_t));
+	if (column_vals == NULL){
+		fprintf(stderr, "Could not allocate memory for columnar chunk\n");
+		return -1;
+	}
+
+	// field lists
+	if (ensure_capacity(&buf, 4 * n_fields) == -1){
+		free(column_vals);
+		return -1;
+	}
+	memcpy(buf.data + buf.len, samples_buffer -> field_ids, n_fields * sizeof(unsigned short));
+	buf.len += n_fields * sizeof(unsigned short);
+	memcpy(buf.data + buf.len, samples_buffer -> field_types, n_fields * sizeof(unsigned short));
+	buf.len += n_fields * sizeof(unsigned short);
+
+	// timestamps
+	for (int i = 0; i < n_samples; i++){
+		column_vals[i] = samples_buffer -> times[i].tv_sec * 1000000000L + samples_buffer -> times[i].tv_nsec;
+	}
+	align_bits(&buf);
+	err |= ensure_capacity(&buf, 4);
+	size_t length_pos = buf.len;
+	buf.len += 4;
+	err |= encode_timestamps(&buf, column_vals, n_samples);
+	uint32_t column_bytes = buf.len - length_pos - 4;
+	memcpy(buf.data + length_pos, &column_bytes, 4);
+
+	Columnar_Chunk_Header header;
+	header.first_timestamp_ns = column_vals[0];
+	header.last_timestamp_ns = column_vals[n_samples - 1];
+
+	// host metrics
+	for (int c = 0; c < N_COLUMNAR_HOST_COLUMNS; c++){
+		gather_host_column(samples_buffer, n_samples, c, column_vals);
+		err |= encode_column(&buf, column_vals, n_samples, host_column_types[c]);
+	}
+
+	// gpu fields are already columns in the arena, copied because the encoder scales doubles in place
+	for (int gpuId = 0; gpuId < n_devices; gpuId++){
+		for (int fieldNum = 0; fieldNum < n_fields; fieldNum++){
+			memcpy(column_vals, FIELD_COLUMN(samples_buffer, gpuId * n_fields + fieldNum), n_samples * sizeof(int64_t));
+			err |= encode_column(&buf, column_vals, n_samples, samples_buffer -> field_types[fieldNum]);
+		}
+	}
+
+	free(column_vals);
+
+	// keep the (possibly grown) scratch for the next chunk
+	columnar_writer -> scratch = buf.data;
+	columnar_writer -> scratch_cap = buf.cap;
+
+	if (err != 0){
+		fprintf(stderr, "Could not allocate memory for columnar chunk\n");
+		return -1;
+	}
+
+	header.magic = COLUMNAR_MAGIC;
+	header.version = COLUMNAR_VERSION;
+	header.n_fields = n_fields;
+	header.n_samples = n_samples;
+	header.n_devices = n_devices;
+	header.payload_bytes = buf.len;
+
+	FILE * data_file = columnar_writer -> data_file;
+	fseek(data_file, 0, SEEK_END);
+	long offset = ftell(data_file);
+
+	if ((fwrite(&header, sizeof(Columnar_Chunk_Header), 1, data_file) != 1) || (fwrite(buf.data, 1, buf.len, data_file) != buf.len) || (fflush(data_file) != 0)){
+		fprintf(stderr, "Error writing columnar chunk: %s\n", strerror(errno));
+		return -1;
+	}
+
+	// index only points at chunks that made it to the file completely
+	Columnar_Index_Entry entry;
+	entry.first_timestamp_ns = header.first_timestamp_ns;
+	entry.last_timestamp_ns = header.last_timestamp_ns;
+	entry.offset = offset;
+	entry.n_samples = n_samples;
+	if ((fwrite(&entry, sizeof(Columnar_Index_Entry), 1, columnar_writer -> index_file) != 1) || (fflush(columnar_writer -> index_file) != 0)){
+		fprintf(stderr, "Error writing columnar index: %s\n", strerror(errno));
+	}
+
+	columnar_writer -> n_chunks++;
+	columnar_writer -> n_bytes_written += sizeof(Columnar_Chunk_Header) + buf.len;
+	columnar_writer -> n_samples_written += n_samples;
+
+	return 0;
+}
+
+
+/* READING */
+
+void free_columnar_chunk(Columnar_Chunk * chunk){
+	free(chunk -> field_ids);
+	free(chunk -> field_types);
+	free(chunk -> timestamps);
+	free(chunk -> column_types);
+	free(chunk -> values);
+	free(chunk);
+}
+
+Columnar_Chunk * read_columnar_chunk(FILE * data_file){
+
+	long offset = ftell(data_file);
+
+	Columnar_Chunk_Header header;
+	if (fread(&header, sizeof(Columnar_Chunk_Header), 1, data_file) != 1){
+		return NULL;
+	}
+
+	if ((header.magic != COLUMNAR_MAGIC) || (header.version < 1) || (header.version > COLUMNAR_VERSION)){
+		fprintf(stderr, "Bad columnar chunk header at offset %ld\n", offset);
+		return NULL;
+	}
+
+	unsigned char * payload = (unsigned char *) malloc(header.payload_bytes);
+	if (payload == NULL){
+		fprintf(stderr, "Could not allocate memory for columnar chunk\n");
+		return NULL;
+	}
+	if (fread(payload, 1, header.payload_bytes, data_file) != header.payload_bytes){
+		fprintf(stderr, "Truncated columnar chunk at offset %ld\n", offset);
+		free(payload);
+		return NULL;
+	}
+
+	Columnar_Chunk * chunk = (Columnar_Chunk *) calloc(1, sizeof(Columnar_Chunk));
+	if (chunk == NULL){
+		free(payload);
+		return NULL;
+	}
+
+	int n_samples = header.n_samples;
+	int n_fields = header.n_fields;
+	int n_devices = header.n_devices;
+	int n_columns = N_COLUMNAR_HOST_COLUMNS + n_devices * n_fields;
+	// columns in the file, host columns the chunk's version doesn't have stay 0
+	int n_host_columns = get_n_host_columns(header.version);
+	int n_file_columns = n_columns - (N_COLUMNAR_HOST_COLUMNS - n_host_columns);
+
+	chunk -> offset = offset;
+	chunk -> n_samples = n_samples;
+	chunk -> n_devices = n_devices;
+	chunk -> n_fields = n_fields;
+	chunk -> first_timestamp_ns = header.first_timestamp_ns;
+	chunk -> last_timestamp_ns = header.last_timestamp_ns;
+	chunk -> n_columns = n_columns;
+	chunk -> field_ids = (unsigned short *) malloc(n_fields * sizeof(unsigned short));
+	chunk -> field_types = (unsigned short *) malloc(n_fields * sizeof(unsigned short));
+	chunk -> timestamps = (long *) malloc(n_samples * sizeof(long));
+	chunk -> column_types = (unsigned short *) malloc(n_columns * sizeof(unsigned short));
+	chunk -> values = calloc((size_t) n_columns * n_samples, 8);
+
+	if ((chunk -> field_ids == NULL) || (chunk -> field_types == NULL) || (chunk -> timestamps == NULL) || (chunk -> column_types == NULL) || (chunk -> values == NULL)){
+		fprintf(stderr, "Could not allocate memory for columnar chunk\n");
+		free(payload);
+		free_columnar_chunk(chunk);
+		return NULL;
+	}
+
+	memcpy(chunk -> field_ids, payload, n_fields * sizeof(unsigned short));
+	memcpy(chunk -> field_types, payload + n_fields * sizeof(unsigned short), n_fields * sizeof(unsigned short));
+
+	for (int c = 0; c < N_COLUMNAR_HOST_COLUMNS; c++){
+		chunk -> column_types[c] = host_column_types[c];
+	}
+	for (int c = N_COLUMNAR_HOST_COLUMNS; c < n_columns; c++){
+		chunk -> column_types[c] = chunk -> field_types[(c - N_COLUMNAR_HOST_COLUMNS) % n_fields];
+	}
+
+	size_t pos = 2 * n_fields * sizeof(unsigned short);
+	uint32_t column_bytes;
+	Bit_Reader reader;
+	bool corrupt = false;
+
+	// column -1 is the timestamps, f is the column in the file, c the column in the chunk
+	int c;
+	for (int f = -1; f < n_file_columns; f++){
+		c = (f < n_host_columns) ? f : f + (N_COLUMNAR_HOST_COLUMNS - n_host_columns);
+		if (pos + 4 > header.payload_bytes){
+			corrupt = true;
+			break;
+		}
+		memcpy(&column_bytes, payload + pos, 4);
+		pos += 4;
+		if (pos + column_bytes > header.payload_bytes){
+			corrupt = true;
+			break;
+		}
+
+		reader.data = payload + pos;
+		reader.len = column_bytes;
+		reader.bit_pos = 0;
+		reader.overrun = false;
+
+		if (c == -1){
+			decode_timestamps(&reader, (int64_t *) chunk -> timestamps, n_samples);
+		}
+		else if (chunk -> column_types[c] == GPU_FT_DOUBLE){
+			decode_double_column(&reader, (uint64_t *) chunk -> values + (size_t) c * n_samples, n_samples);
+		}
+		else {
+			decode_longs(&reader, (int64_t *) chunk -> values + (size_t) c * n_samples, n_samples);
+		}
+
+		if (reader.overrun){
+			corrupt = true;
+			break;
+		}
+		pos += column_bytes;
+	}
+
+	free(payload);
+
+	if (corrupt){
+		fprintf(stderr, "Corrupt columnar chunk at offset %ld\n", offset);
+		free_columnar_chunk(chunk);
+		return NULL;
+	}
+
+	return chunk;
+}
+
+long find_columnar_chunk(char * index_path, long timestamp_ns){
+
+	FILE * index_file = fopen(index_path, "rb");
+	if (index_file == NULL){
+		fprintf(stderr, "Could not open columnar index at: %s\n", index_path);
+		return -1;
+	}
+
+	fseek(index_file, 0, SEEK_END);
+	long n_entries = ftell(index_file) / sizeof(Columnar_Index_Entry);
+
+	// chunks are appended in time order, find the first one ending at or after timestamp_ns
+	Columnar_Index_Entry entry;
+	long lo = 0;
+	long hi = n_entries;
+	long mid;
+	while (lo < hi){
+		mid = (lo + hi) / 2;
+		fseek(index_file, mid * sizeof(Columnar_Index_Entry), SEEK_SET);
+		if (fread(&entry, sizeof(Columnar_Index_Entry), 1, index_file) != 1){
+			break;
+		}
+		if (entry.last_timestamp_ns < timestamp_ns){
+			lo = mid + 1;
+		}
+		else {
+			hi = mid;
+		}
+	}
+
+	long offset = -1;
+	if (lo < n_entries){
+		fseek(index_file, lo * sizeof(Columnar_Index_Entry), SEEK_SET);
+		if (fread(&entry, sizeof(Columnar_Index_Entry), 1, index_file) == 1){
+			offset = entry.offset;
+		}
+	}
+
+	fclose(index_file);
+	return offset;
+}
+
+long get_columnar_long(Columnar_Chunk * chunk, int column, int sample){
+	return ((int64_t *) chunk -> values)[(size_t) column * chunk -> n_samples + sample];
+}
+
+double get_columnar_double(Columnar_Chunk * chunk, int column, int sample){
+	return ((double *) chunk -> values)[(size_t) column * chunk -> n_samples + sample];
+}
@@ -0,0 +1,101 @@
+#ifndef COLUMNAR_H
+#define COLUMNAR_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+// COMPRESSED COLUMNAR SAMPLE FILE (<hostname>.mts)
+//
+// One chunk is appended per samples buffer dump:
+//	- Columnar_Chunk_Header
+//	- field_ids[n_fields], field_types[n_fields] (unsigned short)
+//	- n_columns x (uint32 byte length, encoded column)
+//
+// Columns, in order:
+//	- timestamps (ns): first value raw, then delta-of-delta, zigzag varints
+//	- N_COLUMNAR_HOST_COLUMNS host metrics (see columnar.c for the order)
+//	- one per (GPU, field), GPU major
+// Doubles are stored as scaled decimal integers when that is exact and Gorilla XOR encoded
+// otherwise, integers are delta + zigzag varint encoded (the net columns are already deltas
+// of the cumulative counters).
+//
+// <hostname>.mts.idx gets one Columnar_Index_Entry per chunk, written after the chunk,
+// so time range lookups can binary search without touching the data file.
+
+#define COLUMNAR_MAGIC 0x4353544d
+#define COLUMNAR_VERSION 3
+
+// version 1 chunks have no period_ms column, version 2 chunks no skipped_collectors (both read back as 0)
+#define N_COLUMNAR_HOST_COLUMNS 11
+
+typedef struct columnar_chunk_header {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t n_fields;
+	uint32_t n_samples;
+	uint32_t n_devices;
+	// everything after the header (field lists + columns)
+	uint64_t payload_bytes;
+	int64_t first_timestamp_ns;
+	int64_t last_timestamp_ns;
+} Columnar_Chunk_Header;
+
+typedef struct columnar_index_entry {
+	int64_t first_timestamp_ns;
+	int64_t last_timestamp_ns;
+	uint64_t offset;
+	uint64_t n_samples;
+} Columnar_Index_Entry;
+
+typedef struct columnar_writer {
+	FILE * data_file;
+	FILE * index_file;
+	// scratch space reused between chunks
+	size_t scratch_cap;
+	unsigned char * scratch;
+	// reported by the writer thread / benchmark
+	long n_chunks;
+	long n_bytes_written;
+	long n_samples_written;
+} Columnar_Writer;
+
+// Decoded chunk, every column holds n_samples 8-byte values (long or double by column_types)
+typedef struct columnar_chunk {
+	long offset;
+	int n_samples;
+	int n_devices;
+	int n_fields;
+	unsigned short * field_ids;
+	unsigned short * field_types;
+	long first_timestamp_ns;
+	long last_timestamp_ns;
+	long * timestamps;
+	// N_COLUMNAR_HOST_COLUMNS + n_devices * n_fields
+	int n_columns;
+	unsigned short * column_types;
+	// [n_columns][n_samples]
+	void * values;
+} Columnar_Chunk;
+
+
+// WRITING
+
+// path is the data file, index goes to <path>.idx
+Columnar_Writer * open_columnar_writer(char * path);
+void close_columnar_writer(Columnar_Writer * columnar_writer);
+int write_columnar_chunk(Columnar_Writer * columnar_writer, Samples_Buffer * samples_buffer);
+
+// READING
+
+// reads the chunk at the current position, NULL at end of file (or on a corrupt/truncated chunk)
+Columnar_Chunk * read_columnar_chunk(FILE * data_file);
+void free_columnar_chunk(Columnar_Chunk * chunk);
+
+// offset of the first chunk that may contain samples at or after timestamp_ns, -1 if none
+long find_columnar_chunk(char * index_path, long timestamp_ns);
+
+// 8 byte slot for (column, sample) of a decoded chunk
+long get_columnar_long(Columnar_Chunk * chunk, int column, int sample);
+double get_columnar_double(Columnar_Chunk * chunk, int column, int sample);
+
+#endif
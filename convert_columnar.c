@@ -0,0 +1,229 @@
+#define _GNU_SOURCE
+
+#include "job_stats.h"
+
+#include "monitoring.h"
+#include "samples_arena.h"
+#include "storage.h"
+
+// Converts a columnar <hostname>.mts file back into a SQLite db (any storage mode),
+// or prints a per-chunk summary.
+//
+// Usage: ./convertColumnar -i <file.mts> [-o <out.db>] [-m eav|wide] [-s start_ns] [-e end_ns] [--summary]
+
+
+void print_usage(){
+	const char * usage_str = "Usage: [-i, --input=<string: columnar .mts file>] || \
+					[-o, --output=<string: sqlite db to insert samples into>] || \
+					[-m, --storage_mode=<string: eav or wide layout in the output db>] || \
+					[-s, --start_ns=<long: only samples at or after this timestamp>] || \
+					[-e, --end_ns=<long: only samples at or before this timestamp>] || \
+					[--summary: print bytes per sample for every chunk instead of converting]";
+
+	printf("%s\n", usage_str);
+}
+
+// rebuilds the in-memory buffer the chunk was written from, keeping samples in [start_ns, end_ns]
+Samples_Buffer * chunk_to_samples_buffer(Columnar_Chunk * chunk, long start_ns, long end_ns){
+
+	int n_devices = chunk -> n_devices;
+	int n_fields = chunk -> n_fields;
+
+	Samples_Buffer * samples_buffer = (Samples_Buffer *) calloc(1, sizeof(Samples_Buffer));
+	if (samples_buffer == NULL){
+		fprintf(stderr, "Could not allocate memory for samples buffer\n");
+		return NULL;
+	}
+
+	samples_buffer -> n_devices = n_devices;
+	samples_buffer -> n_fields = n_fields;
+	samples_buffer -> field_ids = chunk -> field_ids;
+	samples_buffer -> field_types = chunk -> field_types;
+	samples_buffer -> max_samples = chunk -> n_samples;
+	if (alloc_samples_arena(samples_buffer) == -1){
+		return NULL;
+	}
+
+	int n_samples = 0;
+	long timestamp;
+	Proc_Data * cpu_util;
+	Net_Data * net_util;
+	for (int i = 0; i < chunk -> n_samples; i++){
+		timestamp = chunk -> timestamps[i];
+		if ((timestamp < start_ns) || (timestamp > end_ns)){
+			continue;
+		}
+
+		samples_buffer -> times[n_samples].tv_sec = timestamp / 1000000000L;
+		samples_buffer -> times[n_samples].tv_nsec = timestamp % 1000000000L;
+		samples_buffer -> periods_ms[n_samples] = get_columnar_long(chunk, 9, i);
+		samples_buffer -> skipped_collectors[n_samples] = get_columnar_long(chunk, 10, i);
+
+		// same column order as the writer
+		cpu_util = &(samples_buffer -> cpu_util[n_samples]);
+		cpu_util -> mem_used_pct = get_columnar_double(chunk, 0, i);
+		cpu_util -> free_mem = get_columnar_long(chunk, 1, i);
+		cpu_util -> util_pct = get_columnar_double(chunk, 2, i);
+		net_util = &(samples_buffer -> net_util[n_samples]);
+		net_util -> ib_rx_bytes = get_columnar_long(chunk, 3, i);
+		net_util -> ib_tx_bytes = get_columnar_long(chunk, 4, i);
+		net_util -> ib_sys_rx_bytes = get_columnar_long(chunk, 5, i);
+		net_util -> ib_sys_tx_bytes = get_columnar_long(chunk, 6, i);
+		net_util -> eth_rx_bytes = get_columnar_long(chunk, 7, i);
+		net_util -> eth_tx_bytes = get_columnar_long(chunk, 8, i);
+
+		for (int c = 0; c < n_devices * n_fields; c++){
+			((long *) FIELD_COLUMN(samples_buffer, c))[n_samples] = get_columnar_long(chunk, N_COLUMNAR_HOST_COLUMNS + c, i);
+		}
+
+		n_samples++;
+	}
+
+	samples_buffer -> n_samples = n_samples;
+	return samples_buffer;
+}
+
+void free_converted_buffer(Samples_Buffer * samples_buffer){
+	free_samples_arena(samples_buffer);
+	free(samples_buffer);
+}
+
+int main(int argc, char ** argv){
+
+	char * input_path = NULL;
+	char * output_path = NULL;
+	Storage_Mode storage_mode = STORAGE_EAV;
+	long start_ns = 0;
+	long end_ns = LONG_MAX;
+	int summary = 0;
+
+	static struct option long_options[] = {
+		{"input", required_argument, 0, 'i'},
+		{"output", required_argument, 0, 'o'},
+		{"storage_mode", required_argument, 0, 'm'},
+		{"start_ns", required_argument, 0, 's'},
+		{"end_ns", required_argument, 0, 'e'},
+		{"summary", no_argument, 0, 'S'},
+		{0, 0, 0, 0}
+	};
+
+	int opt_index = 0;
+	int opt;
+	while ((opt = getopt_long(argc, argv, "i:o:m:s:e:", long_options, &opt_index)) != -1){
+		switch (opt){
+			case 'i': input_path = optarg;
+				break;
+			case 'o': output_path = optarg;
+				break;
+			case 'm':
+				if ((parse_storage_mode(optarg, &storage_mode) == -1) || (storage_mode == STORAGE_COLUMNAR)){
+					print_usage();
+					exit(1);
+				}
+				break;
+			case 's': start_ns = atol(optarg);
+				break;
+			case 'e': end_ns = atol(optarg);
+				break;
+			case 'S': summary = 1;
+				break;
+			default: print_usage();
+				exit(1);
+		}
+	}
+
+	if ((input_path == NULL) || ((output_path == NULL) && (!summary))){
+		print_usage();
+		exit(1);
+	}
+
+	FILE * data_file = fopen(input_path, "rb");
+	if (data_file == NULL){
+		fprintf(stderr, "Could not open columnar file at: %s\n", input_path);
+		exit(1);
+	}
+
+	// skip straight to the first chunk that can hold start_ns
+	if (start_ns > 0){
+		char * index_path;
+		asprintf(&index_path, "%s.idx", input_path);
+		long offset = find_columnar_chunk(index_path, start_ns);
+		free(index_path);
+		if (offset == -1){
+			fprintf(stderr, "No chunks at or after %ld\n", start_ns);
+			fclose(data_file);
+			return 0;
+		}
+		fseek(data_file, offset, SEEK_SET);
+	}
+
+	sqlite3 * db = NULL;
+	Storage * storage = NULL;
+	bool tables_created = false;
+
+	if (summary){
+		printf("offset,first_timestamp_ns,last_timestamp_ns,n_samples,n_devices,n_fields,chunk_bytes,bytes_per_sample,bytes_per_value\n");
+	}
+	else if (sqlite3_open(output_path, &db) != SQLITE_OK){
+		fprintf(stderr, "COULD NOT OPEN SQL DB at filepath: %s. Exiting...\n", output_path);
+		exit(1);
+	}
+
+	Columnar_Chunk * chunk;
+	Samples_Buffer * samples_buffer;
+	long n_converted = 0;
+	long chunk_bytes;
+	int n_values;
+
+	while ((chunk = read_columnar_chunk(data_file)) != NULL){
+
+		if (chunk -> first_timestamp_ns > end_ns){
+			free_columnar_chunk(chunk);
+			break;
+		}
+
+		if (summary){
+			chunk_bytes = ftell(data_file) - chunk -> offset;
+			n_values = N_COLUMNAR_HOST_COLUMNS + chunk -> n_devices * chunk -> n_fields;
+			printf("%ld,%ld,%ld,%d,%d,%d,%ld,%.2f,%.3f\n", chunk -> offset, chunk -> first_timestamp_ns, chunk -> last_timestamp_ns, chunk -> n_samples, chunk -> n_devices, chunk -> n_fields,
+						chunk_bytes, (double) chunk_bytes / chunk -> n_samples, (double) chunk_bytes / ((double) chunk -> n_samples * n_values));
+			free_columnar_chunk(chunk);
+			continue;
+		}
+
+		// field list is fixed for one run of the monitor, so the first chunk decides the schema
+		if (!tables_created){
+			if (create_storage_tables(db, storage_mode, chunk -> n_fields, chunk -> field_ids) == -1){
+				exit(1);
+			}
+			storage = init_storage(db, storage_mode, STORAGE_BATCH_ROWS, chunk -> n_fields, chunk -> field_ids);
+			if (storage == NULL){
+				exit(1);
+			}
+			tables_created = true;
+		}
+
+		samples_buffer = chunk_to_samples_buffer(chunk, start_ns, end_ns);
+		if (samples_buffer == NULL){
+			exit(1);
+		}
+		n_converted += samples_buffer -> n_samples;
+		if (dump_samples_buffer(samples_buffer, storage) == -1){
+			fprintf(stderr, "Error inserting chunk at offset %ld\n", chunk -> offset);
+		}
+		free_converted_buffer(samples_buffer);
+		free_columnar_chunk(chunk);
+	}
+
+	fclose(data_file);
+
+	if (!summary){
+		if (storage != NULL){
+			destroy_storage(storage);
+		}
+		sqlite3_close(db);
+		printf("Converted %ld samples\n", n_converted);
+	}
+
+	return 0;
+}
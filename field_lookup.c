@@ -0,0 +1,74 @@
+#define _GNU_SOURCE
+
+#include <limits.h>
+
+#include "job_stats.h"
+#ifdef WITH_DCGM
+#include "dcgm_structs.h"
+#include "dcgm_fields.h"
+#endif
+
+#include "monitoring.h"
+#include "field_lookup.h"
+
+
+short * init_field_lookup(unsigned short * field_ids, int n_fields){
+
+	if (n_fields > SHRT_MAX){
+		fprintf(stderr, "Too many fields for the field lookup table: %d\n", n_fields);
+		return NULL;
+	}
+
+	short * field_lookup = (short *) malloc(N_FIELD_LOOKUP_ENTRIES * sizeof(short));
+	if (field_lookup == NULL){
+		fprintf(stderr, "Could not allocate memory for field lookup table\n");
+		return NULL;
+	}
+
+	for (int i = 0; i < N_FIELD_LOOKUP_ENTRIES; i++){
+		field_lookup[i] = -1;
+	}
+
+	// first occurrence wins, same as the old linear search
+	for (int i = n_fields - 1; i >= 0; i--){
+		field_lookup[field_ids[i]] = i;
+	}
+
+	return field_lookup;
+}
+
+#ifdef WITH_DCGM
+int copy_field_values_function(unsigned int gpuId, dcgmFieldValue_v1 * values, int numValues, void * userdata){
+	Samples_Buffer * samples_buffer = (Samples_Buffer *) userdata;
+	int n_samples = samples_buffer -> n_samples;
+	int n_fields = samples_buffer -> n_fields;
+	short * field_lookup = samples_buffer -> field_lookup;
+	unsigned short fieldType;
+	int indOfField;
+	void * field_column;
+
+	if (gpuId >= (unsigned int) samples_buffer -> n_devices){
+		return 0;
+	}
+
+	for (int i = 0; i < numValues; i++){
+		indOfField = field_lookup[values[i].fieldId];
+		if (indOfField == -1){
+			continue;
+		}
+		fieldType = values[i].fieldType;
+		field_column = FIELD_COLUMN(samples_buffer, gpuId * n_fields + indOfField);
+		if (fieldType == DCGM_FT_DOUBLE){
+			((double *) field_column)[n_samples] = values[i].value.dbl;
+		}
+		else if ((fieldType == DCGM_FT_INT64) || (fieldType == DCGM_FT_TIMESTAMP)){
+			((long *) field_column)[n_samples] = values[i].value.i64;
+		}
+		else{
+			// fieldType not supported
+			continue;
+		}		
+	}
+	return 0;
+}
+#endif
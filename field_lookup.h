@@ -0,0 +1,19 @@
+#ifndef FIELD_LOOKUP_H
+#define FIELD_LOOKUP_H
+
+// GPU FIELD ID -> FIELD INDEX
+//	- one entry for every possible unsigned short field id (128 KB), -1 if the field is not watched
+//	- built once at startup (open_gpu_source) and shared by every samples buffer, so the DCGM
+//	  callback does a single load per value instead of searching field_ids
+#define N_FIELD_LOOKUP_ENTRIES 65536
+
+short * init_field_lookup(unsigned short * field_ids, int n_fields);
+
+#ifdef WITH_DCGM
+#include "dcgm_structs.h"
+
+// dcgmGetLatestValues callback, userdata is the Samples_Buffer being filled
+int copy_field_values_function(unsigned int gpuId, dcgmFieldValue_v1 * values, int numValues, void * userdata);
+#endif
+
+#endif
@@ -0,0 +1,496 @@
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "job_stats.h"
+
+#include "file_trace.h"
+
+
+// every *_trace_file call goes through it, NULL reads the files as they are
+static File_Trace * active_trace = NULL;
+
+void set_file_trace(File_Trace * file_trace){
+	active_trace = file_trace;
+}
+
+
+/* PATHS */
+
+static char * get_relative_path(File_Trace * file_trace, char * path){
+	if ((file_trace -> root_len > 0) && (strncmp(path, file_trace -> root_dir, file_trace -> root_len) == 0)){
+		return path + file_trace -> root_len;
+	}
+	return path;
+}
+
+static int find_trace_path(File_Trace * file_trace, char * rel_path){
+	for (int i = 0; i < file_trace -> n_paths; i++){
+		if (strcmp(file_trace -> paths[i].path, rel_path) == 0){
+			return i;
+		}
+	}
+	return -1;
+}
+
+// new path at the end, its id or -1
+static int add_trace_path(File_Trace * file_trace, char * rel_path){
+
+	if (file_trace -> n_paths == file_trace -> max_paths){
+		int max_paths = (file_trace -> max_paths == 0) ? 64 : 2 * file_trace -> max_paths;
+		Trace_Path * paths = (Trace_Path *) realloc(file_trace -> paths, max_paths * sizeof(Trace_Path));
+		if (paths == NULL){
+			fprintf(stderr, "Could not allocate memory for trace paths\n");
+			return -1;
+		}
+		file_trace -> paths = paths;
+		file_trace -> max_paths = max_paths;
+	}
+
+	Trace_Path * trace_path = &(file_trace -> paths[file_trace -> n_paths]);
+	memset(trace_path, 0, sizeof(Trace_Path));
+	trace_path -> path = strdup(rel_path);
+	return file_trace -> n_paths++;
+}
+
+static int set_trace_contents(Trace_Path * trace_path, int length){
+	if (length > trace_path -> capacity){
+		char * contents = (char *) realloc(trace_path -> contents, length);
+		if (contents == NULL){
+			fprintf(stderr, "Could not allocate memory for trace contents of %s\n", trace_path -> path);
+			return -1;
+		}
+		trace_path -> contents = contents;
+		trace_path -> capacity = length;
+	}
+	trace_path -> length = length;
+	return 0;
+}
+
+
+/* RECORD */
+
+static void write_trace_bytes(File_Trace * file_trace, void * data, size_t n_bytes){
+
+	if (file_trace -> write_error){
+		return;
+	}
+	if (fwrite(data, 1, n_bytes, file_trace -> fp) != n_bytes){
+		fprintf(stderr, "Could not write to file trace, recording stops here\n");
+		file_trace -> write_error = true;
+		return;
+	}
+	file_trace -> n_bytes += n_bytes;
+}
+
+static void write_id_record(File_Trace * file_trace, uint8_t type, uint32_t path_id){
+	write_trace_bytes(file_trace, &type, sizeof(uint8_t));
+	write_trace_bytes(file_trace, &path_id, sizeof(uint32_t));
+}
+
+static void write_path_record(File_Trace * file_trace, uint32_t path_id, char * rel_path){
+	uint16_t length = (uint16_t) strlen(rel_path);
+	write_id_record(file_trace, TRACE_RECORD_PATH, path_id);
+	write_trace_bytes(file_trace, &length, sizeof(uint16_t));
+	write_trace_bytes(file_trace, rel_path, length);
+}
+
+// the part of buf that changed since the last read of the path
+static void record_contents(File_Trace * file_trace, uint32_t path_id, char * buf, int n_read){
+
+	Trace_Path * trace_path = &(file_trace -> paths[path_id]);
+	int n_common = (n_read < trace_path -> length) ? n_read : trace_path -> length;
+	int prefix = 0;
+	while ((prefix < n_common) && (buf[prefix] == trace_path -> contents[prefix])){
+		prefix++;
+	}
+	if ((prefix == n_read) && (n_read == trace_path -> length)){
+		return;
+	}
+
+	uint32_t length = n_read;
+	uint32_t prefix_length = prefix;
+	write_id_record(file_trace, TRACE_RECORD_DATA, path_id);
+	write_trace_bytes(file_trace, &length, sizeof(uint32_t));
+	write_trace_bytes(file_trace, &prefix_length, sizeof(uint32_t));
+	write_trace_bytes(file_trace, buf + prefix, n_read - prefix);
+
+	if (set_trace_contents(trace_path, n_read) == 0){
+		memcpy(trace_path -> contents + prefix, buf + prefix, n_read - prefix);
+	}
+}
+
+// maps fd to the path (adding it on the first open), caller holds the lock
+static void record_open(File_Trace * file_trace, int fd, char * rel_path){
+
+	int path_id = find_trace_path(file_trace, rel_path);
+	if (path_id == -1){
+		path_id = add_trace_path(file_trace, rel_path);
+		if (path_id == -1){
+			return;
+		}
+		write_path_record(file_trace, path_id, rel_path);
+	}
+
+	if (fd >= file_trace -> max_fds){
+		int max_fds = (fd < 1024) ? 1024 : 2 * fd;
+		int * fd_paths = (int *) realloc(file_trace -> fd_paths, max_fds * sizeof(int));
+		if (fd_paths == NULL){
+			fprintf(stderr, "Could not allocate memory for trace fds\n");
+			return;
+		}
+		memset(fd_paths + file_trace -> max_fds, 0, (max_fds - file_trace -> max_fds) * sizeof(int));
+		file_trace -> fd_paths = fd_paths;
+		file_trace -> max_fds = max_fds;
+	}
+	file_trace -> fd_paths[fd] = path_id + 1;
+	write_id_record(file_trace, TRACE_RECORD_OPEN, path_id);
+}
+
+
+/* REPLAY */
+
+static int read_trace_bytes(File_Trace * file_trace, void * data, size_t n_bytes){
+	if (fread(data, 1, n_bytes, file_trace -> fp) != n_bytes){
+		return -1;
+	}
+	file_trace -> n_bytes += n_bytes;
+	return 0;
+}
+
+// creates the directories above full_path
+static void make_tree_dirs(char * full_path){
+	for (char * slash = strchr(full_path + 1, '/'); slash != NULL; slash = strchr(slash + 1, '/')){
+		*slash = '\0';
+		mkdir(full_path, 0755);
+		*slash = '/';
+	}
+}
+
+// creates <root_dir><rel_path> and the directories above it
+static void create_tree_file(File_Trace * file_trace, char * rel_path){
+
+	char * full_path;
+	asprintf(&full_path, "%s%s", file_trace -> root_dir, rel_path);
+	make_tree_dirs(full_path);
+	int fd = open(full_path, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+	if (fd == -1){
+		fprintf(stderr, "Could not create %s in the replay tree\n", full_path);
+	}
+	else {
+		close(fd);
+	}
+	free(full_path);
+}
+
+// removes <root_dir><rel_path> and the directories above it that are left empty (up to a scanned one)
+static void remove_tree_file(File_Trace * file_trace, char * rel_path){
+
+	char * full_path;
+	asprintf(&full_path, "%s%s", file_trace -> root_dir, rel_path);
+	if (unlink(full_path) == 0){
+		char * slash;
+		int path_id;
+		while (((slash = strrchr(full_path, '/')) != NULL) && (slash - full_path > file_trace -> root_len)){
+			*slash = '\0';
+			path_id = find_trace_path(file_trace, full_path + file_trace -> root_len);
+			if (((path_id != -1) && (file_trace -> paths[path_id].is_dir)) || (rmdir(full_path) == -1)){
+				break;
+			}
+		}
+	}
+	free(full_path);
+}
+
+// applies records up to (and including) the next TICK, -1 on a corrupt trace
+static int apply_trace_records(File_Trace * file_trace){
+
+	uint8_t type;
+	uint32_t path_id, length, prefix;
+	uint16_t path_length;
+	int64_t timestamp_ns;
+	char path[UINT16_MAX + 1];
+	Trace_Path * trace_path;
+
+	while (read_trace_bytes(file_trace, &type, sizeof(uint8_t)) == 0){
+
+		if (type == TRACE_RECORD_TICK){
+			if (read_trace_bytes(file_trace, &timestamp_ns, sizeof(int64_t)) == -1){
+				return -1;
+			}
+			file_trace -> next_timestamp_ns = timestamp_ns;
+			file_trace -> has_tick = true;
+			return 0;
+		}
+
+		if (read_trace_bytes(file_trace, &path_id, sizeof(uint32_t)) == -1){
+			return -1;
+		}
+		if (type == TRACE_RECORD_PATH){
+			if ((path_id != (uint32_t) file_trace -> n_paths) || (read_trace_bytes(file_trace, &path_length, sizeof(uint16_t)) == -1)
+					|| (read_trace_bytes(file_trace, path, path_length) == -1)){
+				return -1;
+			}
+			path[path_length] = '\0';
+			if (add_trace_path(file_trace, path) == -1){
+				return -1;
+			}
+			continue;
+		}
+
+		if (path_id >= (uint32_t) file_trace -> n_paths){
+			return -1;
+		}
+		trace_path = &(file_trace -> paths[path_id]);
+		switch (type){
+			case TRACE_RECORD_OPEN:
+				trace_path -> n_open++;
+				if (trace_path -> n_open == 1){
+					create_tree_file(file_trace, trace_path -> path);
+				}
+				break;
+			case TRACE_RECORD_CLOSE:
+				if (trace_path -> n_open > 0){
+					trace_path -> n_open--;
+					if (trace_path -> n_open == 0){
+						remove_tree_file(file_trace, trace_path -> path);
+					}
+				}
+				break;
+			case TRACE_RECORD_DIR:
+				if (!trace_path -> is_dir){
+					trace_path -> is_dir = true;
+					char * full_path;
+					asprintf(&full_path, "%s%s/", file_trace -> root_dir, trace_path -> path);
+					make_tree_dirs(full_path);
+					free(full_path);
+				}
+				break;
+			case TRACE_RECORD_DATA:
+				if ((read_trace_bytes(file_trace, &length, sizeof(uint32_t)) == -1) || (read_trace_bytes(file_trace, &prefix, sizeof(uint32_t)) == -1)
+						|| (prefix > length) || (prefix > (uint32_t) trace_path -> length) || (set_trace_contents(trace_path, length) == -1)
+						|| (read_trace_bytes(file_trace, trace_path -> contents + prefix, length - prefix) == -1)){
+					return -1;
+				}
+				break;
+			default:
+				return -1;
+		}
+	}
+
+	// end of the trace
+	file_trace -> has_tick = false;
+	return 0;
+}
+
+
+/* TRACE */
+
+File_Trace * open_file_trace(char * filename, File_Trace_Mode mode, char * root_dir){
+
+	if ((mode == FILE_TRACE_REPLAY) && (root_dir[0] == '\0')){
+		fprintf(stderr, "Replaying a file trace needs a root dir (-P) to build its tree in\n");
+		return NULL;
+	}
+
+	File_Trace * file_trace = (File_Trace *) calloc(1, sizeof(File_Trace));
+	if (file_trace == NULL){
+		fprintf(stderr, "Could not allocate memory for file trace\n");
+		return NULL;
+	}
+	file_trace -> mode = mode;
+	file_trace -> root_dir = strdup(root_dir);
+	file_trace -> root_len = strlen(root_dir);
+	pthread_mutex_init(&(file_trace -> lock), NULL);
+
+	File_Trace_Header header;
+	if (mode == FILE_TRACE_RECORD){
+		file_trace -> fp = fopen(filename, "w");
+		if (file_trace -> fp == NULL){
+			fprintf(stderr, "Could not create file trace %s\n", filename);
+			close_file_trace(file_trace);
+			return NULL;
+		}
+		header.magic = FILE_TRACE_MAGIC;
+		header.version = FILE_TRACE_VERSION;
+		header.reserved = 0;
+		write_trace_bytes(file_trace, &header, sizeof(File_Trace_Header));
+		return file_trace;
+	}
+
+	file_trace -> fp = fopen(filename, "r");
+	if (file_trace -> fp == NULL){
+		fprintf(stderr, "Could not open file trace %s\n", filename);
+		close_file_trace(file_trace);
+		return NULL;
+	}
+	if ((read_trace_bytes(file_trace, &header, sizeof(File_Trace_Header)) == -1) || (header.magic != FILE_TRACE_MAGIC) || (header.version != FILE_TRACE_VERSION)){
+		fprintf(stderr, "%s is not a file trace (or from another version)\n", filename);
+		close_file_trace(file_trace);
+		return NULL;
+	}
+
+	// what the collectors opened and read at init, the tree has to be there before they start
+	mkdir(root_dir, 0755);
+	if (apply_trace_records(file_trace) == -1){
+		fprintf(stderr, "File trace %s is corrupt\n", filename);
+		close_file_trace(file_trace);
+		return NULL;
+	}
+
+	return file_trace;
+}
+
+void close_file_trace(File_Trace * file_trace){
+
+	if (file_trace -> fp != NULL){
+		fclose(file_trace -> fp);
+	}
+	for (int i = 0; i < file_trace -> n_paths; i++){
+		free(file_trace -> paths[i].path);
+		free(file_trace -> paths[i].contents);
+	}
+	free(file_trace -> paths);
+	free(file_trace -> fd_paths);
+	free(file_trace -> root_dir);
+	pthread_mutex_destroy(&(file_trace -> lock));
+	free(file_trace);
+}
+
+void end_file_trace_tick(File_Trace * file_trace){
+
+	if (file_trace -> mode != FILE_TRACE_RECORD){
+		return;
+	}
+	pthread_mutex_lock(&(file_trace -> lock));
+	fflush(file_trace -> fp);
+	pthread_mutex_unlock(&(file_trace -> lock));
+}
+
+int advance_file_trace(File_Trace * file_trace, long timestamp_ns){
+
+	if (file_trace -> mode == FILE_TRACE_RECORD){
+		uint8_t type = TRACE_RECORD_TICK;
+		int64_t tick_timestamp_ns = timestamp_ns;
+		pthread_mutex_lock(&(file_trace -> lock));
+		write_trace_bytes(file_trace, &type, sizeof(uint8_t));
+		write_trace_bytes(file_trace, &tick_timestamp_ns, sizeof(int64_t));
+		file_trace -> tick_timestamp_ns = timestamp_ns;
+		file_trace -> n_ticks++;
+		pthread_mutex_unlock(&(file_trace -> lock));
+		return 1;
+	}
+
+	if (!file_trace -> has_tick){
+		return 0;
+	}
+	file_trace -> has_tick = false;
+	file_trace -> tick_timestamp_ns = file_trace -> next_timestamp_ns;
+	if (apply_trace_records(file_trace) == -1){
+		fprintf(stderr, "File trace is corrupt after %ld ticks, replay stops here\n", file_trace -> n_ticks);
+		return 0;
+	}
+	file_trace -> n_ticks++;
+	return 1;
+}
+
+
+/* FILES */
+
+int open_trace_file(char * path){
+
+	File_Trace * file_trace = active_trace;
+	if ((file_trace != NULL) && (file_trace -> mode == FILE_TRACE_REPLAY)){
+		int path_id = find_trace_path(file_trace, get_relative_path(file_trace, path));
+		if (path_id == -1){
+			errno = ENOENT;
+			return -1;
+		}
+		return TRACE_FD_BASE + path_id;
+	}
+
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if ((file_trace == NULL) || (fd == -1)){
+		return fd;
+	}
+	pthread_mutex_lock(&(file_trace -> lock));
+	record_open(file_trace, fd, get_relative_path(file_trace, path));
+	pthread_mutex_unlock(&(file_trace -> lock));
+	return fd;
+}
+
+ssize_t read_trace_file(int fd, char * buf, size_t buf_size){
+
+	File_Trace * file_trace = active_trace;
+	if ((file_trace != NULL) && (file_trace -> mode == FILE_TRACE_REPLAY) && (fd >= TRACE_FD_BASE)){
+		if (fd - TRACE_FD_BASE >= file_trace -> n_paths){
+			errno = EBADF;
+			return -1;
+		}
+		Trace_Path * trace_path = &(file_trace -> paths[fd - TRACE_FD_BASE]);
+		size_t n_read = ((size_t) trace_path -> length < buf_size) ? (size_t) trace_path -> length : buf_size;
+		if (n_read > 0){
+			memcpy(buf, trace_path -> contents, n_read);
+		}
+		return n_read;
+	}
+
+	ssize_t n_read = pread(fd, buf, buf_size, 0);
+	if ((file_trace == NULL) || (file_trace -> mode != FILE_TRACE_RECORD) || (n_read < 0)){
+		return n_read;
+	}
+	pthread_mutex_lock(&(file_trace -> lock));
+	if ((fd < file_trace -> max_fds) && (file_trace -> fd_paths[fd] != 0)){
+		record_contents(file_trace, file_trace -> fd_paths[fd] - 1, buf, n_read);
+	}
+	pthread_mutex_unlock(&(file_trace -> lock));
+	return n_read;
+}
+
+void close_trace_file(int fd){
+
+	// a replay fd, even after the trace was detached
+	if (fd >= TRACE_FD_BASE){
+		return;
+	}
+	File_Trace * file_trace = active_trace;
+	if ((file_trace == NULL) || (file_trace -> mode != FILE_TRACE_RECORD)){
+		close(fd);
+		return;
+	}
+
+	// unmapped before the fd can be handed out again
+	pthread_mutex_lock(&(file_trace -> lock));
+	if ((fd < file_trace -> max_fds) && (file_trace -> fd_paths[fd] != 0)){
+		write_id_record(file_trace, TRACE_RECORD_CLOSE, file_trace -> fd_paths[fd] - 1);
+		file_trace -> fd_paths[fd] = 0;
+	}
+	close(fd);
+	pthread_mutex_unlock(&(file_trace -> lock));
+}
+
+DIR * open_trace_dir(char * path){
+
+	DIR * dr = opendir(path);
+	File_Trace * file_trace = active_trace;
+	if ((dr == NULL) || (file_trace == NULL) || (file_trace -> mode != FILE_TRACE_RECORD)){
+		return dr;
+	}
+
+	pthread_mutex_lock(&(file_trace -> lock));
+	char * rel_path = get_relative_path(file_trace, path);
+	int path_id = find_trace_path(file_trace, rel_path);
+	if (path_id == -1){
+		path_id = add_trace_path(file_trace, rel_path);
+		if (path_id != -1){
+			write_path_record(file_trace, path_id, rel_path);
+		}
+	}
+	if ((path_id != -1) && (!file_trace -> paths[path_id].is_dir)){
+		file_trace -> paths[path_id].is_dir = true;
+		write_id_record(file_trace, TRACE_RECORD_DIR, path_id);
+	}
+	pthread_mutex_unlock(&(file_trace -> lock));
+	return dr;
+}
@@ -0,0 +1,123 @@
+#ifndef FILE_TRACE_H
+#define FILE_TRACE_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+// FILE TRACES (-W, --record_trace=<file> and -X, --replay_trace=<file>)
+//	- every procfs / sysfs / cgroupfs file the collectors read is opened, read and closed
+//	  through open_trace_file / read_trace_file / close_trace_file (see the host_stats.h helpers),
+//	  every directory they scan is opened with open_trace_dir
+//	- RECORD: the real files are read as usual, every open and close and the contents of every
+//	  read go to the trace, tick by tick
+//	- REPLAY: nothing is read, opening a recorded path returns a virtual fd and reads return what
+//	  the path held on the current tick of the trace. The tree under the root dir (-P) is kept in
+//	  step, a file is created on the tick it was opened and removed once it was closed, so the
+//	  directory scans (interfaces, IB ports, job cgroups) see what the recorded node had
+//	- the replay moves one recorded tick per monitor tick and the monitor exits at the end of the
+//	  trace (the tree is left as it was on the last tick), -s sets the speed (a trace recorded at
+//	  100 ms replays 100x faster at -s 1), samples carry the recorded timestamps
+//	- paths are stored relative to the root dir, a trace recorded on a node replays under any root
+//
+// Trace file: File_Trace_Header, then records that start with a uint8 type (native byte order)
+//	- PATH: uint32 path_id, uint16 length, path (before the first OPEN / DIR of the path, ids count up from 0)
+//	- TICK: int64 timestamp_ns (start of a tick, the records after it belong to it)
+//	- OPEN / CLOSE: uint32 path_id
+//	- DATA: uint32 path_id, uint32 length, uint32 prefix, then length - prefix bytes (the first
+//	  prefix bytes are the same as the previous contents), a read that returns the same contents
+//	  as the previous one isn't recorded
+//	- DIR: uint32 path_id, a directory that was scanned (once per path), the replay creates it
+//	  and keeps it even when it's empty
+
+#define FILE_TRACE_MAGIC 0x4352544d
+#define FILE_TRACE_VERSION 1
+
+#define TRACE_RECORD_PATH 1
+#define TRACE_RECORD_TICK 2
+#define TRACE_RECORD_OPEN 3
+#define TRACE_RECORD_CLOSE 4
+#define TRACE_RECORD_DATA 5
+#define TRACE_RECORD_DIR 6
+
+// replay fds are TRACE_FD_BASE + path_id, above any fd the kernel hands out (fs.nr_open <= 2^30)
+#define TRACE_FD_BASE (1 << 30)
+
+typedef enum file_trace_mode {
+	FILE_TRACE_RECORD,
+	FILE_TRACE_REPLAY
+} File_Trace_Mode;
+
+typedef struct file_trace_header {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t reserved;
+} File_Trace_Header;
+
+typedef struct trace_path {
+	// relative to the root dir
+	char * path;
+	// contents of the last read (record) or on the current tick (replay)
+	char * contents;
+	int length;
+	int capacity;
+	// REPLAY: opens without a close so far, the file is in the tree while > 0
+	int n_open;
+	// a scanned directory (DIR record), stays in the replay tree
+	bool is_dir;
+} Trace_Path;
+
+typedef struct file_trace {
+	File_Trace_Mode mode;
+	FILE * fp;
+	char * root_dir;
+	int root_len;
+	// RECORD: reads come from every collection thread (see collect_pool.h)
+	pthread_mutex_t lock;
+	int n_paths;
+	int max_paths;
+	Trace_Path * paths;
+	// RECORD: path_id + 1 of every traced fd (0 if not traced), indexed by fd
+	int max_fds;
+	int * fd_paths;
+	bool write_error;
+	// REPLAY: the next TICK record has been read, false once the trace is over
+	bool has_tick;
+	// timestamp of the current tick (REPLAY: when it was recorded)
+	long tick_timestamp_ns;
+	// REPLAY: timestamp of the next TICK record
+	long next_timestamp_ns;
+	long n_ticks;
+	// bytes of trace written or read
+	long n_bytes;
+} File_Trace;
+
+
+// RECORD writes filename, REPLAY reads it (and every record before its first tick) and creates
+// the tree under root_dir, NULL on failure. Paths under root_dir are stored without it.
+File_Trace * open_file_trace(char * filename, File_Trace_Mode mode, char * root_dir);
+void close_file_trace(File_Trace * file_trace);
+
+// call at the start of every tick
+//	- RECORD: starts the tick in the trace, always 1
+//	- REPLAY: moves to the next recorded tick, 0 once the trace is over
+int advance_file_trace(File_Trace * file_trace, long timestamp_ns);
+
+// call once a tick's files were read, RECORD: the tick is complete on disk (a killed recording keeps it)
+void end_file_trace_tick(File_Trace * file_trace);
+
+// the trace the *_trace_file functions go through, NULL (default) uses the files as they are
+void set_file_trace(File_Trace * file_trace);
+
+// open(path, O_RDONLY | O_CLOEXEC), -1 if it doesn't exist (REPLAY: wasn't recorded)
+int open_trace_file(char * path);
+
+// pread(fd, buf, buf_size, 0)
+ssize_t read_trace_file(int fd, char * buf, size_t buf_size);
+
+void close_trace_file(int fd);
+
+// opendir(path), RECORD: the directory goes to the trace (the replay tree has it even if empty)
+DIR * open_trace_dir(char * path);
+
+#endif
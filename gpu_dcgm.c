@@ -0,0 +1,429 @@
+#define _GNU_SOURCE
+
+#include "job_stats.h"
+#include "dcgm_agent.h"
+#include "dcgm_fields.h"
+#include "dcgm_structs.h"
+
+#include "monitoring.h"
+#include "field_lookup.h"
+#include "gpu_source.h"
+
+
+// EMBEDDED DCGM HOST ENGINE
+//	- one group with every device and one field group with field_ids, watched at the sample rate
+//	- default: every tick forces an update and copies the latest values through the field lookup
+//
+// BATCH MODE (dcgm:batch_secs=<int>[,watch_millis=<int>])
+//	- the host engine samples on its own every watch_millis (default: the gpu period) and keeps
+//	  everything since the last drain, ticks make no DCGM calls at all
+//	- every batch_secs (and on the last sample of a buffer, before it goes to the writer) the
+//	  cache is drained with dcgmGetValuesSince from a cursor, values newer than the current
+//	  tick are left for the next drain
+//	- every drained value is kept with its DCGM timestamp in the buffer's gpu_values (Gpu_Values table)
+//	- the tick grid gets the mean of the values whose DCGM timestamp falls in the sample's tick
+//	  window (times[i - 1], times[i]], windows without a value are blank (NULL in storage)
+//	- until their drain, the latest samples of a buffer are blank (also in <hostname>.ring)
+
+typedef struct dcgm_state {
+	dcgmHandle_t dcgmHandle;
+	dcgmGpuGrp_t groupId;
+	dcgmFieldGrp_t fieldGroupId;
+	bool initialized;
+	bool started;
+	bool group_created;
+	bool field_group_created;
+	// BATCH MODE
+	long batch_ns;
+	long last_drain_ns;
+	// microseconds since 1970, values before it were already drained
+	long long since_timestamp;
+	// buffer being drained and the first sample of it no drain covered yet
+	Samples_Buffer * drain_buffer;
+	int next_slot;
+	// [n_columns][max_samples], sum and count of the drained values in every slot's window
+	double * window_sums;
+	int * window_counts;
+	int window_max_samples;
+} Dcgm_State;
+
+// passed through dcgmGetValuesSince to the callback
+typedef struct dcgm_drain {
+	Samples_Buffer * samples_buffer;
+	Dcgm_State * dcgm_state;
+	// time of the current tick (microseconds)
+	long long tick_timestamp;
+	bool alloc_failed;
+} Dcgm_Drain;
+
+
+static long long get_sample_micros(Samples_Buffer * samples_buffer, int sample){
+	return (long long) samples_buffer -> times[sample].tv_sec * 1000000LL + samples_buffer -> times[sample].tv_nsec / 1000;
+}
+
+// first sample in [next_slot, n_samples] whose tick is at or after timestamp
+static int find_sample_slot(Samples_Buffer * samples_buffer, int next_slot, long long timestamp){
+
+	int lo = next_slot;
+	int hi = samples_buffer -> n_samples;
+	int mid;
+	while (lo < hi){
+		mid = lo + (hi - lo) / 2;
+		if (get_sample_micros(samples_buffer, mid) < timestamp){
+			lo = mid + 1;
+		}
+		else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+// keeps one drained value with its own timestamp, the list grows with the buffer's drains
+static int add_gpu_value(Samples_Buffer * samples_buffer, long timestamp_ns, int device_id, int field_num, dcgmFieldValue_v1 * field_value){
+
+	if (samples_buffer -> n_gpu_values == samples_buffer -> max_gpu_values){
+		int max_gpu_values = (samples_buffer -> max_gpu_values > 0) ? 2 * samples_buffer -> max_gpu_values : 1024;
+		Gpu_Value * gpu_values = (Gpu_Value *) realloc(samples_buffer -> gpu_values, (size_t) max_gpu_values * sizeof(Gpu_Value));
+		if (gpu_values == NULL){
+			return -1;
+		}
+		samples_buffer -> gpu_values = gpu_values;
+		samples_buffer -> max_gpu_values = max_gpu_values;
+	}
+
+	Gpu_Value * gpu_value = &(samples_buffer -> gpu_values[samples_buffer -> n_gpu_values]);
+	gpu_value -> timestamp_ns = timestamp_ns;
+	gpu_value -> device_id = device_id;
+	gpu_value -> field_num = field_num;
+	if (field_value -> fieldType == DCGM_FT_DOUBLE){
+		gpu_value -> value.dbl = field_value -> value.dbl;
+	}
+	else {
+		gpu_value -> value.i64 = field_value -> value.i64;
+	}
+	samples_buffer -> n_gpu_values++;
+	return 0;
+}
+
+// dcgmGetValuesSince callback, userdata is a Dcgm_Drain
+static int drain_field_values_function(unsigned int gpuId, dcgmFieldValue_v1 * values, int numValues, void * userdata){
+	Dcgm_Drain * drain = (Dcgm_Drain *) userdata;
+	Samples_Buffer * samples_buffer = drain -> samples_buffer;
+	Dcgm_State * dcgm_state = drain -> dcgm_state;
+	int n_fields = samples_buffer -> n_fields;
+	short * field_lookup = samples_buffer -> field_lookup;
+	int indOfField, slot;
+	size_t window;
+
+	if (gpuId >= (unsigned int) samples_buffer -> n_devices){
+		return 0;
+	}
+
+	for (int i = 0; i < numValues; i++){
+		indOfField = field_lookup[values[i].fieldId];
+		if ((indOfField == -1) || (values[i].ts > drain -> tick_timestamp)){
+			continue;
+		}
+		// fieldType not supported
+		if ((values[i].fieldType != DCGM_FT_DOUBLE) && (values[i].fieldType != DCGM_FT_INT64) && (values[i].fieldType != DCGM_FT_TIMESTAMP)){
+			continue;
+		}
+		if (add_gpu_value(samples_buffer, values[i].ts * 1000L, gpuId, indOfField, &(values[i])) == -1){
+			drain -> alloc_failed = true;
+		}
+		// blanks (fields DCGM couldn't read) are kept above but stay out of the means
+		if ((values[i].fieldType == DCGM_FT_DOUBLE) ? (values[i].value.dbl >= GPU_FP64_BLANK) : (values[i].value.i64 >= GPU_INT64_BLANK)){
+			continue;
+		}
+		slot = find_sample_slot(samples_buffer, dcgm_state -> next_slot, values[i].ts);
+		window = (size_t) (gpuId * n_fields + indOfField) * dcgm_state -> window_max_samples + slot;
+		dcgm_state -> window_sums[window] += (values[i].fieldType == DCGM_FT_DOUBLE) ? values[i].value.dbl : (double) values[i].value.i64;
+		dcgm_state -> window_counts[window]++;
+	}
+	return 0;
+}
+
+// GPU columns of a sample no drain covered yet
+static void blank_sample(Samples_Buffer * samples_buffer, int sample){
+
+	int n_fields = samples_buffer -> n_fields;
+	int n_columns = samples_buffer -> n_devices * n_fields;
+	void * field_column;
+	for (int c = 0; c < n_columns; c++){
+		field_column = FIELD_COLUMN(samples_buffer, c);
+		if (samples_buffer -> field_types[c % n_fields] == GPU_FT_DOUBLE){
+			((double *) field_column)[sample] = GPU_FP64_BLANK;
+		}
+		else {
+			((long *) field_column)[sample] = GPU_INT64_BLANK;
+		}
+	}
+}
+
+// everything DCGM sampled up to the current tick goes into gpu_values and samples [next_slot, n_samples]
+static int drain_dcgm_values(Gpu_Source * gpu_source, Dcgm_State * dcgm_state, Samples_Buffer * samples_buffer){
+
+	int n_fields = gpu_source -> n_fields;
+	int n_columns = gpu_source -> n_devices * n_fields;
+	int n_samples = samples_buffer -> n_samples;
+
+	if (dcgm_state -> window_max_samples != samples_buffer -> max_samples){
+		free(dcgm_state -> window_sums);
+		free(dcgm_state -> window_counts);
+		dcgm_state -> window_sums = (double *) malloc((size_t) n_columns * samples_buffer -> max_samples * sizeof(double));
+		dcgm_state -> window_counts = (int *) malloc((size_t) n_columns * samples_buffer -> max_samples * sizeof(int));
+		if ((dcgm_state -> window_sums == NULL) || (dcgm_state -> window_counts == NULL)){
+			fprintf(stderr, "Could not allocate memory for DCGM batch state\n");
+			dcgm_state -> window_max_samples = 0;
+			return -1;
+		}
+		dcgm_state -> window_max_samples = samples_buffer -> max_samples;
+	}
+
+	if (samples_buffer != dcgm_state -> drain_buffer){
+		dcgm_state -> drain_buffer = samples_buffer;
+		dcgm_state -> next_slot = 0;
+	}
+	int next_slot = dcgm_state -> next_slot;
+	size_t window_row = dcgm_state -> window_max_samples;
+	for (int c = 0; c < n_columns; c++){
+		memset(dcgm_state -> window_sums + c * window_row + next_slot, 0, (n_samples + 1 - next_slot) * sizeof(double));
+		memset(dcgm_state -> window_counts + c * window_row + next_slot, 0, (n_samples + 1 - next_slot) * sizeof(int));
+	}
+
+	Dcgm_Drain drain;
+	drain.samples_buffer = samples_buffer;
+	drain.dcgm_state = dcgm_state;
+	drain.tick_timestamp = get_sample_micros(samples_buffer, n_samples);
+	drain.alloc_failed = false;
+
+	// the cursor only moves up to the current tick, so newer values come back next time
+	long long next_since_timestamp;
+	dcgmReturn_t dcgm_ret = dcgmGetValuesSince(dcgm_state -> dcgmHandle, dcgm_state -> groupId, dcgm_state -> fieldGroupId, dcgm_state -> since_timestamp, &next_since_timestamp, &drain_field_values_function, (void *) &drain);
+	if ((dcgm_ret != DCGM_ST_OK) && (dcgm_ret != DCGM_ST_NO_DATA)){
+		fprintf(stderr, "GET VALUES SINCE ERROR: %s\n", errorString(dcgm_ret));
+		return -1;
+	}
+	dcgm_state -> since_timestamp = drain.tick_timestamp + 1;
+
+	// mean of every window, windows nothing landed in are blank
+	void * field_column;
+	size_t window;
+	int count;
+	for (int c = 0; c < n_columns; c++){
+		field_column = FIELD_COLUMN(samples_buffer, c);
+		for (int i = next_slot; i <= n_samples; i++){
+			window = c * window_row + i;
+			count = dcgm_state -> window_counts[window];
+			if (gpu_source -> field_types[c % n_fields] == GPU_FT_DOUBLE){
+				((double *) field_column)[i] = (count > 0) ? dcgm_state -> window_sums[window] / count : GPU_FP64_BLANK;
+			}
+			else {
+				((long *) field_column)[i] = (count > 0) ? llround(dcgm_state -> window_sums[window] / count) : GPU_INT64_BLANK;
+			}
+		}
+	}
+
+	dcgm_state -> next_slot = n_samples + 1;
+
+	// the grid is complete either way
+	if (drain.alloc_failed){
+		fprintf(stderr, "Could not allocate memory for drained GPU values, some are missing from Gpu_Values\n");
+	}
+	return 0;
+}
+
+int open_dcgm_source(Gpu_Source * gpu_source, char * backend_options, int sample_freq_millis, int max_keep_samples){
+
+	Dcgm_State * dcgm_state = (Dcgm_State *) calloc(1, sizeof(Dcgm_State));
+	if (dcgm_state == NULL){
+		fprintf(stderr, "Could not allocate memory for DCGM state\n");
+		return -1;
+	}
+	gpu_source -> state = dcgm_state;
+
+	char * option = get_gpu_backend_option(backend_options, "batch_secs");
+	if (option != NULL){
+		dcgm_state -> batch_ns = atol(option) * 1000000000L;
+		free(option);
+		if (dcgm_state -> batch_ns <= 0){
+			fprintf(stderr, "batch_secs must be at least 1\n");
+			return -1;
+		}
+	}
+
+	// batch mode can let DCGM sample faster than the ticks, every value ends up in Gpu_Values
+	int watch_millis = sample_freq_millis;
+	option = get_gpu_backend_option(backend_options, "watch_millis");
+	if (option != NULL){
+		watch_millis = atoi(option);
+		free(option);
+		if ((dcgm_state -> batch_ns == 0) || (watch_millis <= 0)){
+			fprintf(stderr, "watch_millis must be at least 1 and needs batch_secs\n");
+			return -1;
+		}
+	}
+
+	dcgmReturn_t dcgm_ret;
+	dcgm_ret = dcgmInit();
+
+	if (dcgm_ret != DCGM_ST_OK){
+		fprintf(stderr, "INIT ERROR: %s\n", errorString(dcgm_ret));
+		return -1;
+	}
+	dcgm_state -> initialized = true;
+
+	// Start embedded process, in batch mode it samples the watched fields by itself
+	dcgmOperationMode_t operation_mode = (dcgm_state -> batch_ns > 0) ? DCGM_OPERATION_MODE_AUTO : DCGM_OPERATION_MODE_MANUAL;
+	dcgm_ret = dcgmStartEmbedded(operation_mode, &(dcgm_state -> dcgmHandle));
+
+	if (dcgm_ret != DCGM_ST_OK){
+		fprintf(stderr, "CONNECT ERROR: %s\n", errorString(dcgm_ret));
+		return -1;
+	}
+	dcgm_state -> started = true;
+
+
+	/* READ SYSTEM INFO */
+
+	unsigned int gpuIdList[DCGM_MAX_NUM_DEVICES];
+	int n_devices;
+
+	dcgm_ret = dcgmGetAllSupportedDevices(dcgm_state -> dcgmHandle, gpuIdList, &n_devices);
+
+	if (dcgm_ret != DCGM_ST_OK){
+		fprintf(stderr, "GET DEVICES ERROR: %s\n", errorString(dcgm_ret));
+		return -1;
+	}
+
+	// no GPUs in system, open_gpu_source reports it
+	gpu_source -> n_devices = n_devices;
+	if (n_devices == 0){
+		return 0;
+	}
+
+	// GROUP_DEFAULT creates group with all entities present on system
+	char groupName[] = "MyGroup";
+	dcgm_ret = dcgmGroupCreate(dcgm_state -> dcgmHandle, DCGM_GROUP_DEFAULT, groupName, &(dcgm_state -> groupId));
+
+	if (dcgm_ret != DCGM_ST_OK){
+		fprintf(stderr, "GROUP CREATE ERROR: %s\n", errorString(dcgm_ret));
+		return -1;
+	}
+	dcgm_state -> group_created = true;
+
+	// create field group with all the metrics we want to scan
+	char fieldGroupName[] = "MyFieldGroup";
+
+	dcgm_ret = dcgmFieldGroupCreate(dcgm_state -> dcgmHandle, gpu_source -> n_fields, gpu_source -> field_ids, fieldGroupName, &(dcgm_state -> fieldGroupId));
+	if (dcgm_ret != DCGM_ST_OK){
+		fprintf(stderr, "FIELD GROUP CREATE ERROR: %s\n", errorString(dcgm_ret));
+		return -1;
+	}
+	dcgm_state -> field_group_created = true;
+
+	// watch fields by combining device group and field group
+	// sample freq millis from command line
+	long long update_freq_micros = (long long) watch_millis * 1000;
+
+	// don't cache old metrics for more than 1 sec, batch mode has to keep everything since the last drain
+	//	- however many samples that is at watch_millis (0 = no count limit)
+	double max_keep_seconds = 1;
+	if (dcgm_state -> batch_ns > 0){
+		max_keep_seconds = 2 * (dcgm_state -> batch_ns / 1e9);
+		max_keep_samples = 0;
+	}
+
+	dcgm_ret = dcgmWatchFields(dcgm_state -> dcgmHandle, dcgm_state -> groupId, dcgm_state -> fieldGroupId, update_freq_micros, max_keep_seconds, max_keep_samples);
+
+	if (dcgm_ret != DCGM_ST_OK){
+		fprintf(stderr, "WATCH FIELDS ERROR: %s\n", errorString(dcgm_ret));
+		return -1;
+	}
+
+	DcgmFieldsInit();
+
+	dcgm_field_meta_p meta_ptr;
+	for (int i = 0 ; i < gpu_source -> n_fields; i++){
+		meta_ptr = DcgmFieldGetById(gpu_source -> field_ids[i]);
+		if (meta_ptr == NULL){
+			fprintf(stderr, "Unknown field %d\n", gpu_source -> field_ids[i]);
+			return -1;
+		}
+		gpu_source -> field_types[i] = (unsigned short) meta_ptr -> fieldType;
+	}
+
+	if (dcgm_state -> batch_ns > 0){
+		// only values sampled from now on
+		struct timespec now;
+		clock_gettime(CLOCK_REALTIME, &now);
+		dcgm_state -> since_timestamp = (long long) now.tv_sec * 1000000LL + now.tv_nsec / 1000;
+	}
+
+	return 0;
+}
+
+int collect_dcgm_values(Gpu_Source * gpu_source, Samples_Buffer * samples_buffer){
+
+	Dcgm_State * dcgm_state = (Dcgm_State *) gpu_source -> state;
+	dcgmReturn_t dcgm_ret;
+
+	if (dcgm_state -> batch_ns > 0){
+		int n_samples = samples_buffer -> n_samples;
+		long tick_ns = samples_buffer -> times[n_samples].tv_sec * 1000000000L + samples_buffer -> times[n_samples].tv_nsec;
+		if (dcgm_state -> last_drain_ns == 0){
+			dcgm_state -> last_drain_ns = tick_ns;
+		}
+		if ((n_samples < samples_buffer -> max_samples - 1) && ((tick_ns - dcgm_state -> last_drain_ns) < dcgm_state -> batch_ns)){
+			blank_sample(samples_buffer, n_samples);
+			return 0;
+		}
+		dcgm_state -> last_drain_ns = tick_ns;
+		return drain_dcgm_values(gpu_source, dcgm_state, samples_buffer);
+	}
+
+	// update fields (and wait for return)
+	dcgm_ret = dcgmUpdateAllFields(dcgm_state -> dcgmHandle, 1);
+	if (dcgm_ret != DCGM_ST_OK){
+		fprintf(stderr, "UPDATE ALL FIELDS ERROR: %s\n", errorString(dcgm_ret));
+		return -1;
+	}
+
+	// retrieve values
+	dcgm_ret = dcgmGetLatestValues(dcgm_state -> dcgmHandle, dcgm_state -> groupId, dcgm_state -> fieldGroupId, &copy_field_values_function, (void *) samples_buffer);
+	if (dcgm_ret != DCGM_ST_OK){
+		fprintf(stderr, "GET LATEST VALUES ERROR: %s\n", errorString(dcgm_ret));
+		return -1;
+	}
+
+	return 0;
+}
+
+void close_dcgm_source(Gpu_Source * gpu_source){
+
+	Dcgm_State * dcgm_state = (Dcgm_State *) gpu_source -> state;
+	if (dcgm_state == NULL){
+		return;
+	}
+
+	if (dcgm_state -> field_group_created){
+		dcgmFieldGroupDestroy(dcgm_state -> dcgmHandle, dcgm_state -> fieldGroupId);
+	}
+
+	if (dcgm_state -> group_created){
+		dcgmGroupDestroy(dcgm_state -> dcgmHandle, dcgm_state -> groupId);
+	}
+
+	if (dcgm_state -> started){
+		dcgmStopEmbedded(dcgm_state -> dcgmHandle);
+	}
+
+	if (dcgm_state -> initialized){
+		dcgmShutdown();
+	}
+
+	free(dcgm_state -> window_sums);
+	free(dcgm_state -> window_counts);
+	free(dcgm_state);
+}
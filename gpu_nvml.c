@@ -0,0 +1,183 @@
+#define _GNU_SOURCE
+
+#include "job_stats.h"
+#include "nvml.h"
+
+#include "monitoring.h"
+#include "gpu_source.h"
+
+
+// NVML DEVICE QUERIES
+//	- no host engine and no profiling counters, only the fields below (DCGM ids, same units
+//	  as DCGM), anything else stays 0
+//	- every device query is a driver call, so this is slower per tick than dcgm
+
+typedef struct nvml_state {
+	bool initialized;
+	nvmlDevice_t * devices;
+} Nvml_State;
+
+static int is_nvml_field(unsigned short field_id){
+
+	switch (field_id){
+		case 100: case 101: case 150: case 155:
+		case 203: case 204:
+		case 250: case 251: case 252: case 254:
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+
+int open_nvml_source(Gpu_Source * gpu_source, char * backend_options){
+
+	Nvml_State * nvml_state = (Nvml_State *) calloc(1, sizeof(Nvml_State));
+	if (nvml_state == NULL){
+		fprintf(stderr, "Could not allocate memory for NVML state\n");
+		return -1;
+	}
+	gpu_source -> state = nvml_state;
+
+	nvmlReturn_t nvml_ret = nvmlInit_v2();
+	if (nvml_ret != NVML_SUCCESS){
+		fprintf(stderr, "NVML INIT ERROR: %s\n", nvmlErrorString(nvml_ret));
+		return -1;
+	}
+	nvml_state -> initialized = true;
+
+	unsigned int n_devices;
+	nvml_ret = nvmlDeviceGetCount_v2(&n_devices);
+	if (nvml_ret != NVML_SUCCESS){
+		fprintf(stderr, "NVML GET DEVICES ERROR: %s\n", nvmlErrorString(nvml_ret));
+		return -1;
+	}
+
+	// no GPUs in system, open_gpu_source reports it
+	gpu_source -> n_devices = n_devices;
+	if (n_devices == 0){
+		return 0;
+	}
+
+	nvml_state -> devices = (nvmlDevice_t *) malloc(n_devices * sizeof(nvmlDevice_t));
+	if (nvml_state -> devices == NULL){
+		fprintf(stderr, "Could not allocate memory for NVML devices\n");
+		return -1;
+	}
+	for (unsigned int i = 0; i < n_devices; i++){
+		nvml_ret = nvmlDeviceGetHandleByIndex_v2(i, &(nvml_state -> devices[i]));
+		if (nvml_ret != NVML_SUCCESS){
+			fprintf(stderr, "NVML GET DEVICE %u ERROR: %s\n", i, nvmlErrorString(nvml_ret));
+			return -1;
+		}
+	}
+
+	Gpu_Field_Info * field_info;
+	for (int i = 0; i < gpu_source -> n_fields; i++){
+		if (!is_nvml_field(gpu_source -> field_ids[i])){
+			fprintf(stderr, "Field %d is not available through NVML, recording 0\n", gpu_source -> field_ids[i]);
+		}
+		field_info = get_gpu_field_info(gpu_source -> field_ids[i]);
+		gpu_source -> field_types[i] = (field_info == NULL) ? GPU_FT_DOUBLE : field_info -> field_type;
+	}
+
+	return 0;
+}
+
+int collect_nvml_values(Gpu_Source * gpu_source, Samples_Buffer * samples_buffer){
+
+	Nvml_State * nvml_state = (Nvml_State *) gpu_source -> state;
+	int n_samples = samples_buffer -> n_samples;
+	int n_fields = gpu_source -> n_fields;
+
+	nvmlDevice_t device;
+	nvmlUtilization_t utilization;
+	nvmlMemory_t memory;
+	nvmlReturn_t nvml_ret;
+	unsigned int uint_val;
+	void * field_column;
+	long long_val;
+	double double_val;
+
+	for (int gpuId = 0; gpuId < gpu_source -> n_devices; gpuId++){
+		device = nvml_state -> devices[gpuId];
+		for (int fieldNum = 0; fieldNum < n_fields; fieldNum++){
+			long_val = 0;
+			double_val = 0;
+			nvml_ret = NVML_SUCCESS;
+			switch (gpu_source -> field_ids[fieldNum]){
+				case 100:
+					nvml_ret = nvmlDeviceGetClockInfo(device, NVML_CLOCK_SM, &uint_val);
+					long_val = uint_val;
+					break;
+				case 101:
+					nvml_ret = nvmlDeviceGetClockInfo(device, NVML_CLOCK_MEM, &uint_val);
+					long_val = uint_val;
+					break;
+				case 150:
+					nvml_ret = nvmlDeviceGetTemperature(device, NVML_TEMPERATURE_GPU, &uint_val);
+					long_val = uint_val;
+					break;
+				case 155:
+					// milliwatts
+					nvml_ret = nvmlDeviceGetPowerUsage(device, &uint_val);
+					double_val = uint_val / 1000.0;
+					break;
+				case 203:
+					nvml_ret = nvmlDeviceGetUtilizationRates(device, &utilization);
+					long_val = utilization.gpu;
+					break;
+				case 204:
+					nvml_ret = nvmlDeviceGetUtilizationRates(device, &utilization);
+					long_val = utilization.memory;
+					break;
+				case 250: case 251: case 252: case 254:
+					nvml_ret = nvmlDeviceGetMemoryInfo(device, &memory);
+					if (gpu_source -> field_ids[fieldNum] == 250){
+						long_val = memory.total >> 20;
+					}
+					else if (gpu_source -> field_ids[fieldNum] == 251){
+						long_val = memory.free >> 20;
+					}
+					else if (gpu_source -> field_ids[fieldNum] == 252){
+						long_val = memory.used >> 20;
+					}
+					else if (memory.total > 0){
+						double_val = 100 * ((double) memory.used / (double) memory.total);
+					}
+					break;
+				default:
+					break;
+			}
+
+			// a query that fails on one device (e.g. not supported) records 0, same as a blank DCGM value
+			if (nvml_ret != NVML_SUCCESS){
+				long_val = 0;
+				double_val = 0;
+			}
+
+			field_column = FIELD_COLUMN(samples_buffer, gpuId * n_fields + fieldNum);
+			if (gpu_source -> field_types[fieldNum] == GPU_FT_DOUBLE){
+				((double *) field_column)[n_samples] = double_val;
+			}
+			else {
+				((long *) field_column)[n_samples] = long_val;
+			}
+		}
+	}
+
+	return 0;
+}
+
+void close_nvml_source(Gpu_Source * gpu_source){
+
+	Nvml_State * nvml_state = (Nvml_State *) gpu_source -> state;
+	if (nvml_state == NULL){
+		return;
+	}
+	if (nvml_state -> initialized){
+		nvmlShutdown();
+	}
+	free(nvml_state -> devices);
+	free(nvml_state);
+}
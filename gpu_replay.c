@@ -0,0 +1,170 @@
+#define _GNU_SOURCE
+
+#include "job_stats.h"
+
+#include "monitoring.h"
+#include "columnar.h"
+#include "gpu_source.h"
+
+
+// REPLAY OF A COLUMNAR FILE (replay:<file.mts>)
+//	- every collect hands out the GPU values of the next sample in the file, starting over
+//	  at the end, so a recorded run can drive the monitor on a machine without GPUs
+//	- the device count comes from the first chunk, requested fields are matched by id
+//	  against every chunk's field list (fields missing from a chunk read as 0)
+//	- only values are replayed, timestamps come from this run's clock
+
+typedef struct replay_state {
+	char * path;
+	FILE * data_file;
+	Columnar_Chunk * chunk;
+	int next_sample;
+	// per requested field, its index in chunk -> field_ids or -1
+	int * chunk_field_inds;
+} Replay_State;
+
+
+// moves to the next chunk with samples, rewinding once at the end of the file
+static int load_next_chunk(Gpu_Source * gpu_source, Replay_State * replay_state){
+
+	Columnar_Chunk * chunk;
+	bool rewound = false;
+
+	if (replay_state -> chunk != NULL){
+		free_columnar_chunk(replay_state -> chunk);
+		replay_state -> chunk = NULL;
+	}
+
+	while (true){
+		chunk = read_columnar_chunk(replay_state -> data_file);
+		if (chunk == NULL){
+			if (rewound){
+				fprintf(stderr, "No samples to replay in %s\n", replay_state -> path);
+				return -1;
+			}
+			rewind(replay_state -> data_file);
+			rewound = true;
+			continue;
+		}
+		if (chunk -> n_samples > 0){
+			break;
+		}
+		free_columnar_chunk(chunk);
+	}
+
+	for (int i = 0; i < gpu_source -> n_fields; i++){
+		replay_state -> chunk_field_inds[i] = -1;
+		for (int j = 0; j < chunk -> n_fields; j++){
+			if (chunk -> field_ids[j] == gpu_source -> field_ids[i]){
+				replay_state -> chunk_field_inds[i] = j;
+				break;
+			}
+		}
+	}
+
+	replay_state -> chunk = chunk;
+	replay_state -> next_sample = 0;
+	return 0;
+}
+
+int open_replay_source(Gpu_Source * gpu_source, char * backend_options){
+
+	if ((backend_options == NULL) || (backend_options[0] == '\0')){
+		fprintf(stderr, "Replay backend needs a columnar file (replay:<file.mts>)\n");
+		return -1;
+	}
+
+	Replay_State * replay_state = (Replay_State *) calloc(1, sizeof(Replay_State));
+	if (replay_state == NULL){
+		fprintf(stderr, "Could not allocate memory for replay state\n");
+		return -1;
+	}
+	gpu_source -> state = replay_state;
+
+	replay_state -> path = strdup(backend_options);
+	replay_state -> chunk_field_inds = (int *) malloc(gpu_source -> n_fields * sizeof(int));
+	if ((replay_state -> path == NULL) || (replay_state -> chunk_field_inds == NULL)){
+		fprintf(stderr, "Could not allocate memory for replay state\n");
+		return -1;
+	}
+
+	replay_state -> data_file = fopen(replay_state -> path, "rb");
+	if (replay_state -> data_file == NULL){
+		fprintf(stderr, "Could not open columnar file at: %s\n", replay_state -> path);
+		return -1;
+	}
+
+	if (load_next_chunk(gpu_source, replay_state) == -1){
+		return -1;
+	}
+
+	Columnar_Chunk * chunk = replay_state -> chunk;
+	gpu_source -> n_devices = chunk -> n_devices;
+
+	Gpu_Field_Info * field_info;
+	int ind;
+	for (int i = 0; i < gpu_source -> n_fields; i++){
+		ind = replay_state -> chunk_field_inds[i];
+		if (ind != -1){
+			gpu_source -> field_types[i] = chunk -> field_types[ind];
+			continue;
+		}
+		fprintf(stderr, "Field %d is not in %s, replaying 0\n", gpu_source -> field_ids[i], replay_state -> path);
+		field_info = get_gpu_field_info(gpu_source -> field_ids[i]);
+		gpu_source -> field_types[i] = (field_info == NULL) ? GPU_FT_DOUBLE : field_info -> field_type;
+	}
+
+	return 0;
+}
+
+int collect_replay_values(Gpu_Source * gpu_source, Samples_Buffer * samples_buffer){
+
+	Replay_State * replay_state = (Replay_State *) gpu_source -> state;
+
+	if (replay_state -> next_sample == replay_state -> chunk -> n_samples){
+		if (load_next_chunk(gpu_source, replay_state) == -1){
+			return -1;
+		}
+	}
+
+	Columnar_Chunk * chunk = replay_state -> chunk;
+	int sample = replay_state -> next_sample;
+	int n_samples = samples_buffer -> n_samples;
+	int n_fields = gpu_source -> n_fields;
+	int ind;
+	long val;
+
+	// values are copied as raw 8-byte slots, the field types come from the file
+	for (int gpuId = 0; gpuId < gpu_source -> n_devices; gpuId++){
+		for (int fieldNum = 0; fieldNum < n_fields; fieldNum++){
+			ind = replay_state -> chunk_field_inds[fieldNum];
+			if ((ind == -1) || (gpuId >= chunk -> n_devices)){
+				val = 0;
+			}
+			else {
+				val = get_columnar_long(chunk, N_COLUMNAR_HOST_COLUMNS + gpuId * chunk -> n_fields + ind, sample);
+			}
+			((long *) FIELD_COLUMN(samples_buffer, gpuId * n_fields + fieldNum))[n_samples] = val;
+		}
+	}
+
+	replay_state -> next_sample++;
+	return 0;
+}
+
+void close_replay_source(Gpu_Source * gpu_source){
+
+	Replay_State * replay_state = (Replay_State *) gpu_source -> state;
+	if (replay_state == NULL){
+		return;
+	}
+	if (replay_state -> chunk != NULL){
+		free_columnar_chunk(replay_state -> chunk);
+	}
+	if (replay_state -> data_file != NULL){
+		fclose(replay_state -> data_file);
+	}
+	free(replay_state -> chunk_field_inds);
+	free(replay_state -> path);
+	free(replay_state);
+}
@@ -0,0 +1,207 @@
+#define _GNU_SOURCE
+
+#include "job_stats.h"
+
+#include "monitoring.h"
+#include "field_lookup.h"
+#include "gpu_source.h"
+
+
+// FIELDS THE NVML AND SYNTHETIC BACKENDS KNOW ABOUT
+//	- types match DcgmFieldGetById, anything else is treated as a double in [0, 1]
+static Gpu_Field_Info gpu_field_table[] = {
+	// clocks (MHz), temperature (C), power (W)
+	{100, GPU_FT_INT64, 2000},
+	{101, GPU_FT_INT64, 1600},
+	{150, GPU_FT_INT64, 90},
+	{155, GPU_FT_DOUBLE, 400},
+	// coarse utilization (%)
+	{203, GPU_FT_INT64, 100},
+	{204, GPU_FT_INT64, 100},
+	// frame buffer (MB, %)
+	{250, GPU_FT_INT64, 81920},
+	{251, GPU_FT_INT64, 81920},
+	{252, GPU_FT_INT64, 81920},
+	{254, GPU_FT_DOUBLE, 100},
+	// profiling ratios
+	{1001, GPU_FT_DOUBLE, 1},
+	{1002, GPU_FT_DOUBLE, 1},
+	{1003, GPU_FT_DOUBLE, 1},
+	{1004, GPU_FT_DOUBLE, 1},
+	{1005, GPU_FT_DOUBLE, 1},
+	{1006, GPU_FT_DOUBLE, 1},
+	{1007, GPU_FT_DOUBLE, 1},
+	{1008, GPU_FT_DOUBLE, 1},
+	// PCIe / NVLink bytes per second
+	{1009, GPU_FT_INT64, 25e9},
+	{1010, GPU_FT_INT64, 25e9},
+	{1011, GPU_FT_INT64, 300e9},
+	{1012, GPU_FT_INT64, 300e9}
+};
+
+#define N_GPU_FIELD_INFOS (sizeof(gpu_field_table) / sizeof(Gpu_Field_Info))
+
+
+Gpu_Field_Info * get_gpu_field_info(unsigned short field_id){
+
+	for (size_t i = 0; i < N_GPU_FIELD_INFOS; i++){
+		if (gpu_field_table[i].field_id == field_id){
+			return &(gpu_field_table[i]);
+		}
+	}
+	return NULL;
+}
+
+char * get_gpu_backend_option(char * backend_options, char * key){
+
+	if (backend_options == NULL){
+		return NULL;
+	}
+
+	size_t key_len = strlen(key);
+	char * option = backend_options;
+	char * end;
+	while (*option != '\0'){
+		end = strchrnul(option, ',');
+		if ((strncmp(option, key, key_len) == 0) && (option[key_len] == '=')){
+			return strndup(option + key_len + 1, end - (option + key_len + 1));
+		}
+		option = (*end == ',') ? end + 1 : end;
+	}
+	return NULL;
+}
+
+int parse_gpu_backend(char * backend_str, Gpu_Backend * backend, char ** backend_options){
+
+	char * colon = strchr(backend_str, ':');
+	size_t name_len = (colon == NULL) ? strlen(backend_str) : (size_t) (colon - backend_str);
+
+	if ((name_len == 4) && (strncmp(backend_str, "dcgm", 4) == 0)){
+		*backend = GPU_BACKEND_DCGM;
+	}
+	else if ((name_len == 4) && (strncmp(backend_str, "nvml", 4) == 0)){
+		*backend = GPU_BACKEND_NVML;
+	}
+	else if ((name_len == 9) && (strncmp(backend_str, "synthetic", 9) == 0)){
+		*backend = GPU_BACKEND_SYNTHETIC;
+	}
+	else if ((name_len == 6) && (strncmp(backend_str, "replay", 6) == 0)){
+		*backend = GPU_BACKEND_REPLAY;
+	}
+	else {
+		fprintf(stderr, "Unknown GPU backend: %s (expected dcgm, nvml, synthetic or replay)\n", backend_str);
+		return -1;
+	}
+
+	*backend_options = (colon == NULL) ? NULL : colon + 1;
+	return 0;
+}
+
+static int open_backend(Gpu_Source * gpu_source, char * backend_options, int sample_freq_millis, int max_keep_samples){
+
+	switch (gpu_source -> backend){
+		case GPU_BACKEND_DCGM:
+#ifdef WITH_DCGM
+			return open_dcgm_source(gpu_source, backend_options, sample_freq_millis, max_keep_samples);
+#else
+			fprintf(stderr, "Monitor was built without DCGM (make WITH_DCGM=1)\n");
+			return -1;
+#endif
+		case GPU_BACKEND_NVML:
+#ifdef WITH_NVML
+			return open_nvml_source(gpu_source, backend_options);
+#else
+			fprintf(stderr, "Monitor was built without NVML (make WITH_NVML=1)\n");
+			return -1;
+#endif
+		case GPU_BACKEND_SYNTHETIC:
+			return open_synthetic_source(gpu_source, backend_options);
+		case GPU_BACKEND_REPLAY:
+			return open_replay_source(gpu_source, backend_options);
+	}
+	return -1;
+}
+
+Gpu_Source * open_gpu_source(Gpu_Backend backend, char * backend_options, int n_fields, unsigned short * field_ids, int sample_freq_millis, int max_keep_samples){
+
+	Gpu_Source * gpu_source = (Gpu_Source *) calloc(1, sizeof(Gpu_Source));
+	if (gpu_source == NULL){
+		fprintf(stderr, "Could not allocate memory for GPU source\n");
+		return NULL;
+	}
+
+	gpu_source -> backend = backend;
+	gpu_source -> n_fields = n_fields;
+	gpu_source -> field_ids = field_ids;
+	gpu_source -> field_types = (unsigned short *) calloc(n_fields, sizeof(unsigned short));
+	gpu_source -> field_lookup = init_field_lookup(field_ids, n_fields);
+	if ((gpu_source -> field_types == NULL) || (gpu_source -> field_lookup == NULL)){
+		fprintf(stderr, "Could not allocate memory for GPU source\n");
+		free(gpu_source -> field_types);
+		free(gpu_source -> field_lookup);
+		free(gpu_source);
+		return NULL;
+	}
+
+	if (open_backend(gpu_source, backend_options, sample_freq_millis, max_keep_samples) == -1){
+		close_gpu_source(gpu_source);
+		return NULL;
+	}
+
+	if (gpu_source -> n_devices <= 0){
+		fprintf(stderr, "No GPUs in System\n");
+		close_gpu_source(gpu_source);
+		return NULL;
+	}
+
+	return gpu_source;
+}
+
+void close_gpu_source(Gpu_Source * gpu_source){
+
+	switch (gpu_source -> backend){
+		case GPU_BACKEND_DCGM:
+#ifdef WITH_DCGM
+			close_dcgm_source(gpu_source);
+#endif
+			break;
+		case GPU_BACKEND_NVML:
+#ifdef WITH_NVML
+			close_nvml_source(gpu_source);
+#endif
+			break;
+		case GPU_BACKEND_SYNTHETIC:
+			close_synthetic_source(gpu_source);
+			break;
+		case GPU_BACKEND_REPLAY:
+			close_replay_source(gpu_source);
+			break;
+	}
+
+	free(gpu_source -> field_types);
+	free(gpu_source -> field_lookup);
+	free(gpu_source);
+}
+
+int collect_gpu_values(Gpu_Source * gpu_source, Samples_Buffer * samples_buffer){
+
+	switch (gpu_source -> backend){
+		case GPU_BACKEND_DCGM:
+#ifdef WITH_DCGM
+			return collect_dcgm_values(gpu_source, samples_buffer);
+#else
+			break;
+#endif
+		case GPU_BACKEND_NVML:
+#ifdef WITH_NVML
+			return collect_nvml_values(gpu_source, samples_buffer);
+#else
+			break;
+#endif
+		case GPU_BACKEND_SYNTHETIC:
+			return collect_synthetic_values(gpu_source, samples_buffer);
+		case GPU_BACKEND_REPLAY:
+			return collect_replay_values(gpu_source, samples_buffer);
+	}
+	return -1;
+}
@@ -0,0 +1,93 @@
+#ifndef GPU_SOURCE_H
+#define GPU_SOURCE_H
+
+// GPU METRICS SOURCE
+//
+// Everything the sampling loop needs from the GPUs goes through a Gpu_Source, so the monitor
+// can run on machines without GPUs (or without DCGM) and the sampler, buffers and storage can
+// be load-tested at any rate.
+//
+// Backends (-g, --gpu_backend=<name>[:<options>]):
+//	- dcgm[:batch_secs=<int>,watch_millis=<int>]: embedded DCGM host engine (build with WITH_DCGM=1,
+//	  the default), batch_secs lets DCGM sample on its own (every watch_millis) and drains its
+//	  cache that often (see gpu_dcgm.c)
+//	- nvml: NVML device queries, only the fields in gpu_nvml.c (build with WITH_NVML=1)
+//	- synthetic[:n_devices=<int>,pattern=<idle|steady|noisy>,seed=<int>]: generated values
+//	  for any field list, costs nothing per tick
+//	- replay:<file.mts>: GPU values of a columnar file from a previous run, looping at the end
+
+typedef enum gpu_backend {
+	GPU_BACKEND_DCGM,
+	GPU_BACKEND_NVML,
+	GPU_BACKEND_SYNTHETIC,
+	GPU_BACKEND_REPLAY
+} Gpu_Backend;
+
+#ifdef WITH_DCGM
+#define DEFAULT_GPU_BACKEND GPU_BACKEND_DCGM
+#else
+#define DEFAULT_GPU_BACKEND GPU_BACKEND_SYNTHETIC
+#endif
+
+typedef struct gpu_source {
+	Gpu_Backend backend;
+	int n_devices;
+	int n_fields;
+	// owned by the caller
+	unsigned short * field_ids;
+	// GPU_FT_* for every field, filled in by the backend
+	unsigned short * field_types;
+	// field id -> index into field_ids (see field_lookup.h), shared by every samples buffer
+	short * field_lookup;
+	// backend specific
+	void * state;
+} Gpu_Source;
+
+// Known fields (DCGM ids), used by the backends that can't ask DCGM for the type
+typedef struct gpu_field_info {
+	unsigned short field_id;
+	unsigned short field_type;
+	// largest value the synthetic backend generates
+	double max_value;
+} Gpu_Field_Info;
+
+
+// "dcgm[:options]", "nvml", "synthetic[:options]" or "replay:<file.mts>", options point into backend_str
+int parse_gpu_backend(char * backend_str, Gpu_Backend * backend, char ** backend_options);
+
+// starts collection of field_ids on every device the backend finds, NULL on failure
+//	- sample_freq_millis and max_keep_samples are the watch parameters for dcgm
+Gpu_Source * open_gpu_source(Gpu_Backend backend, char * backend_options, int n_fields, unsigned short * field_ids, int sample_freq_millis, int max_keep_samples);
+void close_gpu_source(Gpu_Source * gpu_source);
+
+// fills every (GPU, field) column at sample n_samples of samples_buffer, -1 on a fatal error
+int collect_gpu_values(Gpu_Source * gpu_source, Samples_Buffer * samples_buffer);
+
+// NULL if the field is not in the table
+Gpu_Field_Info * get_gpu_field_info(unsigned short field_id);
+
+// copy of the value for key in "key=value,key=value" options, NULL if missing
+char * get_gpu_backend_option(char * backend_options, char * key);
+
+
+/* BACKENDS (gpu_<backend>.c) */
+//	- open sets n_devices, field_types and state, returns -1 on failure
+//	- close has to handle a source that only partially opened
+
+int open_dcgm_source(Gpu_Source * gpu_source, char * backend_options, int sample_freq_millis, int max_keep_samples);
+int collect_dcgm_values(Gpu_Source * gpu_source, Samples_Buffer * samples_buffer);
+void close_dcgm_source(Gpu_Source * gpu_source);
+
+int open_nvml_source(Gpu_Source * gpu_source, char * backend_options);
+int collect_nvml_values(Gpu_Source * gpu_source, Samples_Buffer * samples_buffer);
+void close_nvml_source(Gpu_Source * gpu_source);
+
+int open_synthetic_source(Gpu_Source * gpu_source, char * backend_options);
+int collect_synthetic_values(Gpu_Source * gpu_source, Samples_Buffer * samples_buffer);
+void close_synthetic_source(Gpu_Source * gpu_source);
+
+int open_replay_source(Gpu_Source * gpu_source, char * backend_options);
+int collect_replay_values(Gpu_Source * gpu_source, Samples_Buffer * samples_buffer);
+void close_replay_source(Gpu_Source * gpu_source);
+
+#endif
@@ -0,0 +1,147 @@
+#define _GNU_SOURCE
+
+#include "job_stats.h"
+
+#include "monitoring.h"
+#include "gpu_source.h"
+
+
+// SYNTHETIC GPUS
+//	- any device count and field list, values follow a pattern scaled to each field's range
+//	  (see gpu_field_table in gpu_source.c)
+//	- idle: constant low levels (compresses best), steady: slow sine per column,
+//	  noisy: uniform random every sample
+//	- nothing blocks, so the sample rate is only limited by the rest of the loop
+
+#define SYNTHETIC_DEFAULT_DEVICES 8
+// samples per period of the steady pattern
+#define SYNTHETIC_STEADY_PERIOD 600
+
+typedef enum synthetic_pattern {
+	SYNTHETIC_IDLE,
+	SYNTHETIC_STEADY,
+	SYNTHETIC_NOISY
+} Synthetic_Pattern;
+
+typedef struct synthetic_state {
+	Synthetic_Pattern pattern;
+	unsigned int seed;
+	long n_generated;
+	// per field, the largest value generated
+	double * max_values;
+} Synthetic_State;
+
+
+int open_synthetic_source(Gpu_Source * gpu_source, char * backend_options){
+
+	Synthetic_State * synthetic_state = (Synthetic_State *) calloc(1, sizeof(Synthetic_State));
+	if (synthetic_state == NULL){
+		fprintf(stderr, "Could not allocate memory for synthetic GPU state\n");
+		return -1;
+	}
+	gpu_source -> state = synthetic_state;
+
+	synthetic_state -> max_values = (double *) malloc(gpu_source -> n_fields * sizeof(double));
+	if (synthetic_state -> max_values == NULL){
+		fprintf(stderr, "Could not allocate memory for synthetic GPU state\n");
+		return -1;
+	}
+
+	// OPTIONS
+	char * option;
+
+	gpu_source -> n_devices = SYNTHETIC_DEFAULT_DEVICES;
+	option = get_gpu_backend_option(backend_options, "n_devices");
+	if (option != NULL){
+		gpu_source -> n_devices = atoi(option);
+		free(option);
+	}
+
+	synthetic_state -> pattern = SYNTHETIC_STEADY;
+	option = get_gpu_backend_option(backend_options, "pattern");
+	if (option != NULL){
+		if (strcmp(option, "idle") == 0){
+			synthetic_state -> pattern = SYNTHETIC_IDLE;
+		}
+		else if (strcmp(option, "noisy") == 0){
+			synthetic_state -> pattern = SYNTHETIC_NOISY;
+		}
+		else if (strcmp(option, "steady") != 0){
+			fprintf(stderr, "Unknown synthetic pattern: %s (expected idle, steady or noisy)\n", option);
+			free(option);
+			return -1;
+		}
+		free(option);
+	}
+
+	synthetic_state -> seed = 1;
+	option = get_gpu_backend_option(backend_options, "seed");
+	if (option != NULL){
+		synthetic_state -> seed = atoi(option);
+		free(option);
+	}
+
+	// FIELDS
+	Gpu_Field_Info * field_info;
+	for (int i = 0; i < gpu_source -> n_fields; i++){
+		field_info = get_gpu_field_info(gpu_source -> field_ids[i]);
+		if (field_info == NULL){
+			gpu_source -> field_types[i] = GPU_FT_DOUBLE;
+			synthetic_state -> max_values[i] = 1;
+		}
+		else {
+			gpu_source -> field_types[i] = field_info -> field_type;
+			synthetic_state -> max_values[i] = field_info -> max_value;
+		}
+	}
+
+	return 0;
+}
+
+int collect_synthetic_values(Gpu_Source * gpu_source, Samples_Buffer * samples_buffer){
+
+	Synthetic_State * synthetic_state = (Synthetic_State *) gpu_source -> state;
+	int n_samples = samples_buffer -> n_samples;
+	int n_fields = gpu_source -> n_fields;
+	int n_columns = gpu_source -> n_devices * n_fields;
+	long t = synthetic_state -> n_generated;
+	void * field_column;
+	double level;
+	int fieldNum;
+
+	for (int c = 0; c < n_columns; c++){
+		switch (synthetic_state -> pattern){
+			case SYNTHETIC_IDLE:
+				level = 0.01 * (1 + c % 5);
+				break;
+			case SYNTHETIC_STEADY:
+				level = 0.5 + 0.4 * sin(2 * M_PI * (t + 37 * c) / SYNTHETIC_STEADY_PERIOD);
+				break;
+			default:
+				level = (double) rand_r(&(synthetic_state -> seed)) / RAND_MAX;
+				break;
+		}
+
+		fieldNum = c % n_fields;
+		field_column = FIELD_COLUMN(samples_buffer, c);
+		if (gpu_source -> field_types[fieldNum] == GPU_FT_DOUBLE){
+			((double *) field_column)[n_samples] = level * synthetic_state -> max_values[fieldNum];
+		}
+		else {
+			((long *) field_column)[n_samples] = (long) round(level * synthetic_state -> max_values[fieldNum]);
+		}
+	}
+
+	synthetic_state -> n_generated++;
+	return 0;
+}
+
+void close_synthetic_source(Gpu_Source * gpu_source){
+
+	Synthetic_State * synthetic_state = (Synthetic_State *) gpu_source -> state;
+	if (synthetic_state == NULL){
+		return;
+	}
+	free(synthetic_state -> max_values);
+	free(synthetic_state);
+}
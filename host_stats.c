@@ -0,0 +1,741 @@
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+
+#include "job_stats.h"
+
+#include "monitoring.h"
+#include "host_stats.h"
+#include "net_link.h"
+#include "port_counters.h"
+#include "file_trace.h"
+
+
+/* READERS */
+
+int open_counter_file(char * path){
+
+	int fd = open_trace_file(path);
+	if (fd == -1){
+		fprintf(stderr, "Error: couldn't open counter file: %s\n", path);
+	}
+	return fd;
+}
+
+int read_counter_file(int fd, char * buf, int buf_size){
+
+	ssize_t n_read = read_trace_file(fd, buf, buf_size - 1);
+	if (n_read < 0){
+		return -1;
+	}
+	buf[n_read] = '\0';
+	return n_read;
+}
+
+int scan_next_ulong(char ** pos, char * end, unsigned long * value){
+
+	char * p = *pos;
+	while ((p < end) && ((*p < '0') || (*p > '9'))){
+		p++;
+	}
+	if (p == end){
+		*pos = p;
+		return -1;
+	}
+
+	unsigned long val = 0;
+	while ((p < end) && (*p >= '0') && (*p <= '9')){
+		val = val * 10 + (*p - '0');
+		p++;
+	}
+
+	*value = val;
+	*pos = p;
+	return 0;
+}
+
+int read_counter_value(int fd, long * value){
+
+	// sysfs counters are at most 20 digits + newline
+	char buf[32];
+	int n_read = read_counter_file(fd, buf, sizeof(buf));
+	if (n_read <= 0){
+		return -1;
+	}
+
+	char * pos = buf;
+	unsigned long val;
+	if (scan_next_ulong(&pos, buf + n_read, &val) == -1){
+		return -1;
+	}
+	*value = (long) val;
+	return 0;
+}
+
+
+// CPU MONITORING
+
+Proc_Stat_Reader * init_proc_stat_reader(char * root_dir, int n_cpu){
+
+	Proc_Stat_Reader * proc_stat_reader = (Proc_Stat_Reader *) calloc(1, sizeof(Proc_Stat_Reader));
+	if (proc_stat_reader == NULL){
+		fprintf(stderr, "Could not allocate memory for /proc/stat reader\n");
+		return NULL;
+	}
+
+	// the cpuN lines come right after the aggregate line, so per-core reads only need room for them
+	proc_stat_reader -> n_cpu = n_cpu;
+	proc_stat_reader -> buf_size = PROC_STAT_READ_BYTES + n_cpu * PROC_STAT_CPU_LINE_BYTES;
+	proc_stat_reader -> buf = (char *) malloc(proc_stat_reader -> buf_size);
+	if (n_cpu > 0){
+		proc_stat_reader -> counters = (unsigned long *) calloc((size_t) N_CPU_COUNTERS * n_cpu, sizeof(unsigned long));
+		proc_stat_reader -> prev_counters = (unsigned long *) calloc((size_t) N_CPU_COUNTERS * n_cpu, sizeof(unsigned long));
+		proc_stat_reader -> deltas = (float *) malloc((size_t) N_CPU_COUNTERS * n_cpu * sizeof(float));
+		proc_stat_reader -> scales = (float *) malloc(n_cpu * sizeof(float));
+	}
+	if ((proc_stat_reader -> buf == NULL) || ((n_cpu > 0) && ((proc_stat_reader -> counters == NULL) || (proc_stat_reader -> prev_counters == NULL)
+			|| (proc_stat_reader -> deltas == NULL) || (proc_stat_reader -> scales == NULL)))){
+		fprintf(stderr, "Could not allocate memory for /proc/stat reader\n");
+		proc_stat_reader -> fd = -1;
+		destroy_proc_stat_reader(proc_stat_reader);
+		return NULL;
+	}
+
+	char * path;
+	asprintf(&path, "%s/proc/stat", root_dir);
+	proc_stat_reader -> fd = open_counter_file(path);
+	free(path);
+	if (proc_stat_reader -> fd == -1){
+		destroy_proc_stat_reader(proc_stat_reader);
+		return NULL;
+	}
+
+	return proc_stat_reader;
+}
+
+void destroy_proc_stat_reader(Proc_Stat_Reader * proc_stat_reader){
+	if (proc_stat_reader -> fd != -1){
+		close_trace_file(proc_stat_reader -> fd);
+	}
+	free(proc_stat_reader -> buf);
+	free(proc_stat_reader -> counters);
+	free(proc_stat_reader -> prev_counters);
+	free(proc_stat_reader -> deltas);
+	free(proc_stat_reader -> scales);
+	free(proc_stat_reader);
+}
+
+Proc_Data * process_proc_stat(Proc_Stat_Reader * proc_stat_reader, Proc_Data * proc_data, Proc_Data * prev_data){
+
+	int n_read = read_counter_file(proc_stat_reader -> fd, proc_stat_reader -> buf, proc_stat_reader -> buf_size);
+	proc_stat_reader -> n_read = n_read;
+	if (n_read <= 0){
+		fprintf(stderr, "Error Reading /proc/stat\n");
+		return NULL;
+	}
+
+	// only collecting aggregate
+	Cpu_stat cpu_stats;
+
+	// only look the top line which aggregates all CPUS ("cpu  user nice system idle iowait irq softirq ...")
+	char * pos = proc_stat_reader -> buf;
+	char * end = proc_stat_reader -> buf + n_read;
+	if ((scan_next_ulong(&pos, end, &(cpu_stats.t_user)) == -1) || (scan_next_ulong(&pos, end, &(cpu_stats.t_nice)) == -1)
+			|| (scan_next_ulong(&pos, end, &(cpu_stats.t_system)) == -1) || (scan_next_ulong(&pos, end, &(cpu_stats.t_idle)) == -1)
+			|| (scan_next_ulong(&pos, end, &(cpu_stats.t_iowait)) == -1) || (scan_next_ulong(&pos, end, &(cpu_stats.t_irq)) == -1)
+			|| (scan_next_ulong(&pos, end, &(cpu_stats.t_softirq)) == -1)){
+		fprintf(stderr, "Error Parsing /proc/stat\n");
+		return NULL;
+	}
+
+	long total_time = cpu_stats.t_user + cpu_stats.t_nice + cpu_stats.t_system + cpu_stats.t_idle + cpu_stats.t_iowait + cpu_stats.t_irq + cpu_stats.t_softirq;
+	long idle_time = cpu_stats.t_idle;
+
+	// if there wasn't a previous sample can't compute util %
+	if (prev_data == NULL){
+		proc_data -> util_pct = 0;
+		proc_data -> total_time = total_time;
+		proc_data -> idle_time = idle_time;
+		return proc_data;
+	}
+
+	long prev_total_time = prev_data -> total_time;
+	long prev_idle_time = prev_data -> idle_time;
+
+
+	long total_delta = total_time - prev_total_time;
+	long idle_delta = idle_time - prev_idle_time;
+
+	long cpu_used = total_delta - idle_delta;
+
+	double util_pct = (100 * (double) cpu_used) / ((double) total_delta);
+
+	proc_data -> util_pct = util_pct;
+	proc_data -> total_time = total_time;
+	proc_data -> idle_time = idle_time;
+
+	return proc_data;
+}
+
+Mem_Info_Reader * init_mem_info_reader(char * root_dir){
+
+	Mem_Info_Reader * mem_info_reader = (Mem_Info_Reader *) malloc(sizeof(Mem_Info_Reader));
+	if (mem_info_reader == NULL){
+		fprintf(stderr, "Could not allocate memory for /proc/meminfo reader\n");
+		return NULL;
+	}
+
+	char * path;
+	asprintf(&path, "%s/proc/meminfo", root_dir);
+	mem_info_reader -> fd = open_counter_file(path);
+	free(path);
+	if (mem_info_reader -> fd == -1){
+		free(mem_info_reader);
+		return NULL;
+	}
+
+	return mem_info_reader;
+}
+
+void destroy_mem_info_reader(Mem_Info_Reader * mem_info_reader){
+	close_trace_file(mem_info_reader -> fd);
+	free(mem_info_reader);
+}
+
+Proc_Data * process_mem_info(Mem_Info_Reader * mem_info_reader, Proc_Data * proc_data){
+
+	// MemFree is what sysinfo() reports as free (the old _SC_AVPHYS_PAGES)
+	int n_read = read_counter_file(mem_info_reader -> fd, mem_info_reader -> buf, MEM_INFO_READ_BYTES);
+	if (n_read <= 0){
+		return NULL;
+	}
+	char * pos = mem_info_reader -> buf;
+	char * end = pos + n_read;
+	unsigned long total_kb, free_kb;
+	if ((scan_next_ulong(&pos, end, &total_kb) == -1) || (scan_next_ulong(&pos, end, &free_kb) == -1) || (total_kb == 0)){
+		return NULL;
+	}
+
+	proc_data -> mem_used_pct = 100 * ((double) (total_kb - free_kb) / (double) total_kb);
+	proc_data -> free_mem = free_kb / 1024;
+
+	return proc_data;
+}
+
+// cpuN lines into the counter block, one column per core (cores that are offline or >= n_cpu keep their old values)
+static int parse_per_cpu_lines(Proc_Stat_Reader * proc_stat_reader){
+
+	int n_cpu = proc_stat_reader -> n_cpu;
+	unsigned long * counters = proc_stat_reader -> counters;
+	char * buf_end = proc_stat_reader -> buf + proc_stat_reader -> n_read;
+
+	// skip the aggregate line
+	char * line = memchr(proc_stat_reader -> buf, '\n', proc_stat_reader -> n_read);
+	char * line_end;
+	unsigned long cpu_id;
+	int n_parsed = 0;
+	while ((line != NULL) && (++line < buf_end)){
+		// the cpuN lines are contiguous, stop at the first other line (intr, ctxt, ...)
+		if ((buf_end - line < 4) || (strncmp(line, "cpu", 3) != 0)){
+			break;
+		}
+		line_end = memchr(line, '\n', buf_end - line);
+		if (line_end == NULL){
+			line_end = buf_end;
+		}
+		line += 3;
+		if ((scan_next_ulong(&line, line_end, &cpu_id) == -1) || (cpu_id >= (unsigned long) n_cpu)){
+			line = line_end;
+			continue;
+		}
+		for (int c = 0; c < N_CPU_COUNTERS; c++){
+			// older kernels don't have steal, it stays 0
+			if (scan_next_ulong(&line, line_end, &(counters[c * n_cpu + cpu_id])) == -1){
+				break;
+			}
+		}
+		n_parsed++;
+		line = line_end;
+	}
+
+	return (n_parsed > 0) ? 0 : -1;
+}
+
+// one byte per core: (a [+ b]) * scale rounded, at most 200
+static void fill_core_column(unsigned char * out, float * a, float * b, float * scales, int n_cpu){
+
+	float val;
+	for (int i = 0; i < n_cpu; i++){
+		val = ((b == NULL) ? a[i] : a[i] + b[i]) * scales[i] + 0.5f;
+		out[i] = (unsigned char) ((val < 200.0f) ? val : 200.0f);
+	}
+}
+
+int process_per_cpu_stat(Proc_Stat_Reader * proc_stat_reader, unsigned char * core_util){
+
+	int n_cpu = proc_stat_reader -> n_cpu;
+	if (parse_per_cpu_lines(proc_stat_reader) == -1){
+		fprintf(stderr, "Error Parsing per-cpu lines of /proc/stat\n");
+		return -1;
+	}
+
+	if (!proc_stat_reader -> has_prev){
+		memset(core_util, 0, (size_t) N_CORE_UTIL_COLUMNS * n_cpu);
+		memcpy(proc_stat_reader -> prev_counters, proc_stat_reader -> counters, (size_t) N_CPU_COUNTERS * n_cpu * sizeof(unsigned long));
+		proc_stat_reader -> has_prev = true;
+		return 0;
+	}
+
+	// DELTAS (row at a time over every core, no per-core branches so the loops vectorize)
+	unsigned long * cur = proc_stat_reader -> counters;
+	unsigned long * prev = proc_stat_reader -> prev_counters;
+	float * deltas = proc_stat_reader -> deltas;
+	float * scales = proc_stat_reader -> scales;
+	for (int i = 0; i < n_cpu; i++){
+		scales[i] = 0;
+	}
+	for (int c = 0; c < N_CPU_COUNTERS; c++){
+		for (int i = 0; i < n_cpu; i++){
+			deltas[c * n_cpu + i] = (float) (cur[c * n_cpu + i] - prev[c * n_cpu + i]);
+			scales[i] += deltas[c * n_cpu + i];
+		}
+	}
+	// half percent of each core's elapsed ticks (idle cores with no ticks stay at 0)
+	for (int i = 0; i < n_cpu; i++){
+		scales[i] = 200.0f / ((scales[i] > 1.0f) ? scales[i] : 1.0f);
+	}
+
+	fill_core_column(core_util, &deltas[CPU_USER * n_cpu], &deltas[CPU_NICE * n_cpu], scales, n_cpu);
+	fill_core_column(core_util + n_cpu, &deltas[CPU_SYSTEM * n_cpu], NULL, scales, n_cpu);
+	fill_core_column(core_util + 2 * n_cpu, &deltas[CPU_IOWAIT * n_cpu], NULL, scales, n_cpu);
+	fill_core_column(core_util + 3 * n_cpu, &deltas[CPU_IRQ * n_cpu], &deltas[CPU_SOFTIRQ * n_cpu], scales, n_cpu);
+	fill_core_column(core_util + 4 * n_cpu, &deltas[CPU_STEAL * n_cpu], NULL, scales, n_cpu);
+
+	memcpy(prev, cur, (size_t) N_CPU_COUNTERS * n_cpu * sizeof(unsigned long));
+	return 0;
+}
+
+
+// NANOSECOND CPU TIME
+
+int parse_cpu_time_source(char * str, Cpu_Time_Source * source){
+
+	if (strcmp(str, "ticks") == 0){
+		*source = CPU_TIME_TICKS;
+		return 0;
+	}
+	if (strcmp(str, "schedstat") == 0){
+		*source = CPU_TIME_SCHEDSTAT;
+		return 0;
+	}
+	if (strcmp(str, "cgroup") == 0){
+		*source = CPU_TIME_CGROUP;
+		return 0;
+	}
+	fprintf(stderr, "Unknown cpu time source: %s (expected ticks, schedstat or cgroup)\n", str);
+	return -1;
+}
+
+Cpu_Time_Reader * init_cpu_time_reader(char * root_dir, Cpu_Time_Source source, int n_cpu){
+
+	if (source == CPU_TIME_TICKS){
+		return NULL;
+	}
+
+	Cpu_Time_Reader * cpu_time_reader = (Cpu_Time_Reader *) calloc(1, sizeof(Cpu_Time_Reader));
+	if (cpu_time_reader == NULL){
+		fprintf(stderr, "Could not allocate memory for cpu time reader\n");
+		return NULL;
+	}
+	cpu_time_reader -> source = source;
+	cpu_time_reader -> n_cpu = n_cpu;
+	cpu_time_reader -> fd = -1;
+
+	char * path;
+	if (source == CPU_TIME_SCHEDSTAT){
+		cpu_time_reader -> buf_size = PROC_STAT_READ_BYTES + n_cpu * SCHEDSTAT_CPU_BYTES;
+		asprintf(&path, "%s/proc/schedstat", root_dir);
+	}
+	else {
+		// root cgroup v2 (unified), otherwise the v1 cpuacct hierarchy
+		cpu_time_reader -> buf_size = PROC_STAT_READ_BYTES;
+		asprintf(&path, "%s/sys/fs/cgroup/cpu.stat", root_dir);
+		if (access(path, R_OK) != 0){
+			free(path);
+			asprintf(&path, "%s/sys/fs/cgroup/cpuacct/cpuacct.usage", root_dir);
+			cpu_time_reader -> cgroup_v1 = true;
+		}
+	}
+	cpu_time_reader -> fd = open_counter_file(path);
+	free(path);
+
+	cpu_time_reader -> buf = (char *) malloc(cpu_time_reader -> buf_size);
+	if ((cpu_time_reader -> fd == -1) || (cpu_time_reader -> buf == NULL)){
+		destroy_cpu_time_reader(cpu_time_reader);
+		return NULL;
+	}
+
+	return cpu_time_reader;
+}
+
+void destroy_cpu_time_reader(Cpu_Time_Reader * cpu_time_reader){
+	if (cpu_time_reader -> fd != -1){
+		close_trace_file(cpu_time_reader -> fd);
+	}
+	free(cpu_time_reader -> buf);
+	free(cpu_time_reader);
+}
+
+// sum of the run time (7th value after the cpu id, rq_cpu_time) of every cpuN line
+static int parse_schedstat_busy_ns(char * buf, int n_read, long * busy_ns){
+
+	char * end = buf + n_read;
+	char * line = buf;
+	char * line_end;
+	unsigned long val;
+	long total = 0;
+	int n_cpu_lines = 0;
+	while (line < end){
+		line_end = memchr(line, '\n', end - line);
+		if (line_end == NULL){
+			line_end = end;
+		}
+		if ((line_end - line > 3) && (strncmp(line, "cpu", 3) == 0)){
+			// cpu id, 6 counters, then the run time
+			for (int i = 0; i < 8; i++){
+				if (scan_next_ulong(&line, line_end, &val) == -1){
+					return -1;
+				}
+			}
+			total += (long) val;
+			n_cpu_lines++;
+		}
+		line = line_end + 1;
+	}
+
+	if (n_cpu_lines == 0){
+		return -1;
+	}
+	*busy_ns = total;
+	return 0;
+}
+
+int read_cpu_busy_ns(Cpu_Time_Reader * cpu_time_reader, long * busy_ns){
+
+	int n_read = read_counter_file(cpu_time_reader -> fd, cpu_time_reader -> buf, cpu_time_reader -> buf_size);
+	if (n_read <= 0){
+		return -1;
+	}
+
+	char * pos = cpu_time_reader -> buf;
+	char * end = cpu_time_reader -> buf + n_read;
+	unsigned long val;
+	switch (cpu_time_reader -> source){
+		case CPU_TIME_SCHEDSTAT:
+			return parse_schedstat_busy_ns(cpu_time_reader -> buf, n_read, busy_ns);
+		case CPU_TIME_CGROUP:
+			if (!cpu_time_reader -> cgroup_v1){
+				pos = strstr(pos, "usage_usec");
+				if (pos == NULL){
+					return -1;
+				}
+			}
+			if (scan_next_ulong(&pos, end, &val) == -1){
+				return -1;
+			}
+			*busy_ns = cpu_time_reader -> cgroup_v1 ? (long) val : (long) val * 1000;
+			return 0;
+		default:
+			return -1;
+	}
+}
+
+int process_cpu_time(Cpu_Time_Reader * cpu_time_reader, Proc_Data * proc_data){
+
+	long busy_ns;
+	struct timespec now;
+	if (read_cpu_busy_ns(cpu_time_reader, &busy_ns) == -1){
+		fprintf(stderr, "Error Reading cpu time\n");
+		return -1;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	long wall_ns = now.tv_sec * 1000000000L + now.tv_nsec;
+
+	// if there wasn't a previous read can't compute util %
+	if (!cpu_time_reader -> has_prev){
+		proc_data -> util_pct = 0;
+	}
+	else if (wall_ns > cpu_time_reader -> prev_wall_ns){
+		proc_data -> util_pct = (100 * (double) (busy_ns - cpu_time_reader -> prev_busy_ns)) / ((double) (wall_ns - cpu_time_reader -> prev_wall_ns) * cpu_time_reader -> n_cpu);
+	}
+
+	cpu_time_reader -> prev_busy_ns = busy_ns;
+	cpu_time_reader -> prev_wall_ns = wall_ns;
+	cpu_time_reader -> has_prev = true;
+	return 0;
+}
+
+
+// NETWORK MONITORING
+
+// opens <root_dir>/sys/class/net/<if_name>/<path>
+static int open_interface_counter(char * root_dir, char * if_name, const char * path){
+
+	char * full_path;
+	asprintf(&full_path, "%s/sys/class/net/%s/%s", root_dir, if_name, path);
+	int fd = open_counter_file(full_path);
+	free(full_path);
+	return fd;
+}
+
+int parse_net_stats_source(char * str, Net_Stats_Source * source){
+
+	if (strcmp(str, "netlink") == 0){
+		*source = NET_STATS_NETLINK;
+		return 0;
+	}
+	if (strcmp(str, "sysfs") == 0){
+		*source = NET_STATS_SYSFS;
+		return 0;
+	}
+	fprintf(stderr, "Unknown net stats source: %s (expected netlink or sysfs)\n", str);
+	return -1;
+}
+
+Interface_Totals * init_interface_totals(char * root_dir, Net_Stats_Source source){
+	Interface_Totals * interface_totals = (Interface_Totals *) malloc(sizeof(Interface_Totals));
+	if (interface_totals == NULL){
+		fprintf(stderr, "Could not allocate memory for interface names\n");
+		return NULL;
+	}
+
+	char * interface_parent_dir;
+	asprintf(&interface_parent_dir, "%s/sys/class/net", root_dir);
+	DIR *dr = open_trace_dir(interface_parent_dir);
+	free(interface_parent_dir);
+	if (dr == NULL) {
+        fprintf(stderr, "Could not open interface directory\n");
+        free(interface_totals);
+        return NULL;
+    }
+
+    struct dirent * interface_dirs;
+    int max_ifs = 16;
+    char ** ib_ifs = (char **) malloc(max_ifs * sizeof(char *));
+    int n_ib_ifs = 0;
+    char ** eth_ifs = (char **) malloc(max_ifs * sizeof(char *));
+    int n_eth_ifs = 0;
+
+    char * dir_name;
+    while ((interface_dirs = readdir(dr)) != NULL) {
+    	dir_name = interface_dirs -> d_name;
+	if (!strcmp (dir_name, "."))
+            continue;
+        if (!strcmp (dir_name, ".."))
+            continue;
+
+        if ((strncmp("ib", dir_name, 2) == 0) && (n_ib_ifs < max_ifs)) {
+        	ib_ifs[n_ib_ifs] = strdup(dir_name);
+        	n_ib_ifs++;
+
+        }
+
+        if ((strncmp("eno", dir_name, 3) == 0) && (n_eth_ifs < max_ifs)){
+        	eth_ifs[n_eth_ifs] = strdup(dir_name);
+        	n_eth_ifs++;
+        }
+    }
+
+    closedir(dr);
+
+    interface_totals -> n_ib_ifs = n_ib_ifs;
+    interface_totals -> ib_ifs = ib_ifs;
+    interface_totals -> n_eth_ifs = n_eth_ifs;
+    interface_totals -> eth_ifs = eth_ifs;
+
+    interface_totals -> total_ib_rx_bytes = 0;
+    interface_totals -> total_ib_tx_bytes = 0;
+    interface_totals -> total_ib_sys_rx_bytes = 0;
+	interface_totals -> total_ib_sys_tx_bytes = 0;
+    interface_totals -> total_eth_rx_bytes = 0;
+    interface_totals -> total_eth_tx_bytes = 0;
+
+	interface_totals -> net_link_reader = NULL;
+	if (source == NET_STATS_NETLINK){
+		interface_totals -> net_link_reader = init_net_link_reader();
+		if (interface_totals -> net_link_reader == NULL){
+			fprintf(stderr, "Falling back to sysfs interface counters\n");
+		}
+	}
+	bool open_statistics = (interface_totals -> net_link_reader == NULL);
+
+	// OPEN EVERY COUNTER ONCE (-1 if missing, that counter is skipped every tick)
+	interface_totals -> ib_fds = (int *) malloc((n_ib_ifs * N_IB_COUNTER_FILES + 1) * sizeof(int));
+	interface_totals -> eth_fds = (int *) malloc((n_eth_ifs * N_ETH_COUNTER_FILES + 1) * sizeof(int));
+	if ((interface_totals -> ib_fds == NULL) || (interface_totals -> eth_fds == NULL)){
+		fprintf(stderr, "Could not allocate memory for interface counters\n");
+		return NULL;
+	}
+
+	int * fds;
+	for (int i = 0; i < n_ib_ifs; i++){
+		fds = &(interface_totals -> ib_fds[i * N_IB_COUNTER_FILES]);
+		fds[IB_SYS_RX_BYTES] = open_statistics ? open_interface_counter(root_dir, ib_ifs[i], "statistics/rx_bytes") : -1;
+		fds[IB_SYS_TX_BYTES] = open_statistics ? open_interface_counter(root_dir, ib_ifs[i], "statistics/tx_bytes") : -1;
+	}
+	for (int i = 0; i < n_eth_ifs; i++){
+		fds = &(interface_totals -> eth_fds[i * N_ETH_COUNTER_FILES]);
+		fds[ETH_RX_BYTES] = open_statistics ? open_interface_counter(root_dir, eth_ifs[i], "statistics/rx_bytes") : -1;
+		fds[ETH_TX_BYTES] = open_statistics ? open_interface_counter(root_dir, eth_ifs[i], "statistics/tx_bytes") : -1;
+	}
+
+	// IB PORT COUNTERS (every port of every HCA, not just the one behind an ib* interface)
+	char * sysfs_root;
+	char ** port_dirs;
+	char ** port_names;
+	char * path;
+	asprintf(&sysfs_root, "%s/sys", root_dir);
+	int n_ib_ports = find_ib_ports(sysfs_root, &port_dirs, &port_names);
+	free(sysfs_root);
+	if (n_ib_ports == -1){
+		return NULL;
+	}
+	interface_totals -> n_ib_ports = n_ib_ports;
+	interface_totals -> ib_port_fds = (int *) malloc((n_ib_ports * N_IB_PORT_COUNTER_FILES + 1) * sizeof(int));
+	if (interface_totals -> ib_port_fds == NULL){
+		fprintf(stderr, "Could not allocate memory for interface counters\n");
+		return NULL;
+	}
+	for (int p = 0; p < n_ib_ports; p++){
+		fds = &(interface_totals -> ib_port_fds[p * N_IB_PORT_COUNTER_FILES]);
+		asprintf(&path, "%s/counters/port_rcv_data", port_dirs[p]);
+		fds[IB_PORT_RCV_DATA] = open_counter_file(path);
+		free(path);
+		asprintf(&path, "%s/counters/port_xmit_data", port_dirs[p]);
+		fds[IB_PORT_XMIT_DATA] = open_counter_file(path);
+		free(path);
+		free(port_dirs[p]);
+		free(port_names[p]);
+	}
+	free(port_dirs);
+	free(port_names);
+
+    return interface_totals;
+}
+
+void destroy_interface_totals(Interface_Totals * interface_totals){
+
+	for (int i = 0; i < interface_totals -> n_ib_ports * N_IB_PORT_COUNTER_FILES; i++){
+		if (interface_totals -> ib_port_fds[i] != -1){
+			close_trace_file(interface_totals -> ib_port_fds[i]);
+		}
+	}
+	for (int i = 0; i < interface_totals -> n_ib_ifs * N_IB_COUNTER_FILES; i++){
+		if (interface_totals -> ib_fds[i] != -1){
+			close_trace_file(interface_totals -> ib_fds[i]);
+		}
+	}
+	for (int i = 0; i < interface_totals -> n_eth_ifs * N_ETH_COUNTER_FILES; i++){
+		if (interface_totals -> eth_fds[i] != -1){
+			close_trace_file(interface_totals -> eth_fds[i]);
+		}
+	}
+	for (int i = 0; i < interface_totals -> n_ib_ifs; i++){
+		free(interface_totals -> ib_ifs[i]);
+	}
+	for (int i = 0; i < interface_totals -> n_eth_ifs; i++){
+		free(interface_totals -> eth_ifs[i]);
+	}
+	if (interface_totals -> net_link_reader != NULL){
+		destroy_net_link_reader(interface_totals -> net_link_reader);
+	}
+	free(interface_totals -> ib_port_fds);
+	free(interface_totals -> ib_fds);
+	free(interface_totals -> eth_fds);
+	free(interface_totals -> ib_ifs);
+	free(interface_totals -> eth_ifs);
+	free(interface_totals);
+}
+
+// adds the counter in fd to total (if it could be opened and read)
+static void add_counter(int fd, long multiplier, long * total){
+
+	long val;
+	if ((fd == -1) || (read_counter_value(fd, &val) == -1)){
+		return;
+	}
+	*total += multiplier * val;
+}
+
+Net_Data * process_net_stat(Net_Data * net_data, Interface_Totals * interface_totals){
+
+	long total_ib_rx_bytes = 0;
+	long total_ib_tx_bytes = 0;
+	long total_ib_sys_rx_bytes = 0;
+	long total_ib_sys_tx_bytes = 0;
+	long total_eth_rx_bytes = 0;
+	long total_eth_tx_bytes = 0;
+
+	int n_ib_ports = interface_totals -> n_ib_ports;
+	int n_ib_ifs = interface_totals -> n_ib_ifs;
+	int n_eth_ifs = interface_totals -> n_eth_ifs;
+	int * fds;
+
+	// ACCUMULATING TOTALS FOR IB PORTS
+	//	- ALL PHYS TRAFFIC (including RDMA)
+	for (int p = 0; p < n_ib_ports; p++){
+		fds = &(interface_totals -> ib_port_fds[p * N_IB_PORT_COUNTER_FILES]);
+		// need to multiply by 4 because port_rcv_data / port_xmit_data are divided by 4
+		add_counter(fds[IB_PORT_RCV_DATA], 4, &total_ib_rx_bytes);
+		add_counter(fds[IB_PORT_XMIT_DATA], 4, &total_ib_tx_bytes);
+	}
+
+	// ACCUMULATING TOTALS FOR IB IFs
+	for (int i = 0; i < n_ib_ifs; i++){
+		fds = &(interface_totals -> ib_fds[i * N_IB_COUNTER_FILES]);
+		// IB Traffic passing through system memory
+		add_counter(fds[IB_SYS_RX_BYTES], 1, &total_ib_sys_rx_bytes);
+		add_counter(fds[IB_SYS_TX_BYTES], 1, &total_ib_sys_tx_bytes);
+	}
+
+	// ACCUMULATING TOTALS FOR ETH IFs
+	for (int i = 0; i < n_eth_ifs; i++){
+		fds = &(interface_totals -> eth_fds[i * N_ETH_COUNTER_FILES]);
+		add_counter(fds[ETH_RX_BYTES], 1, &total_eth_rx_bytes);
+		add_counter(fds[ETH_TX_BYTES], 1, &total_eth_tx_bytes);
+	}
+
+
+	// Taking these totals minus prev recorded totals
+	net_data -> ib_rx_bytes = total_ib_rx_bytes - interface_totals -> total_ib_rx_bytes;
+	net_data -> ib_tx_bytes = total_ib_tx_bytes - interface_totals -> total_ib_tx_bytes;
+	net_data -> ib_sys_rx_bytes = total_ib_sys_rx_bytes - interface_totals -> total_ib_sys_rx_bytes;
+	net_data -> ib_sys_tx_bytes = total_ib_sys_tx_bytes - interface_totals -> total_ib_sys_tx_bytes;
+	net_data -> eth_rx_bytes = total_eth_rx_bytes - interface_totals -> total_eth_rx_bytes;
+	net_data -> eth_tx_bytes = total_eth_tx_bytes - interface_totals -> total_eth_tx_bytes;
+
+	// Special case for the first time we don't want to have outlier results
+	if (interface_totals -> total_ib_rx_bytes == 0){
+		net_data -> ib_rx_bytes = 0;
+		net_data -> ib_tx_bytes = 0;
+		net_data -> ib_sys_rx_bytes = 0;
+		net_data -> ib_sys_tx_bytes = 0;
+		net_data -> eth_rx_bytes = 0;
+		net_data -> eth_tx_bytes = 0;
+	}
+
+	// Update new totals
+	interface_totals -> total_ib_rx_bytes = total_ib_rx_bytes;
+	interface_totals -> total_ib_tx_bytes = total_ib_tx_bytes;
+	interface_totals -> total_ib_sys_rx_bytes = total_ib_sys_rx_bytes;
+	interface_totals -> total_ib_sys_tx_bytes = total_ib_sys_tx_bytes;
+	interface_totals -> total_eth_rx_bytes = total_eth_rx_bytes;
+	interface_totals -> total_eth_tx_bytes = total_eth_tx_bytes;
+
+	// IPoIB and Ethernet byte counters per link (their totals above stay 0)
+	if (interface_totals -> net_link_reader != NULL){
+		process_net_link(interface_totals -> net_link_reader, net_data);
+	}
+
+	return net_data;
+}
@@ -0,0 +1,163 @@
+#ifndef HOST_STATS_H
+#define HOST_STATS_H
+
+// HOST COUNTERS (/proc/stat, /proc/meminfo and the /sys/class/net counters)
+//	- every file is opened once at init, each tick re-reads it with pread at offset 0 (procfs
+//	  and sysfs regenerate the contents) into a fixed buffer, no paths, stdio or heap per tick
+//	- root_dir is prepended to every path ("" on a real node, a fake tree for benchmarks)
+
+// enough for the aggregate cpu line at the top of /proc/stat
+#define PROC_STAT_READ_BYTES 4096
+// extra bytes per cpuN line when reading per-core counters (a line is ~100 bytes)
+#define PROC_STAT_CPU_LINE_BYTES 256
+
+// per-core counters kept for every cpuN line (order of the /proc/stat columns), row c of the
+// counter block is counter c for every core
+#define N_CPU_COUNTERS 8
+#define CPU_USER 0
+#define CPU_NICE 1
+#define CPU_SYSTEM 2
+#define CPU_IDLE 3
+#define CPU_IOWAIT 4
+#define CPU_IRQ 5
+#define CPU_SOFTIRQ 6
+#define CPU_STEAL 7
+
+// counter files per InfiniBand port (order of Interface_Totals -> ib_port_fds, ports from find_ib_ports)
+#define N_IB_PORT_COUNTER_FILES 2
+#define IB_PORT_RCV_DATA 0
+#define IB_PORT_XMIT_DATA 1
+
+// counter files per IB (IPoIB) interface (order of Interface_Totals -> ib_fds)
+#define N_IB_COUNTER_FILES 2
+#define IB_SYS_RX_BYTES 0
+#define IB_SYS_TX_BYTES 1
+
+// counter files per Ethernet interface (order of Interface_Totals -> eth_fds)
+#define N_ETH_COUNTER_FILES 2
+#define ETH_RX_BYTES 0
+#define ETH_TX_BYTES 1
+
+// Where the interface byte counters come from (-l, --net_stats)
+//	- NETLINK: one RTM_GETLINK dump per tick, picks up interfaces that appear later (net_link.h)
+//	- SYSFS: <if>/statistics/{rx,tx}_bytes of the interfaces found at init
+// The IB port counters (port_rcv_data / port_xmit_data) are sysfs only and read either way.
+typedef enum net_stats_source {
+	NET_STATS_NETLINK,
+	NET_STATS_SYSFS
+} Net_Stats_Source;
+
+typedef struct proc_stat_reader {
+	int fd;
+	int buf_size;
+	char * buf;
+	// bytes of the last read
+	int n_read;
+	// PER-CORE (only if n_cpu > 0)
+	//	- counters / prev_counters are [N_CPU_COUNTERS][n_cpu] (struct-of-arrays)
+	//	- deltas is the same shape, scales[n_cpu] is 200 / (total delta of the core)
+	int n_cpu;
+	bool has_prev;
+	unsigned long * counters;
+	unsigned long * prev_counters;
+	float * deltas;
+	float * scales;
+} Proc_Stat_Reader;
+
+// enough for the MemTotal and MemFree lines at the top of /proc/meminfo
+#define MEM_INFO_READ_BYTES 256
+
+typedef struct mem_info_reader {
+	int fd;
+	char buf[MEM_INFO_READ_BYTES];
+} Mem_Info_Reader;
+
+// Where util_pct comes from (-u, --cpu_time)
+//	- TICKS: aggregate /proc/stat line in USER_HZ ticks (a handful per core per 100 ms sample)
+//	- SCHEDSTAT: sum of the per-cpu run time in /proc/schedstat (ns)
+//	- CGROUP: usage_usec of the root cgroup v2 cpu.stat, or cpuacct.usage (ns) on cgroup v1 hosts
+// The ns sources divide the busy time by the wall time between reads (CLOCK_MONOTONIC) and
+// the number of online cpus.
+typedef enum cpu_time_source {
+	CPU_TIME_TICKS,
+	CPU_TIME_SCHEDSTAT,
+	CPU_TIME_CGROUP
+} Cpu_Time_Source;
+
+// enough for the cpuN + domainN lines of one cpu in /proc/schedstat
+#define SCHEDSTAT_CPU_BYTES 1024
+
+typedef struct cpu_time_reader {
+	Cpu_Time_Source source;
+	int fd;
+	int n_cpu;
+	// cpuacct.usage (ns) instead of cpu.stat (usec)
+	bool cgroup_v1;
+	int buf_size;
+	char * buf;
+	bool has_prev;
+	long prev_busy_ns;
+	long prev_wall_ns;
+} Cpu_Time_Reader;
+
+
+// NULL if /proc/stat can't be opened, n_cpu > 0 also keeps per-core counters for cpu0 .. cpu<n_cpu - 1>
+Proc_Stat_Reader * init_proc_stat_reader(char * root_dir, int n_cpu);
+void destroy_proc_stat_reader(Proc_Stat_Reader * proc_stat_reader);
+
+// fills the cpu fields of proc_data (the current sample's slot in the arena), NULL if /proc/stat could not be read
+Proc_Data * process_proc_stat(Proc_Stat_Reader * proc_stat_reader, Proc_Data * proc_data, Proc_Data * prev_data);
+
+// NULL if /proc/meminfo can't be opened
+Mem_Info_Reader * init_mem_info_reader(char * root_dir);
+void destroy_mem_info_reader(Mem_Info_Reader * mem_info_reader);
+
+// fills the memory fields of proc_data (free_mem, mem_used_pct) from MemTotal / MemFree, NULL if /proc/meminfo could not be read
+Proc_Data * process_mem_info(Mem_Info_Reader * mem_info_reader, Proc_Data * proc_data);
+
+// per-core utilization from the contents of the last process_proc_stat, fills the
+// N_CORE_UTIL_COLUMNS * n_cpu bytes at core_util (see monitoring.h), all 0 on the first call,
+// -1 if the cpuN lines could not be parsed
+int process_per_cpu_stat(Proc_Stat_Reader * proc_stat_reader, unsigned char * core_util);
+
+// "ticks", "schedstat" or "cgroup"
+int parse_cpu_time_source(char * str, Cpu_Time_Source * source);
+
+// NULL if the source's file can't be opened (or source is TICKS, nothing to read)
+Cpu_Time_Reader * init_cpu_time_reader(char * root_dir, Cpu_Time_Source source, int n_cpu);
+void destroy_cpu_time_reader(Cpu_Time_Reader * cpu_time_reader);
+
+// busy cpu time in ns (since boot for schedstat, since the cgroup was created for cgroup), -1 on error
+int read_cpu_busy_ns(Cpu_Time_Reader * cpu_time_reader, long * busy_ns);
+
+// replaces proc_data -> util_pct with the ns based value (0 on the first call), -1 on error
+int process_cpu_time(Cpu_Time_Reader * cpu_time_reader, Proc_Data * proc_data);
+
+// "netlink" or "sysfs"
+int parse_net_stats_source(char * str, Net_Stats_Source * source);
+
+// finds the ib* and eno* interfaces under <root_dir>/sys/class/net and the InfiniBand ports
+// under <root_dir>/sys/class/infiniband and opens their counters
+//	- NETLINK falls back to SYSFS (with a message) if the netlink socket can't be opened
+Interface_Totals * init_interface_totals(char * root_dir, Net_Stats_Source source);
+void destroy_interface_totals(Interface_Totals * interface_totals);
+
+// fills net_data (the current sample's slot in the arena)
+Net_Data * process_net_stat(Net_Data * net_data, Interface_Totals * interface_totals);
+
+
+// HELPERS (also used by the benchmarks)
+
+// -1 (with a message) if the file can't be opened
+int open_counter_file(char * path);
+
+// whole file into buf (NUL terminated, truncated to buf_size - 1), bytes read or -1
+int read_counter_file(int fd, char * buf, int buf_size);
+
+// parses the next unsigned integer in [*pos, end), leaves *pos after it, -1 if there is none
+int scan_next_ulong(char ** pos, char * end, unsigned long * value);
+
+// file holding a single integer (sysfs counters), -1 if it can't be read
+int read_counter_value(int fd, long * value);
+
+#endif
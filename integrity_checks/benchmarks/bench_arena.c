@@ -0,0 +1,275 @@
+#define _GNU_SOURCE
+
+#include <malloc.h>
+
+#include "job_stats.h"
+
+#include "monitoring.h"
+#include "samples_arena.h"
+#include "storage.h"
+#include "synthetic_buffer.h"
+
+// Samples buffer layout: the old per-sample mallocs (3 per sample + the Sample array)
+// vs the struct of arrays arena, same values in both
+//	- heap_bytes: malloc_usable_size of every block + 8 bytes of chunk header each
+//	- scan_ns: reading every value in dump order (the part the layout changes)
+//	- reset_ns: zeroing the buffer like reset_samples_buffer
+//	- dump_ns: EAV rows through the Storage layer into a fresh db
+//
+// Usage: ./benchArena [db_path] [n_samples] [n_devices] [n_fields] [n_repeats]
+// Output (one line per run): layout,n_samples,n_allocs,requested_bytes,heap_bytes,alloc_ns,scan_ns,reset_ns,dump_ns
+
+
+/* OLD LAYOUT */
+
+typedef struct legacy_sample {
+	struct timespec time;
+	void * field_values;
+	Proc_Data * cpu_util;
+	Net_Data * net_util;
+} Legacy_Sample;
+
+Legacy_Sample * init_legacy_samples(int n_samples, int n_devices, int n_fields, long * heap_bytes){
+
+	Legacy_Sample * samples = (Legacy_Sample *) malloc(n_samples * sizeof(Legacy_Sample));
+	if (samples == NULL){
+		fprintf(stderr, "Could not allocate legacy samples\n");
+		exit(1);
+	}
+	*heap_bytes = malloc_usable_size(samples) + 8;
+
+	for (int i = 0; i < n_samples; i++){
+		samples[i].field_values = malloc(n_devices * n_fields * 8);
+		samples[i].cpu_util = (Proc_Data *) malloc(sizeof(Proc_Data));
+		samples[i].net_util = (Net_Data *) malloc(sizeof(Net_Data));
+		if ((samples[i].field_values == NULL) || (samples[i].cpu_util == NULL) || (samples[i].net_util == NULL)){
+			fprintf(stderr, "Could not allocate legacy samples\n");
+			exit(1);
+		}
+		*heap_bytes += malloc_usable_size(samples[i].field_values) + malloc_usable_size(samples[i].cpu_util) + malloc_usable_size(samples[i].net_util) + 3 * 8;
+	}
+	return samples;
+}
+
+void copy_to_legacy_samples(Samples_Buffer * samples_buffer, Legacy_Sample * samples){
+
+	int n_columns = samples_buffer -> n_devices * samples_buffer -> n_fields;
+
+	for (int i = 0; i < samples_buffer -> n_samples; i++){
+		samples[i].time = samples_buffer -> times[i];
+		*(samples[i].cpu_util) = samples_buffer -> cpu_util[i];
+		*(samples[i].net_util) = samples_buffer -> net_util[i];
+		for (int c = 0; c < n_columns; c++){
+			((long *) samples[i].field_values)[c] = ((long *) FIELD_COLUMN(samples_buffer, c))[i];
+		}
+	}
+}
+
+void free_legacy_samples(Legacy_Sample * samples, int n_samples){
+	for (int i = 0; i < n_samples; i++){
+		free(samples[i].field_values);
+		free(samples[i].cpu_util);
+		free(samples[i].net_util);
+	}
+	free(samples);
+}
+
+
+/* TRAVERSALS (same order as the dumps) */
+
+long scan_legacy(Legacy_Sample * samples, int n_samples, int n_columns){
+
+	long sum = 0;
+	for (int i = 0; i < n_samples; i++){
+		sum += samples[i].time.tv_nsec + samples[i].cpu_util -> free_mem + samples[i].net_util -> ib_rx_bytes + samples[i].net_util -> eth_tx_bytes;
+		for (int c = 0; c < n_columns; c++){
+			sum += ((long *) samples[i].field_values)[c];
+		}
+	}
+	return sum;
+}
+
+long scan_arena(Samples_Buffer * samples_buffer){
+
+	int n_samples = samples_buffer -> n_samples;
+	int n_columns = samples_buffer -> n_devices * samples_buffer -> n_fields;
+	long * field_column;
+
+	long sum = 0;
+	for (int i = 0; i < n_samples; i++){
+		sum += samples_buffer -> times[i].tv_nsec + samples_buffer -> cpu_util[i].free_mem + samples_buffer -> net_util[i].ib_rx_bytes + samples_buffer -> net_util[i].eth_tx_bytes;
+	}
+	for (int c = 0; c < n_columns; c++){
+		field_column = (long *) FIELD_COLUMN(samples_buffer, c);
+		for (int i = 0; i < n_samples; i++){
+			sum += field_column[i];
+		}
+	}
+	return sum;
+}
+
+void reset_legacy(Legacy_Sample * samples, int n_samples, int n_columns){
+	struct timespec time = {0, 0};
+	for (int i = 0; i < n_samples; i++){
+		samples[i].time = time;
+		memset(samples[i].field_values, 0, n_columns * 8);
+	}
+}
+
+// the old dump_samples_buffer loop, rows go through the same Storage as the arena dump
+void dump_legacy(Legacy_Sample * samples, Samples_Buffer * samples_buffer, Storage * storage){
+
+	int n_fields = samples_buffer -> n_fields;
+	int n_devices = samples_buffer -> n_devices;
+	unsigned short * field_types = samples_buffer -> field_types;
+	long time_ns, val;
+	int ind;
+
+	storage_begin(storage);
+	for (int i = 0; i < samples_buffer -> n_samples; i++){
+		time_ns = samples[i].time.tv_sec * 1e9 + samples[i].time.tv_nsec;
+		storage_add_row(storage, time_ns, -1, 1, round(samples[i].cpu_util -> mem_used_pct));
+		storage_add_row(storage, time_ns, -1, 2, samples[i].cpu_util -> free_mem);
+		storage_add_row(storage, time_ns, -1, 3, round(samples[i].cpu_util -> util_pct));
+		storage_add_row(storage, time_ns, -1, 10, samples[i].net_util -> ib_rx_bytes);
+		storage_add_row(storage, time_ns, -1, 11, samples[i].net_util -> ib_tx_bytes);
+		storage_add_row(storage, time_ns, -1, 12, samples[i].net_util -> ib_sys_rx_bytes);
+		storage_add_row(storage, time_ns, -1, 13, samples[i].net_util -> ib_sys_tx_bytes);
+		storage_add_row(storage, time_ns, -1, 14, samples[i].net_util -> eth_rx_bytes);
+		storage_add_row(storage, time_ns, -1, 15, samples[i].net_util -> eth_tx_bytes);
+		for (int gpuId = 0; gpuId < n_devices; gpuId++){
+			for (int fieldNum = 0; fieldNum < n_fields; fieldNum++){
+				ind = gpuId * n_fields + fieldNum;
+				if (field_types[fieldNum] == GPU_FT_DOUBLE){
+					val = (long) round(((double *) samples[i].field_values)[ind] * 100);
+				}
+				else {
+					val = ((long *) samples[i].field_values)[ind];
+				}
+				storage_add_row(storage, time_ns, gpuId, samples_buffer -> field_ids[fieldNum], val);
+			}
+		}
+	}
+	storage_commit(storage);
+}
+
+
+Storage * open_fresh_storage(char * db_path, Samples_Buffer * samples_buffer, sqlite3 ** db){
+
+	remove(db_path);
+	if (sqlite3_open(db_path, db) != SQLITE_OK){
+		fprintf(stderr, "Could not open db at: %s\n", db_path);
+		exit(1);
+	}
+	if (create_storage_tables(*db, STORAGE_EAV, samples_buffer -> n_fields, samples_buffer -> field_ids) == -1){
+		exit(1);
+	}
+	Storage * storage = init_storage(*db, STORAGE_EAV, STORAGE_BATCH_ROWS, samples_buffer -> n_fields, samples_buffer -> field_ids);
+	if (storage == NULL){
+		exit(1);
+	}
+	return storage;
+}
+
+int main(int argc, char ** argv){
+
+	char * db_path = (argc > 1) ? argv[1] : "/tmp/bench_arena.db";
+	int n_samples = (argc > 2) ? atoi(argv[2]) : 3000;
+	int n_devices = (argc > 3) ? atoi(argv[3]) : 8;
+	int n_fields = (argc > 4) ? atoi(argv[4]) : 10;
+	int n_repeats = (argc > 5) ? atoi(argv[5]) : 3;
+
+	int n_columns = n_devices * n_fields;
+	long requested_bytes = (long) n_samples * (sizeof(Legacy_Sample) + sizeof(Proc_Data) + sizeof(Net_Data) + n_columns * 8);
+
+	// source of the values for both layouts
+	Samples_Buffer * samples_buffer = init_synthetic_buffer(n_samples, n_devices, n_fields);
+
+	struct timespec start, end;
+	long alloc_ns, scan_ns, reset_ns, dump_ns, heap_bytes;
+	volatile long sum;
+	sqlite3 * db;
+	Storage * storage;
+	Legacy_Sample * legacy_samples;
+	Samples_Buffer arena_buffer;
+
+	printf("layout,n_samples,n_allocs,requested_bytes,heap_bytes,alloc_ns,scan_ns,reset_ns,dump_ns\n");
+
+	for (int r = 0; r < n_repeats; r++){
+
+		fill_synthetic_buffer(samples_buffer, PATTERN_STEADY);
+
+		// PER-SAMPLE MALLOCS
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		legacy_samples = init_legacy_samples(n_samples, n_devices, n_fields, &heap_bytes);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		alloc_ns = elapsed_ns(&start, &end);
+		copy_to_legacy_samples(samples_buffer, legacy_samples);
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		sum = scan_legacy(legacy_samples, n_samples, n_columns);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		scan_ns = elapsed_ns(&start, &end);
+
+		storage = open_fresh_storage(db_path, samples_buffer, &db);
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		dump_legacy(legacy_samples, samples_buffer, storage);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		dump_ns = elapsed_ns(&start, &end);
+		destroy_storage(storage);
+		sqlite3_close(db);
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		reset_legacy(legacy_samples, n_samples, n_columns);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		reset_ns = elapsed_ns(&start, &end);
+
+		printf("per_sample,%d,%d,%ld,%ld,%ld,%ld,%ld,%ld\n", n_samples, 1 + 3 * n_samples, requested_bytes, heap_bytes, alloc_ns, scan_ns, reset_ns, dump_ns);
+		free_legacy_samples(legacy_samples, n_samples);
+
+		// ARENA
+		memset(&arena_buffer, 0, sizeof(Samples_Buffer));
+		arena_buffer.n_devices = n_devices;
+		arena_buffer.n_fields = n_fields;
+		arena_buffer.field_ids = samples_buffer -> field_ids;
+		arena_buffer.field_types = samples_buffer -> field_types;
+		arena_buffer.max_samples = n_samples;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		if (alloc_samples_arena(&arena_buffer) == -1){
+			exit(1);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		alloc_ns = elapsed_ns(&start, &end);
+		heap_bytes = malloc_usable_size(arena_buffer.arena) + 8;
+		memcpy(arena_buffer.arena, samples_buffer -> arena, arena_buffer.arena_bytes);
+		arena_buffer.n_samples = n_samples;
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		sum = scan_arena(&arena_buffer);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		scan_ns = elapsed_ns(&start, &end);
+
+		// dump_samples_buffer resets the buffer afterwards, time the reset on its own first
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		clear_samples_arena(&arena_buffer, n_samples);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		reset_ns = elapsed_ns(&start, &end);
+		memcpy(arena_buffer.arena, samples_buffer -> arena, arena_buffer.arena_bytes);
+
+		storage = open_fresh_storage(db_path, samples_buffer, &db);
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		dump_samples_buffer(&arena_buffer, storage);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		dump_ns = elapsed_ns(&start, &end) - reset_ns;
+		destroy_storage(storage);
+		sqlite3_close(db);
+
+		printf("arena,%d,%d,%ld,%ld,%ld,%ld,%ld,%ld\n", n_samples, 1, (long) arena_buffer.arena_bytes, heap_bytes, alloc_ns, scan_ns, reset_ns, dump_ns);
+		free_samples_arena(&arena_buffer);
+	}
+
+	(void) sum;
+	remove(db_path);
+
+	return 0;
+}
@@ -0,0 +1,115 @@
+#define _GNU_SOURCE
+
+#include "job_stats.h"
+
+#include "monitoring.h"
+#include "host_stats.h"
+#include "collect_pool.h"
+#include "synthetic_buffer.h"
+
+// One tick's collection, serial vs on the collection pool (-T)
+//	- gpu: stands in for dcgmUpdateAllFields waiting on the driver, sleeps gpu_us
+//	- proc: this node's /proc/stat and meminfo through host_stats.c
+//	- net: this node's interface counters through host_stats.c
+//	- jobs: stands in for the cgroup reads, sleeps gpu_us / 4
+// With 0 workers the tick costs the sum of the stages, with enough workers the slowest one
+// plus the two barriers.
+//
+// Usage: ./benchCollectPool [gpu_us] [n_ticks]
+// Output (one line per worker count): n_workers,gpu_us,collect_ns_per_tick,stage_sum_ns_per_tick
+
+
+typedef struct bench_context {
+	long gpu_us;
+	Proc_Stat_Reader * proc_stat_reader;
+	Mem_Info_Reader * mem_info_reader;
+	Interface_Totals * interface_totals;
+	Proc_Data proc_data;
+	Proc_Data prev_data;
+	Net_Data net_data;
+} Bench_Context;
+
+static void sleep_us(long us){
+	struct timespec duration;
+	duration.tv_sec = us / 1000000;
+	duration.tv_nsec = (us % 1000000) * 1000;
+	nanosleep(&duration, NULL);
+}
+
+static int fake_gpu_task(void * ctx){
+	sleep_us(((Bench_Context *) ctx) -> gpu_us);
+	return 0;
+}
+
+static int proc_task(void * ctx){
+	Bench_Context * bench_context = (Bench_Context *) ctx;
+	bench_context -> prev_data = bench_context -> proc_data;
+	process_proc_stat(bench_context -> proc_stat_reader, &(bench_context -> proc_data), &(bench_context -> prev_data));
+	process_mem_info(bench_context -> mem_info_reader, &(bench_context -> proc_data));
+	return 0;
+}
+
+static int net_task(void * ctx){
+	Bench_Context * bench_context = (Bench_Context *) ctx;
+	process_net_stat(&(bench_context -> net_data), bench_context -> interface_totals);
+	return 0;
+}
+
+static int fake_jobs_task(void * ctx){
+	sleep_us(((Bench_Context *) ctx) -> gpu_us / 4);
+	return 0;
+}
+
+int main(int argc, char ** argv){
+
+	long gpu_us = (argc > 1) ? atol(argv[1]) : 2000;
+	int n_ticks = (argc > 2) ? atoi(argv[2]) : 2000;
+
+	Bench_Context bench_context;
+	memset(&bench_context, 0, sizeof(Bench_Context));
+	bench_context.gpu_us = gpu_us;
+	bench_context.proc_stat_reader = init_proc_stat_reader("", 0);
+	bench_context.mem_info_reader = init_mem_info_reader("");
+	bench_context.interface_totals = init_interface_totals("", NET_STATS_SYSFS);
+	if ((bench_context.proc_stat_reader == NULL) || (bench_context.mem_info_reader == NULL) || (bench_context.interface_totals == NULL)){
+		exit(1);
+	}
+	process_proc_stat(bench_context.proc_stat_reader, &(bench_context.proc_data), NULL);
+
+	Collect_Pool * collect_pool;
+	long collect_ns, stage_sum_ns;
+
+	printf("n_workers,gpu_us,collect_ns_per_tick,stage_sum_ns_per_tick\n");
+
+	for (int n_workers = 0; n_workers < N_COLLECT_TASKS; n_workers++){
+
+		collect_pool = init_collect_pool(n_workers);
+		if (collect_pool == NULL){
+			exit(1);
+		}
+		set_collect_task(collect_pool, COLLECT_TASK_GPU, fake_gpu_task, &bench_context);
+		set_collect_task(collect_pool, COLLECT_TASK_PROC, proc_task, &bench_context);
+		set_collect_task(collect_pool, COLLECT_TASK_NET, net_task, &bench_context);
+		set_collect_task(collect_pool, COLLECT_TASK_JOBS, fake_jobs_task, &bench_context);
+		for (int i = 0; i < N_COLLECT_TASKS; i++){
+			collect_pool -> tasks[i].due = true;
+		}
+
+		collect_ns = 0;
+		stage_sum_ns = 0;
+		for (int t = 0; t < n_ticks; t++){
+			collect_ns += run_collect_tasks(collect_pool);
+			for (int i = 0; i < N_COLLECT_TASKS; i++){
+				stage_sum_ns += collect_pool -> tasks[i].duration_ns;
+			}
+		}
+		printf("%d,%ld,%.0f,%.0f\n", n_workers, gpu_us, (double) collect_ns / n_ticks, (double) stage_sum_ns / n_ticks);
+
+		destroy_collect_pool(collect_pool);
+	}
+
+	destroy_proc_stat_reader(bench_context.proc_stat_reader);
+	destroy_mem_info_reader(bench_context.mem_info_reader);
+	destroy_interface_totals(bench_context.interface_totals);
+	return 0;
+}
@@ -0,0 +1,154 @@
+#define _GNU_SOURCE
+
+#include "job_stats.h"
+
+#include "monitoring.h"
+#include "storage.h"
+#include "synthetic_buffer.h"
+
+// Bytes per sample of the columnar format (<hostname>.mts) vs the EAV Data table,
+// for idle / steady / noisy value patterns. Every chunk is read back and compared
+// value by value against what was written.
+//
+// Usage: ./benchColumnar [out_dir] [n_samples] [n_devices] [n_fields] [n_chunks]
+// Output (one line per pattern): pattern,n_samples,columnar_bytes,eav_bytes,columnar_bytes_per_sample,eav_bytes_per_sample,ratio,write_ns_per_chunk,read_ns_per_chunk,round_trip
+
+
+// compares the decoded chunk against the (still filled) buffer it was written from
+int check_round_trip(Columnar_Chunk * chunk, Samples_Buffer * samples_buffer){
+
+	int n_values = samples_buffer -> n_devices * samples_buffer -> n_fields;
+	struct timespec * time;
+	Proc_Data * cpu_util;
+	Net_Data * net_util;
+	long expected_ts;
+
+	if (chunk -> n_samples != samples_buffer -> n_samples){
+		return -1;
+	}
+
+	for (int i = 0; i < chunk -> n_samples; i++){
+		time = &(samples_buffer -> times[i]);
+		cpu_util = &(samples_buffer -> cpu_util[i]);
+		net_util = &(samples_buffer -> net_util[i]);
+		expected_ts = time -> tv_sec * 1000000000L + time -> tv_nsec;
+		if ((chunk -> timestamps[i] != expected_ts)
+				|| (get_columnar_double(chunk, 0, i) != cpu_util -> mem_used_pct)
+				|| (get_columnar_long(chunk, 1, i) != cpu_util -> free_mem)
+				|| (get_columnar_double(chunk, 2, i) != cpu_util -> util_pct)
+				|| (get_columnar_long(chunk, 3, i) != net_util -> ib_rx_bytes)
+				|| (get_columnar_long(chunk, 8, i) != net_util -> eth_tx_bytes)
+				|| (get_columnar_long(chunk, 9, i) != samples_buffer -> periods_ms[i])
+				|| (get_columnar_long(chunk, 10, i) != samples_buffer -> skipped_collectors[i])){
+			return -1;
+		}
+		// bit exact, doubles included
+		for (int c = 0; c < n_values; c++){
+			if (get_columnar_long(chunk, N_COLUMNAR_HOST_COLUMNS + c, i) != ((long *) FIELD_COLUMN(samples_buffer, c))[i]){
+				return -1;
+			}
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char ** argv){
+
+	char * out_dir = (argc > 1) ? argv[1] : "/tmp";
+	int n_samples = (argc > 2) ? atoi(argv[2]) : 3000;
+	int n_devices = (argc > 3) ? atoi(argv[3]) : 8;
+	int n_fields = (argc > 4) ? atoi(argv[4]) : 10;
+	int n_chunks = (argc > 5) ? atoi(argv[5]) : 5;
+
+	const char * pattern_names[3] = {"idle", "steady", "noisy"};
+
+	char * mts_path, * idx_path, * db_path;
+	asprintf(&mts_path, "%s/bench_columnar.mts", out_dir);
+	asprintf(&idx_path, "%s/bench_columnar.mts.idx", out_dir);
+	asprintf(&db_path, "%s/bench_columnar.db", out_dir);
+
+	Samples_Buffer * samples_buffer = init_synthetic_buffer(n_samples, n_devices, n_fields);
+
+	struct timespec start, end;
+	long write_ns, read_ns, columnar_bytes, eav_bytes, total_samples;
+	int round_trip_ok;
+	Columnar_Writer * columnar_writer;
+	Columnar_Chunk * chunk;
+	FILE * data_file;
+	sqlite3 * db;
+	Storage * storage;
+
+	printf("pattern,n_samples,columnar_bytes,eav_bytes,columnar_bytes_per_sample,eav_bytes_per_sample,ratio,write_ns_per_chunk,read_ns_per_chunk,round_trip\n");
+
+	for (int p = PATTERN_IDLE; p <= PATTERN_NOISY; p++){
+
+		remove(mts_path);
+		remove(idx_path);
+		remove(db_path);
+
+		columnar_writer = open_columnar_writer(mts_path);
+		if (sqlite3_open(db_path, &db) != SQLITE_OK){
+			fprintf(stderr, "Could not open db at: %s\n", db_path);
+			exit(1);
+		}
+		if ((columnar_writer == NULL) || (create_storage_tables(db, STORAGE_EAV, n_fields, samples_buffer -> field_ids) == -1)){
+			exit(1);
+		}
+		storage = init_storage(db, STORAGE_EAV, STORAGE_BATCH_ROWS, n_fields, samples_buffer -> field_ids);
+		if (storage == NULL){
+			exit(1);
+		}
+
+		write_ns = 0;
+		read_ns = 0;
+		round_trip_ok = 1;
+		data_file = fopen(mts_path, "rb");
+
+		for (int c = 0; c < n_chunks; c++){
+			fill_synthetic_buffer(samples_buffer, p);
+
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			if (write_columnar_chunk(columnar_writer, samples_buffer) == -1){
+				exit(1);
+			}
+			clock_gettime(CLOCK_MONOTONIC, &end);
+			write_ns += elapsed_ns(&start, &end);
+
+			// written chunk is flushed, read it back before the dump resets the buffer
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			chunk = read_columnar_chunk(data_file);
+			clock_gettime(CLOCK_MONOTONIC, &end);
+			read_ns += elapsed_ns(&start, &end);
+
+			if ((chunk == NULL) || (check_round_trip(chunk, samples_buffer) == -1)){
+				round_trip_ok = 0;
+			}
+			if (chunk != NULL){
+				free_columnar_chunk(chunk);
+			}
+
+			// tick stats are empty so only Data rows are written
+			dump_samples_buffer(samples_buffer, storage);
+		}
+
+		fclose(data_file);
+		close_columnar_writer(columnar_writer);
+		destroy_storage(storage);
+		sqlite3_close(db);
+
+		// the index is part of the format's footprint
+		columnar_bytes = file_size(mts_path) + file_size(idx_path);
+		eav_bytes = file_size(db_path);
+		total_samples = (long) n_samples * n_chunks;
+
+		printf("%s,%ld,%ld,%ld,%.1f,%.1f,%.1f,%ld,%ld,%s\n", pattern_names[p], total_samples, columnar_bytes, eav_bytes,
+					(double) columnar_bytes / total_samples, (double) eav_bytes / total_samples, (double) eav_bytes / columnar_bytes,
+					write_ns / n_chunks, read_ns / n_chunks, round_trip_ok ? "ok" : "FAILED");
+	}
+
+	remove(mts_path);
+	remove(idx_path);
+	remove(db_path);
+
+	return 0;
+}
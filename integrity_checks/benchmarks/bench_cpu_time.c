@@ -0,0 +1,146 @@
+#define _GNU_SOURCE
+
+#include <signal.h>
+#include <sys/wait.h>
+
+#include "job_stats.h"
+
+#include "monitoring.h"
+#include "host_stats.h"
+#include "synthetic_buffer.h"
+
+// Cpu util % from each source (-u) against a known busy-loop workload
+//	- n_busy children each spin duty_pct of every 10 ms and sleep the rest
+//	- every source is read in the same tick, so they see the same load and background
+//	- expected = 100 * n_busy * duty_pct / 100 / n_cpu (background adds a small positive bias to all)
+// Sources whose file doesn't exist on this host are skipped.
+//
+// Usage: ./benchCpuTime [n_busy] [duty_pct] [period_ms] [n_samples]
+// Output (one line per source): source,n_samples,expected_pct,mean_pct,stddev_pct,mean_abs_err_pct
+
+#define BUSY_PERIOD_NS 10000000L
+
+static long now_ns(){
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1000000000L + t.tv_nsec;
+}
+
+static void busy_loop(int duty_pct){
+
+	long busy_ns = BUSY_PERIOD_NS * duty_pct / 100;
+	struct timespec rest = {0, BUSY_PERIOD_NS - busy_ns};
+	volatile unsigned long spin = 0;
+	long start;
+	while (true){
+		start = now_ns();
+		while (now_ns() - start < busy_ns){
+			spin++;
+		}
+		if (rest.tv_nsec > 0){
+			nanosleep(&rest, NULL);
+		}
+	}
+}
+
+typedef struct source_stats {
+	char * name;
+	int n;
+	double sum;
+	double sum_sq;
+	double sum_abs_err;
+} Source_Stats;
+
+static void add_value(Source_Stats * stats, double val, double expected){
+	stats -> n++;
+	stats -> sum += val;
+	stats -> sum_sq += val * val;
+	stats -> sum_abs_err += fabs(val - expected);
+}
+
+static void print_stats(Source_Stats * stats, double expected){
+	if (stats -> n == 0){
+		printf("%s,0,%.2f,,,\n", stats -> name, expected);
+		return;
+	}
+	double mean = stats -> sum / stats -> n;
+	double var = stats -> sum_sq / stats -> n - mean * mean;
+	printf("%s,%d,%.2f,%.2f,%.2f,%.2f\n", stats -> name, stats -> n, expected, mean, sqrt((var > 0) ? var : 0), stats -> sum_abs_err / stats -> n);
+}
+
+int main(int argc, char ** argv){
+
+	int n_busy = (argc > 1) ? atoi(argv[1]) : 1;
+	int duty_pct = (argc > 2) ? atoi(argv[2]) : 50;
+	int period_ms = (argc > 3) ? atoi(argv[3]) : 100;
+	int n_samples = (argc > 4) ? atoi(argv[4]) : 100;
+
+	int n_cpu = sysconf(_SC_NPROCESSORS_ONLN);
+	double expected = 100.0 * n_busy * duty_pct / 100.0 / n_cpu;
+
+	Proc_Stat_Reader * proc_stat_reader = init_proc_stat_reader("", 0);
+	if (proc_stat_reader == NULL){
+		exit(1);
+	}
+	Cpu_Time_Reader * readers[2];
+	readers[0] = init_cpu_time_reader("", CPU_TIME_SCHEDSTAT, n_cpu);
+	readers[1] = init_cpu_time_reader("", CPU_TIME_CGROUP, n_cpu);
+
+	Source_Stats stats[3] = {{"ticks", 0, 0, 0, 0}, {"schedstat", 0, 0, 0, 0}, {"cgroup", 0, 0, 0, 0}};
+	if ((readers[1] != NULL) && (readers[1] -> cgroup_v1)){
+		stats[2].name = "cgroup_v1";
+	}
+
+	pid_t * children = (pid_t *) malloc(n_busy * sizeof(pid_t));
+	for (int i = 0; i < n_busy; i++){
+		children[i] = fork();
+		if (children[i] == 0){
+			busy_loop(duty_pct);
+		}
+	}
+
+	// let the load settle before the first reads
+	struct timespec settle = {0, 200000000L};
+	nanosleep(&settle, NULL);
+
+	Proc_Data proc_data, prev_data;
+	process_proc_stat(proc_stat_reader, &proc_data, NULL);
+	for (int r = 0; r < 2; r++){
+		if (readers[r] != NULL){
+			process_cpu_time(readers[r], &proc_data);
+		}
+	}
+
+	struct timespec period = {period_ms / 1000, (period_ms % 1000) * 1000000L};
+	for (int s = 0; s < n_samples; s++){
+		nanosleep(&period, NULL);
+		prev_data = proc_data;
+		if (process_proc_stat(proc_stat_reader, &proc_data, &prev_data) != NULL){
+			add_value(&stats[0], proc_data.util_pct, expected);
+		}
+		for (int r = 0; r < 2; r++){
+			if ((readers[r] != NULL) && (process_cpu_time(readers[r], &proc_data) == 0)){
+				add_value(&stats[r + 1], proc_data.util_pct, expected);
+			}
+		}
+	}
+
+	for (int i = 0; i < n_busy; i++){
+		kill(children[i], SIGKILL);
+		waitpid(children[i], NULL, 0);
+	}
+
+	printf("source,n_samples,expected_pct,mean_pct,stddev_pct,mean_abs_err_pct\n");
+	for (int i = 0; i < 3; i++){
+		print_stats(&stats[i], expected);
+	}
+
+	destroy_proc_stat_reader(proc_stat_reader);
+	for (int r = 0; r < 2; r++){
+		if (readers[r] != NULL){
+			destroy_cpu_time_reader(readers[r]);
+		}
+	}
+	free(children);
+	return 0;
+}
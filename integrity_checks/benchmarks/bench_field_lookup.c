@@ -0,0 +1,136 @@
+#define _GNU_SOURCE
+
+#include "job_stats.h"
+#include "dcgm_structs.h"
+#include "dcgm_fields.h"
+
+#include "monitoring.h"
+#include "samples_arena.h"
+#include "field_lookup.h"
+#include "synthetic_buffer.h"
+
+// ns per value of the dcgmGetLatestValues callback with synthetic dcgmFieldValue_v1 arrays
+//	- linear: the old get_my_field_ind search over field_ids
+//	- lookup: copy_field_values_function (direct-indexed table)
+// Values arrive in reverse field order (worst case for the search), plus one unwatched
+// field per GPU.
+//
+// Usage: ./benchFieldLookup [n_devices] [n_iters]
+// Output (one line per method and field count): method,n_fields,n_values,ns_per_value
+
+
+int get_my_field_ind(unsigned short fieldId, unsigned short * field_ids, int n_fields){
+
+	for (int i = 0; i < n_fields; i++){
+		if (field_ids[i] == fieldId){
+			return i;
+		}
+	}
+	return -1;
+}
+
+int linear_copy_field_values_function(unsigned int gpuId, dcgmFieldValue_v1 * values, int numValues, void * userdata){
+	Samples_Buffer * samples_buffer = (Samples_Buffer *) userdata;
+	int n_samples = samples_buffer -> n_samples;
+	unsigned short * field_ids = samples_buffer -> field_ids;
+	int n_fields = samples_buffer -> n_fields;
+	unsigned short fieldType;
+	int indOfField;
+	void * field_column;
+	for (int i = 0; i < numValues; i++){
+		indOfField = get_my_field_ind(values[i].fieldId, field_ids, n_fields);
+		if (indOfField == -1){
+			continue;
+		}
+		fieldType = values[i].fieldType;
+		field_column = FIELD_COLUMN(samples_buffer, gpuId * n_fields + indOfField);
+		if (fieldType == DCGM_FT_DOUBLE){
+			((double *) field_column)[n_samples] = values[i].value.dbl;
+		}
+		else if ((fieldType == DCGM_FT_INT64) || (fieldType == DCGM_FT_TIMESTAMP)){
+			((long *) field_column)[n_samples] = values[i].value.i64;
+		}
+	}
+	return 0;
+}
+
+dcgmFieldValue_v1 * init_field_values(Samples_Buffer * samples_buffer, int * n_values){
+
+	int n_fields = samples_buffer -> n_fields;
+	*n_values = n_fields + 1;
+
+	dcgmFieldValue_v1 * values = (dcgmFieldValue_v1 *) calloc(*n_values, sizeof(dcgmFieldValue_v1));
+	if (values == NULL){
+		fprintf(stderr, "Could not allocate field values\n");
+		exit(1);
+	}
+
+	for (int i = 0; i < n_fields; i++){
+		values[i].fieldId = samples_buffer -> field_ids[n_fields - 1 - i];
+		values[i].fieldType = samples_buffer -> field_types[n_fields - 1 - i];
+		if (values[i].fieldType == DCGM_FT_DOUBLE){
+			values[i].value.dbl = 0.5;
+		}
+		else {
+			values[i].value.i64 = i;
+		}
+	}
+	values[n_fields].fieldId = 1;
+	values[n_fields].fieldType = DCGM_FT_INT64;
+
+	return values;
+}
+
+int main(int argc, char ** argv){
+
+	int n_devices = (argc > 1) ? atoi(argv[1]) : 8;
+	int n_iters = (argc > 2) ? atoi(argv[2]) : 100000;
+
+	int field_counts[4] = {10, 40, 100, 250};
+
+	Samples_Buffer * samples_buffer;
+	dcgmFieldValue_v1 * values;
+	int n_values;
+	struct timespec start, end;
+	long ns;
+
+	printf("method,n_fields,n_values,ns_per_value\n");
+
+	for (int f = 0; f < 4; f++){
+
+		// one sample slot is enough, the callback always writes at n_samples = 0
+		samples_buffer = init_synthetic_buffer(1, n_devices, field_counts[f]);
+		samples_buffer -> n_samples = 0;
+		samples_buffer -> field_lookup = init_field_lookup(samples_buffer -> field_ids, samples_buffer -> n_fields);
+		if (samples_buffer -> field_lookup == NULL){
+			exit(1);
+		}
+		values = init_field_values(samples_buffer, &n_values);
+
+		for (int m = 0; m < 2; m++){
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			for (int it = 0; it < n_iters; it++){
+				for (int gpuId = 0; gpuId < n_devices; gpuId++){
+					if (m == 0){
+						linear_copy_field_values_function(gpuId, values, n_values, (void *) samples_buffer);
+					}
+					else {
+						copy_field_values_function(gpuId, values, n_values, (void *) samples_buffer);
+					}
+				}
+			}
+			clock_gettime(CLOCK_MONOTONIC, &end);
+			ns = elapsed_ns(&start, &end);
+			printf("%s,%d,%d,%.2f\n", (m == 0) ? "linear" : "lookup", field_counts[f], n_values, (double) ns / ((double) n_iters * n_devices * n_values));
+		}
+
+		free(values);
+		free(samples_buffer -> field_lookup);
+		free_samples_arena(samples_buffer);
+		free(samples_buffer -> field_ids);
+		free(samples_buffer -> field_types);
+		free(samples_buffer);
+	}
+
+	return 0;
+}
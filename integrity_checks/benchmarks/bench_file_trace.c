@@ -0,0 +1,148 @@
+#define _GNU_SOURCE
+
+#include "job_stats.h"
+
+#include "monitoring.h"
+#include "host_stats.h"
+#include "file_trace.h"
+
+// Host counter collection per tick live, while recording a trace and replaying it (see file_trace.h)
+//	- live: this node's /proc/stat, meminfo and sysfs interface counters through host_stats.c
+//	- record: the same reads with every open / read going to trace_file
+//	- replay: the readers on tree_dir serving the trace, no procfs / sysfs read at all (what a
+//	  load test or a parser benchmark pays per tick)
+// The replay has to parse the same values the recording did on every tick.
+//
+// Usage: ./benchFileTrace [trace_file] [tree_dir] [n_ticks]
+// Output (one line per mode): mode,n_ticks,ns_per_tick,trace_bytes_per_tick
+
+
+typedef struct bench_readers {
+	Proc_Stat_Reader * proc_stat_reader;
+	Mem_Info_Reader * mem_info_reader;
+	Interface_Totals * interface_totals;
+	Proc_Data proc_data;
+	Proc_Data prev_data;
+	Net_Data net_data;
+} Bench_Readers;
+
+static void init_bench_readers(Bench_Readers * bench_readers, char * root_dir){
+	memset(bench_readers, 0, sizeof(Bench_Readers));
+	bench_readers -> proc_stat_reader = init_proc_stat_reader(root_dir, 0);
+	bench_readers -> mem_info_reader = init_mem_info_reader(root_dir);
+	bench_readers -> interface_totals = init_interface_totals(root_dir, NET_STATS_SYSFS);
+	if ((bench_readers -> proc_stat_reader == NULL) || (bench_readers -> mem_info_reader == NULL) || (bench_readers -> interface_totals == NULL)){
+		exit(1);
+	}
+}
+
+static void destroy_bench_readers(Bench_Readers * bench_readers){
+	destroy_proc_stat_reader(bench_readers -> proc_stat_reader);
+	destroy_mem_info_reader(bench_readers -> mem_info_reader);
+	destroy_interface_totals(bench_readers -> interface_totals);
+}
+
+// one tick of the host collectors, a checksum of everything parsed
+static long collect_tick(Bench_Readers * bench_readers){
+	bench_readers -> prev_data = bench_readers -> proc_data;
+	process_proc_stat(bench_readers -> proc_stat_reader, &(bench_readers -> proc_data), &(bench_readers -> prev_data));
+	process_mem_info(bench_readers -> mem_info_reader, &(bench_readers -> proc_data));
+	process_net_stat(&(bench_readers -> net_data), bench_readers -> interface_totals);
+
+	Interface_Totals * interface_totals = bench_readers -> interface_totals;
+	return bench_readers -> proc_data.total_time + bench_readers -> proc_data.free_mem + interface_totals -> total_ib_rx_bytes + interface_totals -> total_ib_tx_bytes
+			+ interface_totals -> total_ib_sys_rx_bytes + interface_totals -> total_ib_sys_tx_bytes + interface_totals -> total_eth_rx_bytes + interface_totals -> total_eth_tx_bytes;
+}
+
+static long now_ns(){
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+int main(int argc, char ** argv){
+
+	char * trace_file = (argc > 1) ? argv[1] : "/tmp/bench_file_trace.trace";
+	char * tree_dir = (argc > 2) ? argv[2] : "/tmp/bench_file_trace_tree";
+	int n_ticks = (argc > 3) ? atoi(argv[3]) : 20000;
+
+	long * checksums = (long *) malloc(n_ticks * sizeof(long));
+	if (checksums == NULL){
+		fprintf(stderr, "Could not allocate memory for checksums\n");
+		exit(1);
+	}
+
+	Bench_Readers bench_readers;
+	File_Trace * file_trace;
+	long start_ns, ns, trace_bytes;
+	int n_replayed;
+
+	printf("mode,n_ticks,ns_per_tick,trace_bytes_per_tick\n");
+
+	// LIVE
+	init_bench_readers(&bench_readers, "");
+	start_ns = now_ns();
+	for (int t = 0; t < n_ticks; t++){
+		collect_tick(&bench_readers);
+	}
+	ns = now_ns() - start_ns;
+	destroy_bench_readers(&bench_readers);
+	printf("live,%d,%.0f,0\n", n_ticks, (double) ns / n_ticks);
+
+	// RECORD
+	file_trace = open_file_trace(trace_file, FILE_TRACE_RECORD, "");
+	if (file_trace == NULL){
+		exit(1);
+	}
+	set_file_trace(file_trace);
+	init_bench_readers(&bench_readers, "");
+	start_ns = now_ns();
+	for (int t = 0; t < n_ticks; t++){
+		advance_file_trace(file_trace, t);
+		checksums[t] = collect_tick(&bench_readers);
+		end_file_trace_tick(file_trace);
+	}
+	ns = now_ns() - start_ns;
+	set_file_trace(NULL);
+	destroy_bench_readers(&bench_readers);
+	trace_bytes = file_trace -> n_bytes;
+	close_file_trace(file_trace);
+	printf("record,%d,%.0f,%.1f\n", n_ticks, (double) ns / n_ticks, (double) trace_bytes / n_ticks);
+
+	// REPLAY
+	char * cmd;
+	asprintf(&cmd, "rm -rf %s", tree_dir);
+	if (system(cmd) != 0){
+		fprintf(stderr, "Could not run: %s\n", cmd);
+		exit(1);
+	}
+	free(cmd);
+	file_trace = open_file_trace(trace_file, FILE_TRACE_REPLAY, tree_dir);
+	if (file_trace == NULL){
+		exit(1);
+	}
+	set_file_trace(file_trace);
+	init_bench_readers(&bench_readers, tree_dir);
+	n_replayed = 0;
+	start_ns = now_ns();
+	while (advance_file_trace(file_trace, 0) == 1){
+		if ((n_replayed >= n_ticks) || (collect_tick(&bench_readers) != checksums[n_replayed])){
+			fprintf(stderr, "Replay disagrees with the recording on tick %d\n", n_replayed);
+			exit(1);
+		}
+		n_replayed++;
+	}
+	ns = now_ns() - start_ns;
+	set_file_trace(NULL);
+	destroy_bench_readers(&bench_readers);
+	trace_bytes = file_trace -> n_bytes;
+	close_file_trace(file_trace);
+	if (n_replayed != n_ticks){
+		fprintf(stderr, "Replayed %d of %d ticks\n", n_replayed, n_ticks);
+		exit(1);
+	}
+	printf("replay,%d,%.0f,%.1f\n", n_ticks, (double) ns / n_ticks, (double) trace_bytes / n_ticks);
+
+	free(checksums);
+	return 0;
+}
@@ -0,0 +1,305 @@
+#define _GNU_SOURCE
+
+#include <sys/resource.h>
+
+#include "job_stats.h"
+
+#include "monitoring.h"
+#include "host_stats.h"
+#include "port_counters.h"
+#include "synthetic_buffer.h"
+
+// Host counter collection per tick against a fake procfs / sysfs tree
+//	- legacy: the old fopen + fscanf of /proc/stat and asprintf + fopen + fscanf + free of
+//	  every interface counter
+//	- pread: host_stats.c (files opened once, pread at offset 0, integer scanner)
+//	- per_cpu: pread plus the per-core utilization of every cpuN line (-c)
+//	- ports: pread plus the default per-port series of every IB port and interface (-i default)
+// The tree is regenerated for every interface count, both methods read the same files and
+// have to produce the same totals.
+//
+// Usage: ./benchHostStats [tree_dir] [n_cpus] [n_ticks]
+// Output (one line per method and interface count): method,n_ib_ifs,n_eth_ifs,n_files,ns_per_tick,minor_faults_per_1k_ticks
+
+
+/* FAKE TREE */
+
+static void write_tree_file(char * path, char * contents){
+
+	FILE * fp = fopen(path, "w");
+	if (fp == NULL){
+		fprintf(stderr, "Could not create %s\n", path);
+		exit(1);
+	}
+	fputs(contents, fp);
+	fclose(fp);
+}
+
+static void make_tree_dir(char * tree_dir, char * fmt, char * if_name, char * if_port){
+
+	char * sub_path;
+	char * cmd;
+	asprintf(&sub_path, fmt, if_name, if_port);
+	asprintf(&cmd, "mkdir -p %s/%s", tree_dir, sub_path);
+	if (system(cmd) != 0){
+		fprintf(stderr, "Could not run: %s\n", cmd);
+		exit(1);
+	}
+	free(sub_path);
+	free(cmd);
+}
+
+static void write_counter(char * tree_dir, char * fmt, char * if_name, char * if_port, long value){
+
+	char * sub_path;
+	char * path;
+	char contents[32];
+	asprintf(&sub_path, fmt, if_name, if_port);
+	asprintf(&path, "%s/%s", tree_dir, sub_path);
+	snprintf(contents, sizeof(contents), "%ld\n", value);
+	write_tree_file(path, contents);
+	free(sub_path);
+	free(path);
+}
+
+// /proc/stat like a real node's (per-cpu lines and a long intr line after the aggregate)
+static void make_fake_tree(char * tree_dir, int n_cpus, int n_ib_ifs, int n_eth_ifs){
+
+	char * cmd;
+	asprintf(&cmd, "rm -rf %s && mkdir -p %s/proc %s/sys/class/net", tree_dir, tree_dir, tree_dir);
+	if (system(cmd) != 0){
+		fprintf(stderr, "Could not run: %s\n", cmd);
+		exit(1);
+	}
+	free(cmd);
+
+	size_t stat_bytes = (size_t) (n_cpus + 1) * 128 + 8192;
+	char * stat_contents = (char *) malloc(stat_bytes);
+	int len = snprintf(stat_contents, stat_bytes, "cpu  %ld 120 %ld %ld 4000 0 900 0 0 0\n", 1000000L * n_cpus, 300000L * n_cpus, 9000000L * n_cpus);
+	for (int c = 0; c < n_cpus; c++){
+		len += snprintf(stat_contents + len, stat_bytes - len, "cpu%d 1000000 1 300000 9000000 40 0 9 0 0 0\n", c);
+	}
+	len += snprintf(stat_contents + len, stat_bytes - len, "intr 123456789");
+	for (int i = 0; i < 512; i++){
+		len += snprintf(stat_contents + len, stat_bytes - len, " %d", i * 7);
+	}
+	snprintf(stat_contents + len, stat_bytes - len, "\nctxt 987654321\nbtime 1700000000\nprocesses 12345\n");
+	asprintf(&cmd, "%s/proc/stat", tree_dir);
+	write_tree_file(cmd, stat_contents);
+	free(cmd);
+	free(stat_contents);
+	asprintf(&cmd, "%s/proc/meminfo", tree_dir);
+	write_tree_file(cmd, "MemTotal:       527966880 kB\nMemFree:        401234560 kB\nMemAvailable:   498765432 kB\n");
+	free(cmd);
+
+	char if_name[16];
+	for (int i = 0; i < n_ib_ifs; i++){
+		snprintf(if_name, sizeof(if_name), "ib%d", i);
+		// the HCA's port under class/infiniband, reachable from the interface like on a real node
+		make_tree_dir(tree_dir, "sys/class/infiniband/mlx5_%s/ports/1/counters", if_name + 2, NULL);
+		make_tree_dir(tree_dir, "sys/class/infiniband/mlx5_%s/ports/1/hw_counters", if_name + 2, NULL);
+		make_tree_dir(tree_dir, "sys/class/net/%s/device/infiniband", if_name, NULL);
+		asprintf(&cmd, "ln -s %s/sys/class/infiniband/mlx5_%s %s/sys/class/net/%s/device/infiniband/mlx5_%s", tree_dir, if_name + 2, tree_dir, if_name, if_name + 2);
+		if (system(cmd) != 0){
+			fprintf(stderr, "Could not run: %s\n", cmd);
+			exit(1);
+		}
+		free(cmd);
+		make_tree_dir(tree_dir, "sys/class/net/%s/statistics", if_name, NULL);
+		asprintf(&cmd, "%s/sys/class/infiniband/mlx5_%s/ports/1/link_layer", tree_dir, if_name + 2);
+		write_tree_file(cmd, "InfiniBand\n");
+		free(cmd);
+		write_counter(tree_dir, "sys/class/infiniband/mlx5_%s/ports/1/counters/port_rcv_data", if_name + 2, NULL, 1000000000L + i);
+		write_counter(tree_dir, "sys/class/infiniband/mlx5_%s/ports/1/counters/port_xmit_data", if_name + 2, NULL, 2000000000L + i);
+		write_counter(tree_dir, "sys/class/infiniband/mlx5_%s/ports/1/counters/port_rcv_packets", if_name + 2, NULL, 3000000L + i);
+		write_counter(tree_dir, "sys/class/infiniband/mlx5_%s/ports/1/counters/port_xmit_packets", if_name + 2, NULL, 4000000L + i);
+		write_counter(tree_dir, "sys/class/infiniband/mlx5_%s/ports/1/counters/port_xmit_wait", if_name + 2, NULL, 5000L + i);
+		write_counter(tree_dir, "sys/class/infiniband/mlx5_%s/ports/1/counters/port_rcv_errors", if_name + 2, NULL, 0);
+		write_counter(tree_dir, "sys/class/infiniband/mlx5_%s/ports/1/hw_counters/out_of_buffer", if_name + 2, NULL, 7);
+		write_counter(tree_dir, "sys/class/infiniband/mlx5_%s/ports/1/hw_counters/lifespan", if_name + 2, NULL, 12);
+		write_counter(tree_dir, "sys/class/net/%s/statistics/rx_bytes", if_name, NULL, 300000L + i);
+		write_counter(tree_dir, "sys/class/net/%s/statistics/tx_bytes", if_name, NULL, 400000L + i);
+	}
+	for (int i = 0; i < n_eth_ifs; i++){
+		snprintf(if_name, sizeof(if_name), "eno%d", i + 1);
+		make_tree_dir(tree_dir, "sys/class/net/%s/statistics", if_name, NULL);
+		write_counter(tree_dir, "sys/class/net/%s/statistics/rx_bytes", if_name, NULL, 5000000L + i);
+		write_counter(tree_dir, "sys/class/net/%s/statistics/tx_bytes", if_name, NULL, 6000000L + i);
+	}
+}
+
+
+/* OLD COLLECTION */
+
+// the old process_proc_stat, returns total_time
+long legacy_proc_stat(char * tree_dir){
+
+	// same memory queries as process_proc_stat
+	volatile long pages = sysconf(_SC_AVPHYS_PAGES) + sysconf(_SC_PHYS_PAGES) + sysconf(_SC_PAGESIZE);
+	(void) pages;
+
+	char * path;
+	asprintf(&path, "%s/proc/stat", tree_dir);
+	FILE * fp = fopen(path, "r");
+	free(path);
+	if (fp == NULL){
+		return -1;
+	}
+	Cpu_stat cpu_stats;
+	char dummy_name[255];
+	fscanf(fp, "%s %lu %lu %lu %lu %lu %lu %lu", dummy_name, &(cpu_stats.t_user), &(cpu_stats.t_nice),
+		&(cpu_stats.t_system), &(cpu_stats.t_idle), &(cpu_stats.t_iowait), &(cpu_stats.t_irq),
+		&(cpu_stats.t_softirq));
+	fclose(fp);
+	return cpu_stats.t_user + cpu_stats.t_nice + cpu_stats.t_system + cpu_stats.t_idle + cpu_stats.t_iowait + cpu_stats.t_irq + cpu_stats.t_softirq;
+}
+
+static long legacy_read_counter(char * tree_dir, const char * fmt, char * if_name, char * if_port){
+
+	char * if_path;
+	char * full_path;
+	long val = 0;
+	asprintf(&if_path, fmt, if_name, if_port);
+	asprintf(&full_path, "%s/sys/class/net/%s", tree_dir, if_path);
+	FILE * fp = fopen(full_path, "r");
+	if (fp != NULL){
+		fscanf(fp, "%ld", &val);
+		fclose(fp);
+	}
+	free(if_path);
+	free(full_path);
+	return val;
+}
+
+// sum of every counter the old process_net_stat read
+long legacy_net_stat(char * tree_dir, Interface_Totals * interface_totals){
+
+	long total = 0;
+	char ** ib_ifs = interface_totals -> ib_ifs;
+	char ** eth_ifs = interface_totals -> eth_ifs;
+	for (int i = 0; i < interface_totals -> n_ib_ifs; i++){
+		total += 4 * legacy_read_counter(tree_dir, "%s/device/infiniband/mlx5_%s/ports/1/counters/port_rcv_data", ib_ifs[i], ib_ifs[i] + 2);
+		total += 4 * legacy_read_counter(tree_dir, "%s/device/infiniband/mlx5_%s/ports/1/counters/port_xmit_data", ib_ifs[i], ib_ifs[i] + 2);
+		total += legacy_read_counter(tree_dir, "%s/statistics/rx_bytes", ib_ifs[i], NULL);
+		total += legacy_read_counter(tree_dir, "%s/statistics/tx_bytes", ib_ifs[i], NULL);
+	}
+	for (int i = 0; i < interface_totals -> n_eth_ifs; i++){
+		total += legacy_read_counter(tree_dir, "%s/statistics/rx_bytes", eth_ifs[i], NULL);
+		total += legacy_read_counter(tree_dir, "%s/statistics/tx_bytes", eth_ifs[i], NULL);
+	}
+	return total;
+}
+
+
+static long get_minor_faults(){
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_minflt;
+}
+
+int main(int argc, char ** argv){
+
+	char * tree_dir = (argc > 1) ? argv[1] : "/tmp/bench_host_tree";
+	int n_cpus = (argc > 2) ? atoi(argv[2]) : 128;
+	int n_ticks = (argc > 3) ? atoi(argv[3]) : 20000;
+
+	int if_counts[3][2] = {{0, 1}, {2, 2}, {8, 2}};
+	const char * method_names[4] = {"legacy", "pread", "per_cpu", "ports"};
+
+	Proc_Stat_Reader * proc_stat_reader;
+	Proc_Stat_Reader * per_cpu_reader;
+	Mem_Info_Reader * mem_info_reader;
+	unsigned char * core_util = (unsigned char *) malloc((size_t) N_CORE_UTIL_COLUMNS * n_cpus);
+	Interface_Totals * interface_totals;
+	Port_Counters * port_counters;
+	long * port_values;
+	char * sysfs_root;
+	Proc_Data proc_data, prev_data;
+	Net_Data net_data;
+	struct timespec start, end;
+	long ns, faults, legacy_total, pread_total;
+	int n_ib_ifs, n_eth_ifs, n_files;
+
+	printf("method,n_ib_ifs,n_eth_ifs,n_files,ns_per_tick,minor_faults_per_1k_ticks\n");
+
+	for (int f = 0; f < 3; f++){
+
+		n_ib_ifs = if_counts[f][0];
+		n_eth_ifs = if_counts[f][1];
+		n_files = 1 + (N_IB_PORT_COUNTER_FILES + N_IB_COUNTER_FILES) * n_ib_ifs + N_ETH_COUNTER_FILES * n_eth_ifs;
+		make_fake_tree(tree_dir, n_cpus, n_ib_ifs, n_eth_ifs);
+
+		proc_stat_reader = init_proc_stat_reader(tree_dir, 0);
+		per_cpu_reader = init_proc_stat_reader(tree_dir, n_cpus);
+		mem_info_reader = init_mem_info_reader(tree_dir);
+		interface_totals = init_interface_totals(tree_dir, NET_STATS_SYSFS);
+		asprintf(&sysfs_root, "%s/sys", tree_dir);
+		port_counters = init_port_counters(sysfs_root, "default");
+		free(sysfs_root);
+		if ((proc_stat_reader == NULL) || (per_cpu_reader == NULL) || (mem_info_reader == NULL) || (interface_totals == NULL) || (port_counters == NULL) || (core_util == NULL)){
+			exit(1);
+		}
+		// 6 default counters per IB port, rx / tx per interface
+		if (port_counters -> n_series != 6 * n_ib_ifs + N_NET_PORT_COUNTERS * (n_ib_ifs + n_eth_ifs)){
+			fprintf(stderr, "Unexpected number of port series: %d\n", port_counters -> n_series);
+			exit(1);
+		}
+		port_values = (long *) malloc((port_counters -> n_series + 1) * sizeof(long));
+
+		// same totals from both methods (first process_net_stat only records totals)
+		process_net_stat(&net_data, interface_totals);
+		pread_total = interface_totals -> total_ib_rx_bytes + interface_totals -> total_ib_tx_bytes + interface_totals -> total_ib_sys_rx_bytes
+				+ interface_totals -> total_ib_sys_tx_bytes + interface_totals -> total_eth_rx_bytes + interface_totals -> total_eth_tx_bytes;
+		legacy_total = legacy_net_stat(tree_dir, interface_totals);
+		process_proc_stat(proc_stat_reader, &proc_data, NULL);
+		if ((legacy_total != pread_total) || (legacy_proc_stat(tree_dir) != proc_data.total_time)){
+			fprintf(stderr, "Methods disagree: net %ld vs %ld, cpu %ld vs %ld\n", legacy_total, pread_total, legacy_proc_stat(tree_dir), proc_data.total_time);
+			exit(1);
+		}
+
+		for (int m = 0; m < 4; m++){
+			faults = get_minor_faults();
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			for (int t = 0; t < n_ticks; t++){
+				if (m == 0){
+					legacy_proc_stat(tree_dir);
+					legacy_net_stat(tree_dir, interface_totals);
+				}
+				else if (m == 1){
+					prev_data = proc_data;
+					process_proc_stat(proc_stat_reader, &proc_data, &prev_data);
+					process_mem_info(mem_info_reader, &proc_data);
+					process_net_stat(&net_data, interface_totals);
+				}
+				else if (m == 2){
+					prev_data = proc_data;
+					process_proc_stat(per_cpu_reader, &proc_data, &prev_data);
+					process_mem_info(mem_info_reader, &proc_data);
+					process_per_cpu_stat(per_cpu_reader, core_util);
+					process_net_stat(&net_data, interface_totals);
+				}
+				else {
+					prev_data = proc_data;
+					process_proc_stat(proc_stat_reader, &proc_data, &prev_data);
+					process_mem_info(mem_info_reader, &proc_data);
+					process_net_stat(&net_data, interface_totals);
+					process_port_counters(port_counters, port_values);
+				}
+			}
+			clock_gettime(CLOCK_MONOTONIC, &end);
+			ns = elapsed_ns(&start, &end);
+			faults = get_minor_faults() - faults;
+			printf("%s,%d,%d,%d,%.0f,%.2f\n", method_names[m], n_ib_ifs, n_eth_ifs, n_files, (double) ns / n_ticks, 1000.0 * faults / n_ticks);
+		}
+
+		destroy_proc_stat_reader(proc_stat_reader);
+		destroy_proc_stat_reader(per_cpu_reader);
+		destroy_mem_info_reader(mem_info_reader);
+		destroy_interface_totals(interface_totals);
+		destroy_port_counters(port_counters);
+		free(port_values);
+	}
+
+	free(core_util);
+	return 0;
+}
@@ -0,0 +1,181 @@
+#define _GNU_SOURCE
+
+#include "job_stats.h"
+
+#include "monitoring.h"
+#include "host_stats.h"
+#include "job_cgroups.h"
+#include "synthetic_buffer.h"
+
+// Per-job cgroup collection per tick against a fake cgroupfs tree
+//	- n_jobs job_<id> directories with cpu.stat, memory.current, memory.stat and io.stat
+//	  shaped like a real cgroup v2 job's
+//	- checks the deltas and gauges of a job after its counters move, and that jobs created /
+//	  removed between ticks are picked up through the directory mtime
+//	- checks GPU ownership from a fake step process's environment
+//
+// Usage: ./benchJobCgroups [tree_dir] [n_ticks]
+// Output (one line per job count): n_jobs,ns_per_tick
+
+
+static void write_tree_file(char * path, char * contents){
+
+	FILE * fp = fopen(path, "w");
+	if (fp == NULL){
+		fprintf(stderr, "Could not create %s\n", path);
+		exit(1);
+	}
+	fputs(contents, fp);
+	fclose(fp);
+}
+
+static void run_cmd(char * cmd){
+	if (system(cmd) != 0){
+		fprintf(stderr, "Could not run: %s\n", cmd);
+		exit(1);
+	}
+}
+
+// cumulative counters scale with step so a later write moves them by a known amount
+static void write_job(char * tree_dir, long job_id, long step){
+
+	char * dir;
+	char * path;
+	char contents[2048];
+	asprintf(&dir, "%s/%s/job_%ld", tree_dir, JOB_CGROUP_DIR, job_id);
+	asprintf(&path, "mkdir -p %s", dir);
+	run_cmd(path);
+	free(path);
+
+	asprintf(&path, "%s/cpu.stat", dir);
+	snprintf(contents, sizeof(contents), "usage_usec %ld\nuser_usec %ld\nsystem_usec %ld\nnr_periods 0\nnr_throttled 0\nthrottled_usec 0\n", 3000 * step, 2000 * step, 1000 * step);
+	write_tree_file(path, contents);
+	free(path);
+
+	asprintf(&path, "%s/memory.current", dir);
+	snprintf(contents, sizeof(contents), "%ld\n", 1000000 * job_id);
+	write_tree_file(path, contents);
+	free(path);
+
+	asprintf(&path, "%s/memory.stat", dir);
+	snprintf(contents, sizeof(contents), "anon %ld\nfile %ld\nkernel 4096\nkernel_stack 0\nanon_thp 0\nfile_mapped 12\nfile_dirty 0\nshmem 0\n", 600000 * job_id, 400000 * job_id);
+	write_tree_file(path, contents);
+	free(path);
+
+	asprintf(&path, "%s/io.stat", dir);
+	snprintf(contents, sizeof(contents), "8:0 rbytes=%ld wbytes=%ld rios=1 wios=1 dbytes=0 dios=0\n259:0 rbytes=%ld wbytes=%ld rios=1 wios=1 dbytes=0 dios=0\n", 100 * step, 10 * step, 100 * step, 10 * step);
+	write_tree_file(path, contents);
+	free(path);
+	free(dir);
+}
+
+static Job_Sample * find_job(Job_Sample * job_samples, int max_jobs, long job_id){
+	for (int i = 0; i < max_jobs; i++){
+		if (job_samples[i].job_id == job_id){
+			return &(job_samples[i]);
+		}
+	}
+	return NULL;
+}
+
+static void check(bool ok, char * what){
+	if (!ok){
+		fprintf(stderr, "Check failed: %s\n", what);
+		exit(1);
+	}
+}
+
+int main(int argc, char ** argv){
+
+	char * tree_dir = (argc > 1) ? argv[1] : "/tmp/bench_job_tree";
+	int n_ticks = (argc > 2) ? atoi(argv[2]) : 20000;
+
+	char * cmd;
+	int max_jobs = 16;
+	Job_Sample * job_samples = (Job_Sample *) malloc(max_jobs * sizeof(Job_Sample));
+
+	/* CORRECTNESS */
+	asprintf(&cmd, "rm -rf %s", tree_dir);
+	run_cmd(cmd);
+	free(cmd);
+
+	Job_Cgroups * job_cgroups = init_job_cgroups(tree_dir, max_jobs);
+	check(process_job_cgroups(job_cgroups, job_samples) == 0, "no jobs before the jobs directory exists");
+
+	write_job(tree_dir, 101, 1);
+	write_job(tree_dir, 102, 1);
+	check(process_job_cgroups(job_cgroups, job_samples) == 2, "two jobs found");
+	check(find_job(job_samples, max_jobs, 101) -> cpu_usage_usec == 0, "first sample has no cpu delta");
+
+	write_job(tree_dir, 101, 3);
+	process_job_cgroups(job_cgroups, job_samples);
+	Job_Sample * job = find_job(job_samples, max_jobs, 101);
+	check(job -> cpu_usage_usec == 6000, "cpu usage delta");
+	check(job -> cpu_user_usec == 4000, "cpu user delta");
+	check(job -> cpu_system_usec == 2000, "cpu system delta");
+	check(job -> mem_current_bytes == 101000000, "memory.current");
+	check((job -> mem_anon_bytes == 60600000) && (job -> mem_file_bytes == 40400000), "memory.stat anon / file");
+	check((job -> io_read_bytes == 400) && (job -> io_write_bytes == 40), "io.stat deltas summed over devices");
+
+	// mtime granularity of the fake tree's filesystem
+	struct timespec pause = {0, 20000000L};
+	nanosleep(&pause, NULL);
+	asprintf(&cmd, "rm -rf %s/%s/job_102", tree_dir, JOB_CGROUP_DIR);
+	run_cmd(cmd);
+	free(cmd);
+	write_job(tree_dir, 103, 1);
+	check(process_job_cgroups(job_cgroups, job_samples) == 2, "job removed and job added");
+	check((find_job(job_samples, max_jobs, 102) == NULL) && (find_job(job_samples, max_jobs, 103) != NULL), "job ids after the rescan");
+
+	// GPU OWNERSHIP (SLURM_*_GPUS only, CUDA_VISIBLE_DEVICES is renumbered per job)
+	unsigned long gpu_mask = 0;
+	char env[] = "HOME=/home/u\0CUDA_VISIBLE_DEVICES=0,1\0SLURM_JOB_GPUS=1,3\0";
+	check((parse_job_gpu_environ(env, sizeof(env), &gpu_mask) == 0) && (gpu_mask == 0xa), "SLURM_JOB_GPUS over CUDA_VISIBLE_DEVICES");
+	char uuid_env[] = "SLURM_JOB_GPUS=GPU-5f2c,2\0";
+	check((parse_job_gpu_environ(uuid_env, sizeof(uuid_env), &gpu_mask) == 0) && (gpu_mask == 0x4), "UUID entries skipped");
+	char cuda_env[] = "CUDA_VISIBLE_DEVICES=0,1\0";
+	check(parse_job_gpu_environ(cuda_env, sizeof(cuda_env), &gpu_mask) == -1, "CUDA_VISIBLE_DEVICES alone");
+	check(parse_job_gpu_environ(env, 12, &gpu_mask) == -1, "no GPU variables");
+
+	write_job(tree_dir, 104, 1);
+	check(find_job(job_samples, max_jobs, 104) == NULL, "job 104 not seen yet");
+	process_job_cgroups(job_cgroups, job_samples);
+	check(find_job(job_samples, max_jobs, 104) -> gpu_mask == 0, "no GPUs before the job has a process");
+	asprintf(&cmd, "mkdir -p %s/%s/job_104/step_0/user/task_0 %s/proc/4241 %s/proc/4242 && printf '4241\\n4242\\n' > %s/%s/job_104/step_0/user/task_0/cgroup.procs"
+			" && printf 'HOME=/home/u\\0' > %s/proc/4241/environ", tree_dir, JOB_CGROUP_DIR, tree_dir, tree_dir, tree_dir, JOB_CGROUP_DIR, tree_dir);
+	run_cmd(cmd);
+	free(cmd);
+	process_job_cgroups(job_cgroups, job_samples);
+	check(find_job(job_samples, max_jobs, 104) -> gpu_mask == 0, "no GPUs while no process has the variables");
+	asprintf(&cmd, "printf 'SLURM_STEP_GPUS=4,5\\0' > %s/proc/4242/environ", tree_dir);
+	run_cmd(cmd);
+	free(cmd);
+	process_job_cgroups(job_cgroups, job_samples);
+	check(find_job(job_samples, max_jobs, 104) -> gpu_mask == 0x30, "GPUs from a later step process");
+	destroy_job_cgroups(job_cgroups);
+
+	/* COST PER TICK */
+	int job_counts[3] = {1, 4, 16};
+	struct timespec start, end;
+	printf("n_jobs,ns_per_tick\n");
+	for (int c = 0; c < 3; c++){
+		asprintf(&cmd, "rm -rf %s", tree_dir);
+		run_cmd(cmd);
+		free(cmd);
+		for (int j = 0; j < job_counts[c]; j++){
+			write_job(tree_dir, 1000 + j, 1);
+		}
+		job_cgroups = init_job_cgroups(tree_dir, max_jobs);
+		process_job_cgroups(job_cgroups, job_samples);
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (int t = 0; t < n_ticks; t++){
+			process_job_cgroups(job_cgroups, job_samples);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		printf("%d,%.0f\n", job_counts[c], (double) elapsed_ns(&start, &end) / n_ticks);
+		destroy_job_cgroups(job_cgroups);
+	}
+
+	free(job_samples);
+	return 0;
+}
@@ -0,0 +1,132 @@
+#define _GNU_SOURCE
+
+#include <dirent.h>
+
+#include "job_stats.h"
+
+#include "monitoring.h"
+#include "host_stats.h"
+#include "net_link.h"
+#include "synthetic_buffer.h"
+
+// Interface byte counters per tick on this host, every interface in /sys/class/net
+//	- sysfs: <if>/statistics/{rx,tx}_bytes opened once and re-read with pread (host_stats.c)
+//	- netlink: one RTM_GETLINK dump (net_link.c)
+// Both have to agree on every interface's counters (read back to back, so an interface with
+// traffic can be slightly ahead in the second read).
+//
+// Then a veth pair is created and deleted (ip link, needs CAP_NET_ADMIN, skipped otherwise)
+// and the netlink reader has to pick up both links and drop them again.
+//
+// Usage: ./benchNetLink [n_ticks]
+// Output: method,n_links,ns_per_tick, then veth,<links before>,<with pair>,<after delete>
+
+#define BENCH_VETH "bench_veth0"
+#define BENCH_VETH_PEER "bench_veth1"
+
+static long total_sysfs(int * fds, int n_fds){
+
+	long total = 0;
+	long val;
+	for (int i = 0; i < n_fds; i++){
+		if ((fds[i] != -1) && (read_counter_value(fds[i], &val) == 0)){
+			total += val;
+		}
+	}
+	return total;
+}
+
+static long total_netlink(Net_Link_Reader * net_link_reader){
+
+	long total = 0;
+	for (int i = 0; i < net_link_reader -> n_links; i++){
+		total += net_link_reader -> links[i].stats.rx_bytes + net_link_reader -> links[i].stats.tx_bytes;
+	}
+	return total;
+}
+
+static int count_veth_links(Net_Link_Reader * net_link_reader){
+
+	int n_found = 0;
+	for (int i = 0; i < net_link_reader -> n_links; i++){
+		n_found += (strcmp(net_link_reader -> links[i].name, BENCH_VETH) == 0) || (strcmp(net_link_reader -> links[i].name, BENCH_VETH_PEER) == 0);
+	}
+	return n_found;
+}
+
+int main(int argc, char ** argv){
+
+	int n_ticks = (argc > 1) ? atoi(argv[1]) : 20000;
+
+	Net_Link_Reader * net_link_reader = init_net_link_reader();
+	if ((net_link_reader == NULL) || (refresh_net_links(net_link_reader) == -1)){
+		exit(1);
+	}
+
+	// every statistics file, same interfaces as the dump
+	int n_links = net_link_reader -> n_links;
+	int * fds = (int *) malloc(2 * n_links * sizeof(int));
+	char * path;
+	for (int i = 0; i < n_links; i++){
+		asprintf(&path, "/sys/class/net/%s/statistics/rx_bytes", net_link_reader -> links[i].name);
+		fds[2 * i] = open_counter_file(path);
+		free(path);
+		asprintf(&path, "/sys/class/net/%s/statistics/tx_bytes", net_link_reader -> links[i].name);
+		fds[2 * i + 1] = open_counter_file(path);
+		free(path);
+	}
+
+	long sysfs_total = total_sysfs(fds, 2 * n_links);
+	refresh_net_links(net_link_reader);
+	long netlink_total = total_netlink(net_link_reader);
+	if (netlink_total < sysfs_total){
+		fprintf(stderr, "Methods disagree: sysfs %ld vs netlink %ld\n", sysfs_total, netlink_total);
+		exit(1);
+	}
+
+	printf("method,n_links,ns_per_tick\n");
+
+	struct timespec start, end;
+	Net_Data net_data;
+	for (int m = 0; m < 2; m++){
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (int t = 0; t < n_ticks; t++){
+			if (m == 0){
+				total_sysfs(fds, 2 * n_links);
+			}
+			else {
+				process_net_link(net_link_reader, &net_data);
+			}
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		printf("%s,%d,%.0f\n", (m == 0) ? "sysfs" : "netlink", n_links, (double) elapsed_ns(&start, &end) / n_ticks);
+	}
+
+	// INTERFACES APPEARING / DISAPPEARING
+	if (system("ip link add " BENCH_VETH " type veth peer name " BENCH_VETH_PEER " 2>/dev/null") != 0){
+		printf("veth,skipped (ip link add failed)\n");
+	}
+	else {
+		refresh_net_links(net_link_reader);
+		int n_with_pair = net_link_reader -> n_links;
+		int n_found = count_veth_links(net_link_reader);
+		if (system("ip link del " BENCH_VETH) != 0){
+			fprintf(stderr, "Could not delete " BENCH_VETH "\n");
+		}
+		refresh_net_links(net_link_reader);
+		printf("veth,%d,%d,%d\n", n_links, n_with_pair, net_link_reader -> n_links);
+		if ((n_found != 2) || (count_veth_links(net_link_reader) != 0) || (net_link_reader -> n_links != n_links)){
+			fprintf(stderr, "veth pair not picked up / dropped (found %d)\n", n_found);
+			exit(1);
+		}
+	}
+
+	for (int i = 0; i < 2 * n_links; i++){
+		if (fds[i] != -1){
+			close(fds[i]);
+		}
+	}
+	free(fds);
+	destroy_net_link_reader(net_link_reader);
+	return 0;
+}
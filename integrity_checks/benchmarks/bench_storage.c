@@ -0,0 +1,157 @@
+#define _GNU_SOURCE
+
+#include "job_stats.h"
+
+#include "monitoring.h"
+#include "storage.h"
+#include "synthetic_buffer.h"
+
+// Rows/s of dumping one synthetic Samples_Buffer to a fresh db:
+//	- legacy: asprintf + sqlite3_exec per value (the original insert_sample_to_db)
+//	- prepared: Storage layer (prepared multi-row inserts)
+//	- wide: Storage layer in wide mode (one row per sample + one per GPU)
+//
+// Usage: ./benchStorage [db_path] [n_samples] [n_devices] [n_fields] [n_repeats]
+// Output (one line per run): method,n_rows,elapsed_ns,rows_per_sec,db_bytes
+
+
+/* LEGACY PATH: one formatted statement per value */
+
+void legacy_insert_sample_to_db(sqlite3 * db, long timestamp_ms, long device_id, long field_id, long value){
+
+	char * insert_statement;
+
+	asprintf(&insert_statement, "INSERT INTO Data (timestamp,device_id,field_id,value) VALUES (%ld, %ld, %ld, %ld);", timestamp_ms, device_id, field_id, value);
+
+	char *sqlErr;
+
+	int sql_ret = sqlite3_exec(db, insert_statement, NULL, NULL, &sqlErr);
+
+	free(insert_statement);
+
+	if (sql_ret != SQLITE_OK){
+		fprintf(stderr, "SQL error: %s\n", sqlErr);
+		sqlite3_free(sqlErr);
+	}
+}
+
+void legacy_dump_samples_buffer(Samples_Buffer * samples_buffer, sqlite3 * db){
+
+	int n_fields = samples_buffer -> n_fields;
+	int n_devices = samples_buffer -> n_devices;
+	unsigned short * field_ids = samples_buffer -> field_ids;
+	unsigned short * field_types = samples_buffer -> field_types;
+
+	long time_ns, val;
+	int ind;
+
+	sqlite3_exec(db, "BEGIN", 0, 0, 0);
+
+	for (int i = 0; i < samples_buffer -> n_samples; i++){
+		Proc_Data * cpu_util = &(samples_buffer -> cpu_util[i]);
+		Net_Data * net_util = &(samples_buffer -> net_util[i]);
+		time_ns = samples_buffer -> times[i].tv_sec * 1e9 + samples_buffer -> times[i].tv_nsec;
+
+		legacy_insert_sample_to_db(db, time_ns, -1, 1, round(cpu_util -> mem_used_pct));
+		legacy_insert_sample_to_db(db, time_ns, -1, 2, cpu_util -> free_mem);
+		legacy_insert_sample_to_db(db, time_ns, -1, 3, round(cpu_util -> util_pct));
+		legacy_insert_sample_to_db(db, time_ns, -1, 10, net_util -> ib_rx_bytes);
+		legacy_insert_sample_to_db(db, time_ns, -1, 11, net_util -> ib_tx_bytes);
+		legacy_insert_sample_to_db(db, time_ns, -1, 12, net_util -> ib_sys_rx_bytes);
+		legacy_insert_sample_to_db(db, time_ns, -1, 13, net_util -> ib_sys_tx_bytes);
+		legacy_insert_sample_to_db(db, time_ns, -1, 14, net_util -> eth_rx_bytes);
+		legacy_insert_sample_to_db(db, time_ns, -1, 15, net_util -> eth_tx_bytes);
+
+		for (int gpuId = 0; gpuId < n_devices; gpuId++){
+			for (int fieldNum = 0; fieldNum < n_fields; fieldNum++){
+				ind = gpuId * n_fields + fieldNum;
+				if (field_types[fieldNum] == GPU_FT_DOUBLE){
+					val = (long) round(((double *) FIELD_COLUMN(samples_buffer, ind))[i] * 100);
+				}
+				else {
+					val = ((long *) FIELD_COLUMN(samples_buffer, ind))[i];
+				}
+				legacy_insert_sample_to_db(db, time_ns, gpuId, field_ids[fieldNum], val);
+			}
+		}
+	}
+
+	sqlite3_exec(db, "COMMIT", 0, 0, 0);
+}
+
+
+sqlite3 * open_fresh_db(char * db_path, Storage_Mode storage_mode, Samples_Buffer * samples_buffer){
+
+	remove(db_path);
+
+	sqlite3 * db;
+	if (sqlite3_open(db_path, &db) != SQLITE_OK){
+		fprintf(stderr, "Could not open db at: %s\n", db_path);
+		exit(1);
+	}
+
+	const char * create_tables = "CREATE TABLE Ticks (timestamp INT, n_ticks INT, n_missed INT, mean_jitter_ns INT, max_jitter_ns INT, mean_latency_ns INT, max_latency_ns INT);"
+					"CREATE TABLE Tick_Latency (timestamp INT, histogram_id INT, bucket_upper_us INT, count INT);";
+	if (sqlite3_exec(db, create_tables, NULL, NULL, NULL) != SQLITE_OK){
+		fprintf(stderr, "Could not create tables: %s\n", sqlite3_errmsg(db));
+		exit(1);
+	}
+	if (create_storage_tables(db, storage_mode, samples_buffer -> n_fields, samples_buffer -> field_ids) == -1){
+		exit(1);
+	}
+	return db;
+}
+
+int main(int argc, char ** argv){
+
+	char * db_path = (argc > 1) ? argv[1] : "/tmp/bench_storage.db";
+	int n_samples = (argc > 2) ? atoi(argv[2]) : 3000;
+	int n_devices = (argc > 3) ? atoi(argv[3]) : 8;
+	int n_fields = (argc > 4) ? atoi(argv[4]) : 10;
+	int n_repeats = (argc > 5) ? atoi(argv[5]) : 3;
+
+	// 9 host metrics + every (device, field) per sample
+	long n_rows = (long) n_samples * (9 + n_devices * n_fields);
+
+	Samples_Buffer * samples_buffer = init_synthetic_buffer(n_samples, n_devices, n_fields);
+
+	struct timespec start, end;
+	long ns;
+	sqlite3 * db;
+
+	// rows/s is always in terms of values (EAV rows) so the methods are comparable
+	printf("method,n_rows,elapsed_ns,rows_per_sec,db_bytes\n");
+
+	for (int r = 0; r < n_repeats; r++){
+
+		fill_synthetic_buffer(samples_buffer, PATTERN_STEADY);
+		db = open_fresh_db(db_path, STORAGE_EAV, samples_buffer);
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		legacy_dump_samples_buffer(samples_buffer, db);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		sqlite3_close(db);
+		ns = elapsed_ns(&start, &end);
+		printf("legacy,%ld,%ld,%.0f,%ld\n", n_rows, ns, n_rows / (ns / 1e9), file_size(db_path));
+
+		for (int m = 0; m < 2; m++){
+			Storage_Mode storage_mode = (m == 0) ? STORAGE_EAV : STORAGE_WIDE;
+			fill_synthetic_buffer(samples_buffer, PATTERN_STEADY);
+			db = open_fresh_db(db_path, storage_mode, samples_buffer);
+			Storage * storage = init_storage(db, storage_mode, STORAGE_BATCH_ROWS, n_fields, samples_buffer -> field_ids);
+			if (storage == NULL){
+				exit(1);
+			}
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			dump_samples_buffer(samples_buffer, storage);
+			clock_gettime(CLOCK_MONOTONIC, &end);
+			destroy_storage(storage);
+			sqlite3_close(db);
+			ns = elapsed_ns(&start, &end);
+			printf("%s,%ld,%ld,%.0f,%ld\n", (m == 0) ? "prepared" : "wide", n_rows, ns, n_rows / (ns / 1e9), file_size(db_path));
+		}
+	}
+
+	remove(db_path);
+
+	return 0;
+}
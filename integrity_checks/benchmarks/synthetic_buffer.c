@@ -0,0 +1,123 @@
+#define _GNU_SOURCE
+
+#include "job_stats.h"
+
+#include "monitoring.h"
+#include "samples_arena.h"
+#include "synthetic_buffer.h"
+
+
+long elapsed_ns(struct timespec * start, struct timespec * end){
+	return ((end -> tv_sec - start -> tv_sec) * 1000000000L) + (end -> tv_nsec - start -> tv_nsec);
+}
+
+long file_size(char * path){
+	struct stat st;
+	if (stat(path, &st) != 0){
+		return -1;
+	}
+	return st.st_size;
+}
+
+Samples_Buffer * init_synthetic_buffer(int n_samples, int n_devices, int n_fields){
+
+	Samples_Buffer * samples_buffer = (Samples_Buffer *) calloc(1, sizeof(Samples_Buffer));
+	unsigned short * field_ids = (unsigned short *) malloc(n_fields * sizeof(unsigned short));
+	unsigned short * field_types = (unsigned short *) malloc(n_fields * sizeof(unsigned short));
+	if ((samples_buffer == NULL) || (field_ids == NULL) || (field_types == NULL)){
+		fprintf(stderr, "Could not allocate synthetic buffer\n");
+		exit(1);
+	}
+
+	// half utilization ratios (doubles), half byte counters (int64), like the default field list
+	for (int i = 0; i < n_fields; i++){
+		field_ids[i] = 1000 + i;
+		field_types[i] = (i % 2 == 0) ? GPU_FT_DOUBLE : GPU_FT_INT64;
+	}
+
+	samples_buffer -> n_devices = n_devices;
+	samples_buffer -> n_fields = n_fields;
+	samples_buffer -> field_ids = field_ids;
+	samples_buffer -> field_types = field_types;
+	samples_buffer -> max_samples = n_samples;
+	if (alloc_samples_arena(samples_buffer) == -1){
+		exit(1);
+	}
+
+	return samples_buffer;
+}
+
+void fill_synthetic_buffer(Samples_Buffer * samples_buffer, Synthetic_Pattern pattern){
+
+	int n_samples = samples_buffer -> max_samples;
+	int n_devices = samples_buffer -> n_devices;
+	int n_fields = samples_buffer -> n_fields;
+
+	struct timespec time;
+	clock_gettime(CLOCK_REALTIME, &time);
+
+	srand(time.tv_sec);
+
+	Proc_Data * cpu_util;
+	Net_Data * net_util;
+	void * field_column;
+
+	for (int i = 0; i < n_samples; i++){
+		samples_buffer -> times[i].tv_sec = time.tv_sec + i / 10;
+		samples_buffer -> times[i].tv_nsec = (i % 10) * 100000000L;
+		samples_buffer -> periods_ms[i] = 100;
+
+		cpu_util = &(samples_buffer -> cpu_util[i]);
+		net_util = &(samples_buffer -> net_util[i]);
+		switch (pattern){
+			case PATTERN_IDLE:
+				cpu_util -> mem_used_pct = 12.5;
+				cpu_util -> free_mem = 500000000;
+				cpu_util -> util_pct = 0;
+				memset(net_util, 0, sizeof(Net_Data));
+				break;
+			case PATTERN_STEADY:
+				cpu_util -> mem_used_pct = 40 + (i % 7);
+				cpu_util -> free_mem = 200000 + i;
+				cpu_util -> util_pct = i % 100;
+				net_util -> ib_rx_bytes = 1000 * i;
+				net_util -> ib_tx_bytes = 1000 * i;
+				net_util -> ib_sys_rx_bytes = 10 * i;
+				net_util -> ib_sys_tx_bytes = 10 * i;
+				net_util -> eth_rx_bytes = i;
+				net_util -> eth_tx_bytes = i;
+				break;
+			case PATTERN_NOISY:
+				cpu_util -> mem_used_pct = 100.0 * rand() / RAND_MAX;
+				cpu_util -> free_mem = rand();
+				cpu_util -> util_pct = 100.0 * rand() / RAND_MAX;
+				net_util -> ib_rx_bytes = rand();
+				net_util -> ib_tx_bytes = rand();
+				net_util -> ib_sys_rx_bytes = rand();
+				net_util -> ib_sys_tx_bytes = rand();
+				net_util -> eth_rx_bytes = rand();
+				net_util -> eth_tx_bytes = rand();
+				break;
+		}
+
+		for (int j = 0; j < n_devices * n_fields; j++){
+			field_column = FIELD_COLUMN(samples_buffer, j);
+			if (samples_buffer -> field_types[j % n_fields] == GPU_FT_DOUBLE){
+				switch (pattern){
+					case PATTERN_IDLE: ((double *) field_column)[i] = 0; break;
+					case PATTERN_STEADY: ((double *) field_column)[i] = (double) ((i + j) % 100) / 100; break;
+					case PATTERN_NOISY: ((double *) field_column)[i] = (double) rand() / RAND_MAX; break;
+				}
+			}
+			else {
+				switch (pattern){
+					case PATTERN_IDLE: ((long *) field_column)[i] = 0; break;
+					case PATTERN_STEADY: ((long *) field_column)[i] = (long) i * j; break;
+					case PATTERN_NOISY: ((long *) field_column)[i] = rand(); break;
+				}
+			}
+		}
+	}
+
+	samples_buffer -> n_samples = n_samples;
+}
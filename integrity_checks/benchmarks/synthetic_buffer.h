@@ -0,0 +1,22 @@
+#ifndef SYNTHETIC_BUFFER_H
+#define SYNTHETIC_BUFFER_H
+
+// Synthetic Samples_Buffer shared by the benchmarks (100ms period, default-like field list)
+
+typedef enum synthetic_pattern {
+	// nothing running: constant GPU values, no network traffic
+	PATTERN_IDLE,
+	// slowly varying values and counters
+	PATTERN_STEADY,
+	// every value random each sample (worst case for compression)
+	PATTERN_NOISY
+} Synthetic_Pattern;
+
+long elapsed_ns(struct timespec * start, struct timespec * end);
+long file_size(char * path);
+
+Samples_Buffer * init_synthetic_buffer(int n_samples, int n_devices, int n_fields);
+// refilled before every run because a dump resets the buffer
+void fill_synthetic_buffer(Samples_Buffer * samples_buffer, Synthetic_Pattern pattern);
+
+#endif
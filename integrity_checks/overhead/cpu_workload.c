@@ -0,0 +1,185 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/syscall.h>
+
+// Calibrated CPU-only workloads for the overhead benchmark (see run_cpu_overhead.sh)
+//	- cpu: dependent integer / floating point chain, stays in registers
+//	- membw: stream triad over arrays much larger than the last level cache
+//	- syscall: getppid + a pread of /proc/self/stat per iteration (kernel entry / exit and procfs,
+//	  the paths the monitor's own reads go through)
+//
+// Usage:
+//	./cpuWorkload <cpu|membw|syscall> calibrate <target_millis>
+//		prints the iteration count that takes about target_millis
+//	./cpuWorkload <cpu|membw|syscall> <iterations> <out_csv>
+//		runs once and appends a row in the shape of raw_dummy_compute.csv:
+//		elapsed_ns,timestamp_start,timestamp_stop,hostname,num_cpus,iterations
+
+// 3 arrays of 32 MB
+#define MEMBW_N_DOUBLES (4 * 1024 * 1024)
+
+static double * membw_a;
+static double * membw_b;
+static double * membw_c;
+static int proc_fd = -1;
+
+// keeps the results alive so the loops aren't optimized away
+static volatile double sink;
+
+static void run_cpu(long iterations){
+	uint64_t x = 88172645463325252ULL;
+	double acc = 1.0;
+	for (long i = 0; i < iterations; i++){
+		x ^= x << 13;
+		x ^= x >> 7;
+		x ^= x << 17;
+		acc = acc * 0.999999 + (double) (x & 0xffff) * 1e-9;
+	}
+	sink = acc + (double) x;
+}
+
+// one iteration is one pass of the triad
+static void run_membw(long iterations){
+	double * tmp;
+	for (long i = 0; i < iterations; i++){
+		for (long j = 0; j < MEMBW_N_DOUBLES; j++){
+			membw_a[j] = membw_b[j] + 3.0 * membw_c[j];
+		}
+		// pass i reads what pass i - 1 wrote
+		tmp = membw_a;
+		membw_a = membw_b;
+		membw_b = tmp;
+	}
+	sink = membw_a[MEMBW_N_DOUBLES / 2];
+}
+
+static void run_syscall(long iterations){
+	char buf[512];
+	long total = 0;
+	for (long i = 0; i < iterations; i++){
+		total += syscall(SYS_getppid);
+		total += pread(proc_fd, buf, sizeof(buf), 0);
+	}
+	sink = (double) total;
+}
+
+static long now_ns(int clock_id){
+	struct timespec now;
+	clock_gettime(clock_id, &now);
+	return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+static long run_workload(char * workload, long iterations){
+
+	long start_ns = now_ns(CLOCK_MONOTONIC);
+	if (strcmp(workload, "cpu") == 0){
+		run_cpu(iterations);
+	}
+	else if (strcmp(workload, "membw") == 0){
+		run_membw(iterations);
+	}
+	else {
+		run_syscall(iterations);
+	}
+	return now_ns(CLOCK_MONOTONIC) - start_ns;
+}
+
+// doubles the iteration count until a run takes at least a tenth of the target, scales it to
+// the target and corrects once more with a run of the scaled count
+static long calibrate(char * workload, long target_ms){
+
+	double target_ns = target_ms * 1000000.0;
+	long iterations = 1;
+	long elapsed_ns = run_workload(workload, iterations);
+	while (elapsed_ns < target_ns / 10){
+		iterations *= 2;
+		elapsed_ns = run_workload(workload, iterations);
+	}
+	iterations = (long) ((double) iterations * target_ns / elapsed_ns) + 1;
+	elapsed_ns = run_workload(workload, iterations);
+	return (long) ((double) iterations * target_ns / elapsed_ns) + 1;
+}
+
+int main(int argc, char ** argv){
+
+	if (argc < 4){
+		fprintf(stderr, "Usage: ./cpuWorkload <cpu|membw|syscall> calibrate <target_millis> || ./cpuWorkload <cpu|membw|syscall> <iterations> <out_csv>\n");
+		exit(1);
+	}
+
+	char * workload = argv[1];
+	if ((strcmp(workload, "cpu") != 0) && (strcmp(workload, "membw") != 0) && (strcmp(workload, "syscall") != 0)){
+		fprintf(stderr, "Unknown workload: %s (cpu, membw or syscall)\n", workload);
+		exit(1);
+	}
+
+	if (strcmp(workload, "membw") == 0){
+		membw_a = (double *) malloc(MEMBW_N_DOUBLES * sizeof(double));
+		membw_b = (double *) malloc(MEMBW_N_DOUBLES * sizeof(double));
+		membw_c = (double *) malloc(MEMBW_N_DOUBLES * sizeof(double));
+		if ((membw_a == NULL) || (membw_b == NULL) || (membw_c == NULL)){
+			fprintf(stderr, "Could not allocate memory for membw arrays\n");
+			exit(1);
+		}
+		// touch every page before timing
+		for (long j = 0; j < MEMBW_N_DOUBLES; j++){
+			membw_a[j] = 0;
+			membw_b[j] = 1;
+			membw_c[j] = 2;
+		}
+	}
+	else if (strcmp(workload, "syscall") == 0){
+		proc_fd = open("/proc/self/stat", O_RDONLY);
+		if (proc_fd == -1){
+			fprintf(stderr, "Could not open /proc/self/stat\n");
+			exit(1);
+		}
+	}
+
+	if (strcmp(argv[2], "calibrate") == 0){
+		printf("%ld\n", calibrate(workload, atol(argv[3])));
+		return 0;
+	}
+
+	long iterations = atol(argv[2]);
+	if (iterations <= 0){
+		fprintf(stderr, "Iterations must be positive\n");
+		exit(1);
+	}
+
+	char hostbuffer[256];
+	if (gethostname(hostbuffer, sizeof(hostbuffer)) == -1){
+		fprintf(stderr, "Could not get hostname, exiting...\n");
+		exit(1);
+	}
+
+	// cpus this run may use (taskset / cgroup), the num_cpus column
+	cpu_set_t cpu_set;
+	int num_cpus = 0;
+	if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) == 0){
+		num_cpus = CPU_COUNT(&cpu_set);
+	}
+
+	FILE * out_file = fopen(argv[3], "a");
+	if (out_file == NULL){
+		fprintf(stderr, "Could not open %s\n", argv[3]);
+		exit(1);
+	}
+
+	long timestamp_start = now_ns(CLOCK_REALTIME);
+	long elapsed = run_workload(workload, iterations);
+	long timestamp_stop = now_ns(CLOCK_REALTIME);
+
+	fprintf(out_file, "%ld,%ld,%ld,%s,%d,%ld\n", elapsed, timestamp_start, timestamp_stop, hostbuffer, num_cpus, iterations);
+	fclose(out_file);
+
+	return 0;
+}
@@ -0,0 +1,129 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Slowdown of the runs with the monitor against the runs without it
+//	- reads the elapsed_ns column (first) of two files in the raw_dummy_compute.csv shape,
+//	  with iterations only the rows of that calibration (last column)
+//	- slowdown = mean(with) / mean(raw) - 1, 95% confidence interval from the delta method
+//	  on the ratio of means with Welch's degrees of freedom
+//
+// Usage: ./overheadSummary <raw_csv> <with_monitoring_csv> [max_slowdown_pct] [iterations]
+//	prints n_raw,n_monitor,mean_raw_ns,mean_monitor_ns,slowdown_pct,ci_low_pct,ci_high_pct
+//	exits 2 if the whole interval is above max_slowdown_pct (a regression)
+
+#define MAX_RUNS 100000
+
+// two sided 95% quantiles of Student's t for 1..30 degrees of freedom
+static const double t_975[30] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+					2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+					2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+
+static double get_t_975(double df){
+	if (df < 1){
+		return t_975[0];
+	}
+	if (df <= 30){
+		return t_975[(int) df - 1];
+	}
+	// within 0.01 of the exact value past 30
+	return 1.960 + 2.4 / df;
+}
+
+// elapsed_ns of every row (with iterations > 0 only the rows that ran that many), returns the number of rows or -1
+static int read_elapsed(char * path, long iterations, double * elapsed){
+
+	FILE * fp = fopen(path, "r");
+	if (fp == NULL){
+		fprintf(stderr, "Could not open %s\n", path);
+		return -1;
+	}
+	char line[1024];
+	char * last_column;
+	int n = 0;
+	while ((n < MAX_RUNS) && (fgets(line, sizeof(line), fp) != NULL)){
+		if ((line[0] < '0') || (line[0] > '9')){
+			continue;
+		}
+		last_column = strrchr(line, ',');
+		if ((iterations > 0) && ((last_column == NULL) || (atol(last_column + 1) != iterations))){
+			continue;
+		}
+		elapsed[n] = atof(line);
+		n++;
+	}
+	fclose(fp);
+	return n;
+}
+
+static void get_mean_var(double * vals, int n, double * mean, double * var){
+	double sum = 0;
+	for (int i = 0; i < n; i++){
+		sum += vals[i];
+	}
+	*mean = sum / n;
+	double sq = 0;
+	for (int i = 0; i < n; i++){
+		sq += (vals[i] - *mean) * (vals[i] - *mean);
+	}
+	*var = (n > 1) ? sq / (n - 1) : 0;
+}
+
+int main(int argc, char ** argv){
+
+	if (argc < 3){
+		fprintf(stderr, "Usage: ./overheadSummary <raw_csv> <with_monitoring_csv> [max_slowdown_pct] [iterations]\n");
+		exit(1);
+	}
+
+	double * raw = (double *) malloc(MAX_RUNS * sizeof(double));
+	double * mon = (double *) malloc(MAX_RUNS * sizeof(double));
+	if ((raw == NULL) || (mon == NULL)){
+		fprintf(stderr, "Could not allocate memory for runs\n");
+		exit(1);
+	}
+
+	long iterations = (argc > 4) ? atol(argv[4]) : 0;
+	int n_raw = read_elapsed(argv[1], iterations, raw);
+	int n_mon = read_elapsed(argv[2], iterations, mon);
+	if ((n_raw < 2) || (n_mon < 2)){
+		fprintf(stderr, "Need at least 2 runs in each file (%d raw, %d with monitoring)\n", n_raw, n_mon);
+		exit(1);
+	}
+
+	double mean_raw, var_raw, mean_mon, var_mon;
+	get_mean_var(raw, n_raw, &mean_raw, &var_raw);
+	get_mean_var(mon, n_mon, &mean_mon, &var_mon);
+
+	// var(mon / raw) ~ ratio^2 * (se_mon^2 / mean_mon^2 + se_raw^2 / mean_raw^2)
+	double ratio = mean_mon / mean_raw;
+	double se2_raw = var_raw / n_raw;
+	double se2_mon = var_mon / n_mon;
+	double rel_var = se2_mon / (mean_mon * mean_mon) + se2_raw / (mean_raw * mean_raw);
+	double se_ratio = ratio * sqrt(rel_var);
+
+	double df = 1;
+	double denom = (se2_raw * se2_raw) / (n_raw - 1) + (se2_mon * se2_mon) / (n_mon - 1);
+	if (denom > 0){
+		df = ((se2_raw + se2_mon) * (se2_raw + se2_mon)) / denom;
+	}
+	double t = get_t_975(df);
+
+	double slowdown_pct = 100 * (ratio - 1);
+	double ci_low_pct = 100 * (ratio - t * se_ratio - 1);
+	double ci_high_pct = 100 * (ratio + t * se_ratio - 1);
+
+	printf("%d,%d,%.0f,%.0f,%.3f,%.3f,%.3f\n", n_raw, n_mon, mean_raw, mean_mon, slowdown_pct, ci_low_pct, ci_high_pct);
+
+	free(raw);
+	free(mon);
+
+	if ((argc > 3) && (ci_low_pct > atof(argv[3]))){
+		fprintf(stderr, "Slowdown of %.3f%% (95%% CI %.3f%% .. %.3f%%) is over the budget of %s%%\n", slowdown_pct, ci_low_pct, ci_high_pct, argv[3]);
+		return 2;
+	}
+	return 0;
+}
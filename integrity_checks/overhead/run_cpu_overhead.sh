@@ -0,0 +1,90 @@
+#!/bin/bash
+
+## CPU-only overhead of the monitor (no GPU needed, the monitor runs on the synthetic backend)
+##	- every workload is calibrated once to TARGET_MS, then each repetition runs it without the
+##	  monitor and with the monitor at every sample rate (interleaved, so drift hits all alike)
+##	- runs go to results/raw_<workload>.csv and results/with_monitoring_<workload>_<millis>ms.csv
+##	  (same shape as raw_dummy_compute.csv), both are emptied first so the summary only sees
+##	  this invocation's calibration
+##	- results/summary.csv: workload,sample_millis + the overheadSummary columns
+##	- exits non-zero if a slowdown's whole 95% interval is above MAX_SLOWDOWN_PCT
+##
+## pass number of repetitions as argument! (default 10)
+## env: RATES (sample millis, default "1000 100 10"), WORKLOADS (default "cpu membw syscall"),
+##	TARGET_MS (default 2000), MAX_SLOWDOWN_PCT (default 5), PIN_CPUS (taskset cpu list for
+##	both the workload and the monitor, unset = no pinning), MONITOR (default ../../monitor),
+##	MONITOR_ARGS (extra monitor options, e.g. "-m columnar -c")
+
+NUM_REPEAT=${1:-10}
+RATES=${RATES:-"1000 100 10"}
+WORKLOADS=${WORKLOADS:-"cpu membw syscall"}
+TARGET_MS=${TARGET_MS:-2000}
+MAX_SLOWDOWN_PCT=${MAX_SLOWDOWN_PCT:-5}
+MONITOR=${MONITOR:-../../monitor}
+RESULTS_DIR=results
+# lets the monitor get through startup before a run is timed
+WARMUP_SECS=1
+
+if [ ! -x "$MONITOR" ]; then
+	echo "No monitor at $MONITOR (build it with make WITH_DCGM=0 monitor at the top of the repo)"
+	exit 1
+fi
+
+PIN=""
+if [ -n "$PIN_CPUS" ]; then
+	PIN="taskset -c $PIN_CPUS"
+fi
+
+mkdir -p $RESULTS_DIR
+MONITOR_OUT=$(mktemp -d)
+trap 'rm -rf "${MONITOR_OUT:?}"' EXIT
+
+declare -A ITERATIONS
+for workload in $WORKLOADS
+do
+	ITERATIONS[$workload]=$($PIN ./cpuWorkload $workload calibrate $TARGET_MS)
+	echo "Calibrated $workload: ${ITERATIONS[$workload]} iterations for ${TARGET_MS} ms"
+	rm -f "${RESULTS_DIR:?}/raw_${workload}.csv"
+	for rate in $RATES
+	do
+		rm -f "${RESULTS_DIR:?}/with_monitoring_${workload}_${rate}ms.csv"
+	done
+done
+
+for (( i=0; i < $NUM_REPEAT; i++))
+do
+	echo "Launching repetition: $i"
+	for workload in $WORKLOADS
+	do
+		$PIN ./cpuWorkload $workload ${ITERATIONS[$workload]} $RESULTS_DIR/raw_${workload}.csv
+
+		for rate in $RATES
+		do
+			# fresh db / ring every run, so no run pays for recovering the previous one
+			rm -rf "${MONITOR_OUT:?}"/*
+			$PIN $MONITOR -g synthetic:n_devices=4,pattern=noisy -s $rate -o $MONITOR_OUT $MONITOR_ARGS > /dev/null 2>&1 &
+			MONITOR_PID=$!
+			sleep $WARMUP_SECS
+			$PIN ./cpuWorkload $workload ${ITERATIONS[$workload]} $RESULTS_DIR/with_monitoring_${workload}_${rate}ms.csv
+			kill $MONITOR_PID
+			wait $MONITOR_PID 2> /dev/null
+		done
+	done
+done
+
+STATUS=0
+echo "workload,sample_millis,n_raw,n_monitor,mean_raw_ns,mean_monitor_ns,slowdown_pct,ci_low_pct,ci_high_pct" > $RESULTS_DIR/summary.csv
+for workload in $WORKLOADS
+do
+	for rate in $RATES
+	do
+		SUMMARY=$(./overheadSummary $RESULTS_DIR/raw_${workload}.csv $RESULTS_DIR/with_monitoring_${workload}_${rate}ms.csv $MAX_SLOWDOWN_PCT ${ITERATIONS[$workload]})
+		if [ $? -ne 0 ]; then
+			STATUS=2
+		fi
+		echo "$workload,$rate,$SUMMARY" >> $RESULTS_DIR/summary.csv
+	done
+done
+
+cat $RESULTS_DIR/summary.csv
+exit $STATUS
@@ -0,0 +1,428 @@
+#define _GNU_SOURCE
+
+#include "job_stats.h"
+
+#include "monitoring.h"
+#include "host_stats.h"
+#include "job_cgroups.h"
+#include "file_trace.h"
+
+
+static const char * job_cgroup_files[N_JOB_CGROUP_FILES] = {"cpu.stat", "memory.current", "memory.stat", "io.stat"};
+
+
+/* DISCOVERY */
+
+Job_Cgroups * init_job_cgroups(char * root_dir, int max_jobs){
+
+	Job_Cgroups * job_cgroups = (Job_Cgroups *) calloc(1, sizeof(Job_Cgroups));
+	if (job_cgroups == NULL){
+		fprintf(stderr, "Could not allocate memory for job cgroups\n");
+		return NULL;
+	}
+
+	job_cgroups -> root_dir = strdup(root_dir);
+	asprintf(&(job_cgroups -> jobs_dir), "%s/%s", root_dir, JOB_CGROUP_DIR);
+	job_cgroups -> max_jobs = max_jobs;
+	job_cgroups -> jobs = (Job_Cgroup *) calloc(max_jobs, sizeof(Job_Cgroup));
+	job_cgroups -> environ_buf = (char *) malloc(JOB_ENVIRON_READ_BYTES);
+	if ((job_cgroups -> jobs == NULL) || (job_cgroups -> environ_buf == NULL)){
+		fprintf(stderr, "Could not allocate memory for job cgroups\n");
+		destroy_job_cgroups(job_cgroups);
+		return NULL;
+	}
+	job_cgroups -> rescan = true;
+
+	return job_cgroups;
+}
+
+static void close_job_cgroup(Job_Cgroup * job){
+	for (int f = 0; f < N_JOB_CGROUP_FILES; f++){
+		if (job -> fds[f] != -1){
+			close_trace_file(job -> fds[f]);
+		}
+	}
+}
+
+void destroy_job_cgroups(Job_Cgroups * job_cgroups){
+	for (int i = 0; i < job_cgroups -> n_jobs; i++){
+		close_job_cgroup(&(job_cgroups -> jobs[i]));
+	}
+	free(job_cgroups -> jobs);
+	free(job_cgroups -> environ_buf);
+	free(job_cgroups -> root_dir);
+	free(job_cgroups -> jobs_dir);
+	free(job_cgroups);
+}
+
+// missing files are normal (controller not delegated, job just ended), no message
+static void open_job_cgroup(Job_Cgroups * job_cgroups, Job_Cgroup * job, char * dir_name, long job_id){
+
+	char * path;
+	memset(job, 0, sizeof(Job_Cgroup));
+	job -> job_id = job_id;
+	job -> present = true;
+	for (int f = 0; f < N_JOB_CGROUP_FILES; f++){
+		asprintf(&path, "%s/%s/%s", job_cgroups -> jobs_dir, dir_name, job_cgroup_files[f]);
+		job -> fds[f] = open_trace_file(path);
+		free(path);
+	}
+}
+
+// adds the job_* directories that are new, drops the ones that are gone
+static void scan_job_cgroups(Job_Cgroups * job_cgroups){
+
+	Job_Cgroup * jobs = job_cgroups -> jobs;
+	for (int i = 0; i < job_cgroups -> n_jobs; i++){
+		jobs[i].present = false;
+	}
+
+	DIR * dr = open_trace_dir(job_cgroups -> jobs_dir);
+	if (dr != NULL){
+		struct dirent * entry;
+		char * id_end;
+		long job_id;
+		int i;
+		while ((entry = readdir(dr)) != NULL){
+			if (strncmp(entry -> d_name, "job_", 4) != 0){
+				continue;
+			}
+			job_id = strtol(entry -> d_name + 4, &id_end, 10);
+			if ((job_id <= 0) || (*id_end != '\0')){
+				continue;
+			}
+			for (i = 0; i < job_cgroups -> n_jobs; i++){
+				if (jobs[i].job_id == job_id){
+					jobs[i].present = true;
+					break;
+				}
+			}
+			if (i < job_cgroups -> n_jobs){
+				continue;
+			}
+			if (job_cgroups -> n_jobs == job_cgroups -> max_jobs){
+				if (!job_cgroups -> warned_full){
+					fprintf(stderr, "More than %d job cgroups, skipping job %ld (raise --max_jobs)\n", job_cgroups -> max_jobs, job_id);
+					job_cgroups -> warned_full = true;
+				}
+				continue;
+			}
+			open_job_cgroup(job_cgroups, &(jobs[job_cgroups -> n_jobs]), entry -> d_name, job_id);
+			job_cgroups -> n_jobs++;
+		}
+		closedir(dr);
+	}
+
+	// compact, slots don't have to keep their position (every sample stores the job id)
+	int n_kept = 0;
+	for (int i = 0; i < job_cgroups -> n_jobs; i++){
+		if (!jobs[i].present){
+			close_job_cgroup(&(jobs[i]));
+			continue;
+		}
+		jobs[n_kept] = jobs[i];
+		n_kept++;
+	}
+	job_cgroups -> n_jobs = n_kept;
+}
+
+// true if the jobs directory changed since the last scan (created, removed or a job added / removed)
+static bool jobs_dir_changed(Job_Cgroups * job_cgroups){
+
+	struct stat dir_stat;
+	struct timespec mtime = {0, 0};
+	if (stat(job_cgroups -> jobs_dir, &dir_stat) == 0){
+		mtime = dir_stat.st_mtim;
+	}
+	if ((mtime.tv_sec == job_cgroups -> dir_mtime.tv_sec) && (mtime.tv_nsec == job_cgroups -> dir_mtime.tv_nsec)){
+		return false;
+	}
+	job_cgroups -> dir_mtime = mtime;
+	return true;
+}
+
+
+/* GPU OWNERSHIP */
+
+// bits for a "0,1,3" list, entries that aren't GPU indices are skipped
+static unsigned long parse_gpu_list(char * list, char * end){
+
+	unsigned long mask = 0;
+	unsigned long gpu;
+	char * pos = list;
+	char * entry_end;
+	while (pos < end){
+		entry_end = memchr(pos, ',', end - pos);
+		if (entry_end == NULL){
+			entry_end = end;
+		}
+		if ((*pos >= '0') && (*pos <= '9') && (scan_next_ulong(&pos, entry_end, &gpu) == 0) && (pos == entry_end) && (gpu < MAX_JOB_GPUS)){
+			mask |= 1UL << gpu;
+		}
+		pos = entry_end + 1;
+	}
+	return mask;
+}
+
+int parse_job_gpu_environ(char * env, int env_bytes, unsigned long * gpu_mask){
+
+	// most specific first, both are global indices
+	const char * gpu_vars[2] = {"SLURM_STEP_GPUS=", "SLURM_JOB_GPUS="};
+	char * found[2] = {NULL, NULL};
+	char * found_end[2] = {NULL, NULL};
+
+	char * end = env + env_bytes;
+	char * var = env;
+	char * var_end;
+	size_t name_len;
+	while (var < end){
+		var_end = memchr(var, '\0', end - var);
+		if (var_end == NULL){
+			var_end = end;
+		}
+		for (int v = 0; v < 2; v++){
+			name_len = strlen(gpu_vars[v]);
+			if (((size_t) (var_end - var) >= name_len) && (strncmp(var, gpu_vars[v], name_len) == 0)){
+				found[v] = var + name_len;
+				found_end[v] = var_end;
+			}
+		}
+		var = var_end + 1;
+	}
+
+	for (int v = 0; v < 2; v++){
+		if (found[v] != NULL){
+			*gpu_mask = parse_gpu_list(found[v], found_end[v]);
+			return 0;
+		}
+	}
+	return -1;
+}
+
+// GPU mask from <root_dir>/proc/<pid>/environ, -1 if the process is gone (or unreadable) or has no GPU variables
+static int read_job_gpu_environ(Job_Cgroups * job_cgroups, long pid, unsigned long * gpu_mask){
+
+	char * path;
+	asprintf(&path, "%s/proc/%ld/environ", job_cgroups -> root_dir, pid);
+	int fd = open_trace_file(path);
+	free(path);
+	if (fd == -1){
+		return -1;
+	}
+	ssize_t n_read = read_trace_file(fd, job_cgroups -> environ_buf, JOB_ENVIRON_READ_BYTES);
+	close_trace_file(fd);
+	if (n_read <= 0){
+		return -1;
+	}
+
+	return parse_job_gpu_environ(job_cgroups -> environ_buf, (int) n_read, gpu_mask);
+}
+
+// tries the pids of every cgroup.procs at or below dir until one's environment names the job's GPUs
+//	- skips *n_skip pids, then reads at most *n_left environs
+//	- 0 once found, -1 otherwise
+static int find_job_gpus(Job_Cgroups * job_cgroups, char * dir, int depth, int * n_skip, int * n_left, unsigned long * gpu_mask){
+
+	char * path;
+	char buf[JOB_PROCS_READ_BYTES];
+
+	asprintf(&path, "%s/cgroup.procs", dir);
+	int fd = open_trace_file(path);
+	free(path);
+	if (fd != -1){
+		int n_read = read_counter_file(fd, buf, sizeof(buf));
+		close_trace_file(fd);
+		// a truncated last pid isn't one of the job's
+		char * end = (n_read > 0) ? memrchr(buf, '\n', n_read) : NULL;
+		char * pos = buf;
+		unsigned long pid;
+		while ((end != NULL) && (*n_left > 0) && (scan_next_ulong(&pos, end, &pid) == 0)){
+			if (*n_skip > 0){
+				(*n_skip)--;
+				continue;
+			}
+			(*n_left)--;
+			if (read_job_gpu_environ(job_cgroups, (long) pid, gpu_mask) == 0){
+				return 0;
+			}
+		}
+	}
+	if ((depth == JOB_CGROUP_MAX_DEPTH) || (*n_left == 0)){
+		return -1;
+	}
+
+	DIR * dr = open_trace_dir(dir);
+	if (dr == NULL){
+		return -1;
+	}
+	int ret = -1;
+	struct dirent * entry;
+	while ((ret == -1) && (*n_left > 0) && ((entry = readdir(dr)) != NULL)){
+		if (((entry -> d_type != DT_DIR) && (entry -> d_type != DT_UNKNOWN)) || (entry -> d_name[0] == '.')){
+			continue;
+		}
+		asprintf(&path, "%s/%s", dir, entry -> d_name);
+		ret = find_job_gpus(job_cgroups, path, depth + 1, n_skip, n_left, gpu_mask);
+		free(path);
+	}
+	closedir(dr);
+	return ret;
+}
+
+static void resolve_job_gpus(Job_Cgroups * job_cgroups, Job_Cgroup * job){
+
+	char * path;
+	asprintf(&path, "%s/job_%ld", job_cgroups -> jobs_dir, job -> job_id);
+	int n_skip = job -> gpu_pid_offset;
+	int n_left = JOB_GPU_PIDS_PER_TRY;
+	int ret = find_job_gpus(job_cgroups, path, 0, &n_skip, &n_left, &(job -> gpu_mask));
+	free(path);
+	if (ret == 0){
+		job -> gpus_resolved = true;
+		return;
+	}
+	job -> gpu_mask = 0;
+
+	// the next try continues after the pids read now, or starts over once every pid was read
+	job -> gpu_pid_offset = (n_left == 0) ? job -> gpu_pid_offset + JOB_GPU_PIDS_PER_TRY : 0;
+
+	// stop paying for the directory walk
+	job -> gpu_resolve_tries++;
+	if (job -> gpu_resolve_tries == JOB_GPU_RESOLVE_TRIES){
+		job -> gpus_resolved = true;
+	}
+}
+
+
+/* READERS */
+
+// value of the "key value" line in [buf, end), -1 if there isn't one
+static int find_keyed_value(char * buf, char * end, const char * key, long * value){
+
+	size_t key_len = strlen(key);
+	char * line = buf;
+	char * line_end;
+	unsigned long val;
+	while (line < end){
+		line_end = memchr(line, '\n', end - line);
+		if (line_end == NULL){
+			line_end = end;
+		}
+		if ((line_end - line > (long) key_len) && (strncmp(line, key, key_len) == 0) && (line[key_len] == ' ')){
+			line += key_len;
+			if (scan_next_ulong(&line, line_end, &val) == -1){
+				return -1;
+			}
+			*value = (long) val;
+			return 0;
+		}
+		line = line_end + 1;
+	}
+	return -1;
+}
+
+// sum of every key=<value> in io.stat (one line per device)
+static long sum_io_stat(char * buf, char * end, const char * key){
+
+	size_t key_len = strlen(key);
+	long total = 0;
+	unsigned long val;
+	char * pos = buf;
+	while ((pos = strstr(pos, key)) != NULL){
+		pos += key_len;
+		if (scan_next_ulong(&pos, end, &val) == 0){
+			total += (long) val;
+		}
+	}
+	return total;
+}
+
+// -1 if the job's cgroup is gone
+static int read_job_cgroup(Job_Cgroups * job_cgroups, Job_Cgroup * job, Job_Sample * job_sample){
+
+	char * buf = job_cgroups -> buf;
+	int n_read;
+	long cpu_usage_usec = 0;
+	long cpu_user_usec = 0;
+	long cpu_system_usec = 0;
+	long io_read_bytes = 0;
+	long io_write_bytes = 0;
+
+	memset(job_sample, 0, sizeof(Job_Sample));
+	job_sample -> job_id = job -> job_id;
+
+	if (!job -> gpus_resolved){
+		resolve_job_gpus(job_cgroups, job);
+	}
+	job_sample -> gpu_mask = job -> gpu_mask;
+
+	if (job -> fds[JOB_CPU_STAT] != -1){
+		n_read = read_counter_file(job -> fds[JOB_CPU_STAT], buf, JOB_CGROUP_READ_BYTES);
+		// a removed cgroup's open files fail to read (ENODEV)
+		if (n_read <= 0){
+			return -1;
+		}
+		find_keyed_value(buf, buf + n_read, "usage_usec", &cpu_usage_usec);
+		find_keyed_value(buf, buf + n_read, "user_usec", &cpu_user_usec);
+		find_keyed_value(buf, buf + n_read, "system_usec", &cpu_system_usec);
+	}
+
+	if (job -> fds[JOB_MEMORY_CURRENT] != -1){
+		read_counter_value(job -> fds[JOB_MEMORY_CURRENT], &(job_sample -> mem_current_bytes));
+	}
+
+	if (job -> fds[JOB_MEMORY_STAT] != -1){
+		n_read = read_counter_file(job -> fds[JOB_MEMORY_STAT], buf, JOB_CGROUP_READ_BYTES);
+		if (n_read > 0){
+			find_keyed_value(buf, buf + n_read, "anon", &(job_sample -> mem_anon_bytes));
+			find_keyed_value(buf, buf + n_read, "file", &(job_sample -> mem_file_bytes));
+		}
+	}
+
+	if (job -> fds[JOB_IO_STAT] != -1){
+		n_read = read_counter_file(job -> fds[JOB_IO_STAT], buf, JOB_CGROUP_READ_BYTES);
+		if (n_read > 0){
+			io_read_bytes = sum_io_stat(buf, buf + n_read, "rbytes=");
+			io_write_bytes = sum_io_stat(buf, buf + n_read, "wbytes=");
+		}
+	}
+
+	// the job's first sample has nothing to take a difference against
+	if (job -> has_prev){
+		job_sample -> cpu_usage_usec = cpu_usage_usec - job -> prev_cpu_usage_usec;
+		job_sample -> cpu_user_usec = cpu_user_usec - job -> prev_cpu_user_usec;
+		job_sample -> cpu_system_usec = cpu_system_usec - job -> prev_cpu_system_usec;
+		job_sample -> io_read_bytes = io_read_bytes - job -> prev_io_read_bytes;
+		job_sample -> io_write_bytes = io_write_bytes - job -> prev_io_write_bytes;
+	}
+
+	job -> prev_cpu_usage_usec = cpu_usage_usec;
+	job -> prev_cpu_user_usec = cpu_user_usec;
+	job -> prev_cpu_system_usec = cpu_system_usec;
+	job -> prev_io_read_bytes = io_read_bytes;
+	job -> prev_io_write_bytes = io_write_bytes;
+	job -> has_prev = true;
+	return 0;
+}
+
+int process_job_cgroups(Job_Cgroups * job_cgroups, Job_Sample * job_samples){
+
+	if (jobs_dir_changed(job_cgroups) || job_cgroups -> rescan){
+		scan_job_cgroups(job_cgroups);
+		job_cgroups -> rescan = false;
+	}
+
+	int n_filled = 0;
+	for (int i = 0; i < job_cgroups -> n_jobs; i++){
+		if (read_job_cgroup(job_cgroups, &(job_cgroups -> jobs[i]), &(job_samples[n_filled])) == -1){
+			// gone before the directory scan noticed, drop it next tick
+			job_cgroups -> rescan = true;
+			continue;
+		}
+		n_filled++;
+	}
+
+	// slots past the jobs stay empty (job_id 0)
+	memset(&(job_samples[n_filled]), 0, (job_cgroups -> max_jobs - n_filled) * sizeof(Job_Sample));
+	return n_filled;
+}
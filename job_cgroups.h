@@ -0,0 +1,95 @@
+#ifndef JOB_CGROUPS_H
+#define JOB_CGROUPS_H
+
+// LIVE PER-JOB RESOURCES (cgroup v2)
+//	- slurmstepd puts every job in <root_dir>/sys/fs/cgroup/system.slice/slurmstepd.scope/job_<id>
+//	- the directory is only rescanned when its mtime changes (a job cgroup was created or
+//	  removed) or a job's files stop reading, every known job keeps its files open and they
+//	  are re-read with pread each tick (like host_stats.h)
+//	- root_dir is "" on a real node, a fake cgroupfs tree for testing
+//
+// GPU OWNERSHIP
+//	- resolved once per job from the environment of its processes (the pids in every
+//	  cgroup.procs under the job's cgroup, <root_dir>/proc/<pid>/environ): SLURM_STEP_GPUS,
+//	  then SLURM_JOB_GPUS (global indices), non-numeric entries (GPU UUIDs) are skipped
+//	- CUDA_VISIBLE_DEVICES is never used, under ConstrainDevices it counts from 0 in every job
+//	- processes without the variables (the step_extern sleep, rewritten environments) don't
+//	  resolve the job, JOB_GPU_PIDS_PER_TRY more pids are tried every tick, after
+//	  JOB_GPU_RESOLVE_TRIES ticks without a match the job owns no GPUs
+//	- every sample carries the mask, storage turns it into (job_id, gpu_id, start_ns, end_ns)
+
+#define JOB_CGROUP_DIR "sys/fs/cgroup/system.slice/slurmstepd.scope"
+
+// enough for memory.stat and an io.stat with a few dozen devices
+#define JOB_CGROUP_READ_BYTES 8192
+
+// files per job (order of Job_Cgroup -> fds), -1 if the controller isn't enabled for the job
+#define N_JOB_CGROUP_FILES 4
+#define JOB_CPU_STAT 0
+#define JOB_MEMORY_CURRENT 1
+#define JOB_MEMORY_STAT 2
+#define JOB_IO_STAT 3
+
+// /proc/<pid>/environ of a job step (module environments get large)
+#define JOB_ENVIRON_READ_BYTES 65536
+
+// job_X/step_Y/user/task_Z
+#define JOB_CGROUP_MAX_DEPTH 4
+
+// ticks to look for a job process before treating the job as owning no GPUs
+#define JOB_GPU_RESOLVE_TRIES 100
+
+// environs read per tick while a job isn't resolved
+#define JOB_GPU_PIDS_PER_TRY 16
+
+// cgroup.procs of one step, pids past it are not tried
+#define JOB_PROCS_READ_BYTES 4096
+
+typedef struct job_cgroup {
+	long job_id;
+	int fds[N_JOB_CGROUP_FILES];
+	// found by the last scan
+	bool present;
+	// GPU ownership (see above)
+	bool gpus_resolved;
+	int gpu_resolve_tries;
+	// pids the next try skips (the ones earlier tries read)
+	int gpu_pid_offset;
+	unsigned long gpu_mask;
+	// cumulative values of the previous sample (cpu and io are stored as deltas)
+	bool has_prev;
+	long prev_cpu_usage_usec;
+	long prev_cpu_user_usec;
+	long prev_cpu_system_usec;
+	long prev_io_read_bytes;
+	long prev_io_write_bytes;
+} Job_Cgroup;
+
+typedef struct job_cgroups {
+	char * root_dir;
+	char * jobs_dir;
+	int max_jobs;
+	int n_jobs;
+	// [max_jobs], the first n_jobs are in use
+	Job_Cgroup * jobs;
+	// mtime of jobs_dir at the last scan (0 if it didn't exist)
+	struct timespec dir_mtime;
+	bool rescan;
+	// more jobs than slots, warn once
+	bool warned_full;
+	char buf[JOB_CGROUP_READ_BYTES];
+	char * environ_buf;
+} Job_Cgroups;
+
+
+// the jobs directory doesn't have to exist yet (created with the node's first job), NULL on allocation failure
+Job_Cgroups * init_job_cgroups(char * root_dir, int max_jobs);
+void destroy_job_cgroups(Job_Cgroups * job_cgroups);
+
+// fills the max_jobs slots at job_samples (the current sample's in the arena), returns the number of jobs
+int process_job_cgroups(Job_Cgroups * job_cgroups, Job_Sample * job_samples);
+
+// GPU mask from a NUL separated environment (environ format), -1 if none of the variables are set
+int parse_job_gpu_environ(char * env, int env_bytes, unsigned long * gpu_mask);
+
+#endif
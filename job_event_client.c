@@ -0,0 +1,64 @@
+#define _GNU_SOURCE
+
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "job_stats.h"
+
+#include "job_events.h"
+
+// Sends a job start / end event to the monitor's socket (see job_events.h), meant to be run
+// from the Slurm prolog / epilog, which set the SLURM_* variables below.
+//	- never fails the prolog / epilog: if the monitor isn't listening the event is dropped
+//	  (the next sacct reconciliation picks the job up)
+//
+// Usage: monitorJobEvent <start|end> <socket_path>
+
+
+// (event key, environment variable)
+static const char * event_vars[][2] = {
+	{"job_id", "SLURM_JOB_ID"},
+	{"user", "SLURM_JOB_USER"},
+	{"group", "SLURM_JOB_GROUP"},
+	{"node_list", "SLURM_JOB_NODELIST"},
+	{"gpus", "SLURM_JOB_GPUS"},
+	{"state", "SLURM_JOB_STATE"},
+	{"exit_code", "SLURM_JOB_EXIT_CODE2"}
+};
+
+#define N_EVENT_VARS (sizeof(event_vars) / sizeof(event_vars[0]))
+
+int main(int argc, char ** argv){
+
+	if ((argc != 3) || ((strcmp(argv[1], "start") != 0) && (strcmp(argv[1], "end") != 0))){
+		fprintf(stderr, "Usage: monitorJobEvent <start|end> <socket_path>\n");
+		return 0;
+	}
+
+	char msg[JOB_EVENT_MAX_BYTES];
+	int len = snprintf(msg, sizeof(msg), "event=%s\n", argv[1]);
+	char * value;
+	for (size_t i = 0; i < N_EVENT_VARS; i++){
+		value = getenv(event_vars[i][1]);
+		if ((value != NULL) && (len < (int) sizeof(msg))){
+			len += snprintf(msg + len, sizeof(msg) - len, "%s=%s\n", event_vars[i][0], value);
+		}
+	}
+	if (len >= (int) sizeof(msg)){
+		len = sizeof(msg) - 1;
+	}
+
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, argv[2], sizeof(addr.sun_path) - 1);
+
+	int fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+	if ((fd == -1) || (sendto(fd, msg, len, 0, (struct sockaddr *) &addr, sizeof(addr)) == -1)){
+		fprintf(stderr, "Could not send job event to %s: %s\n", argv[2], strerror(errno));
+	}
+	if (fd != -1){
+		close(fd);
+	}
+	return 0;
+}
@@ -0,0 +1,250 @@
+#define _GNU_SOURCE
+
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "job_stats.h"
+
+#include "monitoring.h"
+#include "storage.h"
+#include "writer.h"
+#include "job_events.h"
+
+
+// same layout as sacct's Start / End columns
+#define JOB_TIME_FORMAT "%Y-%m-%dT%H:%M:%S"
+
+// one parsed event on its way to the writer thread
+typedef struct job_event {
+	Job_Event_Listener * job_event_listener;
+	bool is_start;
+	long job_id;
+	// NULL if missing, point into msg
+	char * user_name;
+	char * group_name;
+	char * node_list;
+	char * state;
+	char * exit_code;
+	// -1 if the event had no gpus
+	int n_gpus;
+	// when the monitor received it
+	char event_time[20];
+	// copy of the datagram, split into lines in place
+	char msg[];
+} Job_Event;
+
+static sqlite3_stmt * prepare_job_statement(sqlite3 * db, const char * sql){
+
+	sqlite3_stmt * stmt;
+	if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK){
+		fprintf(stderr, "SQL error preparing job event statement: %s\n", sqlite3_errmsg(db));
+		return NULL;
+	}
+	return stmt;
+}
+
+Job_Event_Listener * init_job_event_listener(char * socket_path, sqlite3 * db){
+
+	struct sockaddr_un addr;
+	if (strlen(socket_path) >= sizeof(addr.sun_path)){
+		fprintf(stderr, "Job event socket path too long: %s\n", socket_path);
+		return NULL;
+	}
+
+	Job_Event_Listener * job_event_listener = (Job_Event_Listener *) calloc(1, sizeof(Job_Event_Listener));
+	if (job_event_listener == NULL){
+		fprintf(stderr, "Could not allocate memory for job event listener\n");
+		return NULL;
+	}
+	job_event_listener -> socket_path = strdup(socket_path);
+	job_event_listener -> db = db;
+
+	job_event_listener -> fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (job_event_listener -> fd == -1){
+		fprintf(stderr, "Could not create job event socket: %s\n", strerror(errno));
+		destroy_job_event_listener(job_event_listener);
+		return NULL;
+	}
+
+	// left behind by a killed run
+	unlink(socket_path);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, socket_path);
+	if (bind(job_event_listener -> fd, (struct sockaddr *) &addr, sizeof(addr)) == -1){
+		fprintf(stderr, "Could not bind job event socket %s: %s\n", socket_path, strerror(errno));
+		destroy_job_event_listener(job_event_listener);
+		return NULL;
+	}
+	// root (the prolog / epilog) and the monitor's user
+	chmod(socket_path, 0600);
+
+	job_event_listener -> upsert_start = prepare_job_statement(db, "INSERT INTO Jobs (job_id, user_name, group_name, n_gpus, node_list, start_time, state) VALUES (?,?,?,?,?,?,'RUNNING') "
+							"ON CONFLICT(job_id) DO UPDATE SET user_name = COALESCE(excluded.user_name, user_name), group_name = COALESCE(excluded.group_name, group_name), "
+							"n_gpus = COALESCE(excluded.n_gpus, n_gpus), node_list = COALESCE(excluded.node_list, node_list), start_time = excluded.start_time, state = excluded.state "
+							"WHERE end_time IS NULL;");
+	job_event_listener -> upsert_end = prepare_job_statement(db, "INSERT INTO Jobs (job_id, end_time, state, exit_code) VALUES (?,?,?,?) "
+							"ON CONFLICT(job_id) DO UPDATE SET end_time = excluded.end_time, state = excluded.state, exit_code = COALESCE(excluded.exit_code, exit_code);");
+	if ((job_event_listener -> upsert_start == NULL) || (job_event_listener -> upsert_end == NULL)){
+		destroy_job_event_listener(job_event_listener);
+		return NULL;
+	}
+
+	return job_event_listener;
+}
+
+void destroy_job_event_listener(Job_Event_Listener * job_event_listener){
+	if (job_event_listener -> fd > 0){
+		close(job_event_listener -> fd);
+		unlink(job_event_listener -> socket_path);
+	}
+	// finalize on NULL is a no-op
+	sqlite3_finalize(job_event_listener -> upsert_start);
+	sqlite3_finalize(job_event_listener -> upsert_end);
+	free(job_event_listener -> socket_path);
+	free(job_event_listener);
+}
+
+// value of key in the event's "key=value" lines (NUL terminated in place), NULL if missing or empty
+static char * get_event_value(char ** lines, int n_lines, const char * key){
+
+	size_t key_len = strlen(key);
+	for (int i = 0; i < n_lines; i++){
+		if ((strncmp(lines[i], key, key_len) == 0) && (lines[i][key_len] == '=') && (lines[i][key_len + 1] != '\0')){
+			return lines[i] + key_len + 1;
+		}
+	}
+	return NULL;
+}
+
+// text or NULL (leaves the column as it was on conflict)
+static void bind_event_text(sqlite3_stmt * stmt, int index, char * value){
+	if (value == NULL){
+		sqlite3_bind_null(stmt, index);
+		return;
+	}
+	sqlite3_bind_text(stmt, index, value, -1, SQLITE_STATIC);
+}
+
+// NULL if the event is missing its type or job id
+static Job_Event * parse_job_event(Job_Event_Listener * job_event_listener, char * buf, size_t n_bytes){
+
+	Job_Event * job_event = (Job_Event *) malloc(sizeof(Job_Event) + n_bytes + 1);
+	if (job_event == NULL){
+		fprintf(stderr, "Could not allocate memory for job event\n");
+		return NULL;
+	}
+	memcpy(job_event -> msg, buf, n_bytes + 1);
+
+	// split into lines in place
+	char * lines[32];
+	int n_lines = 0;
+	char * saveptr;
+	char * line = strtok_r(job_event -> msg, "\n", &saveptr);
+	while ((line != NULL) && (n_lines < 32)){
+		lines[n_lines] = line;
+		n_lines++;
+		line = strtok_r(NULL, "\n", &saveptr);
+	}
+
+	char * event = get_event_value(lines, n_lines, "event");
+	char * job_id_str = get_event_value(lines, n_lines, "job_id");
+	job_event -> job_id = (job_id_str != NULL) ? atol(job_id_str) : 0;
+	if ((event == NULL) || (job_event -> job_id <= 0) || ((strcmp(event, "start") != 0) && (strcmp(event, "end") != 0))){
+		free(job_event);
+		return NULL;
+	}
+
+	job_event -> job_event_listener = job_event_listener;
+	job_event -> is_start = (strcmp(event, "start") == 0);
+	job_event -> user_name = get_event_value(lines, n_lines, "user");
+	job_event -> group_name = get_event_value(lines, n_lines, "group");
+	job_event -> node_list = get_event_value(lines, n_lines, "node_list");
+	job_event -> state = get_event_value(lines, n_lines, "state");
+	job_event -> exit_code = get_event_value(lines, n_lines, "exit_code");
+	job_event -> n_gpus = -1;
+	char * gpus = get_event_value(lines, n_lines, "gpus");
+	if (gpus != NULL){
+		job_event -> n_gpus = 1;
+		for (char * c = gpus; *c != '\0'; c++){
+			job_event -> n_gpus += (*c == ',');
+		}
+	}
+
+	time_t now = time(NULL);
+	struct tm now_tm;
+	strftime(job_event -> event_time, sizeof(job_event -> event_time), JOB_TIME_FORMAT, localtime_r(&now, &now_tm));
+
+	return job_event;
+}
+
+// WRITER TASK: upserts one Job_Event into Jobs and frees it
+static int write_job_event(void * arg){
+
+	Job_Event * job_event = (Job_Event *) arg;
+	Job_Event_Listener * job_event_listener = job_event -> job_event_listener;
+
+	sqlite3_stmt * stmt;
+	if (job_event -> is_start){
+		stmt = job_event_listener -> upsert_start;
+		sqlite3_bind_int64(stmt, 1, job_event -> job_id);
+		bind_event_text(stmt, 2, job_event -> user_name);
+		bind_event_text(stmt, 3, job_event -> group_name);
+		if (job_event -> n_gpus != -1){
+			sqlite3_bind_int(stmt, 4, job_event -> n_gpus);
+		}
+		else {
+			sqlite3_bind_null(stmt, 4);
+		}
+		bind_event_text(stmt, 5, job_event -> node_list);
+		sqlite3_bind_text(stmt, 6, job_event -> event_time, -1, SQLITE_STATIC);
+	}
+	else {
+		stmt = job_event_listener -> upsert_end;
+		sqlite3_bind_int64(stmt, 1, job_event -> job_id);
+		sqlite3_bind_text(stmt, 2, job_event -> event_time, -1, SQLITE_STATIC);
+		// the epilog doesn't know how the job ended, sacct fills in the final state later
+		sqlite3_bind_text(stmt, 3, (job_event -> state != NULL) ? job_event -> state : "ENDED", -1, SQLITE_STATIC);
+		bind_event_text(stmt, 4, job_event -> exit_code);
+	}
+
+	int sql_ret = sqlite3_step(stmt);
+	sqlite3_reset(stmt);
+	sqlite3_clear_bindings(stmt);
+	free(job_event);
+	if (sql_ret != SQLITE_DONE){
+		fprintf(stderr, "SQL error writing job event: %s\n", sqlite3_errmsg(job_event_listener -> db));
+		return -1;
+	}
+	return 0;
+}
+
+int process_job_events(Job_Event_Listener * job_event_listener, Buffer_Writer * writer){
+
+	Job_Event * job_event;
+	int n_queued = 0;
+	ssize_t n_read;
+	for (int i = 0; i < JOB_EVENT_MAX_PER_TICK; i++){
+		n_read = recv(job_event_listener -> fd, job_event_listener -> buf, JOB_EVENT_MAX_BYTES, MSG_DONTWAIT);
+		// EAGAIN: nothing (left) to read
+		if (n_read < 0){
+			break;
+		}
+		job_event_listener -> buf[n_read] = '\0';
+		job_event = parse_job_event(job_event_listener, job_event_listener -> buf, n_read);
+		if (job_event == NULL){
+			job_event_listener -> n_bad_events++;
+			continue;
+		}
+		// the next sacct run picks the job up
+		if (queue_writer_task(writer, &write_job_event, (void *) job_event) == -1){
+			free(job_event);
+			job_event_listener -> n_dropped_events++;
+			continue;
+		}
+		job_event_listener -> n_events++;
+		n_queued++;
+	}
+	return n_queued;
+}
@@ -0,0 +1,52 @@
+#ifndef JOB_EVENTS_H
+#define JOB_EVENTS_H
+
+// LIVE JOB START / END EVENTS (-e, --job_socket=<path>)
+//
+// The Slurm prolog / epilog run monitorJobEvent (job_event_client.c), which sends one datagram
+// per event to a local Unix socket. The sampling loop drains the socket without blocking every
+// tick and hands the parsed events to the writer thread (see WRITER TASKS in writer.h), so a
+// job's row in Jobs exists as soon as the writer gets to it and the loop never waits on SQLite.
+// sacct is still run (less often) to fill in what only the accounting db knows (see Sacct_Collector).
+//
+// Datagram: newline separated key=value lines
+//	- event=start|end (required)
+//	- job_id=<int> (required)
+//	- user, group, node_list, gpus (comma separated indices) for start
+//	- state, exit_code for end
+// Unknown keys are ignored, start_time / end_time are the time the monitor received the event.
+
+// largest datagram read, longer ones are truncated
+#define JOB_EVENT_MAX_BYTES 4096
+
+// events handled per tick, the rest wait for the next one so a flood can't stall sampling
+#define JOB_EVENT_MAX_PER_TICK 64
+
+typedef struct job_event_listener {
+	int fd;
+	char * socket_path;
+	// the writer's connection, only used on the writer thread
+	sqlite3 * db;
+	// upserts into Jobs, an end never gets overwritten by a late start
+	sqlite3_stmt * upsert_start;
+	sqlite3_stmt * upsert_end;
+	// sampling loop counters
+	long n_events;
+	long n_bad_events;
+	long n_dropped_events;
+	char buf[JOB_EVENT_MAX_BYTES + 1];
+} Job_Event_Listener;
+
+struct buffer_writer;
+
+
+// binds socket_path (replacing a stale one, only the monitor's user can send), NULL on failure
+//	- the Jobs table has to exist, db is the connection the writer thread uses
+Job_Event_Listener * init_job_event_listener(char * socket_path, sqlite3 * db);
+// after the writer is stopped (it may still hold events)
+void destroy_job_event_listener(Job_Event_Listener * job_event_listener);
+
+// parses the events waiting on the socket and queues them for writer, returns how many were queued
+int process_job_events(Job_Event_Listener * job_event_listener, struct buffer_writer * writer);
+
+#endif
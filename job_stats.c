@@ -1,48 +1,33 @@
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <signal.h>
+#include <sys/wait.h>
+
 #include "job_stats.h"
 
+#include "monitoring.h"
+#include "storage.h"
+#include "writer.h"
+
+extern char ** environ;
+
 
 // FORMAT: User|Group|JobID|ReqTRES|Timelimit|Submit|NodeList|Start|End|Elapsed|State|ExitCode
 //	- ignore rows where user is blank
+#define SACCT_FORMAT "User,Group,JobID,ReqTRES,Timelimit,Submit,NodeList,Start,End,Elapsed,State,ExitCode"
+#define SACCT_N_COLUMNS 12
 
-void insert_job_to_db(sqlite3 * jobs_db, Job * job){
-	char * insert_statement = "INSERT INTO Jobs "
-                        "(job_id, user_name, group_name, n_nodes, n_cpus, n_gpus, mem_mb, billing, time_limit, submit_time, node_list, start_time, end_time, elapsed_time, state, exit_code)";
-
-    char * full_insert_statement;
-
-	asprintf(&full_insert_statement, "%s VALUES (%ld, '%s', '%s', %d, %d, %d, %d, %d, '%s', '%s', '%s', '%s', '%s', '%s', '%s', '%s');", insert_statement, 
-										job -> job_id,
-										job -> user,
-										job -> group,
-										job -> n_nodes,
-										job -> n_cpus,
-										job -> n_gpus,
-										job -> mem_mb,
-										job -> billing,
-										job -> time_limit,
-										job -> submit_time,
-										job -> node_list,
-										job -> start_time,
-										job -> end_time,
-										job -> elapsed_time,
-										job -> state,
-										job -> exit_code);
-
-	char *sqlErr;
-
-	int sql_ret = sqlite3_exec(jobs_db, full_insert_statement, NULL, NULL, &sqlErr);
-	
-
-	if (sql_ret != SQLITE_OK){
-		fprintf(stderr, "SQL error: %s\n", sqlErr);
-		fprintf(stdout, "Bad sql line: %s\n", full_insert_statement);
-		sqlite3_free(sqlErr);
-	}
+#define JOB_TIME_FORMAT "%Y-%m-%dT%H:%M:%S"
 
-	free(full_insert_statement);
-
-	return;
-}
+// a finished run on its way to the writer thread
+typedef struct sacct_run {
+	Sacct_Collector * sacct_collector;
+	Job * jobs;
+	int n_jobs;
+	char window_end[20];
+} Sacct_Run;
 
 
 // Either of the format: billing=96,cpu=96,mem=393216M,node=3
@@ -75,120 +60,397 @@ int parse_req_tres(Job * job){
 	job -> n_cpus = n_cpus;
 	job -> n_gpus = n_gpus;
 	job -> mem_mb = mem_mb;
-	
+
 	return 0;
 
 }
 
-void scan_line(char *line, Job * job)
-{	
+// truncates to the Job field instead of overflowing it
+static void copy_job_field(char * dst, size_t dst_size, char * src){
+	snprintf(dst, dst_size, "%s", src);
+}
+
+// one line of sacct -P output (no newline), -1 for step lines (no user) and malformed lines
+//	- empty columns stay empty (strtok would shift every column after them)
+int scan_line(char * line, Job * job){
+
+	char * cols[SACCT_N_COLUMNS];
+	int n_cols = 0;
+	char * pos = line;
+	while ((pos != NULL) && (n_cols < SACCT_N_COLUMNS)){
+		cols[n_cols] = strsep(&pos, "|");
+		n_cols++;
+	}
 
 	// occurs when there is no user and shows sub-jobs
-	if (line[0] == '|'){
-		job -> user[0] = '\0';
-		return;
+	if ((n_cols < SACCT_N_COLUMNS) || (cols[0][0] == '\0')){
+		return -1;
 	}
 
-    char * tok = strtok(line, "|");
-    strcpy(job -> user, tok);
-    tok = strtok(NULL, "|");
-    strcpy(job -> group, tok);
-    tok = strtok(NULL, "|");
-    job -> job_id = atol(tok);
-
-    tok = strtok(NULL, "|");
-    strcpy(job -> req_tres, tok);
-    parse_req_tres(job);
-
-    tok = strtok(NULL, "|");
-    strcpy(job -> time_limit, tok);
-    tok = strtok(NULL, "|");
-    strcpy(job -> submit_time, tok);
-    tok = strtok(NULL, "|");
-    strcpy(job -> node_list, tok);
-    tok = strtok(NULL, "|");
-    strcpy(job -> start_time, tok);
-    tok = strtok(NULL, "|");
-    strcpy(job -> end_time, tok);
-    tok = strtok(NULL, "|");
-    strcpy(job -> elapsed_time, tok);
-    tok = strtok(NULL, "|");
-    strcpy(job -> state, tok);
-    tok = strtok(NULL, "|");
-    strcpy(job -> exit_code, tok);
+	copy_job_field(job -> user, sizeof(job -> user), cols[0]);
+	copy_job_field(job -> group, sizeof(job -> group), cols[1]);
+	job -> job_id = atol(cols[2]);
+	copy_job_field(job -> req_tres, sizeof(job -> req_tres), cols[3]);
+	parse_req_tres(job);
+	copy_job_field(job -> time_limit, sizeof(job -> time_limit), cols[4]);
+	copy_job_field(job -> submit_time, sizeof(job -> submit_time), cols[5]);
+	copy_job_field(job -> node_list, sizeof(job -> node_list), cols[6]);
+	copy_job_field(job -> start_time, sizeof(job -> start_time), cols[7]);
+	copy_job_field(job -> end_time, sizeof(job -> end_time), cols[8]);
+	copy_job_field(job -> elapsed_time, sizeof(job -> elapsed_time), cols[9]);
+	copy_job_field(job -> state, sizeof(job -> state), cols[10]);
+	copy_job_field(job -> exit_code, sizeof(job -> exit_code), cols[11]);
+
+	return (job -> job_id > 0) ? 0 : -1;
 }
 
 
+/* ASYNCHRONOUS SACCT */
+
+static sqlite3_stmt * prepare_job_statement(sqlite3 * db, const char * sql){
+
+	sqlite3_stmt * stmt;
+	if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK){
+		fprintf(stderr, "SQL error preparing sacct statement: %s\n", sqlite3_errmsg(db));
+		return NULL;
+	}
+	return stmt;
+}
 
-void dump_sacct_file(sqlite3 * jobs_db, char * outfile){
+Sacct_Collector * init_sacct_collector(sqlite3 * db, char * hostname, long default_window_secs){
 
-	FILE * sacct_file = fopen(outfile, "r");
+	Sacct_Collector * sacct_collector = (Sacct_Collector *) calloc(1, sizeof(Sacct_Collector));
+	if (sacct_collector == NULL){
+		fprintf(stderr, "Could not allocate memory for sacct collector\n");
+		return NULL;
+	}
+	sacct_collector -> db = db;
+	sacct_collector -> hostname = strdup(hostname);
+	sacct_collector -> default_window_secs = default_window_secs;
+	sacct_collector -> pid = -1;
+	sacct_collector -> fd = -1;
+	pthread_mutex_init(&(sacct_collector -> window_lock), NULL);
+
+	char * sqlErr;
+	if (sqlite3_exec(db, "CREATE TABLE IF NOT EXISTS Monitor_State (key TEXT PRIMARY KEY, value TEXT);", NULL, NULL, &sqlErr) != SQLITE_OK){
+		fprintf(stderr, "SQL error: %s\n", sqlErr);
+		sqlite3_free(sqlErr);
+		destroy_sacct_collector(sacct_collector);
+		return NULL;
+	}
+
+	sacct_collector -> upsert_job = prepare_job_statement(db, "INSERT INTO Jobs "
+						"(job_id, user_name, group_name, n_nodes, n_cpus, n_gpus, mem_mb, billing, time_limit, submit_time, node_list, start_time, end_time, elapsed_time, state, exit_code) "
+						"VALUES (?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?) ON CONFLICT(job_id) DO UPDATE SET "
+						"user_name = excluded.user_name, group_name = excluded.group_name, n_nodes = excluded.n_nodes, n_cpus = excluded.n_cpus, "
+						"n_gpus = excluded.n_gpus, mem_mb = excluded.mem_mb, billing = excluded.billing, time_limit = excluded.time_limit, "
+						"submit_time = excluded.submit_time, node_list = excluded.node_list, start_time = excluded.start_time, end_time = excluded.end_time, "
+						"elapsed_time = excluded.elapsed_time, state = excluded.state, exit_code = excluded.exit_code;");
+	sacct_collector -> save_state = prepare_job_statement(db, "INSERT INTO Monitor_State (key, value) VALUES ('sacct_window_end', ?) "
+						"ON CONFLICT(key) DO UPDATE SET value = excluded.value;");
+	if ((sacct_collector -> upsert_job == NULL) || (sacct_collector -> save_state == NULL)){
+		destroy_sacct_collector(sacct_collector);
+		return NULL;
+	}
 
-	if (sacct_file == NULL){
-		fprintf(stderr, "Error reading sacct output file\n");
-		exit(1);
+	// where the last run (maybe of a previous monitor) left off
+	//	- monitors before the window end was kept saved the End of the newest job instead
+	sqlite3_stmt * stmt = prepare_job_statement(db, "SELECT value FROM Monitor_State WHERE key IN ('sacct_window_end', 'sacct_last_end_time') "
+						"ORDER BY key = 'sacct_window_end' DESC LIMIT 1;");
+	if ((stmt != NULL) && (sqlite3_step(stmt) == SQLITE_ROW) && (sqlite3_column_text(stmt, 0) != NULL)){
+		copy_job_field(sacct_collector -> window_end, sizeof(sacct_collector -> window_end), (char *) sqlite3_column_text(stmt, 0));
 	}
+	sqlite3_finalize(stmt);
 
+	return sacct_collector;
+}
 
-	// one (or zero) jobs per line in file
-	Job * job  = malloc(sizeof(Job));
+// closes the pipe and reaps / kills the child
+static void end_sacct_run(Sacct_Collector * sacct_collector, bool kill_child){
 
-	if (job == NULL){
-		fprintf(stderr, "Error malloc for job\n");
-		exit(1);
+	if (sacct_collector -> fd != -1){
+		close(sacct_collector -> fd);
+		sacct_collector -> fd = -1;
 	}
+	if ((sacct_collector -> pid != -1) && kill_child){
+		kill(sacct_collector -> pid, SIGKILL);
+		waitpid(sacct_collector -> pid, NULL, 0);
+	}
+	sacct_collector -> pid = -1;
+	sacct_collector -> n_jobs = 0;
+	sacct_collector -> line_len = 0;
+	sacct_collector -> line_overflow = false;
+}
+
+void destroy_sacct_collector(Sacct_Collector * sacct_collector){
+	end_sacct_run(sacct_collector, true);
+	// finalize on NULL is a no-op
+	sqlite3_finalize(sacct_collector -> upsert_job);
+	sqlite3_finalize(sacct_collector -> save_state);
+	pthread_mutex_destroy(&(sacct_collector -> window_lock));
+	free(sacct_collector -> jobs);
+	free(sacct_collector -> hostname);
+	free(sacct_collector);
+}
 
-	char buffer[1024];
+int start_sacct(Sacct_Collector * sacct_collector, long time_sec){
 
-	// EXPLICITY START DB TRANSACTION SO IT DOESN't AUTO COMMIT
-	sqlite3_exec(jobs_db, "BEGIN", 0, 0, 0);
+	if (sacct_collector -> pid != -1){
+		return 0;
+	}
 
+	// WINDOW
+	//	- starts one interval (default_window_secs) before the last successful run's window
+	//	  ended: a job that ended just before that run but reached slurmdbd after it launched
+	//	  is only returned by a later run, the UPSERT absorbs the overlap
+	//	- bounded so a monitor that was down for weeks doesn't ask for everything
+	//	- ends now, the next run starts from here once this one is written
+	char last_window_end[20];
+	pthread_mutex_lock(&(sacct_collector -> window_lock));
+	strcpy(last_window_end, sacct_collector -> window_end);
+	pthread_mutex_unlock(&(sacct_collector -> window_lock));
+
+	time_t t = time_sec - sacct_collector -> default_window_secs;
+	struct tm t_tm;
+	memset(&t_tm, 0, sizeof(t_tm));
+	if ((last_window_end[0] != '\0') && (strptime(last_window_end, JOB_TIME_FORMAT, &t_tm) != NULL)){
+		t_tm.tm_isdst = -1;
+		t = MAX(mktime(&t_tm) - sacct_collector -> default_window_secs, time_sec - SACCT_MAX_WINDOW_SECS);
+	}
+	char window_start[20];
+	strftime(window_start, sizeof(window_start), JOB_TIME_FORMAT, localtime_r(&t, &t_tm));
+	char window_end[20];
+	t = time_sec;
+	strftime(window_end, sizeof(window_end), JOB_TIME_FORMAT, localtime_r(&t, &t_tm));
+
+	char * argv[] = {"sacct", "--nodelist", sacct_collector -> hostname, "--format=" SACCT_FORMAT,
+						"--state=COMPLETED,CANCELLED,FAILED,TIMEOUT,OUT_OF_MEMORY", "--starttime", window_start, "--endtime", window_end,
+						"--unit=M", "--allusers", "-P", "-n", NULL};
+
+	int pipe_fds[2];
+	if (pipe2(pipe_fds, O_CLOEXEC) == -1){
+		fprintf(stderr, "Could not create sacct pipe: %s\n", strerror(errno));
+		return -1;
+	}
 
-	while(fgets(buffer, sizeof(buffer), sacct_file) != NULL){
-			
-		scan_line(buffer, job);
+	posix_spawn_file_actions_t file_actions;
+	posix_spawn_file_actions_init(&file_actions);
+	posix_spawn_file_actions_adddup2(&file_actions, pipe_fds[1], STDOUT_FILENO);
+	posix_spawn_file_actions_addopen(&file_actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+
+	pid_t pid;
+	int ret = posix_spawnp(&pid, "sacct", &file_actions, NULL, argv, environ);
+	posix_spawn_file_actions_destroy(&file_actions);
+	close(pipe_fds[1]);
+	if (ret != 0){
+		fprintf(stderr, "Could not start sacct: %s\n", strerror(ret));
+		close(pipe_fds[0]);
+		sacct_collector -> n_failed_runs++;
+		return -1;
+	}
 
-		// error reading line
-		if (job -> user[0] == '\0'){
-			continue;
+	fcntl(pipe_fds[0], F_SETFL, O_NONBLOCK);
+	sacct_collector -> pid = pid;
+	sacct_collector -> fd = pipe_fds[0];
+	sacct_collector -> eof = false;
+	sacct_collector -> start_time_sec = time_sec;
+	sacct_collector -> n_jobs = 0;
+	sacct_collector -> line_len = 0;
+	sacct_collector -> line_overflow = false;
+	strcpy(sacct_collector -> run_window_end, window_end);
+	return 0;
+}
+
+// parses one complete line into the run's job list
+static void add_sacct_line(Sacct_Collector * sacct_collector, char * line){
+
+	if (sacct_collector -> n_jobs == sacct_collector -> max_jobs){
+		int max_jobs = (sacct_collector -> max_jobs == 0) ? 64 : 2 * sacct_collector -> max_jobs;
+		Job * jobs = (Job *) realloc(sacct_collector -> jobs, max_jobs * sizeof(Job));
+		if (jobs == NULL){
+			fprintf(stderr, "Could not allocate memory for sacct jobs\n");
+			return;
 		}
+		sacct_collector -> jobs = jobs;
+		sacct_collector -> max_jobs = max_jobs;
+	}
 
-		insert_job_to_db(jobs_db, job);
+	Job * job = &(sacct_collector -> jobs[sacct_collector -> n_jobs]);
+	if (scan_line(line, job) == -1){
+		return;
+	}
+	sacct_collector -> n_jobs++;
+}
 
+// splits what is available on the pipe into lines
+static void read_sacct_output(Sacct_Collector * sacct_collector){
+
+	char buf[4096];
+	ssize_t n_read;
+	char * line = sacct_collector -> line;
+	while ((n_read = read(sacct_collector -> fd, buf, sizeof(buf))) > 0){
+		for (ssize_t i = 0; i < n_read; i++){
+			if (buf[i] == '\n'){
+				line[sacct_collector -> line_len] = '\0';
+				if (!sacct_collector -> line_overflow){
+					add_sacct_line(sacct_collector, line);
+				}
+				else {
+					sacct_collector -> n_bad_lines++;
+				}
+				sacct_collector -> line_len = 0;
+				sacct_collector -> line_overflow = false;
+				continue;
+			}
+			if (sacct_collector -> line_len == SACCT_LINE_BYTES - 1){
+				sacct_collector -> line_overflow = true;
+				continue;
+			}
+			line[sacct_collector -> line_len] = buf[i];
+			sacct_collector -> line_len++;
+		}
 	}
+	// 0: sacct closed its end, -1 with EAGAIN: nothing more for now
+	if (n_read == 0){
+		sacct_collector -> eof = true;
+	}
+}
+
+static void bind_job(sqlite3_stmt * stmt, Job * job){
+	sqlite3_bind_int64(stmt, 1, job -> job_id);
+	sqlite3_bind_text(stmt, 2, job -> user, -1, SQLITE_STATIC);
+	sqlite3_bind_text(stmt, 3, job -> group, -1, SQLITE_STATIC);
+	sqlite3_bind_int(stmt, 4, job -> n_nodes);
+	sqlite3_bind_int(stmt, 5, job -> n_cpus);
+	sqlite3_bind_int(stmt, 6, job -> n_gpus);
+	sqlite3_bind_int(stmt, 7, job -> mem_mb);
+	sqlite3_bind_int(stmt, 8, job -> billing);
+	sqlite3_bind_text(stmt, 9, job -> time_limit, -1, SQLITE_STATIC);
+	sqlite3_bind_text(stmt, 10, job -> submit_time, -1, SQLITE_STATIC);
+	sqlite3_bind_text(stmt, 11, job -> node_list, -1, SQLITE_STATIC);
+	sqlite3_bind_text(stmt, 12, job -> start_time, -1, SQLITE_STATIC);
+	sqlite3_bind_text(stmt, 13, job -> end_time, -1, SQLITE_STATIC);
+	sqlite3_bind_text(stmt, 14, job -> elapsed_time, -1, SQLITE_STATIC);
+	sqlite3_bind_text(stmt, 15, job -> state, -1, SQLITE_STATIC);
+	sqlite3_bind_text(stmt, 16, job -> exit_code, -1, SQLITE_STATIC);
+}
 
-	// EXPLICITY COMMIT TRANSACTION
-	sqlite3_exec(jobs_db, "COMMIT", 0, 0, 0);
+// WRITER TASK: one transaction for the whole run, the window only moves if everything got written
+static int write_sacct_run(void * arg){
 
-	free(job);
-	fclose(sacct_file);
+	Sacct_Run * sacct_run = (Sacct_Run *) arg;
+	Sacct_Collector * sacct_collector = sacct_run -> sacct_collector;
+	sqlite3 * db = sacct_collector -> db;
+	sqlite3_stmt * stmt = sacct_collector -> upsert_job;
+	int err = 0;
 
+	if (sqlite3_exec(db, "BEGIN", NULL, NULL, NULL) != SQLITE_OK){
+		fprintf(stderr, "SQL error starting sacct transaction: %s\n", sqlite3_errmsg(db));
+		free(sacct_run -> jobs);
+		free(sacct_run);
+		return -1;
+	}
+	for (int i = 0; i < sacct_run -> n_jobs; i++){
+		bind_job(stmt, &(sacct_run -> jobs[i]));
+		if (sqlite3_step(stmt) != SQLITE_DONE){
+			fprintf(stderr, "SQL error writing job %ld: %s\n", sacct_run -> jobs[i].job_id, sqlite3_errmsg(db));
+			err = -1;
+		}
+		sqlite3_reset(stmt);
+	}
+	if (err == 0){
+		sqlite3_bind_text(sacct_collector -> save_state, 1, sacct_run -> window_end, -1, SQLITE_STATIC);
+		if (sqlite3_step(sacct_collector -> save_state) != SQLITE_DONE){
+			err = -1;
+		}
+		sqlite3_reset(sacct_collector -> save_state);
+	}
+	if ((err == 0) && (sqlite3_exec(db, "COMMIT", NULL, NULL, NULL) != SQLITE_OK)){
+		fprintf(stderr, "SQL error committing sacct transaction: %s\n", sqlite3_errmsg(db));
+		err = -1;
+	}
+	// a failed COMMIT (e.g. SQLITE_BUSY) leaves the transaction open on the connection
+	if ((err == -1) && (!sqlite3_get_autocommit(db)) && (sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL) != SQLITE_OK)){
+		fprintf(stderr, "SQL error rolling back sacct transaction: %s\n", sqlite3_errmsg(db));
+	}
+	if (err == 0){
+		pthread_mutex_lock(&(sacct_collector -> window_lock));
+		strcpy(sacct_collector -> window_end, sacct_run -> window_end);
+		pthread_mutex_unlock(&(sacct_collector -> window_lock));
+	}
+	else {
+		fprintf(stderr, "sacct jobs not written, their window will be covered by the next run\n");
+	}
+	free(sacct_run -> jobs);
+	free(sacct_run);
+	return err;
 }
 
-void collect_job_stats(sqlite3 * jobs_db, char * out_dir, char * hostname, long time_sec){
+// hands the run's job list over to the writer thread, the next run starts a new one
+static int queue_sacct_run(Sacct_Collector * sacct_collector, Buffer_Writer * writer){
 
-	char * cmd;
-	asprintf(&cmd, "sacct --nodelist=%s --format=User,Group,JobID,ReqTRES,Timelimit,Submit,NodeList,Start,End,Elapsed,State,ExitCode --state=COMPLETED,CANCELLED,FAILED,TIMEOUT,OUT_OF_MEMORY --starttime=now-1hour --endtime=now --unit=M --allusers -P -n", hostname);
+	Sacct_Run * sacct_run = (Sacct_Run *) malloc(sizeof(Sacct_Run));
+	if (sacct_run == NULL){
+		fprintf(stderr, "Could not allocate memory for sacct run\n");
+		return -1;
+	}
+	sacct_run -> sacct_collector = sacct_collector;
+	sacct_run -> jobs = sacct_collector -> jobs;
+	sacct_run -> n_jobs = sacct_collector -> n_jobs;
+	strcpy(sacct_run -> window_end, sacct_collector -> run_window_end);
+	sacct_collector -> jobs = NULL;
+	sacct_collector -> max_jobs = 0;
+
+	if (queue_writer_task(writer, &write_sacct_run, (void *) sacct_run) == -1){
+		free(sacct_run -> jobs);
+		free(sacct_run);
+		return -1;
+	}
+	return 0;
+}
 
-	char * outfile;
-	asprintf(&outfile, "%s/%s_temp.txt", out_dir, hostname);
+int poll_sacct(Sacct_Collector * sacct_collector, long time_sec, Buffer_Writer * writer){
 
-	char * full_cmd;
+	if (sacct_collector -> pid == -1){
+		return 0;
+	}
 
-	asprintf(&full_cmd, "%s > %s", cmd, outfile);
+	if (!sacct_collector -> eof){
+		read_sacct_output(sacct_collector);
+	}
 
-	// CALL SACCT
-	system(full_cmd);
+	int status;
+	pid_t ret = waitpid(sacct_collector -> pid, &status, WNOHANG);
+	if (ret == 0){
+		if (time_sec - sacct_collector -> start_time_sec > SACCT_TIMEOUT_SECS){
+			fprintf(stderr, "sacct did not finish in %d seconds, killed\n", SACCT_TIMEOUT_SECS);
+			sacct_collector -> n_failed_runs++;
+			end_sacct_run(sacct_collector, true);
+			return -1;
+		}
+		return 0;
+	}
 
-	dump_sacct_file(jobs_db, outfile);
+	// exited, pick up whatever it wrote after the last read
+	if (!sacct_collector -> eof){
+		read_sacct_output(sacct_collector);
+	}
+	sacct_collector -> pid = -1;
+	int n_jobs = sacct_collector -> n_jobs;
+	int err = 0;
+	if ((ret == -1) || (!WIFEXITED(status)) || (WEXITSTATUS(status) != 0)){
+		fprintf(stderr, "sacct failed, its window will be covered by the next run\n");
+		err = -1;
+	}
+	else {
+		err = queue_sacct_run(sacct_collector, writer);
+	}
 
-	free(cmd);
-	free(full_cmd);
-	
-	// remove temp file
-	if (remove(outfile) != 0){
-		fprintf(stderr, "Could not remove temp file\n");
+	end_sacct_run(sacct_collector, false);
+	if (err == -1){
+		sacct_collector -> n_failed_runs++;
+		return -1;
 	}
-	
-	free(outfile);
+	sacct_collector -> n_runs++;
+	return n_jobs;
 }
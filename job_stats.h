@@ -12,13 +12,11 @@
 #include <sys/param.h>
 #include <sys/stat.h>
 #include <math.h>
+#include <pthread.h>
 
 #include <sqlite3.h>
 
 
-void collect_job_stats(sqlite3 * job_db, char * out_dir, char * hostname, long time_sec);
-
-
 typedef struct job
 {
 	char user[21];
@@ -32,10 +30,76 @@ typedef struct job
 	char end_time[20];
 	char elapsed_time[9];
 	char state[21];
-	char exit_code[4];
+	// <exit>:<signal>
+	char exit_code[8];
 	int n_nodes;
 	int n_cpus;
 	int n_gpus;
 	int mem_mb;
 	int billing;
 } Job;
+
+
+// ASYNCHRONOUS SACCT (job accounting for the jobs that ended on this node)
+//	- sacct runs as a child writing into a pipe (no shell, no temp file), every tick reads
+//	  whatever it wrote so far without blocking and parses the complete lines
+//	- once sacct exits its jobs are handed to the writer thread (see WRITER TASKS in writer.h),
+//	  which writes them in one transaction of prepared UPSERTs, replacing rows from job events
+//	  (see job_events.h) with the accounting db's final values
+//	- each run covers [end of the last successful run's window - default_window_secs, its own
+//	  launch time] (jobs reach slurmdbd late), the window end is kept in Monitor_State so it
+//	  survives restarts, the first run ever looks back default_window_secs
+
+// longest sacct line kept, longer ones are dropped
+#define SACCT_LINE_BYTES 2048
+
+// a sacct that takes longer (slurmdbd down) is killed, the next run covers its window
+#define SACCT_TIMEOUT_SECS 300
+
+// never look back further than this, however long ago the last job ended
+#define SACCT_MAX_WINDOW_SECS (7 * 24 * 60 * 60)
+
+typedef struct sacct_collector {
+	// the writer's connection, only used on the writer thread after init
+	sqlite3 * db;
+	char * hostname;
+	long default_window_secs;
+	// running sacct, -1 when idle
+	pid_t pid;
+	int fd;
+	long start_time_sec;
+	bool eof;
+	// partial line carried over between reads
+	char line[SACCT_LINE_BYTES];
+	int line_len;
+	bool line_overflow;
+	// jobs parsed from the running sacct
+	Job * jobs;
+	int n_jobs;
+	int max_jobs;
+	// launch time of the last successful run ("" before the first run), set by the writer thread
+	pthread_mutex_t window_lock;
+	char window_end[20];
+	// launch time of the running one
+	char run_window_end[20];
+	sqlite3_stmt * upsert_job;
+	sqlite3_stmt * save_state;
+	long n_runs;
+	long n_failed_runs;
+	long n_bad_lines;
+} Sacct_Collector;
+
+struct buffer_writer;
+
+// Jobs has to exist, db is the connection the writer thread uses, NULL on failure
+Sacct_Collector * init_sacct_collector(sqlite3 * db, char * hostname, long default_window_secs);
+// kills a sacct that is still running, after the writer is stopped (it may still hold a run)
+void destroy_sacct_collector(Sacct_Collector * sacct_collector);
+
+// starts a sacct run unless one is already running, -1 if it couldn't be started
+int start_sacct(Sacct_Collector * sacct_collector, long time_sec);
+
+// reads what sacct wrote since the last call, queues the jobs for writer once it has exited, never blocks
+//	- returns the number of jobs queued (0 while running or idle), -1 if the run failed
+int poll_sacct(Sacct_Collector * sacct_collector, long time_sec, struct buffer_writer * writer);
+
@@ -0,0 +1,290 @@
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include "job_stats.h"
+
+#include "monitoring.h"
+#include "storage.h"
+#include "samples_arena.h"
+#include "mapped_buffers.h"
+
+
+static size_t round_up(size_t bytes, size_t multiple){
+	return ((bytes + multiple - 1) / multiple) * multiple;
+}
+
+// fills in the geometry for a file holding these buffers
+static void init_mapped_header(Mapped_Header * header, int n_buffers, int max_samples, int n_devices, int n_fields, int n_core_bytes, int max_jobs, int n_port_series){
+
+	long page_size = sysconf(_SC_PAGESIZE);
+
+	header -> magic = MAPPED_MAGIC;
+	header -> version = MAPPED_VERSION;
+	header -> n_fields = n_fields;
+	header -> n_buffers = n_buffers;
+	header -> max_samples = max_samples;
+	header -> n_devices = n_devices;
+	header -> n_core_bytes = n_core_bytes;
+	header -> max_jobs = max_jobs;
+	header -> n_port_series = n_port_series;
+	header -> arena_bytes = get_samples_arena_bytes(max_samples, n_devices, n_fields, n_core_bytes, max_jobs, n_port_series);
+	header -> slots_offset = round_up(sizeof(Mapped_Header) + round_up(2 * n_fields * sizeof(unsigned short), 4) + n_port_series * sizeof(int), 8);
+	header -> data_offset = round_up(header -> slots_offset + n_buffers * sizeof(Mapped_Slot), page_size);
+	header -> slot_bytes = round_up(header -> arena_bytes, page_size);
+	header -> next_sequence = 0;
+}
+
+// right after the field types (4-byte aligned)
+static int * get_port_series_ids(Mapped_Header * header){
+	return (int *) ((unsigned char *) (header + 1) + round_up(2 * header -> n_fields * sizeof(unsigned short), 4));
+}
+
+static size_t get_map_bytes(Mapped_Header * header){
+	return header -> data_offset + header -> n_buffers * header -> slot_bytes;
+}
+
+static void * get_slot_arena(void * map, Mapped_Header * header, int slot){
+	return (void *) ((unsigned char *) map + header -> data_offset + slot * header -> slot_bytes);
+}
+
+static void move_unrecovered(char * path){
+
+	char * unrecovered_path;
+	asprintf(&unrecovered_path, "%s.unrecovered", path);
+	if (rename(path, unrecovered_path) != 0){
+		fprintf(stderr, "Could not move %s to %s: %s\n", path, unrecovered_path, strerror(errno));
+	}
+	else {
+		fprintf(stderr, "Unrecovered samples kept at: %s\n", unrecovered_path);
+	}
+	free(unrecovered_path);
+}
+
+
+/* RECOVERY */
+
+int recover_mapped_buffers(char * path, sqlite3 * db, Storage_Mode storage_mode, Columnar_Writer * columnar_writer){
+
+	int fd = open(path, O_RDWR);
+	if (fd == -1){
+		if (errno == ENOENT){
+			return 0;
+		}
+		fprintf(stderr, "Could not open %s for recovery: %s\n", path, strerror(errno));
+		return -1;
+	}
+
+	struct stat st;
+	Mapped_Header file_header, expected_header;
+	if ((fstat(fd, &st) != 0) || (st.st_size < (off_t) sizeof(Mapped_Header)) || (pread(fd, &file_header, sizeof(Mapped_Header), 0) != sizeof(Mapped_Header))){
+		fprintf(stderr, "Can't recover truncated sample buffer file: %s\n", path);
+		close(fd);
+		move_unrecovered(path);
+		return -1;
+	}
+
+	// only trust the file if the geometry is exactly what these parameters would have produced
+	init_mapped_header(&expected_header, file_header.n_buffers, file_header.max_samples, file_header.n_devices, file_header.n_fields, file_header.n_core_bytes, file_header.max_jobs, file_header.n_port_series);
+	if ((file_header.magic != MAPPED_MAGIC) || (file_header.version != MAPPED_VERSION) || (file_header.n_buffers == 0)
+			|| (file_header.slots_offset != expected_header.slots_offset) || (file_header.data_offset != expected_header.data_offset)
+			|| (file_header.arena_bytes != expected_header.arena_bytes) || (file_header.slot_bytes != expected_header.slot_bytes) || ((size_t) st.st_size != get_map_bytes(&expected_header))){
+		// e.g. written by a monitor with another MAPPED_VERSION, kept for a matching build to recover
+		fprintf(stderr, "Can't recover sample buffer file with unexpected layout or version: %s\n", path);
+		close(fd);
+		move_unrecovered(path);
+		return -1;
+	}
+
+	size_t map_bytes = st.st_size;
+	void * map = mmap(NULL, map_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED){
+		fprintf(stderr, "Could not map %s for recovery: %s\n", path, strerror(errno));
+		move_unrecovered(path);
+		return -1;
+	}
+
+	Mapped_Header * header = (Mapped_Header *) map;
+	unsigned short * field_ids = (unsigned short *) (header + 1);
+	unsigned short * field_types = field_ids + header -> n_fields;
+	int * port_series_ids = get_port_series_ids(header);
+	Mapped_Slot * slots = (Mapped_Slot *) ((unsigned char *) map + header -> slots_offset);
+	int n_buffers = header -> n_buffers;
+
+	// slots that still hold samples, oldest first (n_buffers is small)
+	int * order = (int *) malloc(n_buffers * sizeof(int));
+	if (order == NULL){
+		fprintf(stderr, "Could not allocate memory for recovery\n");
+		munmap(map, map_bytes);
+		return -1;
+	}
+	int n_pending = 0;
+	int tmp;
+	for (int i = 0; i < n_buffers; i++){
+		if (slots[i].n_committed == 0){
+			continue;
+		}
+		order[n_pending] = i;
+		for (int j = n_pending; (j > 0) && (slots[order[j - 1]].sequence > slots[order[j]].sequence); j--){
+			tmp = order[j];
+			order[j] = order[j - 1];
+			order[j - 1] = tmp;
+		}
+		n_pending++;
+	}
+
+	if (n_pending == 0){
+		free(order);
+		munmap(map, map_bytes);
+		return 0;
+	}
+
+	// the field list may differ from this run's, so the rows go through their own statements
+	Storage * storage = NULL;
+	if (create_storage_tables(db, storage_mode, header -> n_fields, field_ids) == 0){
+		storage = init_storage(db, storage_mode, STORAGE_BATCH_ROWS, header -> n_fields, field_ids);
+	}
+	if (storage == NULL){
+		free(order);
+		munmap(map, map_bytes);
+		move_unrecovered(path);
+		return -1;
+	}
+	storage -> columnar_writer = columnar_writer;
+
+	Samples_Buffer samples_buffer;
+	memset(&samples_buffer, 0, sizeof(Samples_Buffer));
+	samples_buffer.n_devices = header -> n_devices;
+	samples_buffer.n_fields = header -> n_fields;
+	samples_buffer.n_core_bytes = header -> n_core_bytes;
+	samples_buffer.max_jobs = header -> max_jobs;
+	// ids from the run that wrote the file, so its series keep their names
+	samples_buffer.n_port_series = header -> n_port_series;
+	samples_buffer.port_series_ids = port_series_ids;
+	samples_buffer.field_ids = field_ids;
+	samples_buffer.field_types = field_types;
+	samples_buffer.max_samples = header -> max_samples;
+	reset_tick_stats(&(samples_buffer.tick_stats));
+
+	long n_recovered = 0;
+	int err = 0;
+	int slot;
+	for (int i = 0; i < n_pending; i++){
+		slot = order[i];
+		layout_samples_arena(&samples_buffer, get_slot_arena(map, header, slot));
+		samples_buffer.mapped_slot = &(slots[slot]);
+		samples_buffer.n_samples = MIN(slots[slot].n_committed, header -> max_samples);
+
+		n_recovered += samples_buffer.n_samples;
+		// clears the slot's cursor once the samples are in storage
+		if (dump_samples_buffer(&samples_buffer, storage) == -1){
+			err = -1;
+			break;
+		}
+	}
+
+	destroy_storage(storage);
+	free(order);
+	msync(map, map_bytes, MS_SYNC);
+	munmap(map, map_bytes);
+
+	if (err == -1){
+		fprintf(stderr, "Error flushing recovered samples from %s\n", path);
+		move_unrecovered(path);
+		return -1;
+	}
+
+	printf("Recovered %ld samples from %d buffers in %s\n", n_recovered, n_pending, path);
+	fflush(stdout);
+	return n_recovered;
+}
+
+
+/* MAPPING FOR THIS RUN */
+
+Mapped_Buffers * open_mapped_buffers(char * path, int n_buffers, int max_samples, int n_devices, int n_fields, int n_core_bytes, int max_jobs, int n_port_series, unsigned short * field_ids, unsigned short * field_types, int * port_series_ids){
+
+	Mapped_Buffers * mapped_buffers = (Mapped_Buffers *) malloc(sizeof(Mapped_Buffers));
+	if (mapped_buffers == NULL){
+		fprintf(stderr, "Could not allocate memory for mapped buffers\n");
+		return NULL;
+	}
+
+	Mapped_Header header;
+	init_mapped_header(&header, n_buffers, max_samples, n_devices, n_fields, n_core_bytes, max_jobs, n_port_series);
+	size_t map_bytes = get_map_bytes(&header);
+
+	int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd == -1){
+		fprintf(stderr, "Could not create sample buffer file at %s: %s\n", path, strerror(errno));
+		free(mapped_buffers);
+		return NULL;
+	}
+
+	// reserve the blocks up front so a full disk fails here instead of with SIGBUS later
+	int ret = posix_fallocate(fd, 0, map_bytes);
+	if (ret != 0){
+		fprintf(stderr, "Could not allocate %zu bytes for %s: %s\n", map_bytes, path, strerror(ret));
+		close(fd);
+		free(mapped_buffers);
+		return NULL;
+	}
+
+	void * map = mmap(NULL, map_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED){
+		fprintf(stderr, "Could not map %s: %s\n", path, strerror(errno));
+		close(fd);
+		free(mapped_buffers);
+		return NULL;
+	}
+
+	memcpy(map, &header, sizeof(Mapped_Header));
+	unsigned short * mapped_field_ids = (unsigned short *) ((Mapped_Header *) map + 1);
+	memcpy(mapped_field_ids, field_ids, n_fields * sizeof(unsigned short));
+	memcpy(mapped_field_ids + n_fields, field_types, n_fields * sizeof(unsigned short));
+	if (n_port_series > 0){
+		memcpy(get_port_series_ids((Mapped_Header *) map), port_series_ids, n_port_series * sizeof(int));
+	}
+	// header is written once, only the cursors change afterwards
+	msync(map, header.data_offset, MS_SYNC);
+
+	mapped_buffers -> fd = fd;
+	mapped_buffers -> map_bytes = map_bytes;
+	mapped_buffers -> map = map;
+	mapped_buffers -> header = (Mapped_Header *) map;
+	mapped_buffers -> slots = (Mapped_Slot *) ((unsigned char *) map + header.slots_offset);
+
+	return mapped_buffers;
+}
+
+void close_mapped_buffers(Mapped_Buffers * mapped_buffers){
+	msync(mapped_buffers -> map, mapped_buffers -> map_bytes, MS_SYNC);
+	munmap(mapped_buffers -> map, mapped_buffers -> map_bytes);
+	close(mapped_buffers -> fd);
+	free(mapped_buffers);
+}
+
+void attach_mapped_buffer(Mapped_Buffers * mapped_buffers, int slot, Samples_Buffer * samples_buffer){
+
+	layout_samples_arena(samples_buffer, get_slot_arena(mapped_buffers -> map, mapped_buffers -> header, slot));
+	samples_buffer -> mapped_slot = &(mapped_buffers -> slots[slot]);
+}
+
+void commit_mapped_sample(Mapped_Buffers * mapped_buffers, Samples_Buffer * samples_buffer){
+
+	Mapped_Slot * mapped_slot = samples_buffer -> mapped_slot;
+	if (mapped_slot == NULL){
+		return;
+	}
+
+	// first sample of a fresh buffer, only the sampling thread hands out sequence numbers
+	if (samples_buffer -> n_samples == 1){
+		mapped_buffers -> header -> next_sequence++;
+		mapped_slot -> sequence = mapped_buffers -> header -> next_sequence;
+	}
+
+	// the sample's values are stored before the cursor covers them
+	__atomic_store_n(&(mapped_slot -> n_committed), samples_buffer -> n_samples, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,74 @@
+#ifndef MAPPED_BUFFERS_H
+#define MAPPED_BUFFERS_H
+
+#include <stdint.h>
+
+// CRASH-SAFE SAMPLE BUFFERS (<hostname>.ring)
+//
+// Every samples buffer lives in one shared file mapping, so the collection loop writes
+// samples straight into the page cache and nothing is lost when the process gets killed
+// (a clean node reboot flushes the page cache too, a power loss can lose whatever the
+// kernel had not written back yet).
+//
+// File layout:
+//	- Mapped_Header
+//	- field_ids[n_fields], field_types[n_fields] (unsigned short)
+//	- port_series_ids[n_port_series] (int32, Port_Series ids of the per-port columns)
+//	- Mapped_Slot[n_buffers] (commit cursors, see monitoring.h)
+//	- padding to a page, then one region of slot_bytes per buffer holding that buffer's
+//	  arena (see samples_arena.h)
+//
+// Nothing in the file is a pointer, a recovered slot is laid out again wherever it gets mapped.
+
+#define MAPPED_MAGIC 0x474e4952
+#define MAPPED_VERSION 9
+
+typedef struct mapped_header {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t n_fields;
+	uint32_t n_buffers;
+	uint32_t max_samples;
+	uint32_t n_devices;
+	// per-core utilization bytes per sample (0 if off)
+	uint32_t n_core_bytes;
+	// per-job slots per sample (0 if off)
+	uint32_t max_jobs;
+	// per-port series per sample (0 if off)
+	uint32_t n_port_series;
+	uint64_t arena_bytes;
+	uint64_t slots_offset;
+	uint64_t data_offset;
+	uint64_t slot_bytes;
+	// orders the slots for recovery
+	uint64_t next_sequence;
+} Mapped_Header;
+
+typedef struct mapped_buffers {
+	int fd;
+	size_t map_bytes;
+	void * map;
+	Mapped_Header * header;
+	Mapped_Slot * slots;
+} Mapped_Buffers;
+
+
+// flushes every committed sample in an existing file to storage, returns the number of
+// samples recovered (0 if there is no file) or -1 if they could not be written
+//	- the file is moved to <path>.unrecovered if anything fails (also a file this build can't
+//	  read, e.g. from another MAPPED_VERSION), so it isn't overwritten and a later run can retry
+//	- the tables are migrated to the file's field list (wide mode rebuilds the Data view for it),
+//	  call create_storage_tables with the current list again afterwards
+int recover_mapped_buffers(char * path, sqlite3 * db, Storage_Mode storage_mode, Columnar_Writer * columnar_writer);
+
+// creates a fresh file, call after recover_mapped_buffers
+Mapped_Buffers * open_mapped_buffers(char * path, int n_buffers, int max_samples, int n_devices, int n_fields, int n_core_bytes, int max_jobs, int n_port_series, unsigned short * field_ids, unsigned short * field_types, int * port_series_ids);
+void close_mapped_buffers(Mapped_Buffers * mapped_buffers);
+
+// lays samples_buffer's arena out in the slot
+void attach_mapped_buffer(Mapped_Buffers * mapped_buffers, int slot, Samples_Buffer * samples_buffer);
+
+// call once the sample at n_samples - 1 is complete
+void commit_mapped_sample(Mapped_Buffers * mapped_buffers, Samples_Buffer * samples_buffer);
+
+#endif
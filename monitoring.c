@@ -1,490 +1,45 @@
 #define _GNU_SOURCE
 
 #include "job_stats.h"
-#include "dcgm_agent.h"
-#include "dcgm_fields.h"
-#include "dcgm_structs.h"
 
 #include "monitoring.h"
+#include "storage.h"
+#include "writer.h"
+#include "samples_arena.h"
+#include "gpu_source.h"
+#include "host_stats.h"
+#include "job_cgroups.h"
+#include "job_events.h"
+#include "port_counters.h"
+#include "adaptive_rate.h"
+#include "collectors.h"
+#include "collect_pool.h"
+#include "self_stats.h"
+#include "mapped_buffers.h"
+#include "file_trace.h"
 
 
 
 #define PRINT 0
 
-// CPU MONITORING
-Proc_Data * process_proc_stat(Sample * cur_sample, Proc_Data * prev_data){
-
-	FILE * fp = fopen("/proc/stat", "r");
-
-	if (fp == NULL){
-		fprintf(stderr, "Error Opening /proc/stat\n");
-		return NULL;
-	}
-
-	Proc_Data * proc_data = cur_sample -> cpu_util;
-
-	// QUERY MEMORY INFO
-	long avail_pages = sysconf(_SC_AVPHYS_PAGES);
-	long total_pages = sysconf(_SC_PHYS_PAGES);
-	proc_data -> mem_used_pct = 100 * ((double) (total_pages - avail_pages) / (double) total_pages);
-	long page_size = sysconf(_SC_PAGESIZE);
-	long free_mem_mb = (avail_pages * page_size) / (1 << 20);
-	proc_data -> free_mem = free_mem_mb;
-	
-	// only collecting aggregate 
-	Cpu_stat cpu_stats;
-
-	// parse all the cpu data
-	char dummy_name[255];
-	// only look the top line which aggregates all CPUS
-	fscanf(fp, "%s %lu %lu %lu %lu %lu %lu %lu", dummy_name, &(cpu_stats.t_user), &(cpu_stats.t_nice), 
-        &(cpu_stats.t_system), &(cpu_stats.t_idle), &(cpu_stats.t_iowait), &(cpu_stats.t_irq),
-        &(cpu_stats.t_softirq));
-
-	//done with file, closing
-	fclose(fp);
-  
-
-	long total_time = cpu_stats.t_user + cpu_stats.t_nice + cpu_stats.t_system + cpu_stats.t_idle + cpu_stats.t_iowait + cpu_stats.t_irq + cpu_stats.t_softirq;
-	long idle_time = cpu_stats.t_idle;
-
-	// if there wasn't a previous sample can't compute util %
-	if (prev_data == NULL){
-		proc_data -> util_pct = 0;
-		proc_data -> total_time = total_time;
-		proc_data -> idle_time = idle_time;
-		return proc_data;
-	}
-
-	long prev_total_time = prev_data -> total_time;
-	long prev_idle_time = prev_data -> idle_time;
-
-
-	long total_delta = total_time - prev_total_time;
-	long idle_delta = idle_time - prev_idle_time;
-
-	long cpu_used = total_delta - idle_delta;
-
-	double util_pct = (100 * (double) cpu_used) / ((double) total_delta);
-
-	proc_data -> util_pct = util_pct;
-	proc_data -> total_time = total_time;
-	proc_data -> idle_time = idle_time;
-
-	return proc_data;
-}
-
-
-Net_Data * process_net_stat(Sample * cur_sample, Interface_Totals * interface_totals){
-
-	Net_Data * net_data = cur_sample -> net_util;
-
-	long total_ib_rx_bytes = 0;
-	long total_ib_tx_bytes = 0;
-	long total_ib_sys_rx_bytes = 0;
-	long total_ib_sys_tx_bytes = 0;
-	long total_eth_rx_bytes = 0;
-	long total_eth_tx_bytes = 0;
-	
-
-	FILE * net_stat_fp;
-	long cur_rx, cur_tx;
-	char * if_path;
-
-	int n_ib_ifs = interface_totals -> n_ib_ifs;
-	int n_eth_ifs = interface_totals -> n_eth_ifs;
-	char ** ib_ifs = interface_totals -> ib_ifs;
-	char ** eth_ifs = interface_totals -> eth_ifs;
-	
-	// ACCUMULATING TOTALS FOR IB IFs
-
-	// ALL PHYS TRAFFIC (including RDMA)
-	for (int i = 0; i < n_ib_ifs; i++){
-		// RX
-		// ib_ifs[i] + 2 because we need to get the numerical port for ib device
-		asprintf(&if_path, "/sys/class/net/%s/device/infiniband/mlx5_%s/ports/1/counters/port_rcv_data", ib_ifs[i], ib_ifs[i] + 2);
-		net_stat_fp = fopen(if_path, "r");
-		// error couldn't read file
-		if (net_stat_fp == NULL){
-			fprintf(stderr, "Error: couldn't read rx_bytes at file: %s\n", if_path);
-			free(if_path);
-			continue;
-		}
-		fscanf(net_stat_fp, "%ld", &cur_rx);
-		// need to multiply by 4 because port_recv_data is divided by 4
-		total_ib_rx_bytes += 4 * cur_rx;
-		free(if_path);
-		fclose(net_stat_fp);
-
-		// TX
-		asprintf(&if_path, "/sys/class/net/%s/device/infiniband/mlx5_%s/ports/1/counters/port_xmit_data", ib_ifs[i], ib_ifs[i] + 2);
-		net_stat_fp = fopen(if_path, "r");
-		// error couldn't read file
-		if (net_stat_fp == NULL){
-			free(if_path);
-			continue;
-		}
-		fscanf(net_stat_fp, "%ld", &cur_tx);
-		// need to multiply by 4 because port_xmit_data is divided by 4
-		total_ib_tx_bytes += 4 * cur_tx;
-		free(if_path);
-		fclose(net_stat_fp);
-	}
-
-	// IB Traffic passing through system memory
-	for (int i = 0; i < n_ib_ifs; i++){
-		// RX
-		asprintf(&if_path, "/sys/class/net/%s/statistics/rx_bytes", ib_ifs[i]);
-		net_stat_fp = fopen(if_path, "r");
-		// error couldn't read file
-		if (net_stat_fp == NULL){
-			fprintf(stderr, "Error: couldn't read rx_bytes at file: %s\n", if_path);
-			free(if_path);
-			continue;
-		}
-		fscanf(net_stat_fp, "%ld", &cur_rx);
-		total_ib_sys_rx_bytes += cur_rx;
-		free(if_path);
-		fclose(net_stat_fp);
-
-		// TX
-		asprintf(&if_path, "/sys/class/net/%s/statistics/tx_bytes", ib_ifs[i]);
-		net_stat_fp = fopen(if_path, "r");
-		// error couldn't read file
-		if (net_stat_fp == NULL){
-			free(if_path);
-			continue;
-		}
-		fscanf(net_stat_fp, "%ld", &cur_tx);
-		total_ib_sys_tx_bytes += cur_tx;
-		free(if_path);
-		fclose(net_stat_fp);
-	}
-
-
-
-	// ACCUMULATING TOTALS FOR ETH IFs
-	for (int i = 0; i < n_eth_ifs; i++){
-		// RX
-		asprintf(&if_path, "/sys/class/net/%s/statistics/rx_bytes", eth_ifs[i]);
-		net_stat_fp = fopen(if_path, "r");
-		// error couldn't read file
-		if (net_stat_fp == NULL){
-			free(if_path);
-			continue;
-		}
-		fscanf(net_stat_fp, "%ld", &cur_rx);
-		total_eth_rx_bytes += cur_rx;
-		free(if_path);
-		fclose(net_stat_fp);
-
-		// TX
-		asprintf(&if_path, "/sys/class/net/%s/statistics/tx_bytes", eth_ifs[i]);
-		net_stat_fp = fopen(if_path, "r");
-		// error couldn't read file
-		if (net_stat_fp == NULL){
-			free(if_path);
-			continue;
-		}
-		fscanf(net_stat_fp, "%ld", &cur_tx);
-		total_eth_tx_bytes += cur_tx;
-		free(if_path);
-		fclose(net_stat_fp);
-	}
-
-
-
-	// Taking these totals minus prev recorded totals
-	net_data -> ib_rx_bytes = total_ib_rx_bytes - interface_totals -> total_ib_rx_bytes;
-	net_data -> ib_tx_bytes = total_ib_tx_bytes - interface_totals -> total_ib_tx_bytes;
-	net_data -> ib_sys_rx_bytes = total_ib_sys_rx_bytes - interface_totals -> total_ib_sys_rx_bytes;
-	net_data -> ib_sys_tx_bytes = total_ib_sys_tx_bytes - interface_totals -> total_ib_sys_tx_bytes;
-	net_data -> eth_rx_bytes = total_eth_rx_bytes - interface_totals -> total_eth_rx_bytes;
-	net_data -> eth_tx_bytes = total_eth_tx_bytes - interface_totals -> total_eth_tx_bytes;
-
-	// Special case for the first time we don't want to have outlier results
-	if (interface_totals -> total_ib_rx_bytes == 0){
-		net_data -> ib_rx_bytes = 0;
-		net_data -> ib_tx_bytes = 0;
-		net_data -> ib_sys_rx_bytes = 0;
-		net_data -> ib_sys_tx_bytes = 0;
-		net_data -> eth_rx_bytes = 0;
-		net_data -> eth_tx_bytes = 0;
-	}
-
-	// Update new totals
-	interface_totals -> total_ib_rx_bytes = total_ib_rx_bytes;
-	interface_totals -> total_ib_tx_bytes = total_ib_tx_bytes;
-	interface_totals -> total_ib_sys_rx_bytes = total_ib_sys_rx_bytes;
-	interface_totals -> total_ib_sys_tx_bytes = total_ib_sys_tx_bytes;
-	interface_totals -> total_eth_rx_bytes = total_eth_rx_bytes;
-	interface_totals -> total_eth_tx_bytes = total_eth_tx_bytes;
-
-	return net_data;
-}
-
-// GPU MONITORING
-
-// < 100 values, do not need hash table
-int get_my_field_ind(unsigned short fieldId, unsigned short * field_ids, int n_fields){
-
-	for (int i = 0; i < n_fields; i++){
-		if (field_ids[i] == fieldId){
-			return i;
-		}
-	}
-	return -1;
-}
-
-// pass in memory location of pointer to allocated array
-int copy_field_values_function(unsigned int gpuId, dcgmFieldValue_v1 * values, int numValues, void * userdata){
-	Samples_Buffer * samples_buffer = (Samples_Buffer *) userdata;
-	int n_samples = samples_buffer -> n_samples;
-	Sample * cur_sample = &((samples_buffer -> samples)[n_samples]);
-	unsigned short * field_ids = samples_buffer -> field_ids;
-	int n_fields = samples_buffer -> n_fields;
-	// hardcoded but could use the fieldTypes
-	int field_size_bytes = 8;
-	unsigned short fieldId, fieldType;
-	int indOfField;
-	for (int i = 0; i < numValues; i++){
-		fieldId = values[i].fieldId;
-		indOfField = get_my_field_ind(fieldId, field_ids, n_fields);
-		if (indOfField == -1){
-			continue;
-		}
-		fieldType = values[i].fieldType;
-		if (fieldType == DCGM_FT_DOUBLE){
-			memcpy(cur_sample -> field_values + (gpuId * n_fields + indOfField) * field_size_bytes, &(values[i].value.dbl), field_size_bytes);
-		}
-		else if ((fieldType == DCGM_FT_INT64) || (fieldType == DCGM_FT_TIMESTAMP)){
-			memcpy(cur_sample -> field_values + (gpuId * n_fields + indOfField) * field_size_bytes, &(values[i].value.i64), field_size_bytes);
-		}
-		else{
-			// fieldType not supported
-			continue;
-		}		
-	}
-	return 0;
-}
-
-void insert_sample_to_db(sqlite3 * db, long timestamp_ms, long device_id, long field_id, long value){
-
-	char * insert_statement;
-
-	asprintf(&insert_statement, "INSERT INTO Data (timestamp,device_id,field_id,value) VALUES (%ld, %ld, %ld, %ld);", timestamp_ms, device_id, field_id, value);
-
-	char *sqlErr;
-
-	int sql_ret = sqlite3_exec(db, insert_statement, NULL, NULL, &sqlErr);
-	
-	free(insert_statement);
-
-	if (sql_ret != SQLITE_OK){
-		fprintf(stderr, "SQL error: %s\n", sqlErr);
-		sqlite3_free(sqlErr);
-	}
-	return;
-}
-
-
-int dump_samples_buffer(Samples_Buffer * samples_buffer, sqlite3 * db){
-
-	int n_fields = samples_buffer -> n_fields;
-	int n_devices = samples_buffer -> n_devices;
-
-	// hardcoded, but could also look at field_types field in sample struct
-	int field_size_bytes = 8;
-
-	int n_samples = samples_buffer -> n_samples;
-	unsigned short * fieldIds = samples_buffer -> field_ids;
-	unsigned short * fieldTypes = samples_buffer -> field_types;
-
-	Sample * samples = samples_buffer -> samples;
-
-	// Saving Data
-	Proc_Data * cpu_data;
-	Net_Data * net_data;
-	void * fieldValues;
-	Sample data;
-
-	unsigned short fieldId, fieldType;
-	long ind, time_ns;
-
-	long val;
-	// insert timestamp and field values for every sample
-	struct timespec start, end;
-	clock_gettime(CLOCK_REALTIME, &start);
-
-	// EXPLICITY START DB TRANSACTION SO IT DOESN't AUTO COMMIT
-	sqlite3_exec(db, "BEGIN", 0, 0, 0);	
-	
-
-	for (int i = 0; i < n_samples; i++){
-
-		data = samples[i];
-		time_ns = data.time.tv_sec * 1e9 + data.time.tv_nsec;
-
-		// CPU dump
-		cpu_data = data.cpu_util;
-		// HARDCODING FIELDS:
-		//	- 0 = free_mem
-		//	- 1 = util_pct
-		insert_sample_to_db(db, time_ns, -1, 1, round(cpu_data -> mem_used_pct));
-		insert_sample_to_db(db, time_ns, -1, 2, cpu_data -> free_mem);
-		insert_sample_to_db(db, time_ns, -1, 3, round(cpu_data -> util_pct));
-
-		// NET dump
-		net_data = data.net_util;
-		// HARDCODING FIELDS:
-		//	- 2 = ib_rx_bytes
-		//	- 3 = ib_tx_bytes
-		//	- 4 = eth_rx_bytes
-		//	- 5 = eth_tx_bytes
-		insert_sample_to_db(db, time_ns, -1, 10, net_data -> ib_rx_bytes);
-		insert_sample_to_db(db, time_ns, -1, 11, net_data -> ib_tx_bytes);
-		insert_sample_to_db(db, time_ns, -1, 12, net_data -> ib_sys_rx_bytes);
-		insert_sample_to_db(db, time_ns, -1, 13, net_data -> ib_sys_tx_bytes);
-		// SAVE DB SPACE BY NOT STORING ETH DATA. 
-		// PRETTY MUCH NEVER USED SO MIGHT WANT TO COMMENT OUT
-		insert_sample_to_db(db, time_ns, -1, 14, net_data -> eth_rx_bytes);
-		insert_sample_to_db(db, time_ns, -1, 15, net_data -> eth_tx_bytes);
-		
-		// GPU Field dump
-		fieldValues = data.field_values;
-
-		for (int gpuId = 0; gpuId < n_devices; gpuId++){
-    		for (int fieldNum = 0; fieldNum < n_fields; fieldNum++){
-    			ind = gpuId * n_fields + fieldNum;
-    			fieldId = fieldIds[fieldNum];
-				fieldType = fieldTypes[fieldNum];
-				switch (fieldType) {
-					case DCGM_FT_DOUBLE:
-						// all the doubles are fractions 0-1, we instead represent as int 0-100
-						val = (long) round(((double *) fieldValues)[ind] * 100);
-						break;
-					case DCGM_FT_INT64:
-						val =  (((long *) fieldValues)[ind]);
-						break;
-					case DCGM_FT_TIMESTAMP:
-						val = (((long *) fieldValues)[ind]);
-						break;
-					default:
-						val = 0;
-						break;
-    			}
-    			insert_sample_to_db(db, time_ns, gpuId, fieldId, val);
-    		}
-    	}
-	}
-	
-	// EXPLICITY COMMIT TRANSACTION
-	sqlite3_exec(db, "COMMIT", 0, 0, 0);
-
-	clock_gettime(CLOCK_REALTIME, &end);
-
-	long elapsed_time_ns = ((end.tv_sec - start.tv_sec) * 1e9) + (end.tv_nsec - start.tv_nsec);
-	long elapsed_time_ms = elapsed_time_ns / 1e6;
-	//printf("Elasped time of dump: %lu ms\n", elapsed_time_ms);
-	//fflush(stdout);
-
-
-	// reset samples
-	struct timespec time;
-	for (int i = 0; i < n_samples; i++){
-		samples[i].time = time;
-		memset(samples[i].field_values, 0, n_fields * n_devices * field_size_bytes);
-	}
-
-	return 0;
-	
-}
-
-void cleanup_and_exit(int error_code, dcgmHandle_t * dcgmHandle, dcgmGpuGrp_t * groupId, dcgmFieldGrp_t * fieldGroupId){
+void cleanup_and_exit(int error_code, Gpu_Source * gpu_source){
 
 	// if cleanup was caused by error
-	if ((error_code != -1) && (error_code != DCGM_ST_OK)){
-		printf("ERROR: %s\nFreeing Structs And Exiting...\n", errorString(error_code));
-	}
-
-	if (fieldGroupId){
-		dcgmFieldGroupDestroy(*dcgmHandle, *fieldGroupId);
-	}
-
-	if (groupId){
-		dcgmGroupDestroy(*dcgmHandle, *groupId);
+	if (error_code != 0){
+		printf("Freeing Structs And Exiting...\n");
 	}
 
-	if (dcgmHandle){
-		dcgmStopEmbedded(*dcgmHandle);
+	// stops the GPU backend (DCGM host engine, NVML, ...)
+	if (gpu_source){
+		close_gpu_source(gpu_source);
 	}
 
-	dcgmShutdown();
-
 	exit(error_code);
 
 }
 
-Interface_Totals * init_interface_totals(){
-	Interface_Totals * interface_totals = (Interface_Totals *) malloc(sizeof(Interface_Totals));
-	if (interface_totals == NULL){
-		fprintf(stderr, "Could not allocate memory for interface names\n");
-		return NULL;
-	}
-
-	const char * interface_parent_dir = "/sys/class/net";
-	DIR *dr = opendir(interface_parent_dir);
-	if (dr == NULL) { 
-        fprintf(stderr, "Could not open interface directory\n"); 
-        return NULL;
-    }
-
-    struct dirent * interface_dirs;
-    int max_ifs = 16;
-    char ** ib_ifs = (char **) malloc(max_ifs * sizeof(char *));
-    int n_ib_ifs = 0;
-    char ** eth_ifs = (char **) malloc(max_ifs * sizeof(char *));
-    int n_eth_ifs = 0;
-   	
-    char * dir_name; 
-    while ((interface_dirs = readdir(dr)) != NULL) {
-    	dir_name = interface_dirs -> d_name;
-	if (!strcmp (dir_name, "."))
-            continue;
-        if (!strcmp (dir_name, ".."))    
-            continue;
-   
-        if (strncmp("ib", dir_name, 2) == 0) {
-        	ib_ifs[n_ib_ifs] = strdup(dir_name);
-        	n_ib_ifs++;
-
-        }
-
-        if (strncmp("eno", dir_name, 3) == 0){
-        	eth_ifs[n_eth_ifs] = strdup(dir_name);
-        	n_eth_ifs++;
-        }
-    }
-
-    closedir(dr);
-
-    interface_totals -> n_ib_ifs = n_ib_ifs;
-    interface_totals -> ib_ifs = ib_ifs;
-    interface_totals -> n_eth_ifs = n_eth_ifs;
-    interface_totals -> eth_ifs = eth_ifs;
-
-    interface_totals -> total_ib_rx_bytes = 0;
-    interface_totals -> total_ib_tx_bytes = 0;
-    interface_totals -> total_ib_sys_rx_bytes = 0;
-	interface_totals -> total_ib_sys_tx_bytes = 0;
-    interface_totals -> total_eth_rx_bytes = 0;
-    interface_totals -> total_eth_tx_bytes = 0;
-    
-    return interface_totals;
-}
-
-
-Samples_Buffer * init_samples_buffer(int n_cpu, int clk_tck, int n_devices, int n_fields, unsigned short * field_ids, unsigned short * field_types, int max_samples){
+// arena lives in slot of mapped_buffers, or on the heap if mapped_buffers is NULL
+Samples_Buffer * init_samples_buffer(int n_cpu, int clk_tck, int n_core_bytes, int max_jobs, int n_port_series, int * port_series_ids, int n_devices, int n_fields, unsigned short * field_ids, unsigned short * field_types, short * field_lookup, int max_samples, Interface_Totals * interface_totals, Mapped_Buffers * mapped_buffers, int slot){
 
 	Samples_Buffer * samples_buffer = (Samples_Buffer *) malloc(sizeof(Samples_Buffer));
 	if (samples_buffer == NULL){
@@ -494,35 +49,35 @@ Samples_Buffer * init_samples_buffer(int n_cpu, int clk_tck, int n_devices, int
 
 	samples_buffer -> n_cpu = n_cpu;
 	samples_buffer -> clk_tck = clk_tck;
+	samples_buffer -> n_core_bytes = n_core_bytes;
+	samples_buffer -> max_jobs = max_jobs;
+	samples_buffer -> n_port_series = n_port_series;
+	samples_buffer -> port_series_ids = port_series_ids;
 	samples_buffer -> n_devices = n_devices;
 	samples_buffer -> n_fields = n_fields;
 	samples_buffer -> field_ids = field_ids;
 	samples_buffer -> field_types = field_types;
+	samples_buffer -> field_lookup = field_lookup;
 	samples_buffer -> max_samples = max_samples;
 	samples_buffer -> n_samples = 0;
-	Sample * samples = (Sample *) malloc(max_samples * sizeof(Sample));
-	if (samples == NULL){
-		fprintf(stderr, "Could not allocate memory for samples buffer, exiting...\n");
-		return NULL;
-	}
+	reset_tick_stats(&(samples_buffer -> tick_stats));
+	samples_buffer -> mapped_slot = NULL;
+	samples_buffer -> gpu_values = NULL;
+	samples_buffer -> n_gpu_values = 0;
+	samples_buffer -> max_gpu_values = 0;
 
-	// hardcoded because only doubles and i64 field value types
-	int field_size_bytes = 8;
-	for (int i = 0; i < max_samples; i++){
-		Sample my_sample;
-		my_sample.field_values = (void *) malloc(n_fields * n_devices * field_size_bytes);
-		my_sample.cpu_util = (Proc_Data *) malloc(sizeof(Proc_Data));
-		my_sample.net_util = (Net_Data *) malloc(sizeof(Net_Data));
-		if ((my_sample.field_values == NULL) || (my_sample.cpu_util == NULL) || (my_sample.net_util == NULL)){
-			fprintf(stderr, "Could not allocate memory for values in samples buffer, exiting...\n");
-			return NULL;
-		}
-		samples[i] = my_sample;
-	}
+	// shared by every buffer so the cumulative net totals carry over between buffers
+	samples_buffer -> interface_totals = interface_totals;
 
-	samples_buffer -> samples = samples;
+	if (mapped_buffers != NULL){
+		attach_mapped_buffer(mapped_buffers, slot, samples_buffer);
+		return samples_buffer;
+	}
 
-	samples_buffer -> interface_totals = init_interface_totals();
+	// one block for every column instead of 3 mallocs per sample
+	if (alloc_samples_arena(samples_buffer) == -1){
+		return NULL;
+	}
 
 	return samples_buffer;
 
@@ -533,7 +88,26 @@ void print_usage(){
 	const char * usage_str = "Usage: [-f, --fields=<string: comma separated of field ids>] || \
 					[-s, --sample_freq_millis=<int>] || \
 					[-n, --n_samples_per_buffer=<int: number of samples to hold in-mem before dumping to file>] || \
-					[-o, --output_dir=<string: directory to store outputted results]";
+					[-o, --output_dir=<string: directory to store outputted results] || \
+					[-q, --queue_depth=<int: number of full buffers that can wait for the writer thread>] || \
+					[-p, --overflow_policy=<string: block, drop_oldest or drop_newest when the writer falls behind>] || \
+					[-m, --storage_mode=<string: eav (one row per value), wide (one row per sample / per GPU) or columnar (compressed <hostname>.mts file)>] || \
+					[-g, --gpu_backend=<string: dcgm[:batch_secs=<int>,watch_millis=<int>], nvml, synthetic[:n_devices=<int>,pattern=<idle|steady|noisy>,seed=<int>] or replay:<file.mts>>] || \
+					[-c, --per_cpu (also record per-core utilization every sample)] || \
+					[-u, --cpu_time=<string: ticks (/proc/stat), schedstat (/proc/schedstat ns) or cgroup (cgroup cpu usage ns) as the source of cpu util %>] || \
+					[-j, --max_jobs=<int: slurm job cgroups to sample every tick, 0 (default) turns per-job collection off>] || \
+					[-e, --job_socket=<string: unix socket for job start / end events from the prolog / epilog (monitorJobEvent)>] || \
+					[-r, --sacct_interval_secs=<int: seconds between sacct runs, default 3600 or 21600 with --job_socket>] || \
+					[-l, --net_stats=<string: netlink (one rtnetlink dump per tick, default) or sysfs (statistics files) for interface byte counters>] || \
+					[-i, --port_counters=<string: per-port series for every IB port and ib* / eno* interface, default, all or comma separated IB counters (see port_counters.h)>] || \
+					[-S, --sysfs_root=<string: where sysfs is mounted for the per-port series, default <root_dir>/sys>] || \
+					[-a, --adaptive_base_millis=<int: sample period while the node is idle (multiple of sample_freq_millis), 0 (default) always samples at sample_freq_millis>] || \
+					[-A, --adaptive_threshold_pct=<double: cpu / GPU util % that counts as activity, default 5>] || \
+					[-R, --collector_periods=<string: comma separated <source>=<millis>[+<phase_millis>] for proc, meminfo, net, gpu or jobs, multiples of sample_freq_millis (see collectors.h)>] || \
+					[-T, --collect_threads=<int: threads collecting a tick alongside the sampling thread, default 3, 0 collects serially>] || \
+					[-P, --root_dir=<string: prefix of every procfs / sysfs / cgroupfs path the collectors read, default none>] || \
+					[-W, --record_trace=<string: file to record every procfs / sysfs / cgroupfs read into, tick by tick (see file_trace.h)>] || \
+					[-X, --replay_trace=<string: recorded file to collect from instead of the node, replays one tick per sample and exits at its end, needs --root_dir>]";
 	
 	printf("%s\n", usage_str);
 }
@@ -577,6 +151,91 @@ unsigned short * parse_string_to_arr(char * str, int * n_vals){
 }
 
 
+// COLLECTION TASKS OF A TICK (see collect_pool.h)
+//	- each one only writes its own columns of sample n_samples (and its own reader state)
+typedef struct tick_context {
+	Samples_Buffer * samples_buffer;
+	int n_samples;
+	unsigned int due_collectors;
+	Gpu_Source * gpu_source;
+	Proc_Stat_Reader * proc_stat_reader;
+	Mem_Info_Reader * mem_info_reader;
+	Cpu_Time_Reader * cpu_time_reader;
+	// result of the proc task, NULL if /proc/stat wasn't read
+	Proc_Data * cpu_util;
+	// keep our own copy because the sample it came from may already be with the writer
+	Proc_Data * prev_proc_data;
+	Proc_Data prev_proc_data_copy;
+	Job_Cgroups * job_cgroups;
+	Port_Counters * port_counters;
+} Tick_Context;
+
+// fills every (GPU, field) column at n_samples
+static int collect_gpu_task(void * ctx){
+	Tick_Context * tick_context = (Tick_Context *) ctx;
+	return collect_gpu_values(tick_context -> gpu_source, tick_context -> samples_buffer);
+}
+
+// COMPUTE CPU % AND COLLECT FREE MEM
+static int collect_proc_task(void * ctx){
+
+	Tick_Context * tick_context = (Tick_Context *) ctx;
+	Samples_Buffer * samples_buffer = tick_context -> samples_buffer;
+	int n_samples = tick_context -> n_samples;
+	int n_core_bytes = samples_buffer -> n_core_bytes;
+
+	tick_context -> cpu_util = NULL;
+	if (tick_context -> due_collectors & COLLECTOR_BIT(COLLECTOR_PROC)){
+		Proc_Data * cpu_util = process_proc_stat(tick_context -> proc_stat_reader, &(samples_buffer -> cpu_util[n_samples]), tick_context -> prev_proc_data);
+		tick_context -> cpu_util = cpu_util;
+
+		// set the previous to be current so as to accurately compute util % next time
+		if (cpu_util != NULL){
+			tick_context -> prev_proc_data_copy = *cpu_util;
+			tick_context -> prev_proc_data = &(tick_context -> prev_proc_data_copy);
+		}
+
+		if ((tick_context -> cpu_time_reader != NULL) && (cpu_util != NULL)){
+			process_cpu_time(tick_context -> cpu_time_reader, cpu_util);
+		}
+
+		// PER-CORE UTILIZATION (same read of /proc/stat)
+		if ((n_core_bytes > 0) && (cpu_util != NULL)){
+			process_per_cpu_stat(tick_context -> proc_stat_reader, &(samples_buffer -> core_util[n_samples * n_core_bytes]));
+		}
+	}
+
+	if (tick_context -> due_collectors & COLLECTOR_BIT(COLLECTOR_MEMINFO)){
+		process_mem_info(tick_context -> mem_info_reader, &(samples_buffer -> cpu_util[n_samples]));
+	}
+	return 0;
+}
+
+// COLLECT NETWORK DATA AND THE PER-PORT SERIES
+static int collect_net_task(void * ctx){
+
+	Tick_Context * tick_context = (Tick_Context *) ctx;
+	Samples_Buffer * samples_buffer = tick_context -> samples_buffer;
+	int n_samples = tick_context -> n_samples;
+	int n_port_series = samples_buffer -> n_port_series;
+
+	process_net_stat(&(samples_buffer -> net_util[n_samples]), samples_buffer -> interface_totals);
+	if (n_port_series > 0){
+		process_port_counters(tick_context -> port_counters, &(samples_buffer -> port_values[n_samples * n_port_series]));
+	}
+	return 0;
+}
+
+// PER-JOB CGROUP RESOURCES
+static int collect_jobs_task(void * ctx){
+
+	Tick_Context * tick_context = (Tick_Context *) ctx;
+	Samples_Buffer * samples_buffer = tick_context -> samples_buffer;
+	process_job_cgroups(tick_context -> job_cgroups, &(samples_buffer -> job_samples[tick_context -> n_samples * samples_buffer -> max_jobs]));
+	return 0;
+}
+
+
 int main(int argc, char ** argv, char * envp[]){
 
 	// handle command line args
@@ -589,7 +248,38 @@ int main(int argc, char ** argv, char * envp[]){
 	// deafult for Della
 	// location where the per-host databases are 
 	char * output_dir = "/scratch/gpfs/as1669/ClusterMonitoring/data/trial";
-
+	// buffers that can be waiting on the writer thread while sampling continues
+	int queue_depth = 2;
+	Overflow_Policy overflow_policy = OVERFLOW_BLOCK;
+	Storage_Mode storage_mode = STORAGE_EAV;
+	// dcgm when built with it, synthetic GPUs otherwise
+	Gpu_Backend gpu_backend = DEFAULT_GPU_BACKEND;
+	char * gpu_backend_options = NULL;
+	// per-core utilization off unless asked for
+	bool per_cpu = false;
+	// USER_HZ ticks from /proc/stat unless a ns source is asked for
+	Cpu_Time_Source cpu_time_source = CPU_TIME_TICKS;
+	// per-job cgroup samples off unless asked for
+	int max_jobs = 0;
+	// job events off unless a socket is given, sacct then only reconciles
+	char * job_socket_path = NULL;
+	long sacct_interval_secs = -1;
+	// one rtnetlink dump per tick unless sysfs is asked for
+	Net_Stats_Source net_stats_source = NET_STATS_NETLINK;
+	// per-port series off unless a counter set is given
+	char * port_counter_set = NULL;
+	// <root_dir>/sys unless given
+	char * sysfs_root = NULL;
+	// fixed rate unless a base period for idle nodes is given
+	int adaptive_base_millis = 0;
+	double adaptive_threshold_pct = ADAPTIVE_DEFAULT_THRESHOLD_PCT;
+	// every source on every tick unless given its own period
+	char * collector_periods = NULL;
+	int collect_threads = DEFAULT_COLLECT_WORKERS;
+	// the node's own files unless a fake tree / trace is given
+	char * root_dir = "";
+	char * record_trace_file = NULL;
+	char * replay_trace_file = NULL;
 	
 
 	static struct option long_options[] = {
@@ -597,12 +287,31 @@ int main(int argc, char ** argv, char * envp[]){
 		{"sample_freq_millis", required_argument, 0, 's'},
 		{"n_samples_per_buffer", required_argument, 0, 'n'},
 		{"output_dir", required_argument, 0, 'o'},
+		{"queue_depth", required_argument, 0, 'q'},
+		{"overflow_policy", required_argument, 0, 'p'},
+		{"storage_mode", required_argument, 0, 'm'},
+		{"gpu_backend", required_argument, 0, 'g'},
+		{"per_cpu", no_argument, 0, 'c'},
+		{"cpu_time", required_argument, 0, 'u'},
+		{"max_jobs", required_argument, 0, 'j'},
+		{"job_socket", required_argument, 0, 'e'},
+		{"sacct_interval_secs", required_argument, 0, 'r'},
+		{"net_stats", required_argument, 0, 'l'},
+		{"port_counters", required_argument, 0, 'i'},
+		{"sysfs_root", required_argument, 0, 'S'},
+		{"adaptive_base_millis", required_argument, 0, 'a'},
+		{"adaptive_threshold_pct", required_argument, 0, 'A'},
+		{"collector_periods", required_argument, 0, 'R'},
+		{"collect_threads", required_argument, 0, 'T'},
+		{"root_dir", required_argument, 0, 'P'},
+		{"record_trace", required_argument, 0, 'W'},
+		{"replay_trace", required_argument, 0, 'X'},
 		{0, 0, 0, 0}
 	};
 
 	int opt_index = 0;
 	int opt;
-	while ((opt = getopt_long(argc, argv, "f:s:n:o:", long_options, &opt_index)) != -1){
+	while ((opt = getopt_long(argc, argv, "f:s:n:o:q:p:m:g:cu:j:e:r:l:i:S:a:A:R:T:P:W:X:", long_options, &opt_index)) != -1){
 		switch (opt){
 			case 'f': field_ids_string = optarg;
 				break;
@@ -612,6 +321,64 @@ int main(int argc, char ** argv, char * envp[]){
 				break;
 			case 'o': output_dir = optarg;
 				break;
+			case 'q': queue_depth = atoi(optarg);
+				break;
+			case 'p': 
+				if (parse_overflow_policy(optarg, &overflow_policy) == -1){
+					print_usage();
+					exit(1);
+				}
+				break;
+			case 'm':
+				if (parse_storage_mode(optarg, &storage_mode) == -1){
+					print_usage();
+					exit(1);
+				}
+				break;
+			case 'g':
+				if (parse_gpu_backend(optarg, &gpu_backend, &gpu_backend_options) == -1){
+					print_usage();
+					exit(1);
+				}
+				break;
+			case 'c': per_cpu = true;
+				break;
+			case 'u':
+				if (parse_cpu_time_source(optarg, &cpu_time_source) == -1){
+					print_usage();
+					exit(1);
+				}
+				break;
+			case 'j': max_jobs = atoi(optarg);
+				break;
+			case 'e': job_socket_path = optarg;
+				break;
+			case 'r': sacct_interval_secs = atol(optarg);
+				break;
+			case 'l':
+				if (parse_net_stats_source(optarg, &net_stats_source) == -1){
+					print_usage();
+					exit(1);
+				}
+				break;
+			case 'i': port_counter_set = optarg;
+				break;
+			case 'S': sysfs_root = optarg;
+				break;
+			case 'a': adaptive_base_millis = atoi(optarg);
+				break;
+			case 'A': adaptive_threshold_pct = atof(optarg);
+				break;
+			case 'R': collector_periods = optarg;
+				break;
+			case 'T': collect_threads = atoi(optarg);
+				break;
+			case 'P': root_dir = optarg;
+				break;
+			case 'W': record_trace_file = optarg;
+				break;
+			case 'X': replay_trace_file = optarg;
+				break;
 			default: print_usage();
 				exit(1);
 		}
@@ -631,61 +398,6 @@ int main(int argc, char ** argv, char * envp[]){
 	unsigned short * fieldIds = parse_string_to_arr(field_ids_string, &n_fields);
 
 
-	/* DCGM SETUP */
-	dcgmReturn_t dcgm_ret; 
-	dcgm_ret = dcgmInit();
-
-	if (dcgm_ret != DCGM_ST_OK){
-		fprintf(stderr, "INIT ERROR, Exiting...\n");
-		cleanup_and_exit(dcgm_ret, NULL, NULL, NULL);
-	}
-
-	dcgmHandle_t dcgmHandle;
-	// Start embedded process
-	dcgm_ret = dcgmStartEmbedded(DCGM_OPERATION_MODE_MANUAL, &dcgmHandle);
-
-	if (dcgm_ret != DCGM_ST_OK){
-		fprintf(stderr, "CONNECT ERROR, Exiting...\n");
-		cleanup_and_exit(dcgm_ret, &dcgmHandle, NULL, NULL);
-	}
-
-
-	/* READ SYSTEM INFO */
-
-	unsigned int gpuIdList[DCGM_MAX_NUM_DEVICES];
-	int n_devices;
-
-	dcgm_ret = dcgmGetAllSupportedDevices(dcgmHandle, gpuIdList, &n_devices);
-
-	if (dcgm_ret != DCGM_ST_OK){
-		fprintf(stderr, "GET DEVICES ERROR, Exiting...\n");
-		cleanup_and_exit(dcgm_ret, &dcgmHandle, NULL, NULL);
-	}	
-
-	// no GPUs in system
-	if (n_devices == 0){
-		fprintf(stderr, "No GPUs in System, Exiting...\n");
-		cleanup_and_exit(dcgm_ret, &dcgmHandle, NULL, NULL);
-	}
-	//printf("Found %d GPUs\n", n_devices);
-
-	// create group with all devices
-
-	// GROUP_DEFAULT creates group with all entities present on system
-	char groupName[] = "MyGroup";
-	dcgmGpuGrp_t groupId;
-	dcgm_ret = dcgmGroupCreate(dcgmHandle, DCGM_GROUP_DEFAULT, groupName, &groupId);
-
-	if (dcgm_ret != DCGM_ST_OK){
-		fprintf(stderr, "GROUP CREATE ERROR, Exiting...\n");
-		cleanup_and_exit(dcgm_ret, &dcgmHandle, &groupId, NULL);
-	}
-
-	// create field group with all the metrics we want to scan
-
-	dcgmFieldGrp_t fieldGroupId;
-	char fieldGroupName[] = "MyFieldGroup";
-
 	/* DEFAULT FIELDS BEING COLLECTED */
 
 	/* 203: COASE GPU UTIL
@@ -700,64 +412,141 @@ int main(int argc, char ** argv, char * envp[]){
 	 * 1012: NVLink Recv Bytes 
 	*/
 
-	// from command line args
+	/* COLLECTOR PERIODS */
+	Collector_Wheel * collector_wheel = init_collector_wheel((long) sample_freq_millis * 1000000L, collector_periods);
+	if (collector_wheel == NULL){
+		print_usage();
+		exit(1);
+	}
+	long gpu_period_millis = get_collector_period_millis(collector_wheel, COLLECTOR_GPU);
 
-	dcgm_ret = dcgmFieldGroupCreate(dcgmHandle, n_fields, fieldIds, fieldGroupName, &fieldGroupId);
-	if (dcgm_ret != DCGM_ST_OK){
-		fprintf(stderr, "FIELD GROUP CREATE ERROR, Exiting...\n");
-		cleanup_and_exit(dcgm_ret, &dcgmHandle, &groupId, &fieldGroupId);
+	// batch mode fills the GPU columns long after the tick, too late to decide the next period,
+	// and drains on the buffer's last sample, so it has to run every tick
+	char * batch_secs_option = (gpu_backend == GPU_BACKEND_DCGM) ? get_gpu_backend_option(gpu_backend_options, "batch_secs") : NULL;
+	if ((batch_secs_option != NULL) && ((adaptive_base_millis > 0) || (gpu_period_millis != sample_freq_millis))){
+		fprintf(stderr, "dcgm batch_secs can't be used with the adaptive sampling rate or its own gpu period\n");
+		print_usage();
+		exit(1);
 	}
-	// watch fields by combining device group and field group
+	free(batch_secs_option);
 
-	// update every second
-	// sample freq millis from command line
-	long long update_freq_micros = sample_freq_millis * 1000;
+	/* GPU SOURCE SETUP */
+	// DCGM watches the fields at the gpu collector's period and caches at most one buffer's worth
+	int max_keep_samples = n_samples_per_buffer;
+	Gpu_Source * gpu_source = open_gpu_source(gpu_backend, gpu_backend_options, n_fields, fieldIds, (int) gpu_period_millis, max_keep_samples);
+	if (gpu_source == NULL){
+		fprintf(stderr, "Could not start GPU collection, Exiting...\n");
+		exit(1);
+	}
 
-	// don't cache old metrics for more than 1 sec
-	double max_keep_seconds = 1;
+	int n_devices = gpu_source -> n_devices;
+	unsigned short * fieldTypes = gpu_source -> field_types;
+	//printf("Found %d GPUs\n", n_devices);
 
-	int max_keep_samples = n_samples_per_buffer;
 
-	dcgm_ret = dcgmWatchFields(dcgmHandle, groupId, fieldGroupId, update_freq_micros, max_keep_seconds, max_keep_samples);
+	int n_cpu = sysconf(_SC_NPROCESSORS_ONLN);
+	int clk_tck = sysconf(_SC_CLK_TCK);
+
+	// per-core slots cover every configured cpu so the ids in /proc/stat stay valid if cpus come online
+	int n_core_cpu = per_cpu ? (int) sysconf(_SC_NPROCESSORS_CONF) : 0;
+	int n_core_bytes = N_CORE_UTIL_COLUMNS * n_core_cpu;
 
-	if (dcgm_ret != DCGM_ST_OK){
-		fprintf(stderr, "WATCH FIELDS ERROR, Exiting...\n");
-		cleanup_and_exit(dcgm_ret, &dcgmHandle, &groupId, &fieldGroupId);
+	/* FILE TRACE */
+	// has to be in place before any counter file is opened
+	if ((record_trace_file != NULL) && (replay_trace_file != NULL)){
+		fprintf(stderr, "Can't record and replay a trace at the same time\n");
+		print_usage();
+		cleanup_and_exit(-1, gpu_source);
+	}
+	File_Trace * file_trace = NULL;
+	if (record_trace_file != NULL){
+		file_trace = open_file_trace(record_trace_file, FILE_TRACE_RECORD, root_dir);
+	}
+	else if (replay_trace_file != NULL){
+		file_trace = open_file_trace(replay_trace_file, FILE_TRACE_REPLAY, root_dir);
+	}
+	if ((record_trace_file != NULL) || (replay_trace_file != NULL)){
+		if (file_trace == NULL){
+			print_usage();
+			cleanup_and_exit(-1, gpu_source);
+		}
+		set_file_trace(file_trace);
 	}
 
-	/* FINISHED INIT SETUP FOR DCGM, NOW INIT THE SAMPLE BUFFER TO STORE VALUES*/
-	DcgmFieldsInit();
+	// an rtnetlink dump doesn't go through files, so it can't be faked, recorded or replayed
+	if ((net_stats_source == NET_STATS_NETLINK) && ((root_dir[0] != '\0') || (file_trace != NULL))){
+		printf("Reading interface counters from sysfs (a root dir or trace was given)\n");
+		net_stats_source = NET_STATS_SYSFS;
+	}
 
-	unsigned short * fieldTypes = (unsigned short *) malloc(n_fields * sizeof(unsigned short));
-	dcgm_field_meta_p meta_ptr;
-	for (int i = 0 ; i < n_fields; i++){
-		meta_ptr = DcgmFieldGetById(fieldIds[i]);
-		if (meta_ptr == NULL){
-			fprintf(stderr, "Unknown field %d\n", fieldIds[i]);
-			print_usage();
-			cleanup_and_exit(dcgm_ret, &dcgmHandle, &groupId, &fieldGroupId);
+	char * default_sysfs_root = NULL;
+	if (sysfs_root == NULL){
+		asprintf(&default_sysfs_root, "%s/sys", root_dir);
+		sysfs_root = default_sysfs_root;
+	}
+
+	// counter files stay open for the whole run
+	Proc_Stat_Reader * proc_stat_reader = init_proc_stat_reader(root_dir, n_core_cpu);
+	if (proc_stat_reader == NULL){
+		cleanup_and_exit(-1, gpu_source);
+	}
+
+	Mem_Info_Reader * mem_info_reader = init_mem_info_reader(root_dir);
+	if (mem_info_reader == NULL){
+		cleanup_and_exit(-1, gpu_source);
+	}
+
+	// ns counters replace the tick based util % (memory comes from process_mem_info)
+	Cpu_Time_Reader * cpu_time_reader = NULL;
+	if (cpu_time_source != CPU_TIME_TICKS){
+		cpu_time_reader = init_cpu_time_reader(root_dir, cpu_time_source, n_cpu);
+		if (cpu_time_reader == NULL){
+			cleanup_and_exit(-1, gpu_source);
 		}
-		fieldTypes[i] = (unsigned short) meta_ptr -> fieldType;
 	}
-	
 
+	Job_Cgroups * job_cgroups = NULL;
+	if (max_jobs > 0){
+		job_cgroups = init_job_cgroups(root_dir, max_jobs);
+		if (job_cgroups == NULL){
+			cleanup_and_exit(-1, gpu_source);
+		}
+	}
 
-	int n_cpu = sysconf(_SC_NPROCESSORS_ONLN);
-	int clk_tck = sysconf(_SC_CLK_TCK);
+	Interface_Totals * interface_totals = init_interface_totals(root_dir, net_stats_source);
+	if (interface_totals == NULL){
+		cleanup_and_exit(-1, gpu_source);
+	}
 
-	Samples_Buffer * samples_buffer = init_samples_buffer(n_cpu, clk_tck, n_devices, n_fields, fieldIds, fieldTypes, n_samples_per_buffer);
-	if (samples_buffer == NULL){
-		cleanup_and_exit(dcgm_ret, &dcgmHandle, &groupId, &fieldGroupId);
+	Port_Counters * port_counters = NULL;
+	int n_port_series = 0;
+	if (port_counter_set != NULL){
+		port_counters = init_port_counters(sysfs_root, port_counter_set);
+		if (port_counters == NULL){
+			print_usage();
+			cleanup_and_exit(-1, gpu_source);
+		}
+		n_port_series = port_counters -> n_series;
+	}
+
+	// one buffer being filled, one being written and queue_depth waiting for the writer
+	if (queue_depth < 1){
+		fprintf(stderr, "Queue depth must be at least 1\n");
+		print_usage();
+		cleanup_and_exit(-1, gpu_source);
+	}
+	int n_buffers = queue_depth + 2;
+	Samples_Buffer ** buffers = (Samples_Buffer **) malloc(n_buffers * sizeof(Samples_Buffer *));
+	if (buffers == NULL){
+		fprintf(stderr, "Could not allocate memory for samples buffers, exiting...\n");
+		cleanup_and_exit(-1, gpu_source);
 	}
 	
 	struct timespec time;
-	int n_samples, err;
-	Sample * cur_sample;
+	int n_samples;
 
 	Proc_Data * cpu_util;
-	Proc_Data * prev_proc_data = NULL;
 
-	Net_Data * net_util;
 
 
 	/* CREATING METRICS TABLE */
@@ -770,18 +559,20 @@ int main(int argc, char ** argv, char * envp[]){
 	sql_ret = sqlite3_open(db_filename, &db);
 	if (sql_ret != SQLITE_OK){
 		fprintf(stderr, "COULD NOT OPEN SQL DB at filepath: %s. Exiting...\n", db_filename);
-		cleanup_and_exit(-1, &dcgmHandle, &groupId, &fieldGroupId);
+		cleanup_and_exit(-1, gpu_source);
 	}
 	free(db_filename);
 
-	char * create_table_cmd = "CREATE TABLE IF NOT EXISTS Data (timestamp INT, device_id INT, field_id INT, value INT);";
-	char * sqlErr;
+	// Data table (eav) or Host_Samples + Gpu_Samples with a Data view (wide)
+	if (create_storage_tables(db, storage_mode, n_fields, fieldIds) == -1){
+		cleanup_and_exit(-1, gpu_source);
+	}
 
-	sql_ret = sqlite3_exec(db, create_table_cmd, NULL, NULL, &sqlErr);
-	if (sql_ret != SQLITE_OK){
-		fprintf(stderr, "SQL Error: %s\n", sqlErr);
-		cleanup_and_exit(-1, &dcgmHandle, &groupId, &fieldGroupId);
+	// names of the per-port series, every sample only carries their ids
+	if ((port_counters != NULL) && (register_port_series(db, n_port_series, port_counters -> series_ports, port_counters -> series_counters, port_counters -> series_ids) == -1)){
+		cleanup_and_exit(-1, gpu_source);
 	}
+	char * sqlErr;
 
 	/* CREATING JOBS TABLE */
 	const char * jobs_table_creation = "CREATE TABLE IF NOT EXISTS Jobs ("
@@ -807,67 +598,219 @@ int main(int argc, char ** argv, char * envp[]){
         sql_ret = sqlite3_exec(db, jobs_table_creation, NULL, NULL, &sqlErr);
 	if (sql_ret != SQLITE_OK){
 		fprintf(stderr, "SQL Error: %s\n", sqlErr);
-		cleanup_and_exit(-1, &dcgmHandle, &groupId, &fieldGroupId);
+		cleanup_and_exit(-1, gpu_source);
 	}
 
 	
 	long time_sec;
         long prev_job_collection_time = 0;
-	
-	struct timespec iter_end;
+
+	/* WRITER CONNECTION */
+	// the writer thread has its own connection for the dumps and the job events / sacct results
+	// handed to it (see WRITER TASKS in writer.h), the sampling loop never waits on SQLite
+	sqlite3 * writer_db;
+	asprintf(&db_filename, "%s/%s.db", output_dir, hostbuffer);
+	sql_ret = sqlite3_open(db_filename, &writer_db);
+	if (sql_ret != SQLITE_OK){
+		fprintf(stderr, "COULD NOT OPEN SQL DB at filepath: %s. Exiting...\n", db_filename);
+		cleanup_and_exit(-1, gpu_source);
+	}
+	free(db_filename);
+
+	// both connections write to the same file, wait on each other's locks instead of failing
+	sqlite3_busy_timeout(db, 60000);
+	sqlite3_busy_timeout(writer_db, 60000);
+
+	/* JOB EVENTS */
+	// with live events sacct only has to catch what the prolog / epilog missed
+	if (sacct_interval_secs <= 0){
+		sacct_interval_secs = (job_socket_path != NULL) ? 6 * 60 * 60 : 60 * 60;
+	}
+	Job_Event_Listener * job_event_listener = NULL;
+	if (job_socket_path != NULL){
+		job_event_listener = init_job_event_listener(job_socket_path, writer_db);
+		if (job_event_listener == NULL){
+			cleanup_and_exit(-1, gpu_source);
+		}
+	}
+
+	/* SACCT */
+	// the first run ever looks back one interval, later ones continue where the last left off
+	Sacct_Collector * sacct_collector = init_sacct_collector(writer_db, hostbuffer, sacct_interval_secs);
+	if (sacct_collector == NULL){
+		cleanup_and_exit(-1, gpu_source);
+	}
+
+	/* STARTING WRITER THREAD */
+	// insert statements are prepared once here and reused for every dump
+	Storage * storage = init_storage(writer_db, storage_mode, STORAGE_BATCH_ROWS, n_fields, fieldIds);
+	if (storage == NULL){
+		cleanup_and_exit(-1, gpu_source);
+	}
+
+	// compressed chunks go next to the db as <hostname>.mts
+	if (storage_mode == STORAGE_COLUMNAR){
+		char * columnar_filename;
+		asprintf(&columnar_filename, "%s/%s.mts", output_dir, hostbuffer);
+		storage -> columnar_writer = open_columnar_writer(columnar_filename);
+		free(columnar_filename);
+		if (storage -> columnar_writer == NULL){
+			cleanup_and_exit(-1, gpu_source);
+		}
+	}
+
+	/* CRASH-SAFE SAMPLE BUFFERS */
+	// flush whatever a killed previous run had collected but not written, then map fresh buffers
+	char * ring_filename;
+	asprintf(&ring_filename, "%s/%s.ring", output_dir, hostbuffer);
+	// recovery migrates the tables to the killed run's field list, the Data view has to show this run's again
+	if ((recover_mapped_buffers(ring_filename, writer_db, storage_mode, storage -> columnar_writer) != 0) && (create_storage_tables(writer_db, storage_mode, n_fields, fieldIds) == -1)){
+		cleanup_and_exit(-1, gpu_source);
+	}
+	Mapped_Buffers * mapped_buffers = open_mapped_buffers(ring_filename, n_buffers, n_samples_per_buffer, n_devices, n_fields, n_core_bytes, max_jobs, n_port_series, fieldIds, fieldTypes, (port_counters != NULL) ? port_counters -> series_ids : NULL);
+	free(ring_filename);
+	if (mapped_buffers == NULL){
+		cleanup_and_exit(-1, gpu_source);
+	}
+
+	for (int i = 0; i < n_buffers; i++){
+		buffers[i] = init_samples_buffer(n_cpu, clk_tck, n_core_bytes, max_jobs, n_port_series, (port_counters != NULL) ? port_counters -> series_ids : NULL, n_devices, n_fields, fieldIds, fieldTypes, gpu_source -> field_lookup, n_samples_per_buffer, interface_totals, mapped_buffers, i);
+		if (buffers[i] == NULL){
+			cleanup_and_exit(-1, gpu_source);
+		}
+	}
+
+	Buffer_Writer * writer = init_buffer_writer(storage, buffers, queue_depth, overflow_policy);
+	if (writer == NULL){
+		cleanup_and_exit(-1, gpu_source);
+	}
+
+	Samples_Buffer * samples_buffer = acquire_samples_buffer(writer);
+
+	// wake on absolute deadlines instead of sleeping a fixed amount after the work
+	Tick_Scheduler * scheduler = init_tick_scheduler((long) sample_freq_millis * 1000000L);
+	if (scheduler == NULL){
+		cleanup_and_exit(-1, gpu_source);
+	}
+
+	// idle nodes drop to the base period, each sample records the period it covers
+	Adaptive_Rate * adaptive_rate = NULL;
+	if (adaptive_base_millis > 0){
+		adaptive_rate = init_adaptive_rate((long) sample_freq_millis * 1000000L, (long) adaptive_base_millis * 1000000L, adaptive_threshold_pct, n_fields, fieldIds);
+		if (adaptive_rate == NULL){
+			print_usage();
+			cleanup_and_exit(-1, gpu_source);
+		}
+	}
+	int n_job_events = 0;
+	unsigned int due_collectors;
+
+	// the GPU update, /proc, the network counters and the job cgroups run side by side
+	Collect_Pool * collect_pool = init_collect_pool(collect_threads);
+	if (collect_pool == NULL){
+		cleanup_and_exit(-1, gpu_source);
+	}
+	Tick_Context tick_context;
+	memset(&tick_context, 0, sizeof(Tick_Context));
+	tick_context.gpu_source = gpu_source;
+	tick_context.proc_stat_reader = proc_stat_reader;
+	tick_context.mem_info_reader = mem_info_reader;
+	tick_context.cpu_time_reader = cpu_time_reader;
+	tick_context.job_cgroups = job_cgroups;
+	tick_context.port_counters = port_counters;
+	set_collect_task(collect_pool, COLLECT_TASK_GPU, collect_gpu_task, &tick_context);
+	set_collect_task(collect_pool, COLLECT_TASK_PROC, collect_proc_task, &tick_context);
+	set_collect_task(collect_pool, COLLECT_TASK_NET, collect_net_task, &tick_context);
+	set_collect_task(collect_pool, COLLECT_TASK_JOBS, collect_jobs_task, &tick_context);
+	long stage_ns[N_COLLECT_TASKS];
+	long collect_ns;
+
+	// what the monitor itself costs (Self_Samples), without /proc/self/statm the samples carry none
+	Self_Stats_Reader * self_stats_reader = init_self_stats_reader();
+	Self_Sample * self_sample;
+	long n_missed_ticks;
+	long dump_ns_total, dump_bytes_total;
+	int queue_len;
 
 
 	// For now, run indefinitely 
 	while (true){
+		n_missed_ticks = wait_next_tick(scheduler);
+
+		// SOURCES DUE ON THIS TICK
+		due_collectors = advance_collector_wheel(collector_wheel, scheduler -> sample_period_ns);
+
 		n_samples = samples_buffer -> n_samples;
 		clock_gettime(CLOCK_REALTIME, &time);
 
-		// CHECK TO SEE IF IT HAS BEEN AN HOUR SINCE LAST JOB STATUS QUERY
-                // IF SO, CALL PYTHON SCRIPT TO COLLECT INFO FROM SACCT AND DUMP TO DIFFERENT DB
+		// NEXT TICK OF THE TRACE (a replay stamps samples with the time they were recorded)
+		if (file_trace != NULL){
+			if (advance_file_trace(file_trace, time.tv_sec * 1000000000L + time.tv_nsec) == 0){
+				printf("Replayed every tick of the trace, exiting...\n");
+				break;
+			}
+			if (file_trace -> mode == FILE_TRACE_REPLAY){
+				time.tv_sec = file_trace -> tick_timestamp_ns / 1000000000L;
+				time.tv_nsec = file_trace -> tick_timestamp_ns % 1000000000L;
+			}
+		}
+
+		// JOB STARTS / ENDS PUSHED SINCE THE LAST TICK
+		if (job_event_listener != NULL){
+			n_job_events = process_job_events(job_event_listener, writer);
+		}
+
+		// CHECK TO SEE IF IT HAS BEEN sacct_interval_secs SINCE LAST JOB STATUS QUERY
+                // IF SO, START SACCT IN THE BACKGROUND, ITS OUTPUT IS PICKED UP OVER THE NEXT TICKS
                 time_sec = time.tv_sec;
-                if ((time_sec - prev_job_collection_time) > (60 * 60)){
-                       	collect_job_stats(db, output_dir, hostbuffer, time_sec);
+                if ((time_sec - prev_job_collection_time) > sacct_interval_secs){
+                       	start_sacct(sacct_collector, time_sec);
                         prev_job_collection_time = time_sec;
                 }
+		poll_sacct(sacct_collector, time_sec, writer);
 
-		cur_sample = &((samples_buffer -> samples)[n_samples]);
-		cur_sample -> time = time;
-		
-		// COLLECT CPU FREE MEM AND COMPUTE %
-		cpu_util = process_proc_stat(cur_sample, prev_proc_data);
-		cur_sample -> cpu_util = cpu_util;
-
-		// set the previous to be current so as to accurately compute util % next time
-		prev_proc_data = cpu_util;
-
-		// COLLECT NETWORK DATA
-		net_util = process_net_stat(cur_sample, samples_buffer -> interface_totals);
-		cur_sample -> net_util = net_util;
-
-		// COLLECT GPU VALUES
+		samples_buffer -> times[n_samples] = time;
+		samples_buffer -> periods_ms[n_samples] = scheduler -> sample_period_ns / 1000000L;
+		samples_buffer -> skipped_collectors[n_samples] = ALL_COLLECTORS & ~due_collectors;
 		
 		if (PRINT) {
 			printf("Time %ld: Collecting Values...\n", time.tv_sec);
 		}
 
-		// update fields (and wait for return)
-		dcgm_ret = dcgmUpdateAllFields(dcgmHandle, 1);
-		if (dcgm_ret != DCGM_ST_OK){
-			fprintf(stderr, "UPDATE ALL FIELDS ERROR, Exiting...\n");
-                        cleanup_and_exit(dcgm_ret, &dcgmHandle, &groupId, &fieldGroupId);
+		// COLLECT CPU, MEM, NETWORK, JOB AND GPU VALUES CONCURRENTLY
+		//	- one barrier merges every task's columns into the sample
+		tick_context.samples_buffer = samples_buffer;
+		tick_context.n_samples = n_samples;
+		tick_context.due_collectors = due_collectors;
+		collect_pool -> tasks[COLLECT_TASK_GPU].due = (due_collectors & COLLECTOR_BIT(COLLECTOR_GPU)) != 0;
+		collect_pool -> tasks[COLLECT_TASK_PROC].due = (due_collectors & (COLLECTOR_BIT(COLLECTOR_PROC) | COLLECTOR_BIT(COLLECTOR_MEMINFO))) != 0;
+		collect_pool -> tasks[COLLECT_TASK_NET].due = (due_collectors & COLLECTOR_BIT(COLLECTOR_NET)) != 0;
+		collect_pool -> tasks[COLLECT_TASK_JOBS].due = (job_cgroups != NULL) && (due_collectors & COLLECTOR_BIT(COLLECTOR_JOBS));
+		collect_ns = run_collect_tasks(collect_pool);
+		if (file_trace != NULL){
+			end_file_trace_tick(file_trace);
 		}
+		for (int i = 0; i < N_COLLECT_TASKS; i++){
+			stage_ns[i] = collect_pool -> tasks[i].duration_ns;
+		}
+		add_tick_stages(scheduler, collect_ns, stage_ns, N_COLLECT_TASKS);
+		cpu_util = tick_context.cpu_util;
 
-		// retrieve values
-		dcgm_ret = dcgmGetLatestValues(dcgmHandle, groupId, fieldGroupId, &copy_field_values_function, (void *) samples_buffer);
-		
-		if (dcgm_ret != DCGM_ST_OK){
-			fprintf(stderr, "GET LATEST VALUES ERROR, Exiting...\n");
-			cleanup_and_exit(dcgm_ret, &dcgmHandle, &groupId, &fieldGroupId);
+		self_sample = &(samples_buffer -> self_samples[n_samples]);
+		self_sample -> collect_ns = collect_ns;
+		for (int i = 0; i < N_COLLECT_TASKS; i++){
+			self_sample -> stage_ns[i] = stage_ns[i];
+		}
+		self_sample -> n_missed_ticks = (int) n_missed_ticks;
+
+		if (collect_pool -> tasks[COLLECT_TASK_GPU].ret == -1){
+			fprintf(stderr, "GPU COLLECTION ERROR, Exiting...\n");
+			cleanup_and_exit(-1, gpu_source);
 		}
 		
 		if (PRINT) {
 			if (cpu_util != NULL){
-				printf("CPU Stats. Util: %d, Free Mem: %d\n\nGPU Stats:\n", (int) round(cur_sample -> cpu_util -> util_pct), (int) (cur_sample -> cpu_util -> free_mem));
+				printf("CPU Stats. Util: %d, Free Mem: %d\n\nGPU Stats:\n", (int) round(cpu_util -> util_pct), (int) (cpu_util -> free_mem));
 			}
 			else{
 				printf("Could not retrieve CPU stats\n");
@@ -875,7 +818,7 @@ int main(int argc, char ** argv, char * envp[]){
 		}
 		
 		if (PRINT) {
-			void * field_values = cur_sample -> field_values;
+			void * field_column;
 			int ind;
 			unsigned short fieldId, fieldType;
 			for (int gpuId = 0; gpuId < n_devices; gpuId++){
@@ -883,20 +826,21 @@ int main(int argc, char ** argv, char * envp[]){
 					ind = gpuId * n_fields + fieldNum;
 					fieldId = fieldIds[fieldNum];
 					fieldType = fieldTypes[fieldNum];
+					field_column = FIELD_COLUMN(samples_buffer, ind);
 					switch (fieldType) {
-						case DCGM_FT_DOUBLE:
-							printf("GPU ID: %d, Field ID: %u, Value: %d\n", gpuId, fieldId, (int) round((((double *) field_values)[ind] * 100)));
+						case GPU_FT_DOUBLE:
+							printf("GPU ID: %d, Field ID: %u, Value: %d\n", gpuId, fieldId, (int) round((((double *) field_column)[n_samples] * 100)));
 							break;
-						case DCGM_FT_INT64:
-							printf("GPU ID: %d, Field ID: %u, Value: %d\n", gpuId, fieldId, (int) (((long *) field_values)[ind]));
+						case GPU_FT_INT64:
+							printf("GPU ID: %d, Field ID: %u, Value: %d\n", gpuId, fieldId, (int) (((long *) field_column)[n_samples]));
 							break;
-						case DCGM_FT_TIMESTAMP:
-							printf("GPU ID: %d, Field ID: %u, Value: %d\n", gpuId, fieldId, (int) (((long *) field_values)[ind]));
+						case GPU_FT_TIMESTAMP:
+							printf("GPU ID: %d, Field ID: %u, Value: %d\n", gpuId, fieldId, (int) (((long *) field_column)[n_samples]));
 							break;
 						default:
 							printf("Error in Field Value Types...");
 							printf("GPU ID: %d, Field ID: %u\n", gpuId, fieldId);
-							cleanup_and_exit(dcgm_ret, &dcgmHandle, &groupId, &fieldGroupId);
+							cleanup_and_exit(-1, gpu_source);
 							break;
 					}
 				}
@@ -905,39 +849,87 @@ int main(int argc, char ** argv, char * envp[]){
 		}
 		
 		
-		n_samples++;
-		samples_buffer -> n_samples = n_samples;
-		// SAVING VALUES
-		if (n_samples == n_samples_per_buffer){
-			err = dump_samples_buffer(samples_buffer, db);
-			if (err == -1){
-				fprintf(stderr, "Error dumping buffer to file. Skipping this dump and collecting new data...\n");
-			}
-			samples_buffer -> n_samples = 0;
+		// next tick at the full rate as soon as this sample shows activity
+		if (adaptive_rate != NULL){
+			update_adaptive_rate(adaptive_rate, scheduler, is_sample_active(adaptive_rate, samples_buffer, n_samples, n_job_events));
 		}
 
+		// MONITOR SELF-TELEMETRY, cpu time up to the end of the tick's work
+		if (self_stats_reader != NULL){
+			get_writer_totals(writer, &dump_ns_total, &dump_bytes_total, &queue_len);
+			self_sample -> queue_len = queue_len;
+			process_self_stats(self_stats_reader, self_sample, dump_ns_total, dump_bytes_total);
+		}
 
-                //clock_gettime(CLOCK_REALTIME, &iter_end);
+		n_samples++;
+		samples_buffer -> n_samples = n_samples;
+		// sample is complete in the mapping, it survives a crash from here on
+		commit_mapped_sample(mapped_buffers, samples_buffer);
 
-		//long start_timestamp = time.tv_sec * 1e9 + time.tv_nsec;
-		//long end_timestamp = iter_end.tv_sec * 1e9 + iter_end.tv_nsec;
-		//long elapsed_time_ns = end_timestamp - start_timestamp;
-		//printf("%ld,%d,%ld,%ld\n", elapsed_time_ns, n_samples, start_timestamp, end_timestamp);
+		end_tick(scheduler);
 
-		usleep(update_freq_micros);
+		// SAVING VALUES
+		if (n_samples == n_samples_per_buffer){
+			// hand over the tick stats for this buffer and start a new window
+			samples_buffer -> tick_stats = scheduler -> stats;
+			reset_tick_stats(&(scheduler -> stats));
+			// writer thread dumps it, keep sampling into an empty one
+			samples_buffer = submit_samples_buffer(writer, samples_buffer);
+		}
 	}
 
-	// shouldn't reach this point because inifinte loop collecting data
-	// free's field value memory in this funciton
-	dump_samples_buffer(samples_buffer, db);
+	// only reached at the end of a replayed trace, otherwise the loop collects until killed
+	// flush the partial buffer, writer thread dumps everything queued before exiting
+	submit_samples_buffer(writer, samples_buffer);
+	stop_buffer_writer(writer);
+	if (storage -> columnar_writer != NULL){
+		close_columnar_writer(storage -> columnar_writer);
+	}
+	destroy_storage(storage);
+	// their statements are on writer_db
+	if (job_event_listener != NULL){
+		destroy_job_event_listener(job_event_listener);
+	}
+	destroy_sacct_collector(sacct_collector);
+	sqlite3_close(writer_db);
 
-	// destroy the buffer
+	// destroy the buffers
 	free(fieldIds);
-	free(fieldTypes);
-	free(samples_buffer -> samples);
-	free(samples_buffer);
+	for (int i = 0; i < n_buffers; i++){
+		if (buffers[i] -> mapped_slot == NULL){
+			free_samples_arena(buffers[i]);
+		}
+		free(buffers[i] -> gpu_values);
+		free(buffers[i]);
+	}
+	free(buffers);
+	close_mapped_buffers(mapped_buffers);
+	free(writer);
+	free(scheduler);
+	free(adaptive_rate);
+	free(collector_wheel);
+	destroy_collect_pool(collect_pool);
+	destroy_self_stats_reader(self_stats_reader);
 	free(hostbuffer);
+	// closing the readers isn't part of the trace (a recording usually ends with the monitor killed)
+	set_file_trace(NULL);
+	destroy_proc_stat_reader(proc_stat_reader);
+	destroy_mem_info_reader(mem_info_reader);
+	if (cpu_time_reader != NULL){
+		destroy_cpu_time_reader(cpu_time_reader);
+	}
+	if (job_cgroups != NULL){
+		destroy_job_cgroups(job_cgroups);
+	}
+	destroy_interface_totals(interface_totals);
+	if (port_counters != NULL){
+		destroy_port_counters(port_counters);
+	}
+	free(default_sysfs_root);
+	if (file_trace != NULL){
+		close_file_trace(file_trace);
+	}
 	// AT END
-	cleanup_and_exit(DCGM_ST_OK, &dcgmHandle, &groupId, &fieldGroupId);
+	cleanup_and_exit(0, gpu_source);
 
 }
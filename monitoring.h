@@ -1,3 +1,7 @@
+#include <stdint.h>
+
+#include "scheduler.h"
+
 
 typedef struct Proc_Data {
 	long free_mem;
@@ -13,6 +17,16 @@ typedef struct interface_totals {
 	char ** ib_ifs;
 	int n_eth_ifs;
 	char ** eth_ifs;
+	int n_ib_ports;
+	// counter files opened once (see host_stats.h), -1 where a file is missing
+	//	- ib_port_fds[p * N_IB_PORT_COUNTER_FILES + IB_PORT_*], ib_fds[i * N_IB_COUNTER_FILES + IB_SYS_*],
+	//	  eth_fds[i * N_ETH_COUNTER_FILES + ETH_*]
+	int * ib_port_fds;
+	int * ib_fds;
+	int * eth_fds;
+	// --net_stats=netlink: the statistics files aren't opened, the ib_sys_* and eth_* columns
+	// come from one rtnetlink dump per tick (see net_link.h), NULL for sysfs
+	struct net_link_reader * net_link_reader;
 	// THESE ARE CUMULATIVE TOTALS
 	//      - each sample will record the difference and save most recent value
 	//      - raw values from /sys/class/net/<ifname>/statistics
@@ -35,28 +49,155 @@ typedef struct net_data {
 	long eth_tx_bytes;
 } Net_Data;
 
+// PER-JOB RESOURCES (-j, from the job's cgroup v2 files, see job_cgroups.h)
+//	- max_jobs slots per sample, job_id 0 marks an empty slot
+//	- cpu and io values are since the previous sample (0 on the job's first sample)
+// one bit per GPU in Job_Sample -> gpu_mask
+#define MAX_JOB_GPUS 64
 
-typedef struct sample {
-	struct timespec time;
-	void * field_values;
-	Proc_Data * cpu_util;
-	Net_Data * net_util;
-} Sample;
+typedef struct job_sample {
+	long job_id;
+	// cpu.stat
+	long cpu_usage_usec;
+	long cpu_user_usec;
+	long cpu_system_usec;
+	// memory.current and the anon / file lines of memory.stat
+	long mem_current_bytes;
+	long mem_anon_bytes;
+	long mem_file_bytes;
+	// rbytes / wbytes of io.stat summed over devices
+	long io_read_bytes;
+	long io_write_bytes;
+	// bit g set if the job owns GPU g (see job_cgroups.h), 0 if it has none or they aren't known yet
+	unsigned long gpu_mask;
+} Job_Sample;
+
+// MONITOR SELF-TELEMETRY (one per sample, see self_stats.h)
+//	- what the monitor itself cost on the tick that collected the sample
+typedef struct self_sample {
+	// COLLECTION (see collect_pool.h)
+	//	- collect_ns: start of the collection -> every stage merged
+	//	- stage_ns: each stage in Collect_Task_Id order, 0 if it didn't run
+	long collect_ns;
+	long stage_ns[MAX_TICK_STAGES];
+	// deadlines skipped right before this tick
+	int n_missed_ticks;
+	// full buffers waiting for the writer at the end of the tick
+	int queue_len;
+	// dumps the writer finished since the previous sample (0 on most ticks)
+	long dump_ns;
+	long dump_bytes;
+	// PROCESS
+	//	- rss_kb: resident set of the monitor, 0 marks a sample without self-telemetry
+	//	- cpu_ns: cpu time of every monitor thread since the previous sample
+	long rss_kb;
+	long cpu_ns;
+} Self_Sample;
+
+
+// Commit cursor for a samples buffer that lives in <hostname>.ring (see mapped_buffers.h)
+//	- n_committed is advanced after every complete sample and cleared once the samples are
+//	  in storage, anything committed but not cleared gets flushed on the next startup
+typedef struct mapped_slot {
+	uint64_t sequence;
+	uint32_t n_committed;
+	uint32_t reserved;
+} Mapped_Slot;
+
+// PER-CORE UTILIZATION (-c, one blob per sample, see host_stats.h)
+//	- N_CORE_UTIL_COLUMNS arrays of n_cpu bytes: user (+ nice), system, iowait, irq (+ softirq), steal
+//	- each byte is the core's share of time in that state since the previous sample, in half percent (0-200)
+#define N_CORE_UTIL_COLUMNS 5
+
+// GPU VALUE WITH ITS OWN TIMESTAMP (dcgm batch mode, see gpu_dcgm.c)
+typedef struct gpu_value {
+	// when the GPU source sampled it, not a tick
+	long timestamp_ns;
+	int device_id;
+	// index into field_ids
+	int field_num;
+	// double for GPU_FT_DOUBLE, int64 otherwise
+	union {
+		double dbl;
+		long i64;
+	} value;
+} Gpu_Value;
 
 typedef struct samples_buffer {
 	int n_cpu;
 	int clk_tck;
+	// bytes of per-core utilization per sample, 0 when per-core sampling is off
+	int n_core_bytes;
+	// job slots per sample, 0 when per-job collection is off
+	int max_jobs;
+	// per-port series per sample (see port_counters.h), 0 when per-port collection is off
+	int n_port_series;
+	// Port_Series id of every series, shared by every buffer
+	int * port_series_ids;
 	int n_devices;
 	int n_fields;
 	unsigned short * field_ids;
 	unsigned short * field_types;
+	// field id -> index into field_ids (see field_lookup.h), shared by every buffer
+	short * field_lookup;
 	Interface_Totals * interface_totals;
 	int max_samples;
 	int n_samples;
-	Sample * samples;
+	// ARENA (struct of arrays, see samples_arena.h)
+	//	- one 64-byte aligned block (or a slot of <hostname>.ring) holding every column
+	//	- sample i of any column is column[i]
+	void * arena;
+	size_t arena_bytes;
+	struct timespec * times;
+	// sampling period each sample covers in ms (see Tick_Scheduler -> sample_period_ns), varies with --adaptive_base_millis
+	int * periods_ms;
+	// COLLECTOR_BITs of the sources that didn't run for each sample (see collectors.h), their columns hold 0
+	unsigned int * skipped_collectors;
+	Proc_Data * cpu_util;
+	Net_Data * net_util;
+	// n_core_bytes per sample, sample i at core_util[i * n_core_bytes]
+	unsigned char * core_util;
+	// max_jobs per sample, sample i at job_samples[i * max_jobs]
+	Job_Sample * job_samples;
+	// n_port_series deltas per sample, sample i at port_values[i * n_port_series]
+	long * port_values;
+	// monitor self-telemetry of every sample
+	Self_Sample * self_samples;
+	// one column of max_samples 8-byte values per (GPU, field), GPU major (use FIELD_COLUMN)
+	void * field_values;
+	size_t field_column_bytes;
+	// values a GPU source sampled on its own timeline, on the heap (not in <hostname>.ring)
+	//	- 0 unless the source keeps them (dcgm batch mode)
+	Gpu_Value * gpu_values;
+	int n_gpu_values;
+	int max_gpu_values;
+	// scheduler stats for the ticks that filled this buffer
+	Tick_Stats tick_stats;
+	// NULL when the arena is on the heap
+	Mapped_Slot * mapped_slot;
 } Samples_Buffer;
 
 
+// GPU FIELD VALUE TYPES
+//	- same characters as DCGM_FT_*, so types stored in .mts / .ring files stay compatible
+//	- every value is 8 bytes: double for GPU_FT_DOUBLE, int64 otherwise
+#define GPU_FT_DOUBLE 'd'
+#define GPU_FT_INT64 'i'
+#define GPU_FT_TIMESTAMP 't'
+
+// GPU VALUE BLANKS (no value for the sample, NULL / no row in storage)
+//	- DCGM_INT64_BLANK / DCGM_FP64_BLANK, anything at or above them is blank (DCGM reports
+//	  fields it can't read that way too)
+#define GPU_INT64_BLANK 0x7ffffffffffffff0L
+#define GPU_FP64_BLANK 140737488355328.0
+
+// sample i of a field column has no value
+#define IS_GPU_VALUE_BLANK(field_column, i, field_type) (((field_type) == GPU_FT_DOUBLE) ? (((double *) (field_column))[i] >= GPU_FP64_BLANK) : (((long *) (field_column))[i] >= GPU_INT64_BLANK))
+
+// column = gpuId * n_fields + fieldNum
+#define FIELD_COLUMN(samples_buffer, column) ((void *) ((char *) (samples_buffer) -> field_values + (size_t) (column) * (samples_buffer) -> field_column_bytes))
+
+
 // used to collect values from fscanf from /proc/stat
 typedef struct Cpu_stat {
 	int cpu_id;
@@ -69,4 +210,3 @@ typedef struct Cpu_stat {
     unsigned long t_softirq;
 } Cpu_stat;
 
-
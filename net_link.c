@@ -0,0 +1,252 @@
+#define _GNU_SOURCE
+
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/if_arp.h>
+
+#include "job_stats.h"
+
+#include "monitoring.h"
+#include "net_link.h"
+
+
+Net_Link_Reader * init_net_link_reader(){
+
+	Net_Link_Reader * net_link_reader = (Net_Link_Reader *) calloc(1, sizeof(Net_Link_Reader));
+	if (net_link_reader == NULL){
+		fprintf(stderr, "Could not allocate memory for netlink reader\n");
+		return NULL;
+	}
+	net_link_reader -> max_links = 16;
+	net_link_reader -> links = (Net_Link *) malloc(net_link_reader -> max_links * sizeof(Net_Link));
+	net_link_reader -> buf = (char *) malloc(NET_LINK_RECV_BYTES);
+	if ((net_link_reader -> links == NULL) || (net_link_reader -> buf == NULL)){
+		fprintf(stderr, "Could not allocate memory for netlink reader\n");
+		net_link_reader -> fd = -1;
+		destroy_net_link_reader(net_link_reader);
+		return NULL;
+	}
+
+	net_link_reader -> fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+	if (net_link_reader -> fd == -1){
+		fprintf(stderr, "Could not create netlink socket: %s\n", strerror(errno));
+		destroy_net_link_reader(net_link_reader);
+		return NULL;
+	}
+
+	// nl_pid 0: the kernel picks the port id
+	struct sockaddr_nl addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	struct timeval timeout = {0, NET_LINK_TIMEOUT_MS * 1000};
+	if ((bind(net_link_reader -> fd, (struct sockaddr *) &addr, sizeof(addr)) == -1)
+			|| (setsockopt(net_link_reader -> fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) == -1)){
+		fprintf(stderr, "Could not set up netlink socket: %s\n", strerror(errno));
+		destroy_net_link_reader(net_link_reader);
+		return NULL;
+	}
+
+	return net_link_reader;
+}
+
+void destroy_net_link_reader(Net_Link_Reader * net_link_reader){
+	if (net_link_reader -> fd != -1){
+		close(net_link_reader -> fd);
+	}
+	free(net_link_reader -> links);
+	free(net_link_reader -> buf);
+	free(net_link_reader);
+}
+
+
+/* DUMP */
+
+static int send_link_dump_request(Net_Link_Reader * net_link_reader){
+
+	struct {
+		struct nlmsghdr nlh;
+		struct ifinfomsg ifm;
+	} req;
+	memset(&req, 0, sizeof(req));
+	req.nlh.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
+	req.nlh.nlmsg_type = RTM_GETLINK;
+	req.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+	net_link_reader -> seq++;
+	req.nlh.nlmsg_seq = net_link_reader -> seq;
+	req.ifm.ifi_family = AF_UNSPEC;
+
+	struct sockaddr_nl kernel_addr;
+	memset(&kernel_addr, 0, sizeof(kernel_addr));
+	kernel_addr.nl_family = AF_NETLINK;
+	if (sendto(net_link_reader -> fd, &req, req.nlh.nlmsg_len, 0, (struct sockaddr *) &kernel_addr, sizeof(kernel_addr)) == -1){
+		fprintf(stderr, "Could not send netlink link dump request: %s\n", strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+// slot for ifindex, a new one (no previous counters) if the link wasn't known
+//	- the dump is in ifindex order, so the link is usually at the hint (where the last one was found + 1)
+static Net_Link * find_link(Net_Link_Reader * net_link_reader, int ifindex, int * hint){
+
+	Net_Link * links = net_link_reader -> links;
+	int n_links = net_link_reader -> n_links;
+	if ((*hint < n_links) && (links[*hint].ifindex == ifindex)){
+		return &(links[(*hint)++]);
+	}
+	for (int i = 0; i < n_links; i++){
+		if (links[i].ifindex == ifindex){
+			*hint = i + 1;
+			return &(links[i]);
+		}
+	}
+
+	if (n_links == net_link_reader -> max_links){
+		int max_links = 2 * net_link_reader -> max_links;
+		links = (Net_Link *) realloc(net_link_reader -> links, max_links * sizeof(Net_Link));
+		if (links == NULL){
+			fprintf(stderr, "Could not allocate memory for network links\n");
+			return NULL;
+		}
+		net_link_reader -> links = links;
+		net_link_reader -> max_links = max_links;
+	}
+	Net_Link * link = &(links[n_links]);
+	memset(link, 0, sizeof(Net_Link));
+	link -> ifindex = ifindex;
+	net_link_reader -> n_links++;
+	*hint = net_link_reader -> n_links;
+	return link;
+}
+
+// one RTM_NEWLINK of the dump into its link's counters
+static void handle_link_message(Net_Link_Reader * net_link_reader, struct nlmsghdr * nlh, int * hint){
+
+	struct ifinfomsg * ifm = (struct ifinfomsg *) NLMSG_DATA(nlh);
+	int attr_len = IFLA_PAYLOAD(nlh);
+	char * name = NULL;
+	struct rtattr * stats64 = NULL;
+	for (struct rtattr * attr = IFLA_RTA(ifm); RTA_OK(attr, attr_len); attr = RTA_NEXT(attr, attr_len)){
+		if (attr -> rta_type == IFLA_IFNAME){
+			name = (char *) RTA_DATA(attr);
+		}
+		else if ((attr -> rta_type == IFLA_STATS64) && (RTA_PAYLOAD(attr) >= sizeof(struct rtnl_link_stats64))){
+			stats64 = attr;
+		}
+	}
+	if ((name == NULL) || (stats64 == NULL)){
+		return;
+	}
+
+	Net_Link * link = find_link(net_link_reader, ifm -> ifi_index, hint);
+	if (link == NULL){
+		return;
+	}
+	// renames are rare, the name is only copied when it changed
+	if (strncmp(link -> name, name, IFNAMSIZ) != 0){
+		snprintf(link -> name, IFNAMSIZ, "%s", name);
+		if ((strncmp(name, "ib", 2) == 0) || (ifm -> ifi_type == ARPHRD_INFINIBAND)){
+			link -> kind = NET_LINK_IB;
+		}
+		else if (strncmp(name, "eno", 3) == 0){
+			link -> kind = NET_LINK_ETH;
+		}
+		else {
+			link -> kind = NET_LINK_OTHER;
+		}
+	}
+	// attribute payloads are only 4 byte aligned
+	memcpy(&(link -> stats), RTA_DATA(stats64), sizeof(struct rtnl_link_stats64));
+	link -> seen_dump = net_link_reader -> n_dumps;
+}
+
+int refresh_net_links(Net_Link_Reader * net_link_reader){
+
+	if (send_link_dump_request(net_link_reader) == -1){
+		return -1;
+	}
+	net_link_reader -> n_dumps++;
+
+	int hint = 0;
+	bool done = false;
+	ssize_t n_read;
+	struct nlmsghdr * nlh;
+	while (!done){
+		n_read = recv(net_link_reader -> fd, net_link_reader -> buf, NET_LINK_RECV_BYTES, 0);
+		if (n_read <= 0){
+			fprintf(stderr, "Could not read netlink link dump: %s\n", (n_read == 0) ? "socket closed" : strerror(errno));
+			return -1;
+		}
+		for (nlh = (struct nlmsghdr *) net_link_reader -> buf; NLMSG_OK(nlh, n_read); nlh = NLMSG_NEXT(nlh, n_read)){
+			// replies to an earlier dump that timed out
+			if (nlh -> nlmsg_seq != net_link_reader -> seq){
+				continue;
+			}
+			if (nlh -> nlmsg_type == NLMSG_DONE){
+				done = true;
+				break;
+			}
+			if (nlh -> nlmsg_type == NLMSG_ERROR){
+				fprintf(stderr, "Netlink link dump failed: %s\n", strerror(-((struct nlmsgerr *) NLMSG_DATA(nlh)) -> error));
+				return -1;
+			}
+			if (nlh -> nlmsg_type == RTM_NEWLINK){
+				handle_link_message(net_link_reader, nlh, &hint);
+			}
+		}
+	}
+
+	// DROP LINKS THAT ARE GONE
+	Net_Link * links = net_link_reader -> links;
+	int n_kept = 0;
+	for (int i = 0; i < net_link_reader -> n_links; i++){
+		if (links[i].seen_dump != net_link_reader -> n_dumps){
+			continue;
+		}
+		if (n_kept != i){
+			links[n_kept] = links[i];
+		}
+		n_kept++;
+	}
+	net_link_reader -> n_links = n_kept;
+
+	return n_kept;
+}
+
+// counters that went backwards (link recreated under the same index) count as 0
+static long counter_delta(unsigned long long cur, unsigned long long prev){
+	return (cur >= prev) ? (long) (cur - prev) : 0;
+}
+
+int process_net_link(Net_Link_Reader * net_link_reader, Net_Data * net_data){
+
+	net_data -> ib_sys_rx_bytes = 0;
+	net_data -> ib_sys_tx_bytes = 0;
+	net_data -> eth_rx_bytes = 0;
+	net_data -> eth_tx_bytes = 0;
+
+	if (refresh_net_links(net_link_reader) == -1){
+		return -1;
+	}
+
+	Net_Link * link;
+	long rx_bytes, tx_bytes;
+	for (int i = 0; i < net_link_reader -> n_links; i++){
+		link = &(net_link_reader -> links[i]);
+		// a new link's first sample is 0
+		rx_bytes = link -> has_prev ? counter_delta(link -> stats.rx_bytes, link -> prev_stats.rx_bytes) : 0;
+		tx_bytes = link -> has_prev ? counter_delta(link -> stats.tx_bytes, link -> prev_stats.tx_bytes) : 0;
+		if (link -> kind == NET_LINK_IB){
+			net_data -> ib_sys_rx_bytes += rx_bytes;
+			net_data -> ib_sys_tx_bytes += tx_bytes;
+		}
+		else if (link -> kind == NET_LINK_ETH){
+			net_data -> eth_rx_bytes += rx_bytes;
+			net_data -> eth_tx_bytes += tx_bytes;
+		}
+		link -> prev_stats = link -> stats;
+		link -> has_prev = true;
+	}
+	return 0;
+}
@@ -0,0 +1,65 @@
+#ifndef NET_LINK_H
+#define NET_LINK_H
+
+#include <linux/if_link.h>
+#include <linux/if.h>
+
+// INTERFACE COUNTERS OVER RTNETLINK (-l, --net_stats=netlink)
+//	- one RTM_GETLINK dump per tick returns IFLA_STATS64 for every interface, replacing the
+//	  open + read of <if>/statistics/{rx,tx}_bytes per interface
+//	- the interface list is whatever the dump returned: links that appear after init are
+//	  added (first sample 0, like every counter), links missing from a dump are dropped
+//	- each link keeps its 64-bit counters in place and the deltas are taken per link, so a
+//	  link coming or going (or being recreated with reset counters) never shows up as a jump
+//	  in the totals
+//	- the kernel always answers for the monitor's own network namespace, there is no root_dir
+
+// dump replies (the kernel fills up to 32KB per recv)
+#define NET_LINK_RECV_BYTES 65536
+
+// a dump that doesn't answer in this long fails the tick instead of stalling sampling
+#define NET_LINK_TIMEOUT_MS 100
+
+// which Net_Data columns a link counts towards
+//	- IB: ib* names or ARPHRD_INFINIBAND (IPoIB, the ib_sys_* columns)
+//	- ETH: eno* names (same interfaces as the sysfs collector)
+typedef enum net_link_kind {
+	NET_LINK_OTHER,
+	NET_LINK_IB,
+	NET_LINK_ETH
+} Net_Link_Kind;
+
+typedef struct net_link {
+	int ifindex;
+	char name[IFNAMSIZ];
+	Net_Link_Kind kind;
+	// dump that last returned the link
+	unsigned int seen_dump;
+	bool has_prev;
+	struct rtnl_link_stats64 stats;
+	struct rtnl_link_stats64 prev_stats;
+} Net_Link;
+
+typedef struct net_link_reader {
+	int fd;
+	unsigned int seq;
+	unsigned int n_dumps;
+	int n_links;
+	int max_links;
+	// ifindex order (the dump's), the first n_links are in use
+	Net_Link * links;
+	char * buf;
+} Net_Link_Reader;
+
+
+// NULL if the netlink socket can't be opened
+Net_Link_Reader * init_net_link_reader();
+void destroy_net_link_reader(Net_Link_Reader * net_link_reader);
+
+// one dump into the links' counters, returns the number of links or -1
+int refresh_net_links(Net_Link_Reader * net_link_reader);
+
+// refreshes and fills the ib_sys_* and eth_* columns of net_data with the per-link deltas, -1 on error (columns set to 0)
+int process_net_link(Net_Link_Reader * net_link_reader, Net_Data * net_data);
+
+#endif
@@ -0,0 +1,481 @@
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+
+#include "job_stats.h"
+
+#include "monitoring.h"
+#include "host_stats.h"
+#include "port_counters.h"
+#include "file_trace.h"
+
+
+typedef struct port_counter_def {
+	const char * name;
+	// relative to the port directory
+	const char * path;
+	long scale;
+} Port_Counter_Def;
+
+// NAMED INFINIBAND COUNTERS
+//	- counters/: the IB spec's PortCounters (+ extended), present on every HCA
+//	- hw_counters/: driver counters (mlx5 names), mostly RDMA transport errors and congestion
+static const Port_Counter_Def ib_port_counter_defs[] = {
+	{"port_rcv_data", "counters/port_rcv_data", 4},
+	{"port_xmit_data", "counters/port_xmit_data", 4},
+	{"port_rcv_packets", "counters/port_rcv_packets", 1},
+	{"port_xmit_packets", "counters/port_xmit_packets", 1},
+	{"port_xmit_wait", "counters/port_xmit_wait", 1},
+	{"port_rcv_errors", "counters/port_rcv_errors", 1},
+	{"port_xmit_discards", "counters/port_xmit_discards", 1},
+	{"port_rcv_remote_physical_errors", "counters/port_rcv_remote_physical_errors", 1},
+	{"port_rcv_switch_relay_errors", "counters/port_rcv_switch_relay_errors", 1},
+	{"symbol_error", "counters/symbol_error", 1},
+	{"link_downed", "counters/link_downed", 1},
+	{"link_error_recovery", "counters/link_error_recovery", 1},
+	{"local_link_integrity_errors", "counters/local_link_integrity_errors", 1},
+	{"excessive_buffer_overrun_errors", "counters/excessive_buffer_overrun_errors", 1},
+	{"out_of_buffer", "hw_counters/out_of_buffer", 1},
+	{"out_of_sequence", "hw_counters/out_of_sequence", 1},
+	{"packet_seq_err", "hw_counters/packet_seq_err", 1},
+	{"local_ack_timeout_err", "hw_counters/local_ack_timeout_err", 1},
+	{"rnr_nak_retry_err", "hw_counters/rnr_nak_retry_err", 1},
+	{"np_cnp_sent", "hw_counters/np_cnp_sent", 1},
+	{"rp_cnp_handled", "hw_counters/rp_cnp_handled", 1},
+	{"np_ecn_marked_roce_packets", "hw_counters/np_ecn_marked_roce_packets", 1}
+};
+
+#define N_IB_PORT_COUNTER_DEFS (sizeof(ib_port_counter_defs) / sizeof(ib_port_counter_defs[0]))
+
+// every ib* / eno* interface
+static const Port_Counter_Def net_port_counter_defs[N_NET_PORT_COUNTERS] = {
+	{"rx_bytes", "statistics/rx_bytes", 1},
+	{"tx_bytes", "statistics/tx_bytes", 1}
+};
+
+// directories of "all" (hw_counters/lifespan is the driver's cache time in ms, not a counter)
+static const char * ib_counter_dirs[] = {"counters", "hw_counters"};
+
+
+/* DISCOVERY */
+
+static int compare_names(const void * a, const void * b){
+	return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+// sorted entries of dir (no dot entries), returns the count or -1 if dir can't be opened
+static int list_dir(char * dir, char *** names){
+
+	DIR * dr = open_trace_dir(dir);
+	if (dr == NULL){
+		return -1;
+	}
+	int n_names = 0;
+	int max_names = 16;
+	*names = (char **) malloc(max_names * sizeof(char *));
+	struct dirent * entry;
+	while ((*names != NULL) && ((entry = readdir(dr)) != NULL)){
+		if (entry -> d_name[0] == '.'){
+			continue;
+		}
+		if (n_names == max_names){
+			max_names *= 2;
+			*names = (char **) realloc(*names, max_names * sizeof(char *));
+			if (*names == NULL){
+				break;
+			}
+		}
+		(*names)[n_names] = strdup(entry -> d_name);
+		n_names++;
+	}
+	closedir(dr);
+	if (*names == NULL){
+		fprintf(stderr, "Could not allocate memory for entries of %s\n", dir);
+		return -1;
+	}
+	qsort(*names, n_names, sizeof(char *), compare_names);
+	return n_names;
+}
+
+static void free_names(char ** names, int n_names){
+	for (int i = 0; i < n_names; i++){
+		free(names[i]);
+	}
+	free(names);
+}
+
+int find_ib_ports(char * sysfs_root, char *** port_dirs, char *** port_names){
+
+	*port_dirs = NULL;
+	*port_names = NULL;
+
+	char * hca_parent;
+	asprintf(&hca_parent, "%s/class/infiniband", sysfs_root);
+	char ** hcas;
+	int n_hcas = list_dir(hca_parent, &hcas);
+	// no HCA on this node
+	if (n_hcas <= 0){
+		if (n_hcas == 0){
+			free(hcas);
+		}
+		free(hca_parent);
+		return 0;
+	}
+
+	int n_ports = 0;
+	int max_ports = 16;
+	*port_dirs = (char **) malloc(max_ports * sizeof(char *));
+	*port_names = (char **) malloc(max_ports * sizeof(char *));
+	char * ports_dir;
+	char * port_dir;
+	char ** ports;
+	int n_hca_ports;
+	char link_layer[32];
+	int fd;
+	for (int h = 0; (h < n_hcas) && (*port_dirs != NULL) && (*port_names != NULL); h++){
+		asprintf(&ports_dir, "%s/%s/ports", hca_parent, hcas[h]);
+		n_hca_ports = list_dir(ports_dir, &ports);
+		for (int p = 0; p < n_hca_ports; p++){
+			asprintf(&port_dir, "%s/%s", ports_dir, ports[p]);
+			// RoCE ports (link layer Ethernet) are counted with their Ethernet interface
+			char * link_layer_path;
+			asprintf(&link_layer_path, "%s/link_layer", port_dir);
+			fd = open_trace_file(link_layer_path);
+			free(link_layer_path);
+			if (fd != -1){
+				if ((read_counter_file(fd, link_layer, sizeof(link_layer)) > 0) && (strncmp(link_layer, "InfiniBand", 10) != 0)){
+					close_trace_file(fd);
+					free(port_dir);
+					continue;
+				}
+				close_trace_file(fd);
+			}
+			if (n_ports == max_ports){
+				max_ports *= 2;
+				*port_dirs = (char **) realloc(*port_dirs, max_ports * sizeof(char *));
+				*port_names = (char **) realloc(*port_names, max_ports * sizeof(char *));
+				if ((*port_dirs == NULL) || (*port_names == NULL)){
+					free(port_dir);
+					break;
+				}
+			}
+			(*port_dirs)[n_ports] = port_dir;
+			asprintf(&((*port_names)[n_ports]), "%s/%s", hcas[h], ports[p]);
+			n_ports++;
+		}
+		if (n_hca_ports >= 0){
+			free_names(ports, n_hca_ports);
+		}
+		free(ports_dir);
+	}
+	free_names(hcas, n_hcas);
+	free(hca_parent);
+
+	if ((*port_dirs == NULL) || (*port_names == NULL)){
+		fprintf(stderr, "Could not allocate memory for InfiniBand ports\n");
+		return -1;
+	}
+	return n_ports;
+}
+
+// ib* and eno* interfaces (same as init_interface_totals), returns the count or -1
+static int find_net_ports(char * sysfs_root, char *** port_dirs, char *** port_names){
+
+	char * net_parent;
+	asprintf(&net_parent, "%s/class/net", sysfs_root);
+	char ** ifs;
+	int n_ifs = list_dir(net_parent, &ifs);
+	if (n_ifs < 0){
+		free(net_parent);
+		*port_dirs = NULL;
+		*port_names = NULL;
+		return 0;
+	}
+
+	*port_dirs = (char **) malloc((n_ifs + 1) * sizeof(char *));
+	*port_names = (char **) malloc((n_ifs + 1) * sizeof(char *));
+	if ((*port_dirs == NULL) || (*port_names == NULL)){
+		fprintf(stderr, "Could not allocate memory for network interfaces\n");
+		free_names(ifs, n_ifs);
+		free(net_parent);
+		return -1;
+	}
+	int n_ports = 0;
+	for (int i = 0; i < n_ifs; i++){
+		if ((strncmp(ifs[i], "ib", 2) != 0) && (strncmp(ifs[i], "eno", 3) != 0)){
+			free(ifs[i]);
+			continue;
+		}
+		asprintf(&((*port_dirs)[n_ports]), "%s/%s", net_parent, ifs[i]);
+		(*port_names)[n_ports] = ifs[i];
+		n_ports++;
+	}
+	free(ifs);
+	free(net_parent);
+	return n_ports;
+}
+
+
+/* SERIES TABLE */
+
+// opens <port_dir>/<path> as the next series, 0 if the port doesn't have it, -1 on allocation failure
+static int add_series(Port_Counters * port_counters, int * max_series, char * port_name, char * port_dir, const char * counter_name, const char * path, long scale){
+
+	char * full_path;
+	asprintf(&full_path, "%s/%s", port_dir, path);
+	int fd = open_trace_file(full_path);
+	free(full_path);
+	if (fd == -1){
+		return 0;
+	}
+
+	int n_series = port_counters -> n_series;
+	if (n_series == *max_series){
+		*max_series = (*max_series == 0) ? 64 : 2 * *max_series;
+		port_counters -> fds = (int *) realloc(port_counters -> fds, *max_series * sizeof(int));
+		port_counters -> scales = (long *) realloc(port_counters -> scales, *max_series * sizeof(long));
+		port_counters -> series_ports = (char **) realloc(port_counters -> series_ports, *max_series * sizeof(char *));
+		port_counters -> series_counters = (char **) realloc(port_counters -> series_counters, *max_series * sizeof(char *));
+		if ((port_counters -> fds == NULL) || (port_counters -> scales == NULL) || (port_counters -> series_ports == NULL) || (port_counters -> series_counters == NULL)){
+			fprintf(stderr, "Could not allocate memory for port counters\n");
+			close_trace_file(fd);
+			return -1;
+		}
+	}
+	port_counters -> fds[n_series] = fd;
+	port_counters -> scales[n_series] = scale;
+	port_counters -> series_ports[n_series] = port_name;
+	port_counters -> series_counters[n_series] = strdup(counter_name);
+	port_counters -> n_series++;
+	return 1;
+}
+
+// named counter, a counters/ or hw_counters/ path (named if it is in the table), NULL if unknown
+static const Port_Counter_Def * find_ib_counter_def(char * item){
+	for (size_t d = 0; d < N_IB_PORT_COUNTER_DEFS; d++){
+		if ((strcmp(item, ib_port_counter_defs[d].name) == 0) || (strcmp(item, ib_port_counter_defs[d].path) == 0)){
+			return &(ib_port_counter_defs[d]);
+		}
+	}
+	return NULL;
+}
+
+// every file in counters/ and hw_counters/ of the port
+static int add_all_ib_series(Port_Counters * port_counters, int * max_series, char * port_name, char * port_dir){
+
+	char * dir;
+	char ** files;
+	int n_files;
+	char * path;
+	const Port_Counter_Def * def;
+	int ret = 0;
+	for (size_t c = 0; (c < sizeof(ib_counter_dirs) / sizeof(ib_counter_dirs[0])) && (ret != -1); c++){
+		asprintf(&dir, "%s/%s", port_dir, ib_counter_dirs[c]);
+		n_files = list_dir(dir, &files);
+		free(dir);
+		for (int f = 0; (f < n_files) && (ret != -1); f++){
+			if (strcmp(files[f], "lifespan") == 0){
+				continue;
+			}
+			asprintf(&path, "%s/%s", ib_counter_dirs[c], files[f]);
+			def = find_ib_counter_def(path);
+			ret = add_series(port_counters, max_series, port_name, port_dir, (def != NULL) ? def -> name : path, path, (def != NULL) ? def -> scale : 1);
+			free(path);
+		}
+		if (n_files >= 0){
+			free_names(files, n_files);
+		}
+	}
+	return ret;
+}
+
+// the asked for counters of every IB port (port major), warns about the ones no port has
+static int add_listed_ib_series(Port_Counters * port_counters, int * max_series, int n_ib_ports, char ** port_names, char ** port_dirs, char * counter_set){
+
+	int max_items = 1;
+	for (char * c = counter_set; *c != '\0'; c++){
+		max_items += (*c == ',');
+	}
+	char * set_copy = strdup(counter_set);
+	char ** items = (char **) malloc(max_items * sizeof(char *));
+	const Port_Counter_Def ** defs = (const Port_Counter_Def **) malloc(max_items * sizeof(Port_Counter_Def *));
+	int * n_found = (int *) calloc(max_items, sizeof(int));
+	if ((set_copy == NULL) || (items == NULL) || (defs == NULL) || (n_found == NULL)){
+		fprintf(stderr, "Could not allocate memory for port counters\n");
+		free(set_copy);
+		free(items);
+		free(defs);
+		free(n_found);
+		return -1;
+	}
+
+	int n_items = 0;
+	int ret = 0;
+	char * saveptr;
+	for (char * item = strtok_r(set_copy, ",", &saveptr); item != NULL; item = strtok_r(NULL, ",", &saveptr)){
+		defs[n_items] = find_ib_counter_def(item);
+		if ((defs[n_items] == NULL) && (strncmp(item, "counters/", 9) != 0) && (strncmp(item, "hw_counters/", 12) != 0)){
+			fprintf(stderr, "Unknown port counter: %s (expected a name from port_counters.c, counters/<file> or hw_counters/<file>)\n", item);
+			ret = -1;
+			break;
+		}
+		items[n_items] = item;
+		n_items++;
+	}
+
+	const Port_Counter_Def * def;
+	for (int p = 0; (p < n_ib_ports) && (ret != -1); p++){
+		for (int i = 0; (i < n_items) && (ret != -1); i++){
+			def = defs[i];
+			ret = add_series(port_counters, max_series, port_names[p], port_dirs[p], (def != NULL) ? def -> name : items[i], (def != NULL) ? def -> path : items[i], (def != NULL) ? def -> scale : 1);
+			n_found[i] += (ret == 1);
+		}
+	}
+	for (int i = 0; (i < n_items) && (ret != -1) && (n_ib_ports > 0); i++){
+		if (n_found[i] == 0){
+			fprintf(stderr, "Port counter %s not found on any InfiniBand port\n", items[i]);
+		}
+	}
+
+	free(set_copy);
+	free(items);
+	free(defs);
+	free(n_found);
+	return (ret == -1) ? -1 : 0;
+}
+
+// replaces "default" anywhere in the list with PORT_COUNTERS_DEFAULT (e.g. "default,out_of_buffer")
+static char * expand_counter_set(char * counter_set){
+
+	char * set_copy = strdup(counter_set);
+	char * expanded_set = (char *) malloc(strlen(counter_set) + strlen(PORT_COUNTERS_DEFAULT) + 1);
+	if ((set_copy == NULL) || (expanded_set == NULL)){
+		fprintf(stderr, "Could not allocate memory for port counters\n");
+		free(set_copy);
+		free(expanded_set);
+		return NULL;
+	}
+	expanded_set[0] = '\0';
+	bool added_default = false;
+	char * saveptr;
+	for (char * item = strtok_r(set_copy, ",", &saveptr); item != NULL; item = strtok_r(NULL, ",", &saveptr)){
+		if ((strcmp(item, "default") == 0) && added_default){
+			continue;
+		}
+		if (expanded_set[0] != '\0'){
+			strcat(expanded_set, ",");
+		}
+		strcat(expanded_set, (strcmp(item, "default") == 0) ? PORT_COUNTERS_DEFAULT : item);
+		added_default |= (strcmp(item, "default") == 0);
+	}
+	free(set_copy);
+	return expanded_set;
+}
+
+Port_Counters * init_port_counters(char * sysfs_root, char * counter_set){
+
+	Port_Counters * port_counters = (Port_Counters *) calloc(1, sizeof(Port_Counters));
+	if (port_counters == NULL){
+		fprintf(stderr, "Could not allocate memory for port counters\n");
+		return NULL;
+	}
+
+	char ** ib_dirs;
+	char ** ib_names;
+	char ** net_dirs;
+	char ** net_names;
+	int n_ib_ports = find_ib_ports(sysfs_root, &ib_dirs, &ib_names);
+	int n_net_ports = find_net_ports(sysfs_root, &net_dirs, &net_names);
+	if ((n_ib_ports == -1) || (n_net_ports == -1)){
+		free(port_counters);
+		return NULL;
+	}
+
+	// IB ports first, the port names are owned by port_counters
+	port_counters -> n_ports = n_ib_ports + n_net_ports;
+	port_counters -> port_names = (char **) malloc((port_counters -> n_ports + 1) * sizeof(char *));
+	if (port_counters -> port_names == NULL){
+		fprintf(stderr, "Could not allocate memory for port counters\n");
+		free(port_counters);
+		return NULL;
+	}
+	for (int p = 0; p < n_ib_ports; p++){
+		port_counters -> port_names[p] = ib_names[p];
+	}
+	for (int p = 0; p < n_net_ports; p++){
+		port_counters -> port_names[n_ib_ports + p] = net_names[p];
+	}
+
+	int max_series = 0;
+	int err = 0;
+	if (strcmp(counter_set, "all") == 0){
+		for (int p = 0; (p < n_ib_ports) && (err != -1); p++){
+			err = add_all_ib_series(port_counters, &max_series, ib_names[p], ib_dirs[p]);
+		}
+	}
+	else {
+		char * expanded_set = expand_counter_set(counter_set);
+		err = (expanded_set == NULL) ? -1 : add_listed_ib_series(port_counters, &max_series, n_ib_ports, ib_names, ib_dirs, expanded_set);
+		free(expanded_set);
+	}
+	for (int p = 0; (p < n_net_ports) && (err != -1); p++){
+		for (int c = 0; (c < N_NET_PORT_COUNTERS) && (err != -1); c++){
+			err = add_series(port_counters, &max_series, net_names[p], net_dirs[p], net_port_counter_defs[c].name, net_port_counter_defs[c].path, net_port_counter_defs[c].scale);
+		}
+	}
+
+	// names moved into port_counters
+	free_names(ib_dirs, n_ib_ports);
+	free(ib_names);
+	free_names(net_dirs, n_net_ports);
+	free(net_names);
+
+	port_counters -> prev_values = (long *) calloc(port_counters -> n_series + 1, sizeof(long));
+	port_counters -> series_ids = (int *) calloc(port_counters -> n_series + 1, sizeof(int));
+	if ((err == -1) || (port_counters -> prev_values == NULL) || (port_counters -> series_ids == NULL)){
+		destroy_port_counters(port_counters);
+		return NULL;
+	}
+	if (port_counters -> n_series == 0){
+		fprintf(stderr, "No port counters found under %s\n", sysfs_root);
+	}
+
+	return port_counters;
+}
+
+void destroy_port_counters(Port_Counters * port_counters){
+	for (int s = 0; s < port_counters -> n_series; s++){
+		close_trace_file(port_counters -> fds[s]);
+		free(port_counters -> series_counters[s]);
+	}
+	free_names(port_counters -> port_names, port_counters -> n_ports);
+	free(port_counters -> fds);
+	free(port_counters -> scales);
+	free(port_counters -> prev_values);
+	free(port_counters -> series_ports);
+	free(port_counters -> series_counters);
+	free(port_counters -> series_ids);
+	free(port_counters);
+}
+
+
+/* PER TICK */
+
+void process_port_counters(Port_Counters * port_counters, long * port_values){
+
+	int n_series = port_counters -> n_series;
+	int * fds = port_counters -> fds;
+	long * scales = port_counters -> scales;
+	long * prev_values = port_counters -> prev_values;
+	long value;
+	for (int s = 0; s < n_series; s++){
+		// unreadable this tick: 0, the next delta covers both ticks
+		if (read_counter_value(fds[s], &value) == -1){
+			port_values[s] = 0;
+			continue;
+		}
+		port_values[s] = (port_counters -> has_prev && (value >= prev_values[s])) ? (value - prev_values[s]) * scales[s] : 0;
+		prev_values[s] = value;
+	}
+	port_counters -> has_prev = true;
+}
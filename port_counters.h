@@ -0,0 +1,52 @@
+#ifndef PORT_COUNTERS_H
+#define PORT_COUNTERS_H
+
+// PER-PORT NETWORK SERIES (-i, --port_counters, see Samples_Buffer -> port_values)
+//	- ports are every InfiniBand port under <sysfs_root>/class/infiniband/<hca>/ports/<n>
+//	  (named "<hca>/<n>") and every ib* / eno* interface under <sysfs_root>/class/net
+//	- a series is one (port, counter file), every counter a port doesn't have is left out,
+//	  so the set of series is fixed at init
+//	- every tick walks one flat table of (fd, scale, previous value) with pread, each sample
+//	  stores the delta of every series since the previous one (0 on the first sample and
+//	  when a counter goes backwards)
+//	- sysfs_root is "/sys" on a real node, a fake tree for testing
+
+// The IB counter set is a comma separated list of names from ib_port_counter_defs
+// (port_counters.c, e.g. port_xmit_wait, out_of_buffer) or paths relative to the port
+// directory (counters/<file>, hw_counters/<file>), "default" (can be part of the list) for
+// PORT_COUNTERS_DEFAULT, or just "all" for every file in counters/ and hw_counters/ of each port.
+#define PORT_COUNTERS_DEFAULT "port_rcv_data,port_xmit_data,port_rcv_packets,port_xmit_packets,port_xmit_wait,port_rcv_errors"
+
+// counter files per interface (bytes through the kernel's network stack)
+#define N_NET_PORT_COUNTERS 2
+
+typedef struct port_counters {
+	int n_ports;
+	char ** port_names;
+	// SERIES (port major, counters in the order they were asked for)
+	int n_series;
+	int * fds;
+	// port_rcv_data / port_xmit_data count 4-byte words
+	long * scales;
+	long * prev_values;
+	bool has_prev;
+	// Port_Series row of every series (ports point into port_names)
+	char ** series_ports;
+	char ** series_counters;
+	// filled in by register_port_series (storage.h)
+	int * series_ids;
+} Port_Counters;
+
+
+// every InfiniBand port directory (<sysfs_root>/class/infiniband/<hca>/ports/<n>) whose link
+// layer is InfiniBand, with its "<hca>/<n>" name, returns the number of ports or -1
+int find_ib_ports(char * sysfs_root, char *** port_dirs, char *** port_names);
+
+// counter_set as above, NULL on failure (unknown counter name), a node without any port gets 0 series
+Port_Counters * init_port_counters(char * sysfs_root, char * counter_set);
+void destroy_port_counters(Port_Counters * port_counters);
+
+// fills the n_series deltas at port_values (the current sample's in the arena)
+void process_port_counters(Port_Counters * port_counters, long * port_values);
+
+#endif
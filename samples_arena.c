@@ -0,0 +1,97 @@
+#define _GNU_SOURCE
+
+#include "job_stats.h"
+
+#include "monitoring.h"
+#include "samples_arena.h"
+
+
+static size_t align_column(size_t bytes){
+	return ((bytes + SAMPLES_ARENA_ALIGN - 1) / SAMPLES_ARENA_ALIGN) * SAMPLES_ARENA_ALIGN;
+}
+
+size_t get_samples_arena_bytes(int max_samples, int n_devices, int n_fields, int n_core_bytes, int max_jobs, int n_port_series){
+
+	// hardcoded because only doubles and i64 field value types
+	int field_size_bytes = 8;
+
+	return align_column(max_samples * sizeof(struct timespec))
+			+ align_column(max_samples * sizeof(int))
+			+ align_column(max_samples * sizeof(unsigned int))
+			+ align_column(max_samples * sizeof(Proc_Data))
+			+ align_column(max_samples * sizeof(Net_Data))
+			+ align_column((size_t) max_samples * n_core_bytes)
+			+ align_column((size_t) max_samples * max_jobs * sizeof(Job_Sample))
+			+ align_column((size_t) max_samples * n_port_series * sizeof(long))
+			+ align_column(max_samples * sizeof(Self_Sample))
+			+ (size_t) n_devices * n_fields * align_column((size_t) max_samples * field_size_bytes);
+}
+
+void layout_samples_arena(Samples_Buffer * samples_buffer, void * arena){
+
+	int max_samples = samples_buffer -> max_samples;
+	char * cur = (char *) arena;
+
+	samples_buffer -> arena = arena;
+	samples_buffer -> arena_bytes = get_samples_arena_bytes(max_samples, samples_buffer -> n_devices, samples_buffer -> n_fields, samples_buffer -> n_core_bytes, samples_buffer -> max_jobs, samples_buffer -> n_port_series);
+
+	samples_buffer -> times = (struct timespec *) cur;
+	cur += align_column(max_samples * sizeof(struct timespec));
+	samples_buffer -> periods_ms = (int *) cur;
+	cur += align_column(max_samples * sizeof(int));
+	samples_buffer -> skipped_collectors = (unsigned int *) cur;
+	cur += align_column(max_samples * sizeof(unsigned int));
+	samples_buffer -> cpu_util = (Proc_Data *) cur;
+	cur += align_column(max_samples * sizeof(Proc_Data));
+	samples_buffer -> net_util = (Net_Data *) cur;
+	cur += align_column(max_samples * sizeof(Net_Data));
+	samples_buffer -> core_util = (unsigned char *) cur;
+	cur += align_column((size_t) max_samples * samples_buffer -> n_core_bytes);
+	samples_buffer -> job_samples = (Job_Sample *) cur;
+	cur += align_column((size_t) max_samples * samples_buffer -> max_jobs * sizeof(Job_Sample));
+	samples_buffer -> port_values = (long *) cur;
+	cur += align_column((size_t) max_samples * samples_buffer -> n_port_series * sizeof(long));
+	samples_buffer -> self_samples = (Self_Sample *) cur;
+	cur += align_column(max_samples * sizeof(Self_Sample));
+	samples_buffer -> field_values = (void *) cur;
+	samples_buffer -> field_column_bytes = align_column((size_t) max_samples * 8);
+}
+
+int alloc_samples_arena(Samples_Buffer * samples_buffer){
+
+	size_t arena_bytes = get_samples_arena_bytes(samples_buffer -> max_samples, samples_buffer -> n_devices, samples_buffer -> n_fields, samples_buffer -> n_core_bytes, samples_buffer -> max_jobs, samples_buffer -> n_port_series);
+
+	void * arena;
+	int ret = posix_memalign(&arena, SAMPLES_ARENA_ALIGN, arena_bytes);
+	if (ret != 0){
+		fprintf(stderr, "Could not allocate %zu bytes for samples arena: %s\n", arena_bytes, strerror(ret));
+		return -1;
+	}
+	memset(arena, 0, arena_bytes);
+
+	layout_samples_arena(samples_buffer, arena);
+	return 0;
+}
+
+void free_samples_arena(Samples_Buffer * samples_buffer){
+	free(samples_buffer -> arena);
+	samples_buffer -> arena = NULL;
+}
+
+void clear_samples_arena(Samples_Buffer * samples_buffer, int n_samples){
+
+	int n_columns = samples_buffer -> n_devices * samples_buffer -> n_fields;
+
+	memset(samples_buffer -> times, 0, n_samples * sizeof(struct timespec));
+	memset(samples_buffer -> periods_ms, 0, n_samples * sizeof(int));
+	memset(samples_buffer -> skipped_collectors, 0, n_samples * sizeof(unsigned int));
+	memset(samples_buffer -> cpu_util, 0, n_samples * sizeof(Proc_Data));
+	memset(samples_buffer -> net_util, 0, n_samples * sizeof(Net_Data));
+	memset(samples_buffer -> core_util, 0, (size_t) n_samples * samples_buffer -> n_core_bytes);
+	memset(samples_buffer -> job_samples, 0, (size_t) n_samples * samples_buffer -> max_jobs * sizeof(Job_Sample));
+	memset(samples_buffer -> port_values, 0, (size_t) n_samples * samples_buffer -> n_port_series * sizeof(long));
+	memset(samples_buffer -> self_samples, 0, n_samples * sizeof(Self_Sample));
+	for (int c = 0; c < n_columns; c++){
+		memset(FIELD_COLUMN(samples_buffer, c), 0, (size_t) n_samples * 8);
+	}
+}
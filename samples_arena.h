@@ -0,0 +1,33 @@
+#ifndef SAMPLES_ARENA_H
+#define SAMPLES_ARENA_H
+
+// SAMPLES BUFFER ARENA LAYOUT
+//	- times[max_samples]
+//	- periods_ms[max_samples]
+//	- skipped_collectors[max_samples]
+//	- cpu_util[max_samples] (Proc_Data)
+//	- net_util[max_samples] (Net_Data)
+//	- core_util[max_samples * n_core_bytes] (empty unless per-core sampling is on)
+//	- job_samples[max_samples * max_jobs] (Job_Sample, empty unless per-job collection is on)
+//	- port_values[max_samples * n_port_series] (long, empty unless per-port collection is on)
+//	- self_samples[max_samples] (Self_Sample)
+//	- n_devices * n_fields columns of max_samples 8-byte values (double or int64 by field type)
+// Every column starts on a SAMPLES_ARENA_ALIGN boundary, so a dump or reset walks each
+// column linearly instead of chasing per-sample pointers.
+
+#define SAMPLES_ARENA_ALIGN 64
+
+// bytes needed for a buffer of this shape (a multiple of SAMPLES_ARENA_ALIGN)
+size_t get_samples_arena_bytes(int max_samples, int n_devices, int n_fields, int n_core_bytes, int max_jobs, int n_port_series);
+
+// points the buffer's columns into arena, uses max_samples / n_devices / n_fields / n_core_bytes / max_jobs / n_port_series already set in the buffer
+void layout_samples_arena(Samples_Buffer * samples_buffer, void * arena);
+
+// heap arena (zeroed), returns -1 on failure
+int alloc_samples_arena(Samples_Buffer * samples_buffer);
+void free_samples_arena(Samples_Buffer * samples_buffer);
+
+// zeroes the first n_samples entries of every column
+void clear_samples_arena(Samples_Buffer * samples_buffer, int n_samples);
+
+#endif
@@ -0,0 +1,148 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "scheduler.h"
+
+
+static long timespec_to_ns(struct timespec * ts){
+	return ts -> tv_sec * 1000000000L + ts -> tv_nsec;
+}
+
+static struct timespec ns_to_timespec(long ns){
+	struct timespec ts;
+	ts.tv_sec = ns / 1000000000L;
+	ts.tv_nsec = ns % 1000000000L;
+	return ts;
+}
+
+static void add_to_histogram(Latency_Histogram * hist, long value_ns){
+
+	if (value_ns < 0){
+		value_ns = 0;
+	}
+
+	long value_us = value_ns / 1000;
+	int bucket = 0;
+	while ((value_us > 0) && (bucket < N_LATENCY_BUCKETS - 1)){
+		value_us >>= 1;
+		bucket++;
+	}
+
+	hist -> counts[bucket]++;
+	hist -> n_values++;
+	hist -> total_ns += value_ns;
+	if (value_ns > hist -> max_ns){
+		hist -> max_ns = value_ns;
+	}
+}
+
+void reset_tick_stats(Tick_Stats * tick_stats){
+	memset(tick_stats, 0, sizeof(Tick_Stats));
+}
+
+void add_tick_stages(Tick_Scheduler * scheduler, long collect_ns, long * stage_ns, int n_stages){
+
+	Tick_Stats * stats = &(scheduler -> stats);
+	if (n_stages > MAX_TICK_STAGES){
+		n_stages = MAX_TICK_STAGES;
+	}
+	stats -> n_stages = n_stages;
+
+	long sum_ns = 0;
+	for (int i = 0; i < n_stages; i++){
+		if (stage_ns[i] > 0){
+			add_to_histogram(&(stats -> stages[i]), stage_ns[i]);
+			sum_ns += stage_ns[i];
+		}
+	}
+	add_to_histogram(&(stats -> stage_sum), sum_ns);
+	add_to_histogram(&(stats -> collect_latency), collect_ns);
+}
+
+Tick_Scheduler * init_tick_scheduler(long period_ns){
+
+	if (period_ns <= 0){
+		fprintf(stderr, "Invalid tick period: %ld ns\n", period_ns);
+		return NULL;
+	}
+
+	Tick_Scheduler * scheduler = (Tick_Scheduler *) malloc(sizeof(Tick_Scheduler));
+	if (scheduler == NULL){
+		fprintf(stderr, "Could not allocate memory for tick scheduler\n");
+		return NULL;
+	}
+
+	scheduler -> period_ns = period_ns;
+	scheduler -> sample_period_ns = period_ns;
+	reset_tick_stats(&(scheduler -> stats));
+
+	// read both clocks back to back and place the first deadline on the next
+	// wall-clock multiple of the period, expressed in monotonic time
+	struct timespec mono_now, real_now;
+	clock_gettime(CLOCK_MONOTONIC, &mono_now);
+	clock_gettime(CLOCK_REALTIME, &real_now);
+
+	long real_ns = timespec_to_ns(&real_now);
+	long until_boundary = period_ns - (real_ns % period_ns);
+
+	scheduler -> deadline = ns_to_timespec(timespec_to_ns(&mono_now) + until_boundary);
+	scheduler -> prev_deadline_ns = timespec_to_ns(&(scheduler -> deadline)) - period_ns;
+
+	return scheduler;
+}
+
+long wait_next_tick(Tick_Scheduler * scheduler){
+
+	long period_ns = scheduler -> period_ns;
+	long deadline_ns = timespec_to_ns(&(scheduler -> deadline));
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	long now_ns = timespec_to_ns(&now);
+
+	// if the last tick overran, skip the deadlines that have already passed
+	// instead of stretching the period (keeps every tick on the original grid)
+	long n_missed = 0;
+	if (now_ns > deadline_ns){
+		n_missed = (now_ns - deadline_ns) / period_ns + 1;
+		deadline_ns += n_missed * period_ns;
+		scheduler -> deadline = ns_to_timespec(deadline_ns);
+		scheduler -> stats.n_missed_ticks += n_missed;
+	}
+
+	int ret;
+	do {
+		ret = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &(scheduler -> deadline), NULL);
+	} while (ret == EINTR);
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	add_to_histogram(&(scheduler -> stats.wake_jitter), timespec_to_ns(&now) - deadline_ns);
+
+	scheduler -> sample_period_ns = deadline_ns - scheduler -> prev_deadline_ns;
+	scheduler -> stats.n_ticks++;
+
+	return n_missed;
+}
+
+void end_tick(Tick_Scheduler * scheduler){
+
+	long deadline_ns = timespec_to_ns(&(scheduler -> deadline));
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	add_to_histogram(&(scheduler -> stats.tick_latency), timespec_to_ns(&now) - deadline_ns);
+
+	// next deadline is always relative to the previous deadline, never to "now"
+	scheduler -> prev_deadline_ns = deadline_ns;
+	scheduler -> deadline = ns_to_timespec(deadline_ns + scheduler -> period_ns);
+}
+
+void set_tick_period(Tick_Scheduler * scheduler, long period_ns){
+	if (period_ns > 0){
+		scheduler -> period_ns = period_ns;
+	}
+}
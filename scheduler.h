@@ -0,0 +1,76 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <time.h>
+
+// log2 buckets in microseconds:
+//	- bucket 0 holds < 1 us, bucket i holds [2^(i-1), 2^i) us
+//	- last bucket catches everything >= 2^(N_LATENCY_BUCKETS - 2) us (~0.5 sec)
+#define N_LATENCY_BUCKETS 21
+
+// collection stages timed per tick (at least N_COLLECT_TASKS, see collect_pool.h)
+#define MAX_TICK_STAGES 8
+
+typedef struct latency_histogram {
+	long counts[N_LATENCY_BUCKETS];
+	long n_values;
+	long max_ns;
+	long total_ns;
+} Latency_Histogram;
+
+// Everything recorded about the ticks covered by one samples buffer
+//	- copied into the buffer right before it is dumped so it gets persisted
+//	  in the same transaction as the samples
+typedef struct tick_stats {
+	long n_ticks;
+	// deadlines that were skipped because the previous tick ran past them
+	long n_missed_ticks;
+	// how late we woke up relative to the deadline
+	Latency_Histogram wake_jitter;
+	// deadline -> end of collection for the tick
+	Latency_Histogram tick_latency;
+	// COLLECTION STAGES
+	//	- collect_latency: start of the tick's collection -> every stage merged (the critical path)
+	//	- stage_sum: sum of the stage durations of a tick (what the collection costs run serially)
+	//	- stages: every stage on its own, counted on the ticks it ran
+	Latency_Histogram collect_latency;
+	Latency_Histogram stage_sum;
+	int n_stages;
+	Latency_Histogram stages[MAX_TICK_STAGES];
+} Tick_Stats;
+
+typedef struct tick_scheduler {
+	// period used for the next deadline, can change between ticks (see set_tick_period)
+	long period_ns;
+	// deadline of the current tick - deadline of the previous one, what the current sample covers
+	//	- the period on the first tick, includes the missed deadlines after an overrun
+	long sample_period_ns;
+	// ALL DEADLINES ARE ON CLOCK_MONOTONIC
+	//	- immune to NTP steps, but the first one is aligned to a multiple
+	//	  of the period on CLOCK_REALTIME so ticks line up across hosts
+	struct timespec deadline;
+	// deadline of the last tick that ended
+	long prev_deadline_ns;
+	Tick_Stats stats;
+} Tick_Scheduler;
+
+
+Tick_Scheduler * init_tick_scheduler(long period_ns);
+
+// sleeps until the next deadline (absolute, no drift) and returns the number of deadlines
+// that were missed since the last call
+long wait_next_tick(Tick_Scheduler * scheduler);
+
+// call when the collection work for the current tick is done
+void end_tick(Tick_Scheduler * scheduler);
+
+// call before end_tick: the next deadline is period_ns after the current one (stays on the
+// original grid when period_ns is a multiple of the initial period)
+void set_tick_period(Tick_Scheduler * scheduler, long period_ns);
+
+void reset_tick_stats(Tick_Stats * tick_stats);
+
+// records one tick's collection: collect_ns for the whole, stage_ns[n_stages] for the stages (0 if a stage didn't run)
+void add_tick_stages(Tick_Scheduler * scheduler, long collect_ns, long * stage_ns, int n_stages);
+
+#endif
@@ -0,0 +1,101 @@
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+
+#include "job_stats.h"
+
+#include "monitoring.h"
+#include "host_stats.h"
+#include "self_stats.h"
+
+
+static long get_process_cpu_ns(){
+	struct timespec cpu_time;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_time);
+	return cpu_time.tv_sec * 1000000000L + cpu_time.tv_nsec;
+}
+
+Self_Stats_Reader * init_self_stats_reader(){
+
+	Self_Stats_Reader * self_stats_reader = (Self_Stats_Reader *) calloc(1, sizeof(Self_Stats_Reader));
+	if (self_stats_reader == NULL){
+		fprintf(stderr, "Could not allocate memory for self stats reader\n");
+		return NULL;
+	}
+
+	// not through open_counter_file, the monitor's own files are never traced or replayed (see file_trace.h)
+	self_stats_reader -> statm_fd = open("/proc/self/statm", O_RDONLY | O_CLOEXEC);
+	if (self_stats_reader -> statm_fd == -1){
+		fprintf(stderr, "Could not open /proc/self/statm\n");
+		free(self_stats_reader);
+		return NULL;
+	}
+	self_stats_reader -> page_kb = sysconf(_SC_PAGESIZE) / 1024;
+	self_stats_reader -> prev_cpu_ns = get_process_cpu_ns();
+
+	return self_stats_reader;
+}
+
+void destroy_self_stats_reader(Self_Stats_Reader * self_stats_reader){
+	if (self_stats_reader == NULL){
+		return;
+	}
+	close(self_stats_reader -> statm_fd);
+	free(self_stats_reader);
+}
+
+int process_self_stats(Self_Stats_Reader * self_stats_reader, Self_Sample * self_sample, long dump_ns_total, long dump_bytes_total){
+
+	long cpu_ns = get_process_cpu_ns();
+	self_sample -> cpu_ns = cpu_ns - self_stats_reader -> prev_cpu_ns;
+	self_stats_reader -> prev_cpu_ns = cpu_ns;
+
+	self_sample -> dump_ns = dump_ns_total - self_stats_reader -> prev_dump_ns;
+	self_sample -> dump_bytes = dump_bytes_total - self_stats_reader -> prev_dump_bytes;
+	self_stats_reader -> prev_dump_ns = dump_ns_total;
+	self_stats_reader -> prev_dump_bytes = dump_bytes_total;
+
+	// size resident shared text lib data dt (pages)
+	int n_read = read_counter_file(self_stats_reader -> statm_fd, self_stats_reader -> buf, SELF_STATM_READ_BYTES);
+	if (n_read <= 0){
+		return -1;
+	}
+	char * pos = self_stats_reader -> buf;
+	char * end = pos + n_read;
+	unsigned long size_pages, resident_pages;
+	if ((scan_next_ulong(&pos, end, &size_pages) == -1) || (scan_next_ulong(&pos, end, &resident_pages) == -1)){
+		return -1;
+	}
+	self_sample -> rss_kb = (long) resident_pages * self_stats_reader -> page_kb;
+
+	return 0;
+}
+
+int open_thread_io_file(){
+	int fd = open("/proc/thread-self/io", O_RDONLY | O_CLOEXEC);
+	if (fd == -1){
+		fprintf(stderr, "Could not open /proc/thread-self/io\n");
+	}
+	return fd;
+}
+
+long read_thread_written_bytes(int fd){
+
+	char buf[THREAD_IO_READ_BYTES];
+	int n_read = read_counter_file(fd, buf, THREAD_IO_READ_BYTES);
+	if (n_read <= 0){
+		return -1;
+	}
+
+	// rchar: <n>\nwchar: <n>\n...
+	char * pos = strstr(buf, "wchar:");
+	if (pos == NULL){
+		return -1;
+	}
+	pos += strlen("wchar:");
+	unsigned long wchar;
+	if (scan_next_ulong(&pos, buf + n_read, &wchar) == -1){
+		return -1;
+	}
+	return (long) wchar;
+}
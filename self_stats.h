@@ -0,0 +1,44 @@
+#ifndef SELF_STATS_H
+#define SELF_STATS_H
+
+// MONITOR SELF-TELEMETRY (Self_Samples, one row per sample)
+//	- stage durations and missed deadlines come from the collection pool / scheduler, dump
+//	  latency, bytes and queue depth from the writer, RSS and cpu time from the process itself
+//	- RSS is the resident field of /proc/self/statm, opened once and re-read with pread every
+//	  tick like the host counters (see host_stats.h)
+//	- cpu time is CLOCK_PROCESS_CPUTIME_ID (every thread, in ns), the utime / stime of
+//	  /proc/self/stat are USER_HZ ticks, too coarse for a 100 ms sample
+//	- dump bytes are the wchar of the writer thread's /proc/thread-self/io around each dump
+//	  (db pages, journal / wal and columnar chunks)
+
+// /proc/self/statm is 7 numbers
+#define SELF_STATM_READ_BYTES 256
+// /proc/thread-self/io is 7 "name: value" lines
+#define THREAD_IO_READ_BYTES 512
+
+typedef struct self_stats_reader {
+	int statm_fd;
+	long page_kb;
+	char buf[SELF_STATM_READ_BYTES];
+	// RUNNING TOTALS AT THE PREVIOUS SAMPLE
+	long prev_cpu_ns;
+	long prev_dump_ns;
+	long prev_dump_bytes;
+} Self_Stats_Reader;
+
+
+// NULL if /proc/self/statm can't be opened, the first sample's cpu time counts from here
+Self_Stats_Reader * init_self_stats_reader();
+void destroy_self_stats_reader(Self_Stats_Reader * self_stats_reader);
+
+// fills rss_kb, cpu_ns and (from the writer's running totals) dump_ns / dump_bytes of
+// self_sample, -1 if statm could not be read
+int process_self_stats(Self_Stats_Reader * self_stats_reader, Self_Sample * self_sample, long dump_ns_total, long dump_bytes_total);
+
+// /proc/thread-self/io of the calling thread, -1 (with a message) if it can't be opened
+int open_thread_io_file();
+
+// bytes the thread passed to write() so far (wchar), -1 on error
+long read_thread_written_bytes(int fd);
+
+#endif
@@ -0,0 +1,1171 @@
+#define _GNU_SOURCE
+
+#include <stdarg.h>
+
+#include "job_stats.h"
+
+#include "monitoring.h"
+#include "samples_arena.h"
+#include "collectors.h"
+#include "collect_pool.h"
+#include "storage.h"
+
+
+#define INSERT_DATA_PREFIX "INSERT INTO Data (timestamp,device_id,field_id,value) VALUES "
+
+// HARDCODED HOST METRICS
+//	- field_id is what the metric is stored as in the (EAV) Data table, with device_id = -1
+//	- column is what it is stored as in the (wide) Host_Samples table
+//	- collector is the source that fills it (see collectors.h), -1 for every sample
+typedef struct host_metric {
+	int field_id;
+	const char * column;
+	int collector;
+} Host_Metric;
+
+static const Host_Metric host_metrics[N_HOST_METRICS] = {
+	{1, "mem_used_pct", COLLECTOR_MEMINFO},
+	{2, "free_mem", COLLECTOR_MEMINFO},
+	{3, "cpu_util_pct", COLLECTOR_PROC},
+	{10, "ib_rx_bytes", COLLECTOR_NET},
+	{11, "ib_tx_bytes", COLLECTOR_NET},
+	{12, "ib_sys_rx_bytes", COLLECTOR_NET},
+	{13, "ib_sys_tx_bytes", COLLECTOR_NET},
+	// SAVE DB SPACE BY NOT STORING ETH DATA. 
+	// PRETTY MUCH NEVER USED SO MIGHT WANT TO COMMENT OUT
+	{14, "eth_rx_bytes", COLLECTOR_NET},
+	{15, "eth_tx_bytes", COLLECTOR_NET},
+	// ms since the previous sample, rates over a sample are value / period_ms
+	{4, "period_ms", -1}
+};
+
+// the metric's collector didn't run for the sample
+static bool is_host_metric_skipped(int metric, unsigned int skipped_collectors){
+	return (host_metrics[metric].collector != -1) && (skipped_collectors & COLLECTOR_BIT(host_metrics[metric].collector));
+}
+
+// same order as host_metrics
+static void get_host_values(Samples_Buffer * samples_buffer, int sample, long * vals){
+
+	Proc_Data * cpu_data = &(samples_buffer -> cpu_util[sample]);
+	Net_Data * net_data = &(samples_buffer -> net_util[sample]);
+
+	vals[0] = round(cpu_data -> mem_used_pct);
+	vals[1] = cpu_data -> free_mem;
+	vals[2] = round(cpu_data -> util_pct);
+	vals[3] = net_data -> ib_rx_bytes;
+	vals[4] = net_data -> ib_tx_bytes;
+	vals[5] = net_data -> ib_sys_rx_bytes;
+	vals[6] = net_data -> ib_sys_tx_bytes;
+	vals[7] = net_data -> eth_rx_bytes;
+	vals[8] = net_data -> eth_tx_bytes;
+	vals[9] = samples_buffer -> periods_ms[sample];
+}
+
+// value of sample i in one field column of the arena
+static long get_gpu_value(void * field_column, int i, unsigned short field_type){
+
+	switch (field_type) {
+		case GPU_FT_DOUBLE:
+			// all the doubles are fractions 0-1, we instead represent as int 0-100
+			return (long) round(((double *) field_column)[i] * 100);
+		case GPU_FT_INT64:
+			return ((long *) field_column)[i];
+		case GPU_FT_TIMESTAMP:
+			return ((long *) field_column)[i];
+		default:
+			return 0;
+	}
+}
+
+// no value for sample i (see GPU VALUE BLANKS in monitoring.h)
+static bool is_gpu_value_blank(void * field_column, int i, unsigned short field_type){
+	return IS_GPU_VALUE_BLANK(field_column, i, field_type);
+}
+
+int parse_storage_mode(char * str, Storage_Mode * storage_mode){
+
+	if (strcmp(str, "eav") == 0){
+		*storage_mode = STORAGE_EAV;
+	}
+	else if (strcmp(str, "wide") == 0){
+		*storage_mode = STORAGE_WIDE;
+	}
+	else if (strcmp(str, "columnar") == 0){
+		*storage_mode = STORAGE_COLUMNAR;
+	}
+	else {
+		fprintf(stderr, "Unknown storage mode: %s (expected eav, wide or columnar)\n", str);
+		return -1;
+	}
+	return 0;
+}
+
+// appends printf-style text to a heap string, returns -1 if out of memory
+static int append_sql(char ** sql, const char * fmt, ...){
+
+	char * addition;
+	char * combined;
+
+	va_list args;
+	va_start(args, fmt);
+	int ret = vasprintf(&addition, fmt, args);
+	va_end(args);
+	if (ret == -1){
+		return -1;
+	}
+
+	ret = asprintf(&combined, "%s%s", (*sql == NULL) ? "" : *sql, addition);
+	free(addition);
+	if (ret == -1){
+		return -1;
+	}
+
+	free(*sql);
+	*sql = combined;
+	return 0;
+}
+
+static int exec_sql(sqlite3 * db, const char * sql){
+
+	char * sqlErr;
+
+	int sql_ret = sqlite3_exec(db, sql, NULL, NULL, &sqlErr);
+	if (sql_ret != SQLITE_OK){
+		fprintf(stderr, "SQL Error: %s\n", sqlErr);
+		sqlite3_free(sqlErr);
+		return -1;
+	}
+	return 0;
+}
+
+static int table_has_column(sqlite3 * db, const char * table, const char * column){
+
+	char * sql;
+	asprintf(&sql, "SELECT 1 FROM pragma_table_info('%s') WHERE name = '%s';", table, column);
+
+	sqlite3_stmt * stmt;
+	int found = 0;
+	if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) == SQLITE_OK){
+		found = (sqlite3_step(stmt) == SQLITE_ROW);
+		sqlite3_finalize(stmt);
+	}
+	free(sql);
+	return found;
+}
+
+// returns "table", "view" or NULL (caller frees)
+static char * get_object_type(sqlite3 * db, const char * name){
+
+	sqlite3_stmt * stmt;
+	char * type = NULL;
+	if (sqlite3_prepare_v2(db, "SELECT type FROM sqlite_master WHERE name = ?;", -1, &stmt, NULL) == SQLITE_OK){
+		sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
+		if (sqlite3_step(stmt) == SQLITE_ROW){
+			type = strdup((const char *) sqlite3_column_text(stmt, 0));
+		}
+		sqlite3_finalize(stmt);
+	}
+	return type;
+}
+
+// WIDE SCHEMA:
+//	- Host_Samples: one row per sample, one column per host metric
+//	- Gpu_Samples: one row per (sample, GPU), one column per configured DCGM field (field_<id>)
+//	- Data: view that unpivots both back into (timestamp, device_id, field_id, value) so old queries still work
+static int create_wide_tables(sqlite3 * db, int n_fields, unsigned short * field_ids){
+
+	char * sql = NULL;
+	char * column;
+	int err = 0;
+
+	append_sql(&sql, "CREATE TABLE IF NOT EXISTS Host_Samples (timestamp INT");
+	for (int i = 0; i < N_HOST_METRICS; i++){
+		append_sql(&sql, ", %s INT", host_metrics[i].column);
+	}
+	append_sql(&sql, ");CREATE TABLE IF NOT EXISTS Gpu_Samples (timestamp INT, device_id INT);");
+	if ((sql == NULL) || (exec_sql(db, sql) == -1)){
+		free(sql);
+		return -1;
+	}
+	free(sql);
+	sql = NULL;
+
+	// field list can change between runs, add columns for any new fields (and host metrics
+	// added since the table was created)
+	//	- rows written before the column existed read back as NULL
+	for (int i = 0; i < N_HOST_METRICS; i++){
+		if (!table_has_column(db, "Host_Samples", host_metrics[i].column)){
+			append_sql(&sql, "ALTER TABLE Host_Samples ADD COLUMN %s INT;", host_metrics[i].column);
+		}
+	}
+	for (int i = 0; i < n_fields; i++){
+		asprintf(&column, "field_%u", field_ids[i]);
+		if (!table_has_column(db, "Gpu_Samples", column)){
+			append_sql(&sql, "ALTER TABLE Gpu_Samples ADD COLUMN %s INT;", column);
+		}
+		free(column);
+	}
+	if ((sql != NULL) && (exec_sql(db, sql) == -1)){
+		err = -1;
+	}
+	free(sql);
+	if (err == -1){
+		return -1;
+	}
+
+	// COMPATIBILITY VIEW
+	//	- SQLite pushes "WHERE field_id = X" into each UNION ALL arm, arms with a different (constant) field_id are skipped without a scan
+	char * data_type = get_object_type(db, "Data");
+	if ((data_type != NULL) && (strcmp(data_type, "table") == 0)){
+		fprintf(stderr, "Data table from eav storage already exists in this db, not creating compatibility view\n");
+		free(data_type);
+		return 0;
+	}
+	free(data_type);
+
+	sql = NULL;
+	append_sql(&sql, "DROP VIEW IF EXISTS Data;CREATE VIEW Data AS ");
+	for (int i = 0; i < N_HOST_METRICS; i++){
+		append_sql(&sql, "%sSELECT timestamp, -1 AS device_id, %d AS field_id, %s AS value FROM Host_Samples", (i == 0) ? "" : " UNION ALL ", host_metrics[i].field_id, host_metrics[i].column);
+	}
+	for (int i = 0; i < n_fields; i++){
+		append_sql(&sql, " UNION ALL SELECT timestamp, device_id, %u, field_%u FROM Gpu_Samples", field_ids[i], field_ids[i]);
+	}
+	append_sql(&sql, ";");
+
+	if ((sql == NULL) || (exec_sql(db, sql) == -1)){
+		err = -1;
+	}
+	free(sql);
+	return err;
+}
+
+int create_storage_tables(sqlite3 * db, Storage_Mode storage_mode, int n_fields, unsigned short * field_ids){
+
+	if (storage_mode == STORAGE_WIDE){
+		return create_wide_tables(db, n_fields, field_ids);
+	}
+
+	// samples go to the columnar file
+	if (storage_mode == STORAGE_COLUMNAR){
+		return 0;
+	}
+
+	char * type = get_object_type(db, "Data");
+	if ((type != NULL) && (strcmp(type, "view") == 0)){
+		fprintf(stderr, "Data is a view from wide storage in this db, cannot use eav storage\n");
+		free(type);
+		return -1;
+	}
+	free(type);
+
+	return exec_sql(db, "CREATE TABLE IF NOT EXISTS Data (timestamp INT, device_id INT, field_id INT, value INT);");
+}
+
+static sqlite3_stmt * prepare_statement(sqlite3 * db, const char * sql){
+
+	sqlite3_stmt * stmt;
+
+	int sql_ret = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+	if (sql_ret != SQLITE_OK){
+		fprintf(stderr, "SQL error preparing statement: %s\n", sqlite3_errmsg(db));
+		return NULL;
+	}
+	return stmt;
+}
+
+Storage * init_storage(sqlite3 * db, Storage_Mode storage_mode, int batch_rows, int n_fields, unsigned short * field_ids){
+
+	if (batch_rows < 1){
+		fprintf(stderr, "Storage batch size must be at least 1\n");
+		return NULL;
+	}
+
+	Storage * storage = (Storage *) malloc(sizeof(Storage));
+	if (storage == NULL){
+		fprintf(stderr, "Could not allocate memory for storage\n");
+		return NULL;
+	}
+
+	storage -> db = db;
+	storage -> storage_mode = storage_mode;
+	storage -> batch_rows = batch_rows;
+	storage -> insert_batch = NULL;
+	storage -> insert_single = NULL;
+	storage -> insert_host = NULL;
+	storage -> insert_gpu = NULL;
+	storage -> insert_core = NULL;
+	storage -> insert_job = NULL;
+	storage -> upsert_gpu_job = NULL;
+	storage -> insert_port = NULL;
+	storage -> insert_self = NULL;
+	storage -> insert_gpu_value = NULL;
+	storage -> insert_ticks = NULL;
+	storage -> insert_tick_latency = NULL;
+	storage -> insert_tick_stage = NULL;
+	storage -> insert_writer_stats = NULL;
+	storage -> columnar_writer = NULL;
+	storage -> n_pending = 0;
+	storage -> n_rows_written = 0;
+	storage -> n_row_errors = 0;
+	storage -> pending = (long *) malloc(4 * batch_rows * sizeof(long));
+	if (storage -> pending == NULL){
+		fprintf(stderr, "Could not allocate memory for pending rows\n");
+		free(storage);
+		return NULL;
+	}
+
+	storage -> begin = prepare_statement(db, "BEGIN");
+	storage -> commit = prepare_statement(db, "COMMIT");
+	storage -> rollback = prepare_statement(db, "ROLLBACK");
+
+	if (storage_mode == STORAGE_COLUMNAR){
+		if ((storage -> begin == NULL) || (storage -> commit == NULL) || (storage -> rollback == NULL)){
+			destroy_storage(storage);
+			return NULL;
+		}
+		return storage;
+	}
+
+	if (storage_mode == STORAGE_WIDE){
+		char * host_sql = NULL;
+		char * gpu_sql = NULL;
+
+		append_sql(&host_sql, "INSERT INTO Host_Samples (timestamp");
+		for (int i = 0; i < N_HOST_METRICS; i++){
+			append_sql(&host_sql, ",%s", host_metrics[i].column);
+		}
+		append_sql(&host_sql, ") VALUES (?");
+		for (int i = 0; i < N_HOST_METRICS; i++){
+			append_sql(&host_sql, ",?");
+		}
+		append_sql(&host_sql, ");");
+
+		append_sql(&gpu_sql, "INSERT INTO Gpu_Samples (timestamp,device_id");
+		for (int i = 0; i < n_fields; i++){
+			append_sql(&gpu_sql, ",field_%u", field_ids[i]);
+		}
+		append_sql(&gpu_sql, ") VALUES (?,?");
+		for (int i = 0; i < n_fields; i++){
+			append_sql(&gpu_sql, ",?");
+		}
+		append_sql(&gpu_sql, ");");
+
+		if ((host_sql != NULL) && (gpu_sql != NULL)){
+			storage -> insert_host = prepare_statement(db, host_sql);
+			storage -> insert_gpu = prepare_statement(db, gpu_sql);
+		}
+		free(host_sql);
+		free(gpu_sql);
+
+		if ((storage -> insert_host == NULL) || (storage -> insert_gpu == NULL) || (storage -> begin == NULL) || (storage -> commit == NULL) || (storage -> rollback == NULL)){
+			destroy_storage(storage);
+			return NULL;
+		}
+		return storage;
+	}
+
+	// build "INSERT ... VALUES (?,?,?,?),(?,?,?,?),..." once
+	const char * tuple = "(?,?,?,?)";
+	int prefix_len = strlen(INSERT_DATA_PREFIX);
+	int tuple_len = strlen(tuple);
+	char * batch_sql = (char *) malloc(prefix_len + batch_rows * (tuple_len + 1) + 1);
+	if (batch_sql == NULL){
+		fprintf(stderr, "Could not allocate memory for batch insert statement\n");
+		free(storage -> pending);
+		free(storage);
+		return NULL;
+	}
+
+	char * cur = batch_sql;
+	memcpy(cur, INSERT_DATA_PREFIX, prefix_len);
+	cur += prefix_len;
+	for (int i = 0; i < batch_rows; i++){
+		if (i > 0){
+			*cur = ',';
+			cur++;
+		}
+		memcpy(cur, tuple, tuple_len);
+		cur += tuple_len;
+	}
+	*cur = '\0';
+
+	storage -> insert_batch = prepare_statement(db, batch_sql);
+	free(batch_sql);
+
+	storage -> insert_single = prepare_statement(db, INSERT_DATA_PREFIX "(?,?,?,?);");
+
+	if ((storage -> insert_batch == NULL) || (storage -> insert_single == NULL) || (storage -> begin == NULL) || (storage -> commit == NULL) || (storage -> rollback == NULL)){
+		destroy_storage(storage);
+		return NULL;
+	}
+
+	return storage;
+}
+
+void destroy_storage(Storage * storage){
+
+	// finalize on NULL is a no-op
+	sqlite3_finalize(storage -> insert_batch);
+	sqlite3_finalize(storage -> insert_single);
+	sqlite3_finalize(storage -> insert_host);
+	sqlite3_finalize(storage -> insert_gpu);
+	sqlite3_finalize(storage -> insert_core);
+	sqlite3_finalize(storage -> insert_job);
+	sqlite3_finalize(storage -> upsert_gpu_job);
+	sqlite3_finalize(storage -> insert_port);
+	sqlite3_finalize(storage -> insert_self);
+	sqlite3_finalize(storage -> insert_gpu_value);
+	sqlite3_finalize(storage -> insert_ticks);
+	sqlite3_finalize(storage -> insert_tick_latency);
+	sqlite3_finalize(storage -> insert_tick_stage);
+	sqlite3_finalize(storage -> insert_writer_stats);
+	sqlite3_finalize(storage -> begin);
+	sqlite3_finalize(storage -> commit);
+	sqlite3_finalize(storage -> rollback);
+
+	free(storage -> pending);
+	free(storage);
+}
+
+static int step_and_reset(Storage * storage, sqlite3_stmt * stmt){
+
+	int sql_ret = sqlite3_step(stmt);
+	sqlite3_reset(stmt);
+
+	if (sql_ret != SQLITE_DONE){
+		fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg(storage -> db));
+		storage -> n_txn_errors++;
+		return -1;
+	}
+	return 0;
+}
+
+// binds rows [0, n_rows) of the pending values to stmt and runs it
+static int flush_rows(Storage * storage, sqlite3_stmt * stmt, long * rows, int n_rows){
+
+	// parameters are 1-indexed
+	for (int i = 0; i < 4 * n_rows; i++){
+		sqlite3_bind_int64(stmt, i + 1, rows[i]);
+	}
+
+	if (step_and_reset(storage, stmt) == -1){
+		storage -> n_row_errors += n_rows;
+		return -1;
+	}
+	storage -> n_rows_written += n_rows;
+	return 0;
+}
+
+int storage_begin(Storage * storage){
+	storage -> n_pending = 0;
+	storage -> n_txn_errors = 0;
+	return step_and_reset(storage, storage -> begin);
+}
+
+int storage_add_row(Storage * storage, long timestamp, long device_id, long field_id, long value){
+
+	long * row = &(storage -> pending[4 * storage -> n_pending]);
+	row[0] = timestamp;
+	row[1] = device_id;
+	row[2] = field_id;
+	row[3] = value;
+	storage -> n_pending++;
+
+	if (storage -> n_pending < storage -> batch_rows){
+		return 0;
+	}
+
+	storage -> n_pending = 0;
+	return flush_rows(storage, storage -> insert_batch, storage -> pending, storage -> batch_rows);
+}
+
+// WIDE: one row of host metrics per sample, NULL for the metrics whose collector was skipped
+static int storage_add_host_row(Storage * storage, long timestamp, long * vals, unsigned int skipped_collectors){
+
+	sqlite3_stmt * stmt = storage -> insert_host;
+
+	sqlite3_bind_int64(stmt, 1, timestamp);
+	for (int i = 0; i < N_HOST_METRICS; i++){
+		if (is_host_metric_skipped(i, skipped_collectors)){
+			sqlite3_bind_null(stmt, i + 2);
+		}
+		else {
+			sqlite3_bind_int64(stmt, i + 2, vals[i]);
+		}
+	}
+
+	if (step_and_reset(storage, stmt) == -1){
+		storage -> n_row_errors++;
+		return -1;
+	}
+	storage -> n_rows_written++;
+	return 0;
+}
+
+// WIDE: one row per GPU per sample, field values in the order of the field list
+static int storage_add_gpu_row(Storage * storage, long timestamp, int device_id, Samples_Buffer * samples_buffer, int sample){
+
+	sqlite3_stmt * stmt = storage -> insert_gpu;
+	int n_fields = samples_buffer -> n_fields;
+	unsigned short * field_types = samples_buffer -> field_types;
+
+	sqlite3_bind_int64(stmt, 1, timestamp);
+	sqlite3_bind_int64(stmt, 2, device_id);
+	void * field_column;
+	for (int i = 0; i < n_fields; i++){
+		field_column = FIELD_COLUMN(samples_buffer, device_id * n_fields + i);
+		if (is_gpu_value_blank(field_column, sample, field_types[i])){
+			sqlite3_bind_null(stmt, i + 3);
+			continue;
+		}
+		sqlite3_bind_int64(stmt, i + 3, get_gpu_value(field_column, sample, field_types[i]));
+	}
+
+	if (step_and_reset(storage, stmt) == -1){
+		storage -> n_row_errors++;
+		return -1;
+	}
+	storage -> n_rows_written++;
+	return 0;
+}
+
+static long get_sample_time_ns(Samples_Buffer * samples_buffer, int i){
+	return samples_buffer -> times[i].tv_sec * 1e9 + samples_buffer -> times[i].tv_nsec;
+}
+
+// PER-CORE: one row per sample, the N_CORE_UTIL_COLUMNS * n_cpu bytes as a blob (layout in monitoring.h)
+static int storage_add_core_row(Storage * storage, long timestamp, Samples_Buffer * samples_buffer, int sample){
+
+	if (storage -> insert_core == NULL){
+		if (exec_sql(storage -> db, "CREATE TABLE IF NOT EXISTS Cpu_Core_Samples (timestamp INT, n_cpu INT, core_util BLOB);") == -1){
+			return -1;
+		}
+		storage -> insert_core = prepare_statement(storage -> db, "INSERT INTO Cpu_Core_Samples (timestamp,n_cpu,core_util) VALUES (?,?,?);");
+		if (storage -> insert_core == NULL){
+			return -1;
+		}
+	}
+
+	sqlite3_stmt * stmt = storage -> insert_core;
+	int n_core_bytes = samples_buffer -> n_core_bytes;
+
+	sqlite3_bind_int64(stmt, 1, timestamp);
+	sqlite3_bind_int(stmt, 2, n_core_bytes / N_CORE_UTIL_COLUMNS);
+	// the arena outlives the step
+	sqlite3_bind_blob(stmt, 3, &(samples_buffer -> core_util[(size_t) sample * n_core_bytes]), n_core_bytes, SQLITE_STATIC);
+
+	if (step_and_reset(storage, stmt) == -1){
+		storage -> n_row_errors++;
+		return -1;
+	}
+	storage -> n_rows_written++;
+	return 0;
+}
+
+// PER-JOB: one row per occupied job slot of a sample
+static int storage_add_job_row(Storage * storage, long timestamp, Job_Sample * job_sample){
+
+	if (storage -> insert_job == NULL){
+		if (exec_sql(storage -> db, "CREATE TABLE IF NOT EXISTS Job_Samples (timestamp INT, job_id INT, cpu_usage_usec INT, cpu_user_usec INT, cpu_system_usec INT, "
+						"mem_current_bytes INT, mem_anon_bytes INT, mem_file_bytes INT, io_read_bytes INT, io_write_bytes INT, gpu_mask INT);") == -1){
+			return -1;
+		}
+		// tables from before GPU ownership was tracked
+		if ((!table_has_column(storage -> db, "Job_Samples", "gpu_mask")) && (exec_sql(storage -> db, "ALTER TABLE Job_Samples ADD COLUMN gpu_mask INT;") == -1)){
+			return -1;
+		}
+		storage -> insert_job = prepare_statement(storage -> db, "INSERT INTO Job_Samples (timestamp,job_id,cpu_usage_usec,cpu_user_usec,cpu_system_usec,"
+						"mem_current_bytes,mem_anon_bytes,mem_file_bytes,io_read_bytes,io_write_bytes,gpu_mask) VALUES (?,?,?,?,?,?,?,?,?,?,?);");
+		if (storage -> insert_job == NULL){
+			return -1;
+		}
+	}
+
+	sqlite3_stmt * stmt = storage -> insert_job;
+
+	sqlite3_bind_int64(stmt, 1, timestamp);
+	sqlite3_bind_int64(stmt, 2, job_sample -> job_id);
+	sqlite3_bind_int64(stmt, 3, job_sample -> cpu_usage_usec);
+	sqlite3_bind_int64(stmt, 4, job_sample -> cpu_user_usec);
+	sqlite3_bind_int64(stmt, 5, job_sample -> cpu_system_usec);
+	sqlite3_bind_int64(stmt, 6, job_sample -> mem_current_bytes);
+	sqlite3_bind_int64(stmt, 7, job_sample -> mem_anon_bytes);
+	sqlite3_bind_int64(stmt, 8, job_sample -> mem_file_bytes);
+	sqlite3_bind_int64(stmt, 9, job_sample -> io_read_bytes);
+	sqlite3_bind_int64(stmt, 10, job_sample -> io_write_bytes);
+	sqlite3_bind_int64(stmt, 11, (long) job_sample -> gpu_mask);
+
+	if (step_and_reset(storage, stmt) == -1){
+		storage -> n_row_errors++;
+		return -1;
+	}
+	storage -> n_rows_written++;
+	return 0;
+}
+
+// PER-PORT: one row per (sample, series) with a nonzero delta
+static int storage_add_port_row(Storage * storage, long timestamp, int series_id, long value){
+
+	if (storage -> insert_port == NULL){
+		if (exec_sql(storage -> db, "CREATE TABLE IF NOT EXISTS Port_Samples (timestamp INT, series_id INT, value INT);") == -1){
+			return -1;
+		}
+		storage -> insert_port = prepare_statement(storage -> db, "INSERT INTO Port_Samples (timestamp,series_id,value) VALUES (?,?,?);");
+		if (storage -> insert_port == NULL){
+			return -1;
+		}
+	}
+
+	sqlite3_stmt * stmt = storage -> insert_port;
+
+	sqlite3_bind_int64(stmt, 1, timestamp);
+	sqlite3_bind_int(stmt, 2, series_id);
+	sqlite3_bind_int64(stmt, 3, value);
+
+	if (step_and_reset(storage, stmt) == -1){
+		storage -> n_row_errors++;
+		return -1;
+	}
+	storage -> n_rows_written++;
+	return 0;
+}
+
+// GPU VALUES: one row per value a GPU source sampled on its own timeline, same units as the tick grid
+static int storage_add_gpu_value_row(Storage * storage, Gpu_Value * gpu_value, unsigned short field_id, unsigned short field_type){
+
+	if (storage -> insert_gpu_value == NULL){
+		if (exec_sql(storage -> db, "CREATE TABLE IF NOT EXISTS Gpu_Values (timestamp INT, device_id INT, field_id INT, value INT);") == -1){
+			return -1;
+		}
+		storage -> insert_gpu_value = prepare_statement(storage -> db, "INSERT INTO Gpu_Values (timestamp,device_id,field_id,value) VALUES (?,?,?,?);");
+		if (storage -> insert_gpu_value == NULL){
+			return -1;
+		}
+	}
+
+	sqlite3_stmt * stmt = storage -> insert_gpu_value;
+
+	sqlite3_bind_int64(stmt, 1, gpu_value -> timestamp_ns);
+	sqlite3_bind_int(stmt, 2, gpu_value -> device_id);
+	sqlite3_bind_int(stmt, 3, field_id);
+	if (is_gpu_value_blank(&(gpu_value -> value), 0, field_type)){
+		sqlite3_bind_null(stmt, 4);
+	}
+	else {
+		sqlite3_bind_int64(stmt, 4, get_gpu_value(&(gpu_value -> value), 0, field_type));
+	}
+
+	if (step_and_reset(storage, stmt) == -1){
+		storage -> n_row_errors++;
+		return -1;
+	}
+	storage -> n_rows_written++;
+	return 0;
+}
+
+int register_port_series(sqlite3 * db, int n_series, char ** ports, char ** counters, int * series_ids){
+
+	if (exec_sql(db, "CREATE TABLE IF NOT EXISTS Port_Series (series_id INTEGER PRIMARY KEY, port TEXT, counter TEXT, UNIQUE (port, counter));") == -1){
+		return -1;
+	}
+	sqlite3_stmt * insert = prepare_statement(db, "INSERT OR IGNORE INTO Port_Series (port,counter) VALUES (?,?);");
+	sqlite3_stmt * select = prepare_statement(db, "SELECT series_id FROM Port_Series WHERE port = ? AND counter = ?;");
+	int err = ((insert == NULL) || (select == NULL)) ? -1 : 0;
+	for (int s = 0; (s < n_series) && (err == 0); s++){
+		sqlite3_bind_text(insert, 1, ports[s], -1, SQLITE_STATIC);
+		sqlite3_bind_text(insert, 2, counters[s], -1, SQLITE_STATIC);
+		sqlite3_bind_text(select, 1, ports[s], -1, SQLITE_STATIC);
+		sqlite3_bind_text(select, 2, counters[s], -1, SQLITE_STATIC);
+		if ((sqlite3_step(insert) != SQLITE_DONE) || (sqlite3_step(select) != SQLITE_ROW)){
+			fprintf(stderr, "SQL error registering port series %s %s: %s\n", ports[s], counters[s], sqlite3_errmsg(db));
+			err = -1;
+		}
+		else {
+			series_ids[s] = sqlite3_column_int(select, 0);
+		}
+		sqlite3_reset(insert);
+		sqlite3_reset(select);
+	}
+	sqlite3_finalize(insert);
+	sqlite3_finalize(select);
+	return err;
+}
+
+// GPU OWNERSHIP: widens the (job_id, gpu_id) interval to cover [start_ns, end_ns]
+//	- one upsert per (job, GPU) per buffer, the table is never rebuilt from Job_Samples
+static int storage_add_gpu_job_interval(Storage * storage, long job_id, int gpu_id, long start_ns, long end_ns){
+
+	if (storage -> upsert_gpu_job == NULL){
+		if (exec_sql(storage -> db, "CREATE TABLE IF NOT EXISTS Gpu_Jobs (job_id INT, gpu_id INT, start_ns INT, end_ns INT, PRIMARY KEY (job_id, gpu_id));") == -1){
+			return -1;
+		}
+		storage -> upsert_gpu_job = prepare_statement(storage -> db, "INSERT INTO Gpu_Jobs (job_id,gpu_id,start_ns,end_ns) VALUES (?,?,?,?) "
+						"ON CONFLICT(job_id,gpu_id) DO UPDATE SET start_ns = MIN(start_ns, excluded.start_ns), end_ns = MAX(end_ns, excluded.end_ns);");
+		if (storage -> upsert_gpu_job == NULL){
+			return -1;
+		}
+	}
+
+	sqlite3_stmt * stmt = storage -> upsert_gpu_job;
+
+	sqlite3_bind_int64(stmt, 1, job_id);
+	sqlite3_bind_int64(stmt, 2, gpu_id);
+	sqlite3_bind_int64(stmt, 3, start_ns);
+	sqlite3_bind_int64(stmt, 4, end_ns);
+
+	if (step_and_reset(storage, stmt) == -1){
+		storage -> n_row_errors++;
+		return -1;
+	}
+	storage -> n_rows_written++;
+	return 0;
+}
+
+// first and last sample of the buffer in which each job held GPUs
+typedef struct gpu_job_span {
+	long job_id;
+	unsigned long gpu_mask;
+	long start_ns;
+	long end_ns;
+} Gpu_Job_Span;
+
+static int dump_gpu_job_intervals(Samples_Buffer * samples_buffer, Storage * storage){
+
+	int max_jobs = samples_buffer -> max_jobs;
+	int n_samples = samples_buffer -> n_samples;
+	// jobs can come and go within a buffer, but at most max_jobs at a time
+	int max_spans = 4 * max_jobs;
+	Gpu_Job_Span * spans = (Gpu_Job_Span *) malloc(max_spans * sizeof(Gpu_Job_Span));
+	if (spans == NULL){
+		fprintf(stderr, "Could not allocate memory for gpu job intervals\n");
+		return -1;
+	}
+
+	int n_spans = 0;
+	int s;
+	long time_ns;
+	Job_Sample * job_sample;
+	for (int i = 0; i < n_samples; i++){
+		time_ns = get_sample_time_ns(samples_buffer, i);
+		for (int j = 0; j < max_jobs; j++){
+			job_sample = &(samples_buffer -> job_samples[i * max_jobs + j]);
+			if (job_sample -> job_id == 0){
+				break;
+			}
+			if (job_sample -> gpu_mask == 0){
+				continue;
+			}
+			for (s = 0; s < n_spans; s++){
+				if (spans[s].job_id == job_sample -> job_id){
+					break;
+				}
+			}
+			if (s == n_spans){
+				if (n_spans == max_spans){
+					max_spans *= 2;
+					Gpu_Job_Span * more_spans = (Gpu_Job_Span *) realloc(spans, max_spans * sizeof(Gpu_Job_Span));
+					if (more_spans == NULL){
+						fprintf(stderr, "Could not allocate memory for gpu job intervals\n");
+						free(spans);
+						return -1;
+					}
+					spans = more_spans;
+				}
+				spans[s].job_id = job_sample -> job_id;
+				spans[s].gpu_mask = 0;
+				spans[s].start_ns = time_ns;
+				n_spans++;
+			}
+			spans[s].gpu_mask |= job_sample -> gpu_mask;
+			spans[s].end_ns = time_ns;
+		}
+	}
+
+	int err = 0;
+	for (s = 0; s < n_spans; s++){
+		for (int gpu_id = 0; gpu_id < MAX_JOB_GPUS; gpu_id++){
+			if ((spans[s].gpu_mask & (1UL << gpu_id)) && (storage_add_gpu_job_interval(storage, spans[s].job_id, gpu_id, spans[s].start_ns, spans[s].end_ns) == -1)){
+				err = -1;
+			}
+		}
+	}
+
+	free(spans);
+	return err;
+}
+
+int storage_commit(Storage * storage){
+
+	// the multi-row statement needs every tuple bound, so the tail goes through the single row statement
+	int err = 0;
+	for (int i = 0; i < storage -> n_pending; i++){
+		if (flush_rows(storage, storage -> insert_single, &(storage -> pending[4 * i]), 1) == -1){
+			err = -1;
+		}
+	}
+	storage -> n_pending = 0;
+
+	// a dump is all or nothing, and a connection left inside the transaction would fail every later BEGIN
+	if ((storage -> n_txn_errors > 0) || (step_and_reset(storage, storage -> commit) == -1)){
+		// some errors (e.g. SQLITE_FULL) already rolled back on their own
+		if ((!sqlite3_get_autocommit(storage -> db)) && (step_and_reset(storage, storage -> rollback) == -1)){
+			fprintf(stderr, "Could not roll back the dump transaction\n");
+		}
+		fprintf(stderr, "Dump transaction rolled back (failed statements: %d)\n", storage -> n_txn_errors);
+		return -1;
+	}
+	return err;
+}
+
+static int prepare_tick_statements(Storage * storage){
+
+	if (exec_sql(storage -> db, "CREATE TABLE IF NOT EXISTS Ticks (timestamp INT, n_ticks INT, n_missed INT, mean_jitter_ns INT, max_jitter_ns INT, mean_latency_ns INT, max_latency_ns INT);"
+					"CREATE TABLE IF NOT EXISTS Tick_Latency (timestamp INT, histogram_id INT, bucket_upper_us INT, count INT);"
+					"CREATE TABLE IF NOT EXISTS Tick_Stages (timestamp INT, stage TEXT, n_runs INT, mean_ns INT, max_ns INT);") == -1){
+		return -1;
+	}
+	storage -> insert_ticks = prepare_statement(storage -> db, "INSERT INTO Ticks (timestamp,n_ticks,n_missed,mean_jitter_ns,max_jitter_ns,mean_latency_ns,max_latency_ns) VALUES (?,?,?,?,?,?,?);");
+	storage -> insert_tick_latency = prepare_statement(storage -> db, "INSERT INTO Tick_Latency (timestamp,histogram_id,bucket_upper_us,count) VALUES (?,?,?,?);");
+	storage -> insert_tick_stage = prepare_statement(storage -> db, "INSERT INTO Tick_Stages (timestamp,stage,n_runs,mean_ns,max_ns) VALUES (?,?,?,?,?);");
+	if ((storage -> insert_ticks == NULL) || (storage -> insert_tick_latency == NULL) || (storage -> insert_tick_stage == NULL)){
+		// finalize on NULL is a no-op, the next dump tries again
+		sqlite3_finalize(storage -> insert_ticks);
+		sqlite3_finalize(storage -> insert_tick_latency);
+		sqlite3_finalize(storage -> insert_tick_stage);
+		storage -> insert_ticks = NULL;
+		storage -> insert_tick_latency = NULL;
+		storage -> insert_tick_stage = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+static int insert_histogram_to_db(Storage * storage, long timestamp_ns, int histogram_id, Latency_Histogram * hist){
+
+	sqlite3_stmt * stmt = storage -> insert_tick_latency;
+	int err = 0;
+
+	// bucket i covers [2^(i-1), 2^i) us, store the upper bound and skip empty buckets
+	for (int i = 0; i < N_LATENCY_BUCKETS; i++){
+		if (hist -> counts[i] == 0){
+			continue;
+		}
+		sqlite3_bind_int64(stmt, 1, timestamp_ns);
+		sqlite3_bind_int(stmt, 2, histogram_id);
+		sqlite3_bind_int64(stmt, 3, 1L << i);
+		sqlite3_bind_int64(stmt, 4, hist -> counts[i]);
+		if (step_and_reset(storage, stmt) == -1){
+			err = -1;
+		}
+	}
+	return err;
+}
+
+// one row of Tick_Stages: how often the stage ran in the buffer, its mean and max
+static int insert_tick_stage_to_db(Storage * storage, long timestamp_ns, const char * stage, Latency_Histogram * hist){
+
+	sqlite3_stmt * stmt = storage -> insert_tick_stage;
+
+	long mean_ns = (hist -> n_values > 0) ? hist -> total_ns / hist -> n_values : 0;
+	sqlite3_bind_int64(stmt, 1, timestamp_ns);
+	sqlite3_bind_text(stmt, 2, stage, -1, SQLITE_STATIC);
+	sqlite3_bind_int64(stmt, 3, hist -> n_values);
+	sqlite3_bind_int64(stmt, 4, mean_ns);
+	sqlite3_bind_int64(stmt, 5, hist -> max_ns);
+	return step_and_reset(storage, stmt);
+}
+
+static int insert_tick_stats_to_db(Storage * storage, long timestamp_ns, Tick_Stats * tick_stats){
+
+	if ((storage -> insert_ticks == NULL) && (prepare_tick_statements(storage) == -1)){
+		return -1;
+	}
+
+	Latency_Histogram * jitter = &(tick_stats -> wake_jitter);
+	Latency_Histogram * latency = &(tick_stats -> tick_latency);
+
+	long mean_jitter_ns = (jitter -> n_values > 0) ? jitter -> total_ns / jitter -> n_values : 0;
+	long mean_latency_ns = (latency -> n_values > 0) ? latency -> total_ns / latency -> n_values : 0;
+
+	sqlite3_stmt * stmt = storage -> insert_ticks;
+
+	sqlite3_bind_int64(stmt, 1, timestamp_ns);
+	sqlite3_bind_int64(stmt, 2, tick_stats -> n_ticks);
+	sqlite3_bind_int64(stmt, 3, tick_stats -> n_missed_ticks);
+	sqlite3_bind_int64(stmt, 4, mean_jitter_ns);
+	sqlite3_bind_int64(stmt, 5, jitter -> max_ns);
+	sqlite3_bind_int64(stmt, 6, mean_latency_ns);
+	sqlite3_bind_int64(stmt, 7, latency -> max_ns);
+
+	int err = step_and_reset(storage, stmt);
+
+	// HARDCODING HISTOGRAM IDS:
+	//	- 0 = wake jitter (wakeup - deadline)
+	//	- 1 = tick latency (end of collection - deadline)
+	err |= insert_histogram_to_db(storage, timestamp_ns, 0, jitter);
+	err |= insert_histogram_to_db(storage, timestamp_ns, 1, latency);
+
+	// COLLECTION STAGES (see collect_pool.h)
+	//	- 2 = collection (start -> every stage merged), 3 = sum of the stages
+	if (tick_stats -> collect_latency.n_values == 0){
+		return err;
+	}
+	err |= insert_histogram_to_db(storage, timestamp_ns, 2, &(tick_stats -> collect_latency));
+	err |= insert_histogram_to_db(storage, timestamp_ns, 3, &(tick_stats -> stage_sum));
+
+	err |= insert_tick_stage_to_db(storage, timestamp_ns, "collect", &(tick_stats -> collect_latency));
+	err |= insert_tick_stage_to_db(storage, timestamp_ns, "stage_sum", &(tick_stats -> stage_sum));
+	const char * stage_names[N_COLLECT_TASKS] = COLLECT_TASK_NAMES;
+	for (int i = 0; (i < tick_stats -> n_stages) && (i < N_COLLECT_TASKS); i++){
+		if (tick_stats -> stages[i].n_values > 0){
+			err |= insert_tick_stage_to_db(storage, timestamp_ns, stage_names[i], &(tick_stats -> stages[i]));
+		}
+	}
+	return err;
+}
+
+int storage_add_writer_stats_row(Storage * storage, long timestamp_ns, long n_submitted, long n_dumped, long n_dump_errors, long n_dropped,
+					long n_delayed, long delayed_ns, int queue_len, long dump_ns){
+
+	if (storage -> insert_writer_stats == NULL){
+		if (exec_sql(storage -> db, "CREATE TABLE IF NOT EXISTS Writer_Stats (timestamp INT, n_submitted INT, n_dumped INT, n_dump_errors INT, n_dropped INT, n_delayed INT, delayed_ns INT, queue_len INT, dump_ns INT);") == -1){
+			return -1;
+		}
+		storage -> insert_writer_stats = prepare_statement(storage -> db, "INSERT INTO Writer_Stats (timestamp,n_submitted,n_dumped,n_dump_errors,n_dropped,n_delayed,delayed_ns,queue_len,dump_ns) VALUES (?,?,?,?,?,?,?,?,?);");
+		if (storage -> insert_writer_stats == NULL){
+			return -1;
+		}
+	}
+
+	sqlite3_stmt * stmt = storage -> insert_writer_stats;
+
+	sqlite3_bind_int64(stmt, 1, timestamp_ns);
+	sqlite3_bind_int64(stmt, 2, n_submitted);
+	sqlite3_bind_int64(stmt, 3, n_dumped);
+	sqlite3_bind_int64(stmt, 4, n_dump_errors);
+	sqlite3_bind_int64(stmt, 5, n_dropped);
+	sqlite3_bind_int64(stmt, 6, n_delayed);
+	sqlite3_bind_int64(stmt, 7, delayed_ns);
+	sqlite3_bind_int(stmt, 8, queue_len);
+	sqlite3_bind_int64(stmt, 9, dump_ns);
+
+	return step_and_reset(storage, stmt);
+}
+
+
+// SELF-TELEMETRY: one row per sample, stage columns in Collect_Task_Id order
+static int storage_add_self_row(Storage * storage, long timestamp, Self_Sample * self_sample){
+
+	if (storage -> insert_self == NULL){
+		if (exec_sql(storage -> db, "CREATE TABLE IF NOT EXISTS Self_Samples (timestamp INT, collect_ns INT, gpu_ns INT, proc_ns INT, net_ns INT, jobs_ns INT, "
+						"n_missed INT, queue_len INT, dump_ns INT, dump_bytes INT, rss_kb INT, cpu_ns INT);") == -1){
+			return -1;
+		}
+		storage -> insert_self = prepare_statement(storage -> db, "INSERT INTO Self_Samples (timestamp,collect_ns,gpu_ns,proc_ns,net_ns,jobs_ns,"
+						"n_missed,queue_len,dump_ns,dump_bytes,rss_kb,cpu_ns) VALUES (?,?,?,?,?,?,?,?,?,?,?,?);");
+		if (storage -> insert_self == NULL){
+			return -1;
+		}
+	}
+
+	sqlite3_stmt * stmt = storage -> insert_self;
+
+	sqlite3_bind_int64(stmt, 1, timestamp);
+	sqlite3_bind_int64(stmt, 2, self_sample -> collect_ns);
+	for (int i = 0; i < N_COLLECT_TASKS; i++){
+		sqlite3_bind_int64(stmt, 3 + i, self_sample -> stage_ns[i]);
+	}
+	sqlite3_bind_int(stmt, 3 + N_COLLECT_TASKS, self_sample -> n_missed_ticks);
+	sqlite3_bind_int(stmt, 4 + N_COLLECT_TASKS, self_sample -> queue_len);
+	sqlite3_bind_int64(stmt, 5 + N_COLLECT_TASKS, self_sample -> dump_ns);
+	sqlite3_bind_int64(stmt, 6 + N_COLLECT_TASKS, self_sample -> dump_bytes);
+	sqlite3_bind_int64(stmt, 7 + N_COLLECT_TASKS, self_sample -> rss_kb);
+	sqlite3_bind_int64(stmt, 8 + N_COLLECT_TASKS, self_sample -> cpu_ns);
+
+	if (step_and_reset(storage, stmt) == -1){
+		storage -> n_row_errors++;
+		return -1;
+	}
+	storage -> n_rows_written++;
+	return 0;
+}
+
+
+int dump_samples_buffer(Samples_Buffer * samples_buffer, Storage * storage){
+
+	int n_fields = samples_buffer -> n_fields;
+	int n_devices = samples_buffer -> n_devices;
+
+	int n_samples = samples_buffer -> n_samples;
+	unsigned short * fieldIds = samples_buffer -> field_ids;
+	unsigned short * fieldTypes = samples_buffer -> field_types;
+
+	// Saving Data
+	long host_vals[N_HOST_METRICS];
+	void * field_column;
+
+	long time_ns = 0;
+	if (n_samples > 0){
+		time_ns = get_sample_time_ns(samples_buffer, n_samples - 1);
+	}
+
+	// insert timestamp and field values for every sample
+	//	- the writer times the whole dump (Writer_Stats, Self_Samples)
+	// EXPLICITY START DB TRANSACTION SO IT DOESN't AUTO COMMIT
+	if (storage_begin(storage) == -1){
+		return -1;
+	}
+	
+	int columnar_err = 0;
+	switch (storage -> storage_mode){
+		case STORAGE_COLUMNAR:
+			// only the tick stats below go to the db
+			columnar_err = write_columnar_chunk(storage -> columnar_writer, samples_buffer);
+			break;
+		case STORAGE_WIDE:
+			// one row per sample and one per (sample, GPU), reads across the field columns
+			for (int i = 0; i < n_samples; i++){
+				get_host_values(samples_buffer, i, host_vals);
+				storage_add_host_row(storage, get_sample_time_ns(samples_buffer, i), host_vals, samples_buffer -> skipped_collectors[i]);
+				if (samples_buffer -> skipped_collectors[i] & COLLECTOR_BIT(COLLECTOR_GPU)){
+					continue;
+				}
+				for (int gpuId = 0; gpuId < n_devices; gpuId++){
+					storage_add_gpu_row(storage, get_sample_time_ns(samples_buffer, i), gpuId, samples_buffer, i);
+				}
+			}
+			break;
+		case STORAGE_EAV:
+			// CPU + NET dump
+			for (int i = 0; i < n_samples; i++){
+				get_host_values(samples_buffer, i, host_vals);
+				for (int k = 0; k < N_HOST_METRICS; k++){
+					if (is_host_metric_skipped(k, samples_buffer -> skipped_collectors[i])){
+						continue;
+					}
+					storage_add_row(storage, get_sample_time_ns(samples_buffer, i), -1, host_metrics[k].field_id, host_vals[k]);
+				}
+			}
+			// GPU Field dump, one linear scan per column
+			for (int gpuId = 0; gpuId < n_devices; gpuId++){
+				for (int fieldNum = 0; fieldNum < n_fields; fieldNum++){
+					field_column = FIELD_COLUMN(samples_buffer, gpuId * n_fields + fieldNum);
+					for (int i = 0; i < n_samples; i++){
+						if ((samples_buffer -> skipped_collectors[i] & COLLECTOR_BIT(COLLECTOR_GPU)) || (is_gpu_value_blank(field_column, i, fieldTypes[fieldNum]))){
+							continue;
+						}
+						storage_add_row(storage, get_sample_time_ns(samples_buffer, i), gpuId, fieldIds[fieldNum], get_gpu_value(field_column, i, fieldTypes[fieldNum]));
+					}
+				}
+			}
+			break;
+	}
+
+	// SOURCES THAT DIDN'T RUN FOR A SAMPLE GET NO ROWS BELOW (see collectors.h)
+
+	// PER-CORE UTILIZATION (same table for every mode)
+	if (samples_buffer -> n_core_bytes > 0){
+		for (int i = 0; i < n_samples; i++){
+			if (samples_buffer -> skipped_collectors[i] & COLLECTOR_BIT(COLLECTOR_PROC)){
+				continue;
+			}
+			if (storage_add_core_row(storage, get_sample_time_ns(samples_buffer, i), samples_buffer, i) == -1){
+				break;
+			}
+		}
+	}
+
+	// PER-JOB RESOURCES (same table for every mode, empty slots skipped)
+	int max_jobs = samples_buffer -> max_jobs;
+	Job_Sample * job_sample;
+	for (int i = 0; i < n_samples; i++){
+		if (samples_buffer -> skipped_collectors[i] & COLLECTOR_BIT(COLLECTOR_JOBS)){
+			continue;
+		}
+		for (int j = 0; j < max_jobs; j++){
+			job_sample = &(samples_buffer -> job_samples[i * max_jobs + j]);
+			if (job_sample -> job_id == 0){
+				break;
+			}
+			if (storage_add_job_row(storage, get_sample_time_ns(samples_buffer, i), job_sample) == -1){
+				break;
+			}
+		}
+	}
+
+	// GPU OWNERSHIP INTERVALS
+	if (max_jobs > 0){
+		dump_gpu_job_intervals(samples_buffer, storage);
+	}
+
+	// PER-PORT SERIES (same table for every mode, zero deltas skipped)
+	int n_port_series = samples_buffer -> n_port_series;
+	long * port_values;
+	for (int i = 0; i < n_samples; i++){
+		if (samples_buffer -> skipped_collectors[i] & COLLECTOR_BIT(COLLECTOR_NET)){
+			continue;
+		}
+		port_values = &(samples_buffer -> port_values[(size_t) i * n_port_series]);
+		for (int s = 0; s < n_port_series; s++){
+			if ((port_values[s] != 0) && (storage_add_port_row(storage, get_sample_time_ns(samples_buffer, i), samples_buffer -> port_series_ids[s], port_values[s]) == -1)){
+				break;
+			}
+		}
+	}
+
+	// GPU VALUES WITH THEIR OWN TIMESTAMPS (same table for every mode)
+	Gpu_Value * gpu_value;
+	for (int i = 0; i < samples_buffer -> n_gpu_values; i++){
+		gpu_value = &(samples_buffer -> gpu_values[i]);
+		if (storage_add_gpu_value_row(storage, gpu_value, fieldIds[gpu_value -> field_num], fieldTypes[gpu_value -> field_num]) == -1){
+			break;
+		}
+	}
+
+	// MONITOR SELF-TELEMETRY (same table for every mode, samples rebuilt from columnar chunks have none)
+	for (int i = 0; i < n_samples; i++){
+		if (samples_buffer -> self_samples[i].rss_kb == 0){
+			continue;
+		}
+		if (storage_add_self_row(storage, get_sample_time_ns(samples_buffer, i), &(samples_buffer -> self_samples[i])) == -1){
+			break;
+		}
+	}
+
+	// SCHEDULER STATS FOR THE TICKS IN THIS BUFFER
+	//	- keyed by the timestamp of the last sample
+	if ((samples_buffer -> n_samples > 0) && (samples_buffer -> tick_stats.n_ticks > 0)){
+		insert_tick_stats_to_db(storage, time_ns, &(samples_buffer -> tick_stats));
+	}
+	
+	// EXPLICITY COMMIT TRANSACTION
+	//	- flushes the partially filled batch first
+	int err = storage_commit(storage);
+
+	if ((err == -1) || (columnar_err == -1)){
+		return -1;
+	}
+
+	reset_samples_buffer(samples_buffer);
+
+	return 0;
+	
+}
+
+// called by the writer after a dump (or when a buffer gets dropped) before the buffer is filled again
+void reset_samples_buffer(Samples_Buffer * samples_buffer){
+
+	// values DCGM does not report for a tick stay 0 instead of the last buffer's
+	clear_samples_arena(samples_buffer, samples_buffer -> n_samples);
+
+	samples_buffer -> n_samples = 0;
+	samples_buffer -> n_gpu_values = 0;
+	reset_tick_stats(&(samples_buffer -> tick_stats));
+
+	// samples are persisted (or deliberately dropped), nothing left to recover from the mapping
+	if (samples_buffer -> mapped_slot != NULL){
+		__atomic_store_n(&(samples_buffer -> mapped_slot -> n_committed), 0, __ATOMIC_RELEASE);
+	}
+}
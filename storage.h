@@ -0,0 +1,99 @@
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include "columnar.h"
+
+// rows bound into one multi-row INSERT
+//	- 4 parameters per row, stays under the old SQLITE_MAX_VARIABLE_NUMBER default of 999
+#define STORAGE_BATCH_ROWS 200
+
+// number of hardcoded host metrics (cpu, memory, network, sampling period) stored per sample
+#define N_HOST_METRICS 10
+
+// How samples are laid out in the db
+//	- EAV: Data table with one row per (timestamp, device_id, field_id, value)
+//	- WIDE: Host_Samples (one row per sample) + Gpu_Samples (one row per sample per GPU,
+//	  one column per field), with a Data view on top for the old queries
+//	- COLUMNAR: compressed chunks appended to <hostname>.mts (see columnar.h), only the
+//	  scheduler / writer stats go to the db
+typedef enum storage_mode {
+	STORAGE_EAV,
+	STORAGE_WIDE,
+	STORAGE_COLUMNAR
+} Storage_Mode;
+
+// Owns the prepared statements for one db connection
+//	- statements are prepared once and reset/rebound for every batch
+//	- not thread safe, each thread that writes samples needs its own
+typedef struct storage {
+	sqlite3 * db;
+	Storage_Mode storage_mode;
+	int batch_rows;
+	// INSERT INTO Data ... VALUES (?,?,?,?),(?,?,?,?),... (batch_rows tuples)
+	sqlite3_stmt * insert_batch;
+	// used to flush whatever is left when the transaction commits
+	sqlite3_stmt * insert_single;
+	// WIDE ONLY
+	sqlite3_stmt * insert_host;
+	sqlite3_stmt * insert_gpu;
+	// PER-CORE (any mode, prepared with the Cpu_Core_Samples table the first time a buffer has per-core data)
+	sqlite3_stmt * insert_core;
+	// PER-JOB (any mode, prepared with the Job_Samples table the first time a buffer has job slots)
+	sqlite3_stmt * insert_job;
+	// (job_id, gpu_id) ownership intervals, widened once per buffer
+	sqlite3_stmt * upsert_gpu_job;
+	// PER-PORT (any mode, prepared with the Port_Samples table the first time a buffer has port series)
+	sqlite3_stmt * insert_port;
+	// SELF-TELEMETRY (any mode, prepared with the Self_Samples table on the first dump, see self_stats.h)
+	sqlite3_stmt * insert_self;
+	// GPU VALUES (any mode, prepared with the Gpu_Values table the first time a buffer has values on their own timeline)
+	sqlite3_stmt * insert_gpu_value;
+	// SCHEDULER STATS (any mode, prepared with the Ticks, Tick_Latency and Tick_Stages tables on the first dump with ticks)
+	sqlite3_stmt * insert_ticks;
+	sqlite3_stmt * insert_tick_latency;
+	sqlite3_stmt * insert_tick_stage;
+	// WRITER STATS (prepared with the Writer_Stats table after the first dump, one row per dump from the writer thread)
+	sqlite3_stmt * insert_writer_stats;
+	// COLUMNAR ONLY (set by the caller after init)
+	Columnar_Writer * columnar_writer;
+	sqlite3_stmt * begin;
+	sqlite3_stmt * commit;
+	sqlite3_stmt * rollback;
+	// statements that failed since storage_begin, any rolls the dump back at storage_commit
+	int n_txn_errors;
+	// (timestamp, device_id, field_id, value) rows waiting for the next batch
+	int n_pending;
+	long * pending;
+	long n_rows_written;
+	long n_row_errors;
+} Storage;
+
+
+int parse_storage_mode(char * str, Storage_Mode * storage_mode);
+
+// creates (or migrates) the sample tables for the mode, call once before init_storage
+int create_storage_tables(sqlite3 * db, Storage_Mode storage_mode, int n_fields, unsigned short * field_ids);
+
+Storage * init_storage(sqlite3 * db, Storage_Mode storage_mode, int batch_rows, int n_fields, unsigned short * field_ids);
+void destroy_storage(Storage * storage);
+
+int storage_begin(Storage * storage);
+int storage_add_row(Storage * storage, long timestamp, long device_id, long field_id, long value);
+// commits the dump, or rolls it back if any statement since storage_begin failed (-1)
+int storage_commit(Storage * storage);
+
+// PER-PORT SERIES
+//	- Port_Series (series_id, port, counter) names every series, ids stay the same across runs
+//	- Port_Samples (timestamp, series_id, value) holds the per-sample deltas, a sample without a
+//	  row for a series had a delta of 0
+// fills series_ids for the n_series (port, counter) pairs, adding the ones not seen before, -1 on error
+int register_port_series(sqlite3 * db, int n_series, char ** ports, char ** counters, int * series_ids);
+
+// one row of Writer_Stats, written outside of the dump transactions
+int storage_add_writer_stats_row(Storage * storage, long timestamp_ns, long n_submitted, long n_dumped, long n_dump_errors, long n_dropped,
+					long n_delayed, long delayed_ns, int queue_len, long dump_ns);
+
+int dump_samples_buffer(Samples_Buffer * samples_buffer, Storage * storage);
+void reset_samples_buffer(Samples_Buffer * samples_buffer);
+
+#endif
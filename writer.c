@@ -0,0 +1,310 @@
+#define _GNU_SOURCE
+
+#include "job_stats.h"
+#include "monitoring.h"
+#include "storage.h"
+#include "writer.h"
+#include "self_stats.h"
+
+
+int parse_overflow_policy(char * str, Overflow_Policy * overflow_policy){
+
+	if (strcmp(str, "block") == 0){
+		*overflow_policy = OVERFLOW_BLOCK;
+	}
+	else if (strcmp(str, "drop_oldest") == 0){
+		*overflow_policy = OVERFLOW_DROP_OLDEST;
+	}
+	else if (strcmp(str, "drop_newest") == 0){
+		*overflow_policy = OVERFLOW_DROP_NEWEST;
+	}
+	else {
+		fprintf(stderr, "Unknown overflow policy: %s (expected block, drop_oldest or drop_newest)\n", str);
+		return -1;
+	}
+	return 0;
+}
+
+// copy of the counters taken under the writer's lock
+typedef struct writer_counters {
+	long n_submitted;
+	long n_dumped;
+	long n_dump_errors;
+	long n_dropped;
+	long n_delayed;
+	long delayed_ns;
+} Writer_Counters;
+
+// caller holds the writer's lock
+static void copy_writer_counters(Buffer_Writer * writer, Writer_Counters * counters){
+	counters -> n_submitted = writer -> n_submitted;
+	counters -> n_dumped = writer -> n_dumped;
+	counters -> n_dump_errors = writer -> n_dump_errors;
+	counters -> n_dropped = writer -> n_dropped;
+	counters -> n_delayed = writer -> n_delayed;
+	counters -> delayed_ns = writer -> delayed_ns;
+}
+
+void * writer_thread_main(void * arg){
+
+	Buffer_Writer * writer = (Buffer_Writer *) arg;
+
+	Samples_Buffer * samples_buffer;
+	Writer_Task task;
+	Writer_Counters counters;
+	struct timespec start, end;
+	long dump_ns;
+	int queue_len, err;
+
+	// bytes this thread writes during a dump
+	int io_fd = open_thread_io_file();
+	long io_start = -1;
+	long io_end = -1;
+
+	pthread_mutex_lock(&(writer -> lock));
+	while (true){
+		while ((writer -> queue_len == 0) && (writer -> n_tasks == 0) && (!writer -> stop)){
+			pthread_cond_wait(&(writer -> queue_not_empty), &(writer -> lock));
+		}
+
+		// tasks are a few statements each, run them before the next dump
+		if (writer -> n_tasks > 0){
+			task = writer -> tasks[writer -> task_head];
+			writer -> task_head = (writer -> task_head + 1) % WRITER_MAX_TASKS;
+			writer -> n_tasks--;
+			pthread_mutex_unlock(&(writer -> lock));
+			task.run(task.arg);
+			pthread_mutex_lock(&(writer -> lock));
+			continue;
+		}
+
+		// only exit once everything queued has been flushed
+		if (writer -> queue_len == 0){
+			break;
+		}
+
+		samples_buffer = writer -> queue[writer -> queue_head];
+		writer -> queue_head = (writer -> queue_head + 1) % writer -> max_queue_depth;
+		writer -> queue_len--;
+		queue_len = writer -> queue_len;
+		pthread_cond_signal(&(writer -> queue_not_full));
+		pthread_mutex_unlock(&(writer -> lock));
+
+		if (io_fd != -1){
+			io_start = read_thread_written_bytes(io_fd);
+		}
+		clock_gettime(CLOCK_REALTIME, &start);
+		err = dump_samples_buffer(samples_buffer, writer -> storage);
+		clock_gettime(CLOCK_REALTIME, &end);
+		dump_ns = ((end.tv_sec - start.tv_sec) * 1000000000L) + (end.tv_nsec - start.tv_nsec);
+		if (io_fd != -1){
+			io_end = read_thread_written_bytes(io_fd);
+		}
+
+		pthread_mutex_lock(&(writer -> lock));
+		if (err == -1){
+			fprintf(stderr, "Error dumping buffer to file. Skipping this dump and collecting new data...\n");
+			writer -> n_dump_errors++;
+			reset_samples_buffer(samples_buffer);
+		}
+		writer -> n_dumped++;
+		writer -> dump_ns_total += dump_ns;
+		if ((io_start != -1) && (io_end != -1)){
+			writer -> dump_bytes_total += io_end - io_start;
+		}
+		writer -> free_buffers[writer -> n_free] = samples_buffer;
+		writer -> n_free++;
+		// the sampler keeps updating its counters while the row is written
+		copy_writer_counters(writer, &counters);
+		pthread_mutex_unlock(&(writer -> lock));
+
+		storage_add_writer_stats_row(writer -> storage, end.tv_sec * 1000000000L + end.tv_nsec, counters.n_submitted, counters.n_dumped, counters.n_dump_errors,
+						counters.n_dropped, counters.n_delayed, counters.delayed_ns, queue_len, dump_ns);
+
+		pthread_mutex_lock(&(writer -> lock));
+	}
+	pthread_mutex_unlock(&(writer -> lock));
+
+	if (io_fd != -1){
+		close(io_fd);
+	}
+
+	return NULL;
+}
+
+Buffer_Writer * init_buffer_writer(Storage * storage, Samples_Buffer ** buffers, int max_queue_depth, Overflow_Policy overflow_policy){
+
+	if (max_queue_depth < 1){
+		fprintf(stderr, "Queue depth must be at least 1\n");
+		return NULL;
+	}
+
+	Buffer_Writer * writer = (Buffer_Writer *) malloc(sizeof(Buffer_Writer));
+	if (writer == NULL){
+		fprintf(stderr, "Could not allocate memory for buffer writer\n");
+		return NULL;
+	}
+
+	int n_buffers = max_queue_depth + 2;
+
+	writer -> storage = storage;
+	writer -> overflow_policy = overflow_policy;
+	writer -> n_buffers = n_buffers;
+	writer -> buffers = buffers;
+	writer -> max_queue_depth = max_queue_depth;
+	writer -> queue_head = 0;
+	writer -> queue_len = 0;
+	writer -> task_head = 0;
+	writer -> n_tasks = 0;
+	writer -> n_tasks_dropped = 0;
+	writer -> stop = false;
+	writer -> n_submitted = 0;
+	writer -> n_dumped = 0;
+	writer -> n_dump_errors = 0;
+	writer -> n_dropped = 0;
+	writer -> n_delayed = 0;
+	writer -> delayed_ns = 0;
+	writer -> dump_ns_total = 0;
+	writer -> dump_bytes_total = 0;
+
+	writer -> free_buffers = (Samples_Buffer **) malloc(n_buffers * sizeof(Samples_Buffer *));
+	writer -> queue = (Samples_Buffer **) malloc(max_queue_depth * sizeof(Samples_Buffer *));
+	writer -> tasks = (Writer_Task *) malloc(WRITER_MAX_TASKS * sizeof(Writer_Task));
+	if ((writer -> free_buffers == NULL) || (writer -> queue == NULL) || (writer -> tasks == NULL)){
+		fprintf(stderr, "Could not allocate memory for buffer writer queue\n");
+		return NULL;
+	}
+
+	for (int i = 0; i < n_buffers; i++){
+		writer -> free_buffers[i] = buffers[i];
+	}
+	writer -> n_free = n_buffers;
+
+	pthread_mutex_init(&(writer -> lock), NULL);
+	pthread_cond_init(&(writer -> queue_not_empty), NULL);
+	pthread_cond_init(&(writer -> queue_not_full), NULL);
+
+	int ret = pthread_create(&(writer -> thread), NULL, writer_thread_main, (void *) writer);
+	if (ret != 0){
+		fprintf(stderr, "Could not create writer thread: %s\n", strerror(ret));
+		return NULL;
+	}
+
+	return writer;
+}
+
+Samples_Buffer * acquire_samples_buffer(Buffer_Writer * writer){
+
+	Samples_Buffer * samples_buffer = NULL;
+
+	pthread_mutex_lock(&(writer -> lock));
+	if (writer -> n_free > 0){
+		writer -> n_free--;
+		samples_buffer = writer -> free_buffers[writer -> n_free];
+	}
+	pthread_mutex_unlock(&(writer -> lock));
+
+	return samples_buffer;
+}
+
+Samples_Buffer * submit_samples_buffer(Buffer_Writer * writer, Samples_Buffer * full_buffer){
+
+	Samples_Buffer * dropped_buffer;
+	struct timespec start, end;
+
+	pthread_mutex_lock(&(writer -> lock));
+
+	writer -> n_submitted++;
+
+	if (writer -> queue_len == writer -> max_queue_depth){
+		switch (writer -> overflow_policy){
+			case OVERFLOW_BLOCK:
+				writer -> n_delayed++;
+				clock_gettime(CLOCK_MONOTONIC, &start);
+				while (writer -> queue_len == writer -> max_queue_depth){
+					pthread_cond_wait(&(writer -> queue_not_full), &(writer -> lock));
+				}
+				clock_gettime(CLOCK_MONOTONIC, &end);
+				writer -> delayed_ns += ((end.tv_sec - start.tv_sec) * 1000000000L) + (end.tv_nsec - start.tv_nsec);
+				break;
+			case OVERFLOW_DROP_OLDEST:
+				dropped_buffer = writer -> queue[writer -> queue_head];
+				writer -> queue_head = (writer -> queue_head + 1) % writer -> max_queue_depth;
+				writer -> queue_len--;
+				reset_samples_buffer(dropped_buffer);
+				writer -> free_buffers[writer -> n_free] = dropped_buffer;
+				writer -> n_free++;
+				writer -> n_dropped++;
+				fprintf(stderr, "Writer is behind, dropped oldest queued buffer (%ld dropped so far)\n", writer -> n_dropped);
+				break;
+			case OVERFLOW_DROP_NEWEST:
+				reset_samples_buffer(full_buffer);
+				writer -> n_dropped++;
+				fprintf(stderr, "Writer is behind, dropped newest buffer (%ld dropped so far)\n", writer -> n_dropped);
+				pthread_mutex_unlock(&(writer -> lock));
+				return full_buffer;
+		}
+	}
+
+	int tail = (writer -> queue_head + writer -> queue_len) % writer -> max_queue_depth;
+	writer -> queue[tail] = full_buffer;
+	writer -> queue_len++;
+	pthread_cond_signal(&(writer -> queue_not_empty));
+
+	// with max_queue_depth + 2 buffers there is always a free one once the full one is queued
+	writer -> n_free--;
+	Samples_Buffer * empty_buffer = writer -> free_buffers[writer -> n_free];
+
+	pthread_mutex_unlock(&(writer -> lock));
+
+	return empty_buffer;
+}
+
+int queue_writer_task(Buffer_Writer * writer, Writer_Task_Function run, void * arg){
+
+	pthread_mutex_lock(&(writer -> lock));
+
+	if (writer -> n_tasks == WRITER_MAX_TASKS){
+		writer -> n_tasks_dropped++;
+		fprintf(stderr, "Writer is behind, dropped a task (%ld dropped so far)\n", writer -> n_tasks_dropped);
+		pthread_mutex_unlock(&(writer -> lock));
+		return -1;
+	}
+
+	int tail = (writer -> task_head + writer -> n_tasks) % WRITER_MAX_TASKS;
+	writer -> tasks[tail].run = run;
+	writer -> tasks[tail].arg = arg;
+	writer -> n_tasks++;
+	pthread_cond_signal(&(writer -> queue_not_empty));
+
+	pthread_mutex_unlock(&(writer -> lock));
+
+	return 0;
+}
+
+void get_writer_totals(Buffer_Writer * writer, long * dump_ns_total, long * dump_bytes_total, int * queue_len){
+
+	pthread_mutex_lock(&(writer -> lock));
+	*dump_ns_total = writer -> dump_ns_total;
+	*dump_bytes_total = writer -> dump_bytes_total;
+	*queue_len = writer -> queue_len;
+	pthread_mutex_unlock(&(writer -> lock));
+}
+
+void stop_buffer_writer(Buffer_Writer * writer){
+
+	pthread_mutex_lock(&(writer -> lock));
+	writer -> stop = true;
+	pthread_cond_signal(&(writer -> queue_not_empty));
+	pthread_mutex_unlock(&(writer -> lock));
+
+	pthread_join(writer -> thread, NULL);
+
+	pthread_mutex_destroy(&(writer -> lock));
+	pthread_cond_destroy(&(writer -> queue_not_empty));
+	pthread_cond_destroy(&(writer -> queue_not_full));
+
+	free(writer -> free_buffers);
+	free(writer -> queue);
+	free(writer -> tasks);
+}
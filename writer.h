@@ -0,0 +1,93 @@
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <pthread.h>
+
+// What to do when the sampler fills a buffer but the writer is still behind
+// by max_queue_depth buffers:
+//	- BLOCK: sampler waits for the writer (no data lost, ticks get missed)
+//	- DROP_OLDEST: throw away the oldest queued buffer, keep sampling
+//	- DROP_NEWEST: throw away the buffer just filled, keep sampling
+typedef enum overflow_policy {
+	OVERFLOW_BLOCK,
+	OVERFLOW_DROP_OLDEST,
+	OVERFLOW_DROP_NEWEST
+} Overflow_Policy;
+
+// WRITER TASKS
+//	- other db work the sampling loop hands off (job events, sacct results) so it never waits on SQLite
+//	- run on the writer thread between dumps with the writer's connection, in the order queued
+//	- run owns arg (frees it), also when it fails
+typedef int (*Writer_Task_Function)(void * arg);
+
+typedef struct writer_task {
+	Writer_Task_Function run;
+	void * arg;
+} Writer_Task;
+
+// tasks waiting at once, more get dropped
+#define WRITER_MAX_TASKS 1024
+
+typedef struct buffer_writer {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	// signaled when a buffer or a task is queued (or on stop)
+	pthread_cond_t queue_not_empty;
+	// signaled when the writer takes a buffer off the queue
+	pthread_cond_t queue_not_full;
+	// the writer thread has its own connection (and prepared statements) to the db
+	Storage * storage;
+	Overflow_Policy overflow_policy;
+	// all buffers = 1 being filled + 1 being written + max_queue_depth queued
+	int n_buffers;
+	Samples_Buffer ** buffers;
+	// free buffers are a stack
+	int n_free;
+	Samples_Buffer ** free_buffers;
+	// full buffers waiting to be dumped are a ring
+	int max_queue_depth;
+	int queue_head;
+	int queue_len;
+	Samples_Buffer ** queue;
+	// tasks are a ring of WRITER_MAX_TASKS
+	int task_head;
+	int n_tasks;
+	Writer_Task * tasks;
+	long n_tasks_dropped;
+	bool stop;
+	// COUNTERS
+	long n_submitted;
+	long n_dumped;
+	long n_dump_errors;
+	long n_dropped;
+	// number of times the sampler had to wait for a free buffer
+	long n_delayed;
+	long delayed_ns;
+	// RUNNING TOTALS OF EVERY DUMP (self-telemetry, see self_stats.h)
+	//	- dump_bytes_total is 0 if /proc/thread-self/io couldn't be opened
+	long dump_ns_total;
+	long dump_bytes_total;
+} Buffer_Writer;
+
+
+Buffer_Writer * init_buffer_writer(Storage * storage, Samples_Buffer ** buffers, int max_queue_depth, Overflow_Policy overflow_policy);
+
+// returns an empty buffer for the sampler to fill
+Samples_Buffer * acquire_samples_buffer(Buffer_Writer * writer);
+
+// queue a full buffer for the writer thread and return an empty one to keep sampling into
+Samples_Buffer * submit_samples_buffer(Buffer_Writer * writer, Samples_Buffer * full_buffer);
+
+// queues run(arg) for the writer thread, never waits
+//	- -1 if WRITER_MAX_TASKS are already waiting, arg is then still the caller's
+int queue_writer_task(Buffer_Writer * writer, Writer_Task_Function run, void * arg);
+
+// dump totals and current queue depth, for the sampler's self-telemetry
+void get_writer_totals(Buffer_Writer * writer, long * dump_ns_total, long * dump_bytes_total, int * queue_len);
+
+// dumps everything still queued (and runs the tasks) then joins the thread
+void stop_buffer_writer(Buffer_Writer * writer);
+
+int parse_overflow_policy(char * str, Overflow_Policy * overflow_policy);
+
+#endif